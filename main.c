@@ -26,6 +26,12 @@
 #include "src/file_io.h"
 #include "src/drawing.h"
 #include "src/actions.h"
+#include "src/benchmark.h"
+#include "src/connection_routes.h"
+#include "src/arena.h"
+#include "src/undo_journal.h"
+#include "src/edit_journal.h"
+#include "src/frame_stats.h"
 
 // Global variables for cursor position
 double cursorX = 0.0;
@@ -39,6 +45,10 @@ double panStartScrollY = 0.0;
 // Hovered connection tracking
 int hoveredConnection = -1;
 
+// Redraw scheduling: a frame is drawn only when something on screen may have changed
+static bool redrawRequested = true;
+static int hoveredButton = -1;   // Index into hoverButtonY, -1 = none
+
 // Scroll offset for panning
 double scrollOffsetX = 0.0;
 double scrollOffsetY = 0.0;
@@ -61,29 +71,34 @@ const float redoButtonY = 0.4f;   // Orange redo button
 
 // Flowchart node and connection data (now in flowchart_state.h)
 
-FlowNode nodes[MAX_NODES];
+FlowNode *nodes = NULL;
 int nodeCount = 0;
+int nodeCapacity = 0;
 
-Connection connections[MAX_CONNECTIONS];
+Connection *connections = NULL;
 int connectionCount = 0;
+int connectionCapacity = 0;
 
 // IF Block tracking system (now in flowchart_state.h)
 
-IFBlock ifBlocks[MAX_IF_BLOCKS];
+IFBlock *ifBlocks = NULL;
 int ifBlockCount = 0;
+int ifBlockCapacity = 0;
 
 // Cycle tracking system (now in flowchart_state.h)
 
-CycleBlock cycleBlocks[MAX_CYCLE_BLOCKS];
+CycleBlock *cycleBlocks = NULL;
 int cycleBlockCount = 0;
+int cycleBlockCapacity = 0;
 
 // Undo/Redo system (now in flowchart_state.h)
 
-FlowchartState undoHistory[MAX_UNDO_HISTORY];
 int undoHistoryCount = 0;
 int undoHistoryIndex = -1;  // -1 means no undo available, 0 means first state, etc.
 
 // Forward declarations
+int hit_connection(double x, double y, float threshold);
+bool cursor_over_button(float buttonX, float buttonY, GLFWwindow* window);
 void rebuild_variable_table(void);
 int get_if_branch_type(int connIndex);
 void reposition_convergence_point(int ifBlockIndex, bool shouldPushNodesBelow);
@@ -92,6 +107,11 @@ bool is_valid_if_converge_connection(int fromNode, int toNode);
 void save_state_for_undo(void);
 void perform_undo(void);
 void perform_redo(void);
+void perform_switch_branch(int direction);
+void begin_edit(void);
+void mark_edit_dirty(int flags);
+void commit_edit(void);
+void abort_edit(void);
 int calculate_branch_depth(int ifBlockIndex, int branchType);
 bool is_valid_variable_name(const char* name);
 Variable* find_variable(const char* name);
@@ -101,24 +121,6 @@ void extract_array_accesses(const char* expr, char arrayNames[][MAX_VAR_NAME_LEN
                                    char indexExprs[][MAX_VALUE_LENGTH], int* accessCount);
 
 // Cycle helper utilities
-int find_cycle_block_by_cycle_node(int nodeIndex) {
-    for (int i = 0; i < cycleBlockCount; i++) {
-        if (cycleBlocks[i].cycleNodeIndex == nodeIndex) {
-            return i;
-        }
-    }
-    return -1;
-}
-
-int find_cycle_block_by_end_node(int nodeIndex) {
-    for (int i = 0; i < cycleBlockCount; i++) {
-        if (cycleBlocks[i].cycleEndNodeIndex == nodeIndex) {
-            return i;
-        }
-    }
-    return -1;
-}
-
 int calculate_cycle_depth(int cycleIndex) {
     int depth = 0;
     int current = cycleIndex;
@@ -171,7 +173,7 @@ Variable variables[MAX_VARIABLES];
 int variableCount = 0;
 
 // Popup menu state (types now in flowchart_state.h)
-PopupMenu popupMenu = {false, MENU_TYPE_CONNECTION, 0.0, 0.0, -1, -1};
+PopupMenu popupMenu = {false, MENU_TYPE_CONNECTION, 0.0, 0.0, -1, {-1, 0}};
 
 // Menu item dimensions
 // Menu item dimensions - reduced sizes for better fit on larger window
@@ -256,6 +258,42 @@ float calculate_block_width(const char* text, float fontSize, float minWidth) {
     return gridAlignedWidth > minWidth ? gridAlignedWidth : minWidth;
 }
 
+void request_redraw(void) {
+    redrawRequested = true;
+}
+
+// Recompute what the cursor highlights (connection under it, button under it).
+// Returns true if that changed.
+static bool update_hover(GLFWwindow* window) {
+    static const float *const hoverButtonY[] = {
+        &closeButtonY, &saveButtonY, &loadButtonY, &exportButtonY, &undoButtonY, &redoButtonY
+    };
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+    float aspectRatio = height > 0 ? (float)width / (float)height : 1.0f;
+    
+    int button = -1;
+    for (int i = 0; i < (int)(sizeof(hoverButtonY) / sizeof(hoverButtonY[0])); i++) {
+        if (cursor_over_button(buttonX * aspectRatio, *hoverButtonY[i], window)) {
+            button = i;
+            break;
+        }
+    }
+    
+    // Transformation: screen = scale * (world - scrollOffset/scale) = scale * world - scrollOffset
+    // So: world = (screen + scrollOffset) / scale
+    double worldCursorX = (cursorX + scrollOffsetX) / FLOWCHART_SCALE;
+    double worldCursorY = (cursorY + scrollOffsetY) / FLOWCHART_SCALE;
+    FRAME_PHASE_BEGIN(FRAME_PHASE_HOVER);
+    int connection = hit_connection(worldCursorX, worldCursorY, 0.05f);
+    FRAME_PHASE_END(FRAME_PHASE_HOVER);
+    
+    bool changed = (button != hoveredButton || connection != hoveredConnection);
+    hoveredButton = button;
+    hoveredConnection = connection;
+    return changed;
+}
+
 // Cursor position callback
 void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
     int width, height;
@@ -279,6 +317,12 @@ void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
         scrollOffsetX = panStartScrollX - deltaX;
         scrollOffsetY = panStartScrollY - deltaY;
     }
+    
+    // Moving the cursor only shows up on screen while panning, over an open menu,
+    // or when it changes what is highlighted
+    if (isPanning || popupMenu.active || update_hover(window)) {
+        request_redraw();
+    }
 }
 
 // Scroll callback for panning (both horizontal and vertical)
@@ -286,6 +330,20 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
     (void)window;   // Mark as intentionally unused
     scrollOffsetX -= xoffset * 0.1;  // Smooth horizontal scrolling factor
     scrollOffsetY += yoffset * 0.1;  // Smooth vertical scrolling factor
+    request_redraw();
+}
+
+// The window was uncovered or resized
+void window_refresh_callback(GLFWwindow* window) {
+    (void)window;
+    request_redraw();
+}
+
+void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
+    (void)window;
+    (void)width;
+    (void)height;
+    request_redraw();
 }
 
 // Check if cursor is over a menu item (deprecated - menu width is now dynamic)
@@ -311,6 +369,7 @@ bool cursor_over_button(float buttonX, float buttonY, GLFWwindow* window) {
 // Find which node the cursor is over
 int hit_node(double x, double y) {
     for (int i = 0; i < nodeCount; ++i) {
+        if (!node_is_live(i)) continue;
         const FlowNode *n = &nodes[i];
         
         // Check if point is within node bounds
@@ -350,194 +409,48 @@ bool is_cycle_loopback(int connIndex) {
     int from = connections[connIndex].fromNode;
     int to = connections[connIndex].toNode;
     
-    for (int c = 0; c < cycleBlockCount; c++) {
-        int cycleNode = cycleBlocks[c].cycleNodeIndex;
-        int endNode = cycleBlocks[c].cycleEndNodeIndex;
-        
-        // For WHILE/FOR: loopback is end -> cycle (backwards)
-        // For DO: loopback is cycle -> end (backwards from normal flow)
-        // The loopback is always the connection that goes in the "backwards" direction
-        if (cycleBlocks[c].cycleType == CYCLE_DO) {
-            // DO: loopback is cycle -> end (this is the bracket line)
-            if (from == cycleNode && to == endNode) {
-                return true;
-            }
-        } else {
-            // WHILE/FOR: loopback is end -> cycle (this is the bracket line)
-            if (from == endNode && to == cycleNode) {
-                return true;
-            }
-        }
+    // For WHILE/FOR: loopback is end -> cycle (backwards)
+    // For DO: loopback is cycle -> end (backwards from normal flow)
+    // The loopback is always the connection that goes in the "backwards" direction
+    int c = find_cycle_block_by_end_node(from);
+    if (c >= 0 && cycleBlocks[c].cycleType != CYCLE_DO && cycleBlocks[c].cycleNodeIndex == to) {
+        return true;
+    }
+    c = find_cycle_block_by_cycle_node(from);
+    if (c >= 0 && cycleBlocks[c].cycleType == CYCLE_DO && cycleBlocks[c].cycleEndNodeIndex == to) {
+        return true;
     }
     return false;
 }
 
 // Find which connection (L-shaped path) the cursor is near
 int hit_connection(double x, double y, float threshold) {
+    const ConnectionRoute *routes = get_connection_routes();
+    if (!routes) {
+        return -1;
+    }
+    
+    float px = (float)x;
+    float py = (float)y;
     for (int i = 0; i < connectionCount; ++i) {
+        const ConnectionRoute *route = &routes[i];
+        
         // Skip cycle loopback connections (they're drawn as bracket lines, not clickable)
-        if (is_cycle_loopback(i)) {
+        // and removed entries
+        if (route->kind == CONNECTION_LOOPBACK || route->kind == CONNECTION_REMOVED) {
             continue;
         }
         
-        const FlowNode *from = &nodes[connections[i].fromNode];
-        const FlowNode *to   = &nodes[connections[i].toNode];
-        
-        // Determine if this is an IF branch connection
-        int branchType = get_if_branch_type(i);
-        
-        float dist;
-        
-        if (branchType == 0) {
-            // True branch (3 segments)
-            float x1 = (float)(from->x - from->width * 0.5f);
-            float y1 = (float)from->y;
-            
-            float x2, y2;
-            if (to->type == NODE_CONVERGE) {
-                x2 = (float)(to->x - to->width * 0.5f);
-                y2 = (float)to->y;
-            } else {
-                x2 = (float)to->x;
-                y2 = (float)(to->y + to->height * 0.5f);
-            }
-            
-            // Find IF block to get dynamic branch width
-            int ifBlockIdx = -1;
-            for (int j = 0; j < ifBlockCount; j++) {
-                if (ifBlocks[j].ifNodeIndex == connections[i].fromNode) {
-                    ifBlockIdx = j;
-                    break;
-                }
-            }
-            double leftWidth = (ifBlockIdx >= 0) ? ifBlocks[ifBlockIdx].leftBranchWidth : 1.0;
-            float branchX = (float)(from->x - leftWidth);  // Branch column center using dynamic width
-            
-            // Check distance to all three segments
-            float dist1 = point_to_line_segment_dist((float)x, (float)y, x1, y1, branchX, y1);
-            float dist2 = point_to_line_segment_dist((float)x, (float)y, branchX, y1, branchX, y2);
-            float dist3 = point_to_line_segment_dist((float)x, (float)y, branchX, y2, x2, y2);
-            
-            dist = fmin(dist1, fmin(dist2, dist3));
-            
-        } else if (branchType == 1) {
-            // False branch (3 segments)
-            float x1 = (float)(from->x + from->width * 0.5f);
-            float y1 = (float)from->y;
-            
-            float x2, y2;
-            if (to->type == NODE_CONVERGE) {
-                x2 = (float)(to->x + to->width * 0.5f);
-                y2 = (float)to->y;
-            } else {
-                x2 = (float)to->x;
-                y2 = (float)(to->y + to->height * 0.5f);
-            }
-            
-            // Find IF block to get dynamic branch width
-            int ifBlockIdx = -1;
-            for (int j = 0; j < ifBlockCount; j++) {
-                if (ifBlocks[j].ifNodeIndex == connections[i].fromNode) {
-                    ifBlockIdx = j;
-                    break;
-                }
-            }
-            double rightWidth = (ifBlockIdx >= 0) ? ifBlocks[ifBlockIdx].rightBranchWidth : 1.0;
-            float branchX = (float)(from->x + rightWidth);  // Branch column center using dynamic width
-            
-            // Check distance to all three segments
-            float dist1 = point_to_line_segment_dist((float)x, (float)y, x1, y1, branchX, y1);
-            float dist2 = point_to_line_segment_dist((float)x, (float)y, branchX, y1, branchX, y2);
-            float dist3 = point_to_line_segment_dist((float)x, (float)y, branchX, y2, x2, y2);
-            
-            dist = fmin(dist1, fmin(dist2, dist3));
-            
-        } else {
-            // Normal connection
-            // Check if both nodes are in the same branch
-            bool sameBranch = (from->branchColumn != 0 && from->branchColumn == to->branchColumn);
-        
-        float x1 = (float)from->x;
-        // For cycle end blocks, use radius (width/2) instead of height/2 for connector position
-        float y1;
-        if (from->type == NODE_CYCLE_END) {
-            float fromRadius = from->width * 0.5f;
-            y1 = (float)(from->y - fromRadius);
-        } else {
-            y1 = (float)(from->y - from->height * 0.5f);
+        // Nothing on the route can be within threshold if its bounding box is not
+        if (px < route->minX - threshold || px > route->maxX + threshold ||
+            py < route->minY - threshold || py > route->maxY + threshold) {
+            continue;
         }
         
-        float x2 = (float)to->x;
-        // For cycle end blocks, use radius (width/2) instead of height/2 for connector position
-        float y2;
-        if (to->type == NODE_CYCLE_END) {
-            float toRadius = to->width * 0.5f;
-            y2 = (float)(to->y + toRadius);
-        } else {
-            y2 = (float)(to->y + to->height * 0.5f);
-        }
-        
-            // Special handling for connections TO convergence point from branch blocks
-            // This includes nodes in branches (branchColumn != 0) OR nodes that are owned by an IF (nested IF false branches can have branchColumn=0)
-            if (to->type == NODE_CONVERGE && (from->branchColumn != 0 || from->owningIfBlock >= 0)) {
-                // Source is in a branch, target is convergence
-                float branchX = (float)from->x;  // Stay in branch column
-                
-                // Determine which side of convergence to connect to based on FROM's branchColumn
-                // relative to the convergence's branchColumn (for nested IFs)
-                float convergeX;
-                if (to->branchColumn == 0) {
-                    // Convergence is in main branch - use from's branchColumn
-                    if (from->branchColumn < 0) {
-                        convergeX = (float)(to->x - to->width * 0.5f);
-                    } else {
-                        convergeX = (float)(to->x + to->width * 0.5f);
-                    }
-                } else {
-                    // Convergence is in a branch (nested IF)
-                    // Connect based on whether from is LEFT or RIGHT of the convergence
-                    if (from->branchColumn < to->branchColumn) {
-                        // From is MORE negative (further left) - connect to left side
-                        convergeX = (float)(to->x - to->width * 0.5f);
-                    } else {
-                        // From is MORE positive (further right) - connect to right side
-                        convergeX = (float)(to->x + to->width * 0.5f);
-                    }
-                }
-                float convergeY = (float)to->y;
-                
-                // Check distance to vertical segment (down in branch)
-                float distVert = point_to_line_segment_dist((float)x, (float)y, x1, y1, branchX, convergeY);
-                // Check distance to horizontal segment (to convergence)
-                float distHoriz = point_to_line_segment_dist((float)x, (float)y, branchX, convergeY, convergeX, convergeY);
-                
-                dist = fmin(distVert, distHoriz);
-            } else if (sameBranch) {
-                // Both in same branch - vertical line
-                dist = point_to_line_segment_dist((float)x, (float)y, x1, y1, x2, y2);
-            } else {
-                // Different branches or normal routing
-        // Handle different connection shapes
-        if (fabs(x1 - x2) < 0.001f) {
-            // Same X: vertical line only
-            dist = point_to_line_segment_dist((float)x, (float)y, x1, y1, x2, y2);
-        } else if (fabs(y1 - y2) < 0.001f) {
-            // Same Y: horizontal line only
-            dist = point_to_line_segment_dist((float)x, (float)y, x1, y1, x2, y2);
-        } else {
-            // Different X and Y: L-shape (horizontal then vertical)
-            float midX = x2;  // Horizontal segment goes to target X
-            float midY = y1;  // Vertical segment starts from source Y
-            
-            // Check distance to horizontal segment
-            float distHoriz = point_to_line_segment_dist((float)x, (float)y, x1, y1, midX, midY);
-            // Check distance to vertical segment
-            float distVert = point_to_line_segment_dist((float)x, (float)y, midX, midY, x2, y2);
-            
-            // Use minimum distance to either segment
-            dist = fmin(distHoriz, distVert);
-                }
-            }
+        // Use minimum distance to any segment of the route
+        float dist = point_to_line_segment_dist(px, py, route->x[0], route->y[0], route->x[1], route->y[1]);
+        for (int k = 2; k < route->pointCount; k++) {
+            dist = fmin(dist, point_to_line_segment_dist(px, py, route->x[k - 1], route->y[k - 1], route->x[k], route->y[k]));
         }
         
         if (dist < threshold) {
@@ -602,16 +515,64 @@ void extract_variables_from_expression_simple(const char* expr, char varNames[][
     }
 }
 
+// Count occurrences of a character (bounds the '[' accesses or '{' placeholders in a string)
+int count_char_occurrences(const char* text, char c) {
+    int count = 0;
+    if (!text) return 0;
+    for (const char* p = text; *p != '\0'; p++) {
+        if (*p == c) count++;
+    }
+    return count;
+}
+
+// Upper bound on the names extract_variables_from_expression can return for expr:
+// one per run of identifier characters (a run longer than a name splits into
+// several), plus one array name per '['. Capped at MAX_VARIABLES.
+int count_expression_identifiers(const char* expr) {
+    int count = 0;
+    if (!expr) return 0;
+    const char* p = expr;
+    while (*p != '\0') {
+        int runLen = 0;
+        while ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+               (*p >= '0' && *p <= '9') || *p == '_') {
+            runLen++;
+            p++;
+        }
+        if (runLen > 0) {
+            count += (runLen + MAX_VAR_NAME_LENGTH - 2) / (MAX_VAR_NAME_LENGTH - 1);
+        } else {
+            if (*p == '[') count++;
+            p++;
+        }
+    }
+    return count < MAX_VARIABLES ? count : MAX_VARIABLES;
+}
+
 // Extract variables from expression (handles array access)
+// varNames must hold count_expression_identifiers(expr) entries
 void extract_variables_from_expression(const char* expr, char varNames[][MAX_VAR_NAME_LENGTH], int* varCount) {
     *varCount = 0;
     if (!expr || expr[0] == '\0') return;
     
+    // Temporaries come from the scratch arena, sized for this expression
+    ArenaMark scratch = arena_mark(&scratchArena);
+    int maxAccesses = count_char_occurrences(expr, '[');
+    if (maxAccesses > MAX_VARIABLES) maxAccesses = MAX_VARIABLES;
+    int maxNames = count_expression_identifiers(expr);
+    char (*arrayNames)[MAX_VAR_NAME_LENGTH] = arena_alloc(&scratchArena, (size_t)maxAccesses * MAX_VAR_NAME_LENGTH);
+    char (*indexExprs)[MAX_VALUE_LENGTH] = arena_alloc(&scratchArena, (size_t)maxAccesses * MAX_VALUE_LENGTH);
+    char (*tokenVars)[MAX_VAR_NAME_LENGTH] = arena_alloc(&scratchArena, (size_t)maxNames * MAX_VAR_NAME_LENGTH);
+    if (!arrayNames || !indexExprs || !tokenVars) {
+        arena_release(&scratchArena, scratch);
+        return;
+    }
+    
     // First extract array accesses
-    char arrayNames[MAX_VARIABLES][MAX_VAR_NAME_LENGTH];
-    char indexExprs[MAX_VARIABLES][MAX_VALUE_LENGTH];
     int accessCount = 0;
-    extract_array_accesses(expr, arrayNames, indexExprs, &accessCount);
+    if (maxAccesses > 0) {
+        extract_array_accesses(expr, arrayNames, indexExprs, &accessCount);
+    }
     
     // Add array names to variable list
     for (int i = 0; i < accessCount && *varCount < MAX_VARIABLES; i++) {
@@ -629,20 +590,20 @@ void extract_variables_from_expression(const char* expr, char varNames[][MAX_VAR
             (*varCount)++;
         }
         
-        // Also extract variables from index expression
-        char indexVars[MAX_VARIABLES][MAX_VAR_NAME_LENGTH];
+        // Also extract variables from index expression (a substring of expr, so
+        // tokenVars is large enough)
         int indexVarCount = 0;
-        extract_variables_from_expression_simple(indexExprs[i], indexVars, &indexVarCount);
+        extract_variables_from_expression_simple(indexExprs[i], tokenVars, &indexVarCount);
         for (int j = 0; j < indexVarCount && *varCount < MAX_VARIABLES; j++) {
             bool found = false;
             for (int k = 0; k < *varCount; k++) {
-                if (strcmp(varNames[k], indexVars[j]) == 0) {
+                if (strcmp(varNames[k], tokenVars[j]) == 0) {
                     found = true;
                     break;
                 }
             }
             if (!found) {
-                strncpy(varNames[*varCount], indexVars[j], MAX_VAR_NAME_LENGTH - 1);
+                strncpy(varNames[*varCount], tokenVars[j], MAX_VAR_NAME_LENGTH - 1);
                 varNames[*varCount][MAX_VAR_NAME_LENGTH - 1] = '\0';
                 (*varCount)++;
             }
@@ -668,25 +629,26 @@ void extract_variables_from_expression(const char* expr, char varNames[][MAX_VAR
     }
     
     // Extract remaining variables
-    char remainingVars[MAX_VARIABLES][MAX_VAR_NAME_LENGTH];
     int remainingCount = 0;
-    extract_variables_from_expression_simple(cleanedExpr, remainingVars, &remainingCount);
+    extract_variables_from_expression_simple(cleanedExpr, tokenVars, &remainingCount);
     
     // Add remaining variables to list
     for (int i = 0; i < remainingCount && *varCount < MAX_VARIABLES; i++) {
         bool found = false;
         for (int j = 0; j < *varCount; j++) {
-            if (strcmp(varNames[j], remainingVars[i]) == 0) {
+            if (strcmp(varNames[j], tokenVars[i]) == 0) {
                 found = true;
                 break;
             }
         }
         if (!found) {
-            strncpy(varNames[*varCount], remainingVars[i], MAX_VAR_NAME_LENGTH - 1);
+            strncpy(varNames[*varCount], tokenVars[i], MAX_VAR_NAME_LENGTH - 1);
             varNames[*varCount][MAX_VAR_NAME_LENGTH - 1] = '\0';
             (*varCount)++;
         }
     }
+    
+    arena_release(&scratchArena, scratch);
 }
 
 // Parse array access (format: "arr[index]" or "arr[i]")
@@ -858,6 +820,7 @@ bool check_array_bounds(const char* arrayName, const char* indexExpr, char* erro
 }
 
 // Extract all array accesses from an expression (e.g., "arr[i] = arr[i-1]")
+// The arrays must hold one entry per '[' in expr (up to MAX_VARIABLES)
 void extract_array_accesses(const char* expr, char arrayNames[][MAX_VAR_NAME_LENGTH], 
                                    char indexExprs[][MAX_VALUE_LENGTH], int* accessCount) {
     *accessCount = 0;
@@ -924,43 +887,9 @@ void extract_array_accesses(const char* expr, char arrayNames[][MAX_VAR_NAME_LEN
     }
 }
 
-// Validate expression - check all variables exist and infer return type
-bool validate_expression(const char* expr, VariableType expectedType, VariableType* actualType, char* errorMsg) {
-    if (!expr || expr[0] == '\0') {
-        strcpy(errorMsg, "Expression cannot be empty");
-        return false;
-    }
-    
-    // Check if expression is a quoted string FIRST - if so, skip variable extraction
-    bool isQuotedString = (expr[0] == '"' && expr[strlen(expr) - 1] == '"');
-    
-    if (isQuotedString) {
-        // It's a quoted string literal - set type to STRING and skip variable extraction
-        *actualType = VAR_TYPE_STRING;
-        // Check if actual type matches expected
-        if (*actualType != expectedType) {
-            strcpy(errorMsg, "Expression type doesn't match variable type");
-            return false;
-        }
-        return true;
-    }
-    
-    // Check if expression is a boolean literal (true/false) - skip variable extraction
-    if (strcmp(expr, "true") == 0 || strcmp(expr, "false") == 0) {
-        *actualType = VAR_TYPE_BOOL;
-        // Check if actual type matches expected
-        if (*actualType != expectedType) {
-            strcpy(errorMsg, "Expression type doesn't match variable type");
-            return false;
-        }
-        return true;
-    }
-    
-    // Extract all variables from expression
-    char varNames[MAX_VARIABLES][MAX_VAR_NAME_LENGTH];
-    int varCount = 0;
-    extract_variables_from_expression(expr, varNames, &varCount);
-    
+// Check that every variable in an expression is declared and infer the expression type
+static bool infer_expression_type(const char* expr, char varNames[][MAX_VAR_NAME_LENGTH], int varCount,
+                                  VariableType* actualType, char* errorMsg) {
     // Check all variables are declared
     for (int i = 0; i < varCount; i++) {
         Variable* var = find_variable(varNames[i]);
@@ -1006,6 +935,57 @@ bool validate_expression(const char* expr, VariableType expectedType, VariableTy
         *actualType = firstVar->type;
     }
     
+    return true;
+}
+
+// Validate expression - check all variables exist and infer return type
+bool validate_expression(const char* expr, VariableType expectedType, VariableType* actualType, char* errorMsg) {
+    if (!expr || expr[0] == '\0') {
+        strcpy(errorMsg, "Expression cannot be empty");
+        return false;
+    }
+    
+    // Check if expression is a quoted string FIRST - if so, skip variable extraction
+    bool isQuotedString = (expr[0] == '"' && expr[strlen(expr) - 1] == '"');
+    
+    if (isQuotedString) {
+        // It's a quoted string literal - set type to STRING and skip variable extraction
+        *actualType = VAR_TYPE_STRING;
+        // Check if actual type matches expected
+        if (*actualType != expectedType) {
+            strcpy(errorMsg, "Expression type doesn't match variable type");
+            return false;
+        }
+        return true;
+    }
+    
+    // Check if expression is a boolean literal (true/false) - skip variable extraction
+    if (strcmp(expr, "true") == 0 || strcmp(expr, "false") == 0) {
+        *actualType = VAR_TYPE_BOOL;
+        // Check if actual type matches expected
+        if (*actualType != expectedType) {
+            strcpy(errorMsg, "Expression type doesn't match variable type");
+            return false;
+        }
+        return true;
+    }
+    
+    // Extract all variables from expression into a scratch buffer sized for it
+    ArenaMark scratch = arena_mark(&scratchArena);
+    char (*varNames)[MAX_VAR_NAME_LENGTH] = arena_alloc(&scratchArena,
+        (size_t)count_expression_identifiers(expr) * MAX_VAR_NAME_LENGTH);
+    if (!varNames) {
+        strcpy(errorMsg, "Out of memory validating expression");
+        return false;
+    }
+    int varCount = 0;
+    extract_variables_from_expression(expr, varNames, &varCount);
+    bool inferred = infer_expression_type(expr, varNames, varCount, actualType, errorMsg);
+    arena_release(&scratchArena, scratch);
+    if (!inferred) {
+        return false;
+    }
+    
     // Check if actual type matches expected
     if (*actualType != expectedType) {
         strcpy(errorMsg, "Expression type doesn't match variable type");
@@ -1247,6 +1227,7 @@ void extract_output_placeholders(const char* formatStr, char varNames[][MAX_VAR_
 }
 
 // Extract variable placeholders from output format string with array access info (pattern: {varName} or {arr[index]})
+// The arrays must hold one entry per '{' in formatStr (up to MAX_VARIABLES)
 void extract_output_placeholders_with_arrays(const char* formatStr, char varNames[][MAX_VAR_NAME_LENGTH], 
                                                     char indexExprs[][MAX_VALUE_LENGTH], bool* isArrayAccess, int* varCount) {
     *varCount = 0;
@@ -1475,7 +1456,7 @@ void rebuild_variable_table(void) {
             bool isArray;
             int arraySize;
             
-            if (parse_declare_block(nodes[i].value, varName, &varType, &isArray, &arraySize)) {
+            if (parse_declare_block(node_label(i), varName, &varType, &isArray, &arraySize)) {
                 if (variableCount < MAX_VARIABLES) {
                     strncpy(variables[variableCount].name, varName, MAX_VAR_NAME_LENGTH - 1);
                     variables[variableCount].name[MAX_VAR_NAME_LENGTH - 1] = '\0';
@@ -1538,7 +1519,7 @@ bool variable_name_exists(const char* name, int excludeNodeIndex) {
             VariableType varType;
             bool isArray;
             int arraySize;
-            if (parse_declare_block(nodes[i].value, varName, &varType, &isArray, &arraySize)) {
+            if (parse_declare_block(node_label(i), varName, &varType, &isArray, &arraySize)) {
                 if (strcmp(varName, name) == 0) {
                     return true;
                 }
@@ -1568,27 +1549,19 @@ Variable* find_variable(const char* name) {
 // Calculate the depth (in grid cells) of a branch, recursively accounting for nested IFs
 // branchType: 0 = true/left, 1 = false/right
 int calculate_branch_depth(int ifBlockIndex, int branchType) {
-    if (ifBlockIndex < 0 || ifBlockIndex >= ifBlockCount) return 0;
+    if (!if_block_is_live(ifBlockIndex)) return 0;
     
-    int *branchNodes = (branchType == 0) ? ifBlocks[ifBlockIndex].trueBranchNodes : ifBlocks[ifBlockIndex].falseBranchNodes;
     int branchCount = (branchType == 0) ? ifBlocks[ifBlockIndex].trueBranchCount : ifBlocks[ifBlockIndex].falseBranchCount;
     
     if (branchCount == 0) return 0;
     
     int maxDepth = 1;  // At least 1 grid cell for the branch itself
-    for (int i = 0; i < branchCount; i++) {
-        int nodeIdx = branchNodes[i];
-        if (nodeIdx < 0 || nodeIdx >= nodeCount) continue;
+    for (int nodeIdx = first_if_branch_node(&ifBlocks[ifBlockIndex], branchType); nodeIdx >= 0;
+         nodeIdx = next_if_branch_node(nodeIdx)) {
         
         if (nodes[nodeIdx].type == NODE_IF) {
             // Find the IF block for this node
-            int nestedIfIdx = -1;
-            for (int j = 0; j < ifBlockCount; j++) {
-                if (ifBlocks[j].ifNodeIndex == nodeIdx) {
-                    nestedIfIdx = j;
-                    break;
-                }
-            }
+            int nestedIfIdx = find_if_block_by_if_node(nodeIdx);
             if (nestedIfIdx >= 0) {
                 int nestedDepth = calculate_branch_depth(nestedIfIdx, 0);
                 int nestedDepth2 = calculate_branch_depth(nestedIfIdx, 1);
@@ -1606,7 +1579,7 @@ int calculate_branch_depth(int ifBlockIndex, int branchType) {
 // The convergence point should align with the longest branch
 void reposition_convergence_point(int ifBlockIndex, bool shouldPushNodesBelow) {
     
-    if (ifBlockIndex < 0 || ifBlockIndex >= ifBlockCount) {
+    if (!if_block_is_live(ifBlockIndex)) {
         return;
     }
     
@@ -1644,8 +1617,7 @@ void reposition_convergence_point(int ifBlockIndex, bool shouldPushNodesBelow) {
         int lowestNodeIdx = -1;
         
         // Check true branch nodes
-        for (int i = 0; i < ifBlocks[ifBlockIndex].trueBranchCount; i++) {
-            int nodeIdx = ifBlocks[ifBlockIndex].trueBranchNodes[i];
+        for (int nodeIdx = first_if_branch_node(&ifBlocks[ifBlockIndex], 0); nodeIdx >= 0; nodeIdx = next_if_branch_node(nodeIdx)) {
             if (nodeIdx >= 0 && nodeIdx < nodeCount) {
                 // In this coordinate system, smaller Y means lower on screen
                 if (nodes[nodeIdx].y < lowestBranchY) {
@@ -1657,41 +1629,37 @@ void reposition_convergence_point(int ifBlockIndex, bool shouldPushNodesBelow) {
                 // If this node is a nested IF, recursively check all nodes in its branches
                 if (nodes[nodeIdx].type == NODE_IF) {
                     // Find the nested IF block index
-                    for (int j = 0; j < ifBlockCount; j++) {
-                        if (ifBlocks[j].ifNodeIndex == nodeIdx) {
-                            // Check all nodes in the nested IF's true branch
-                            for (int k = 0; k < ifBlocks[j].trueBranchCount; k++) {
-                                int nestedNodeIdx = ifBlocks[j].trueBranchNodes[k];
-                                if (nestedNodeIdx >= 0 && nestedNodeIdx < nodeCount) {
-                                    if (nodes[nestedNodeIdx].y < lowestBranchY) {
-                                        lowestBranchY = nodes[nestedNodeIdx].y;
-                                        lowestNodeIdx = nestedNodeIdx;
-                                        foundBranchNode = true;
-                                    }
-                                }
-                            }
-                            // Check all nodes in the nested IF's false branch
-                            for (int k = 0; k < ifBlocks[j].falseBranchCount; k++) {
-                                int nestedNodeIdx = ifBlocks[j].falseBranchNodes[k];
-                                if (nestedNodeIdx >= 0 && nestedNodeIdx < nodeCount) {
-                                    if (nodes[nestedNodeIdx].y < lowestBranchY) {
-                                        lowestBranchY = nodes[nestedNodeIdx].y;
-                                        lowestNodeIdx = nestedNodeIdx;
-                                        foundBranchNode = true;
-                                    }
+                    int j = find_if_block_by_if_node(nodeIdx);
+                    if (j >= 0) {
+                        // Check all nodes in the nested IF's true branch
+                        for (int nestedNodeIdx = first_if_branch_node(&ifBlocks[j], 0); nestedNodeIdx >= 0; nestedNodeIdx = next_if_branch_node(nestedNodeIdx)) {
+                            if (nestedNodeIdx >= 0 && nestedNodeIdx < nodeCount) {
+                                if (nodes[nestedNodeIdx].y < lowestBranchY) {
+                                    lowestBranchY = nodes[nestedNodeIdx].y;
+                                    lowestNodeIdx = nestedNodeIdx;
+                                    foundBranchNode = true;
                                 }
                             }
-                            // Also check the nested IF's convergence point
-                            int nestedConvergeIdx = ifBlocks[j].convergeNodeIndex;
-                            if (nestedConvergeIdx >= 0 && nestedConvergeIdx < nodeCount) {
-                                double nestedConvergeY = nodes[nestedConvergeIdx].y;
-                                if (nestedConvergeY < lowestBranchY) {
-                                    lowestBranchY = nestedConvergeY;
-                                    lowestNodeIdx = nestedConvergeIdx;
+                        }
+                        // Check all nodes in the nested IF's false branch
+                        for (int nestedNodeIdx = first_if_branch_node(&ifBlocks[j], 1); nestedNodeIdx >= 0; nestedNodeIdx = next_if_branch_node(nestedNodeIdx)) {
+                            if (nestedNodeIdx >= 0 && nestedNodeIdx < nodeCount) {
+                                if (nodes[nestedNodeIdx].y < lowestBranchY) {
+                                    lowestBranchY = nodes[nestedNodeIdx].y;
+                                    lowestNodeIdx = nestedNodeIdx;
                                     foundBranchNode = true;
                                 }
                             }
-                            break;
+                        }
+                        // Also check the nested IF's convergence point
+                        int nestedConvergeIdx = ifBlocks[j].convergeNodeIndex;
+                        if (nestedConvergeIdx >= 0 && nestedConvergeIdx < nodeCount) {
+                            double nestedConvergeY = nodes[nestedConvergeIdx].y;
+                            if (nestedConvergeY < lowestBranchY) {
+                                lowestBranchY = nestedConvergeY;
+                                lowestNodeIdx = nestedConvergeIdx;
+                                foundBranchNode = true;
+                            }
                         }
                     }
                 }
@@ -1699,8 +1667,7 @@ void reposition_convergence_point(int ifBlockIndex, bool shouldPushNodesBelow) {
         }
         
         // Check false branch nodes
-        for (int i = 0; i < ifBlocks[ifBlockIndex].falseBranchCount; i++) {
-            int nodeIdx = ifBlocks[ifBlockIndex].falseBranchNodes[i];
+        for (int nodeIdx = first_if_branch_node(&ifBlocks[ifBlockIndex], 1); nodeIdx >= 0; nodeIdx = next_if_branch_node(nodeIdx)) {
             if (nodeIdx >= 0 && nodeIdx < nodeCount) {
                 // In this coordinate system, smaller Y means lower on screen
                 if (nodes[nodeIdx].y < lowestBranchY) {
@@ -1712,41 +1679,37 @@ void reposition_convergence_point(int ifBlockIndex, bool shouldPushNodesBelow) {
                 // If this node is a nested IF, recursively check all nodes in its branches
                 if (nodes[nodeIdx].type == NODE_IF) {
                     // Find the nested IF block index
-                    for (int j = 0; j < ifBlockCount; j++) {
-                        if (ifBlocks[j].ifNodeIndex == nodeIdx) {
-                            // Check all nodes in the nested IF's true branch
-                            for (int k = 0; k < ifBlocks[j].trueBranchCount; k++) {
-                                int nestedNodeIdx = ifBlocks[j].trueBranchNodes[k];
-                                if (nestedNodeIdx >= 0 && nestedNodeIdx < nodeCount) {
-                                    if (nodes[nestedNodeIdx].y < lowestBranchY) {
-                                        lowestBranchY = nodes[nestedNodeIdx].y;
-                                        lowestNodeIdx = nestedNodeIdx;
-                                        foundBranchNode = true;
-                                    }
-                                }
-                            }
-                            // Check all nodes in the nested IF's false branch
-                            for (int k = 0; k < ifBlocks[j].falseBranchCount; k++) {
-                                int nestedNodeIdx = ifBlocks[j].falseBranchNodes[k];
-                                if (nestedNodeIdx >= 0 && nestedNodeIdx < nodeCount) {
-                                    if (nodes[nestedNodeIdx].y < lowestBranchY) {
-                                        lowestBranchY = nodes[nestedNodeIdx].y;
-                                        lowestNodeIdx = nestedNodeIdx;
-                                        foundBranchNode = true;
-                                    }
+                    int j = find_if_block_by_if_node(nodeIdx);
+                    if (j >= 0) {
+                        // Check all nodes in the nested IF's true branch
+                        for (int nestedNodeIdx = first_if_branch_node(&ifBlocks[j], 0); nestedNodeIdx >= 0; nestedNodeIdx = next_if_branch_node(nestedNodeIdx)) {
+                            if (nestedNodeIdx >= 0 && nestedNodeIdx < nodeCount) {
+                                if (nodes[nestedNodeIdx].y < lowestBranchY) {
+                                    lowestBranchY = nodes[nestedNodeIdx].y;
+                                    lowestNodeIdx = nestedNodeIdx;
+                                    foundBranchNode = true;
                                 }
                             }
-                            // Also check the nested IF's convergence point
-                            int nestedConvergeIdx = ifBlocks[j].convergeNodeIndex;
-                            if (nestedConvergeIdx >= 0 && nestedConvergeIdx < nodeCount) {
-                                double nestedConvergeY = nodes[nestedConvergeIdx].y;
-                                if (nestedConvergeY < lowestBranchY) {
-                                    lowestBranchY = nestedConvergeY;
-                                    lowestNodeIdx = nestedConvergeIdx;
+                        }
+                        // Check all nodes in the nested IF's false branch
+                        for (int nestedNodeIdx = first_if_branch_node(&ifBlocks[j], 1); nestedNodeIdx >= 0; nestedNodeIdx = next_if_branch_node(nestedNodeIdx)) {
+                            if (nestedNodeIdx >= 0 && nestedNodeIdx < nodeCount) {
+                                if (nodes[nestedNodeIdx].y < lowestBranchY) {
+                                    lowestBranchY = nodes[nestedNodeIdx].y;
+                                    lowestNodeIdx = nestedNodeIdx;
                                     foundBranchNode = true;
                                 }
                             }
-                            break;
+                        }
+                        // Also check the nested IF's convergence point
+                        int nestedConvergeIdx = ifBlocks[j].convergeNodeIndex;
+                        if (nestedConvergeIdx >= 0 && nestedConvergeIdx < nodeCount) {
+                            double nestedConvergeY = nodes[nestedConvergeIdx].y;
+                            if (nestedConvergeY < lowestBranchY) {
+                                lowestBranchY = nestedConvergeY;
+                                lowestNodeIdx = nestedConvergeIdx;
+                                foundBranchNode = true;
+                            }
                         }
                     }
                 }
@@ -1792,14 +1755,19 @@ void reposition_convergence_point(int ifBlockIndex, bool shouldPushNodesBelow) {
             // Store original Y positions BEFORE moving any nodes
             // This ensures we compare against the original positions, not positions that may have been
             // updated by previous reposition_convergence_point calls
-            double originalNodeYs[MAX_NODES];
-            for (int j = 0; j < nodeCount; j++) {
-                originalNodeYs[j] = nodes[j].y;
-            }
+            double *originalNodeYs = malloc((size_t)nodeCount * sizeof(double));
             
             // Track which IF blocks are moved so we can move their branches too
-            int movedIfBlocks[MAX_IF_BLOCKS];
+            int *movedIfBlocks = malloc((size_t)ifBlockCount * sizeof(int));
             int movedIfBlockCount = 0;
+            if (!originalNodeYs || !movedIfBlocks) {
+                free(originalNodeYs);
+                free(movedIfBlocks);
+                return;
+            }
+            for (int j = 0; j < nodeCount; j++) {
+                originalNodeYs[j] = nodes[j].y;
+            }
             
             // Determine which branch this IF block is in (for nested IFs)
             int currentIfBranchColumn = 0;
@@ -1815,6 +1783,7 @@ void reposition_convergence_point(int ifBlockIndex, bool shouldPushNodesBelow) {
             }
             
             for (int i = 0; i < nodeCount; i++) {
+                if (!node_is_live(i)) continue;
                 
                 // Move nodes that are:
                 // 1. Below the OLD convergence position (always use old position as reference)
@@ -1848,11 +1817,9 @@ void reposition_convergence_point(int ifBlockIndex, bool shouldPushNodesBelow) {
                     
                     // If this is an IF node, track it to move its branches
                     if (nodes[i].type == NODE_IF) {
-                        for (int j = 0; j < ifBlockCount; j++) {
-                            if (ifBlocks[j].ifNodeIndex == i) {
-                                movedIfBlocks[movedIfBlockCount++] = j;
-                                break;
-                            }
+                        int j = find_if_block_by_if_node(i);
+                        if (j >= 0) {
+                            movedIfBlocks[movedIfBlockCount++] = j;
                         }
                     }
                 }
@@ -1884,6 +1851,9 @@ void reposition_convergence_point(int ifBlockIndex, bool shouldPushNodesBelow) {
                     nodes[j].y = snap_to_grid_y(nodes[j].y + deltaY);
                 }
             }
+            
+            free(originalNodeYs);
+            free(movedIfBlocks);
         }
     }
 }
@@ -1902,40 +1872,14 @@ int get_if_branch_type(int connIndex) {
     // CRITICAL FIX: For nested IFs, branchColumn can be ambiguous.
     // We need to check which branch array the target node is actually in.
     // Find the IF block that this connection belongs to
-    int ifBlockIdx = -1;
-    for (int j = 0; j < ifBlockCount; j++) {
-        if (ifBlocks[j].ifNodeIndex == connections[connIndex].fromNode) {
-            ifBlockIdx = j;
-            break;
-        }
-    }
+    int ifBlockIdx = find_if_block_by_if_node(connections[connIndex].fromNode);
     
     if (ifBlockIdx >= 0 && to->type != NODE_CONVERGE) {
-        // Check which branch array contains the target node
+        // Check which branch list contains the target node
         // This is the source of truth for nested IFs
-        bool foundInTrueBranch = false;
-        bool foundInFalseBranch = false;
-        
-        // Check true branch array
-        for (int i = 0; i < ifBlocks[ifBlockIdx].trueBranchCount; i++) {
-            if (ifBlocks[ifBlockIdx].trueBranchNodes[i] == connections[connIndex].toNode) {
-                foundInTrueBranch = true;
-                break;
-            }
-        }
-        
-        // Check false branch array
-        for (int i = 0; i < ifBlocks[ifBlockIdx].falseBranchCount; i++) {
-            if (ifBlocks[ifBlockIdx].falseBranchNodes[i] == connections[connIndex].toNode) {
-                foundInFalseBranch = true;
-                break;
-            }
-        }
-        
-        if (foundInTrueBranch) {
-            return 0;  // True branch
-        } else if (foundInFalseBranch) {
-            return 1;  // False branch
+        int branchType = if_branch_of_node(&ifBlocks[ifBlockIdx], connections[connIndex].toNode);
+        if (branchType >= 0) {
+            return branchType;  // 0 = true branch, 1 = false branch
         }
     }
     
@@ -1945,13 +1889,11 @@ int get_if_branch_type(int connIndex) {
         // Use connection order instead
         int fromNode = connections[connIndex].fromNode;
         int connectionIndex = 0;
-        for (int i = 0; i < connectionCount; i++) {
-            if (connections[i].fromNode == fromNode) {
-                if (i == connIndex) {
-                    return connectionIndex;  // 0 = true (first), 1 = false (second)
-                }
-                connectionIndex++;
+        for (int i = first_outgoing_connection(fromNode); i >= 0; i = next_outgoing_connection(i)) {
+            if (i == connIndex) {
+                return connectionIndex;  // 0 = true (first), 1 = false (second)
             }
+            connectionIndex++;
         }
     } else if (to->branchColumn < 0) {
         // Target is in a left branch (negative column) = true branch
@@ -1972,8 +1914,8 @@ int get_if_branch_type(int connIndex) {
         int leftBranchConns = 0;
         int rightBranchConns = 0;
         
-        for (int i = 0; i < connectionCount; i++) {
-            if (connections[i].fromNode == fromNode && i != connIndex) {
+        for (int i = first_outgoing_connection(fromNode); i >= 0; i = next_outgoing_connection(i)) {
+            if (i != connIndex) {
                 int targetNode = connections[i].toNode;
                 if (targetNode >= 0 && targetNode < nodeCount) {
                     
@@ -1990,22 +1932,20 @@ int get_if_branch_type(int connIndex) {
         // For now, use connection order but prioritize spatial logic
         // Connection order: first connection = true (0), second = false (1)
         int connectionIndex = 0;
-        for (int i = 0; i < connectionCount; i++) {
-            if (connections[i].fromNode == fromNode) {
-                if (i == connIndex) {
-                    // If both branches exist or we can't tell, use connection order
-                    // But if only one branch has nodes, we should be adding to the EMPTY one
-                    if (leftBranchConns > 0 && rightBranchConns == 0) {
-                        // Only left branch has nodes, so we're adding to right (false) branch
-                        return 1;
-                    } else if (rightBranchConns > 0 && leftBranchConns == 0) {
-                        // Only right branch has nodes, so we're adding to left (true) branch
-                        return 0;
-                    }
-                    return connectionIndex;
+        for (int i = first_outgoing_connection(fromNode); i >= 0; i = next_outgoing_connection(i)) {
+            if (i == connIndex) {
+                // If both branches exist or we can't tell, use connection order
+                // But if only one branch has nodes, we should be adding to the EMPTY one
+                if (leftBranchConns > 0 && rightBranchConns == 0) {
+                    // Only left branch has nodes, so we're adding to right (false) branch
+                    return 1;
+                } else if (rightBranchConns > 0 && leftBranchConns == 0) {
+                    // Only right branch has nodes, so we're adding to left (true) branch
+                    return 0;
                 }
-                connectionIndex++;
+                return connectionIndex;
             }
+            connectionIndex++;
         }
     }
     
@@ -2023,13 +1963,7 @@ bool is_valid_if_converge_connection(int fromNode, int toNode) {
     }
     
     // Find which IF block this IF node belongs to
-    int ifBlockIdx = -1;
-    for (int i = 0; i < ifBlockCount; i++) {
-        if (ifBlocks[i].ifNodeIndex == fromNode) {
-            ifBlockIdx = i;
-            break;
-        }
-    }
+    int ifBlockIdx = find_if_block_by_if_node(fromNode);
     
     if (ifBlockIdx < 0) {
         return true;  // IF block not found (shouldn't happen), allow for now
@@ -2046,28 +1980,18 @@ bool is_valid_if_converge_connection(int fromNode, int toNode) {
 }
 
 double calculate_branch_width(int ifBlockIndex, int branchType) {
-    if (ifBlockIndex < 0 || ifBlockIndex >= ifBlockCount) {
+    if (!if_block_is_live(ifBlockIndex)) {
         return 1.0;  // Default minimum width
     }
 
     IFBlock *ifBlock = &ifBlocks[ifBlockIndex];
     double maxWidth = 1.0;  // At least one grid unit
 
-    int *branchNodes = (branchType == 0) ? ifBlock->trueBranchNodes : ifBlock->falseBranchNodes;
-    int branchCount = (branchType == 0) ? ifBlock->trueBranchCount : ifBlock->falseBranchCount;
-
-    for (int i = 0; i < branchCount; i++) {
-        int nodeIdx = branchNodes[i];
-        if (nodeIdx < 0 || nodeIdx >= nodeCount) continue;
+    for (int nodeIdx = first_if_branch_node(ifBlock, branchType); nodeIdx >= 0;
+         nodeIdx = next_if_branch_node(nodeIdx)) {
 
         if (nodes[nodeIdx].type == NODE_IF) {
-            int nestedIfIdx = -1;
-            for (int j = 0; j < ifBlockCount; j++) {
-                if (ifBlocks[j].ifNodeIndex == nodeIdx) {
-                    nestedIfIdx = j;
-                    break;
-                }
-            }
+            int nestedIfIdx = find_if_block_by_if_node(nodeIdx);
 
             if (nestedIfIdx >= 0) {
                 double nestedLeft = calculate_branch_width(nestedIfIdx, 0);
@@ -2101,7 +2025,7 @@ double calculate_branch_width(int ifBlockIndex, int branchType) {
 
 // Recursively update X positions for all nodes in an IF block's branches
 void update_branch_x_positions(int ifBlockIndex) {
-    if (ifBlockIndex < 0 || ifBlockIndex >= ifBlockCount) return;
+    if (!if_block_is_live(ifBlockIndex)) return;
 
     IFBlock *ifBlock = &ifBlocks[ifBlockIndex];
     double ifCenterX = nodes[ifBlock->ifNodeIndex].x;
@@ -2113,18 +2037,15 @@ void update_branch_x_positions(int ifBlockIndex) {
 
     // Update true branch (left) nodes
     double leftBranchX = ifCenterX - ifBlock->leftBranchWidth;
-    for (int i = 0; i < ifBlock->trueBranchCount; i++) {
-        int nodeIdx = ifBlock->trueBranchNodes[i];
+    for (int nodeIdx = first_if_branch_node(ifBlock, 0); nodeIdx >= 0; nodeIdx = next_if_branch_node(nodeIdx)) {
         if (nodeIdx >= 0 && nodeIdx < nodeCount) {
             nodes[nodeIdx].x = snap_to_grid_x(leftBranchX);
 
             // If this is a nested IF, recursively update its branches
             if (nodes[nodeIdx].type == NODE_IF) {
-                for (int j = 0; j < ifBlockCount; j++) {
-                    if (ifBlocks[j].ifNodeIndex == nodeIdx) {
-                        update_branch_x_positions(j);
-                        break;
-                    }
+                int j = find_if_block_by_if_node(nodeIdx);
+                if (j >= 0) {
+                    update_branch_x_positions(j);
                 }
             }
         }
@@ -2132,18 +2053,15 @@ void update_branch_x_positions(int ifBlockIndex) {
 
     // Update false branch (right) nodes
     double rightBranchX = ifCenterX + ifBlock->rightBranchWidth;
-    for (int i = 0; i < ifBlock->falseBranchCount; i++) {
-        int nodeIdx = ifBlock->falseBranchNodes[i];
+    for (int nodeIdx = first_if_branch_node(ifBlock, 1); nodeIdx >= 0; nodeIdx = next_if_branch_node(nodeIdx)) {
         if (nodeIdx >= 0 && nodeIdx < nodeCount) {
             nodes[nodeIdx].x = snap_to_grid_x(rightBranchX);
 
             // If this is a nested IF, recursively update its branches
             if (nodes[nodeIdx].type == NODE_IF) {
-                for (int j = 0; j < ifBlockCount; j++) {
-                    if (ifBlocks[j].ifNodeIndex == nodeIdx) {
-                        update_branch_x_positions(j);
-                        break;
-                    }
+                int j = find_if_block_by_if_node(nodeIdx);
+                if (j >= 0) {
+                    update_branch_x_positions(j);
                 }
             }
         }
@@ -2162,6 +2080,9 @@ void update_all_branch_positions(void) {
         iterations++;
 
         for (int i = 0; i < ifBlockCount; i++) {
+            if (!if_block_is_live(i)) {
+                continue;
+            }
             double oldLeft = ifBlocks[i].leftBranchWidth;
             double oldRight = ifBlocks[i].rightBranchWidth;
 
@@ -2177,10 +2098,11 @@ void update_all_branch_positions(void) {
 
     // Second pass: update positions top-down from root IFs
     for (int i = 0; i < ifBlockCount; i++) {
-        if (ifBlocks[i].parentIfIndex == -1) {
+        if (if_block_is_live(i) && ifBlocks[i].parentIfIndex == -1) {
             update_branch_x_positions(i);
         }
     }
+    mark_flowchart_changed();
 }
 
 // Insert IF block with branches in a connection
@@ -2188,103 +2110,127 @@ void update_all_branch_positions(void) {
 
 // Save current state to undo history
 void save_state_for_undo(void) {
-    // If we're not at the end of history, truncate future history
-    if (undoHistoryIndex < undoHistoryCount - 1) {
-        undoHistoryCount = undoHistoryIndex + 1;
+    // Every edit ends here, so caches also learn about nodes it moved directly
+    mark_flowchart_changed();
+    
+    // Only the records changed since the last save are stored (see undo_journal.h)
+    undo_journal_record();
+}
+
+// Perform undo
+// The journal restores the variable table and layout with the records, so there
+// is nothing to re-parse or lay out again
+void perform_undo(void) {
+    undo_journal_undo();
+}
+
+// Perform redo
+void perform_redo(void) {
+    undo_journal_redo();
+}
+
+// Switch to another version of the last edit: a sibling of the current state in
+// the undo tree, left there by editing after an undo. direction -1 moves to the
+// newer sibling and +1 to the older one, wrapping around at either end.
+void perform_switch_branch(int direction) {
+    int current = undo_current_state();
+    int parent = current >= 0 ? undo_state_parent(current) : -1;
+    if (parent < 0) {
+        return;
     }
     
-    // Shift history if we're at max capacity
-    if (undoHistoryCount >= MAX_UNDO_HISTORY) {
-        // Shift all entries left by one
-        for (int i = 0; i < MAX_UNDO_HISTORY - 1; i++) {
-            undoHistory[i] = undoHistory[i + 1];
+    // Children are listed newest first
+    int first = undo_state_first_child(parent);
+    int previous = -1, next = -1, last = -1;
+    bool passedCurrent = false;
+    for (int s = first; s >= 0; s = undo_state_next_sibling(s)) {
+        if (s == current) {
+            passedCurrent = true;
+        } else if (!passedCurrent) {
+            previous = s;
+        } else if (next < 0) {
+            next = s;
         }
-        undoHistoryCount = MAX_UNDO_HISTORY - 1;
+        last = s;
     }
     
-    // Save current state
-    FlowchartState *state = &undoHistory[undoHistoryCount];
-    state->nodeCount = nodeCount;
-    state->connectionCount = connectionCount;
-    state->ifBlockCount = ifBlockCount;
-    state->cycleBlockCount = cycleBlockCount;
-    
-    // Copy nodes
-    for (int i = 0; i < nodeCount; i++) {
-        state->nodes[i] = nodes[i];
+    int target = direction < 0 ? (previous >= 0 ? previous : last) : (next >= 0 ? next : first);
+    if (target != current) {
+        undo_journal_jump(target);
     }
-    
-    // Copy connections
-    for (int i = 0; i < connectionCount; i++) {
-        state->connections[i] = connections[i];
+}
+
+// Edit transactions: every user action runs between begin_edit() and commit_edit().
+// The mutation code only marks what it made stale (EDIT_* flags); the outermost
+// commit_edit() then recalculates branch layout, rebuilds the variable table,
+// compacts removed connections and takes the undo snapshot, each at most once.
+// Nested transactions (bulk operations built from single edits) defer all of
+// that to the outer commit.
+static int editDepth = 0;
+static int editDirtyFlags = 0;
+static bool editAborted = false;
+static unsigned int editStartRevision = 0;
+
+void begin_edit(void) {
+    if (editDepth++ > 0) {
+        return;
     }
     
-    // Copy IF blocks
-    for (int i = 0; i < ifBlockCount; i++) {
-        state->ifBlocks[i] = ifBlocks[i];
+    // The first edit of a session needs a state to undo back to
+    if (undoHistoryCount == 0) {
+        save_state_for_undo();
     }
-    
-    // Copy cycle blocks
-    for (int i = 0; i < cycleBlockCount; i++) {
-        state->cycleBlocks[i] = cycleBlocks[i];
+    editDirtyFlags = 0;
+    editAborted = false;
+    editStartRevision = flowchart_revision();
+}
+
+void mark_edit_dirty(int flags) {
+    editDirtyFlags |= flags;
+}
+
+// Throw away everything done since the outermost begin_edit() by going back to
+// the state recorded at the current undo position
+static void finish_aborted_edit(void) {
+    if (flowchart_revision() != editStartRevision) {
+        undo_journal_revert();
     }
-    
-    undoHistoryCount++;
-    undoHistoryIndex = undoHistoryCount - 1;
+    editDirtyFlags = 0;
+    editAborted = false;
 }
 
-// Restore state from undo history
-static void restore_state(const FlowchartState *state) {
-    nodeCount = state->nodeCount;
-    connectionCount = state->connectionCount;
-    ifBlockCount = state->ifBlockCount;
-    cycleBlockCount = state->cycleBlockCount;
-    
-    // Restore nodes
-    for (int i = 0; i < nodeCount; i++) {
-        nodes[i] = state->nodes[i];
+void commit_edit(void) {
+    if (editDepth <= 0 || --editDepth > 0) {
+        return;
     }
-    
-    // Restore connections
-    for (int i = 0; i < connectionCount; i++) {
-        connections[i] = state->connections[i];
+    if (editAborted) {
+        finish_aborted_edit();
+        return;
     }
     
-    // Restore IF blocks
-    for (int i = 0; i < ifBlockCount; i++) {
-        ifBlocks[i] = state->ifBlocks[i];
+    if (editDirtyFlags & EDIT_LAYOUT) {
+        update_all_branch_positions();
     }
-    
-    // Restore cycle blocks
-    for (int i = 0; i < cycleBlockCount; i++) {
-        cycleBlocks[i] = state->cycleBlocks[i];
+    if (editDirtyFlags & EDIT_VARIABLES) {
+        rebuild_variable_table();
     }
-    
-    // Rebuild variable table after restore
-    rebuild_variable_table();
-    
-    // Recalculate branch positions after restore (critical for correct rendering)
-    update_all_branch_positions();
-}
-
-// Perform undo
-void perform_undo(void) {
-    if (undoHistoryIndex <= 0) {
-        return;  // No undo available
+    // Anything that changed the chart gets an undo step, even without a flag
+    if (editDirtyFlags || flowchart_revision() != editStartRevision) {
+        compact_connections();
+        save_state_for_undo();
     }
-    
-    undoHistoryIndex--;
-    restore_state(&undoHistory[undoHistoryIndex]);
+    editDirtyFlags = 0;
 }
 
-// Perform redo
-void perform_redo(void) {
-    if (undoHistoryIndex >= undoHistoryCount - 1) {
-        return;  // No redo available
+// Abort a nested transaction and the whole edit is dropped when the outermost one ends
+void abort_edit(void) {
+    if (editDepth <= 0) {
+        return;
+    }
+    editAborted = true;
+    if (--editDepth == 0) {
+        finish_aborted_edit();
     }
-    
-    undoHistoryIndex++;
-    restore_state(&undoHistory[undoHistoryIndex]);
 }
 
 // Keyboard callback
@@ -2299,19 +2245,31 @@ void initialize_flowchart() {
     ifBlockCount = 0;
     cycleBlockCount = 0;
     variableCount = 0;
+    rebuild_free_node_slots();
+    invalidate_adjacency();
+    invalidate_block_index();
+    
+    if (!ensure_node_capacity(2) || !ensure_connection_capacity(1)) {
+        return;
+    }
+    
+    int startIndex = allocate_node();
+    int endIndex = allocate_node();
+    if (startIndex < 0 || endIndex < 0) {
+        return;
+    }
     
     // Create START node first to calculate its width (needed for END positioning)
-    nodes[nodeCount].x = 0.0;
-    nodes[nodeCount].y = 0.0;
-    nodes[nodeCount].height = 0.22f;  // Same height as other blocks
-    strcpy(nodes[nodeCount].value, "START");
-    nodes[nodeCount].type = NODE_START;
-    nodes[nodeCount].branchColumn = 0;
-    nodes[nodeCount].owningIfBlock = -1;
+    nodes[startIndex].x = 0.0;
+    nodes[startIndex].y = 0.0;
+    nodes[startIndex].height = 0.22f;  // Same height as other blocks
+    set_node_label(startIndex, "START");
+    nodes[startIndex].type = NODE_START;
+    nodes[startIndex].branchColumn = 0;
+    nodes[startIndex].owningIfBlock = -1;
     // Calculate width based on text content, same as other blocks
-    float fontSize = nodes[nodeCount].height * 0.3f;
-    nodes[nodeCount].width = calculate_block_width(nodes[nodeCount].value, fontSize, 0.35f);
-    int startIndex = nodeCount++;
+    float fontSize = nodes[startIndex].height * 0.3f;
+    nodes[startIndex].width = calculate_block_width(node_label(startIndex), fontSize, 0.35f);
     float startWidth = nodes[startIndex].width;  // Store START's width
     
     // Create END node positioned at standard connection length below START
@@ -2322,34 +2280,97 @@ void initialize_flowchart() {
     double endTopY = startBottomY - initialConnectionLength;
     double endCenterY = endTopY - nodeHeight * 0.5;
     
-    nodes[nodeCount].x = 0.0;
-    nodes[nodeCount].y = endCenterY;  // Position END at standard connection length
-    nodes[nodeCount].height = 0.22f;  // Same height as other blocks
-    strcpy(nodes[nodeCount].value, "END");
-    nodes[nodeCount].type = NODE_END;
-    nodes[nodeCount].branchColumn = 0;
-    nodes[nodeCount].owningIfBlock = -1;
+    nodes[endIndex].x = 0.0;
+    nodes[endIndex].y = endCenterY;  // Position END at standard connection length
+    nodes[endIndex].height = 0.22f;  // Same height as other blocks
+    set_node_label(endIndex, "END");
+    nodes[endIndex].type = NODE_END;
+    nodes[endIndex].branchColumn = 0;
+    nodes[endIndex].owningIfBlock = -1;
     // Calculate width based on text content, same as other blocks
-    fontSize = nodes[nodeCount].height * 0.3f;
-    nodes[nodeCount].width = calculate_block_width(nodes[nodeCount].value, fontSize, 0.35f);
-    int endIndex = nodeCount++;
+    fontSize = nodes[endIndex].height * 0.3f;
+    nodes[endIndex].width = calculate_block_width(node_label(endIndex), fontSize, 0.35f);
     float endWidth = nodes[endIndex].width;  // Store END's width
     
     // Update START to use END's width (make START narrower)
     nodes[startIndex].width = endWidth;
     
     // Connect START to END
-    connections[connectionCount].fromNode = startIndex;
-    connections[connectionCount].toNode = endIndex;
-    connectionCount++;
+    add_connection(startIndex, endIndex);
 }
 
-int main(void) {
+// Render one frame of the editor (flowchart plus screen-space buttons)
+void render_frame(GLFWwindow* window) {
+    glClear(GL_COLOR_BUFFER_BIT);
+    
+    // Set up viewport and projection matrix to account for aspect ratio
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+    glViewport(0, 0, width, height);
+    
+    // Update text renderer with current window size
+    text_renderer_set_window_size(width, height);
+    
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    float aspectRatio = (float)width / (float)height;
+    // Use orthographic projection that accounts for aspect ratio
+    // This prevents horizontal stretching on wider windows
+    // Keep Y range as -1 to 1 to maintain proper vertical proportions
+    glOrtho(-aspectRatio, aspectRatio, -1.0, 1.0, -1.0, 1.0);
+    
+    // Update text renderer with current aspect ratio
+    text_renderer_set_aspect_ratio(aspectRatio);
+    text_renderer_set_y_scale(1.0f);  // No Y scaling needed
+    
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    
+    drawFlowchart(window);
+    
+    // Ensure scroll offsets and flowchart scale are reset for buttons (already reset in drawFlowchart, but be safe)
+    text_renderer_set_scroll_offsets(0.0, 0.0);
+    text_renderer_set_flowchart_scale(1.0f);
+    
+    // Draw buttons in screen space (not affected by scroll)
+    drawButtons(window);
+}
+
+int main(int argc, char** argv) {
+    // "--bench [nodeCount ...]" runs the stress benchmark in a hidden window and exits.
+    // Otherwise "--undo-memory MB" and "--undo-steps N" set the undo limits, and any
+    // other argument is a flowchart file to open.
+    bool benchmarkMode = (argc > 1 && strcmp(argv[1], "--bench") == 0);
+    const char* documentPath = NULL;
+    for (int i = 1; !benchmarkMode && i < argc; i++) {
+        if (strcmp(argv[i], "--undo-memory") == 0 && i + 1 < argc) {
+            int megabytes = atoi(argv[++i]);
+            if (megabytes > 0) {
+                set_undo_memory_budget((size_t)megabytes * 1024 * 1024);
+            } else {
+                fprintf(stderr, "Ignoring undo memory of %s MB\n", argv[i]);
+            }
+        } else if (strcmp(argv[i], "--undo-steps") == 0 && i + 1 < argc) {
+            int steps = atoi(argv[++i]);
+            if (steps > 0) {
+                set_undo_history_capacity(steps);
+            } else {
+                fprintf(stderr, "Ignoring undo step count %s\n", argv[i]);
+            }
+        } else {
+            documentPath = argv[i];
+        }
+    }
+    
     if (!glfwInit()) {
         fprintf(stderr, "Failed to initialize GLFW\n");
         return -1;
     }
     
+    if (benchmarkMode) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
+    
     GLFWwindow* window = glfwCreateWindow(1600, 900, "Flowchart Editor", NULL, NULL);
     if (!window) {
         fprintf(stderr, "Failed to create GLFW window\n");
@@ -2362,6 +2383,8 @@ int main(void) {
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetMouseButtonCallback(window, mouse_button_callback);
     glfwSetKeyCallback(window, key_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     
     if (!init_text_renderer(NULL)) {
         fprintf(stderr, "Warning: Failed to initialize text renderer\n");
@@ -2369,57 +2392,70 @@ int main(void) {
     
     // Initialize with connected START and END nodes
     initialize_flowchart();
+    if (documentPath) {
+        load_flowchart(documentPath);
+    }
 
     // Set background color to white
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
     
+    if (benchmarkMode) {
+        int result = run_benchmark(window, argc - 2, argv + 2);
+        cleanup_text_renderer();
+        glfwTerminate();
+        return result;
+    }
+    
+    // Event-driven loop: sleep until input, a dialog result or due journal work
+    // arrives, and draw only when something requested a frame. Frames are paced
+    // by vsync while panning, when drags can ask for more than the display shows.
+    bool titleDirty = false;
+    bool vsync = false;
+    unsigned int drawnRevision = flowchart_revision();
+    glfwSwapInterval(0);
     while (!glfwWindowShouldClose(window)) {
+        FRAME_PHASE_BEGIN(FRAME_PHASE_FILE_ACTIONS);
         process_pending_file_actions();
-        glClear(GL_COLOR_BUFFER_BIT);
-        
-        // Set up viewport and projection matrix to account for aspect ratio
-        int width, height;
-        glfwGetWindowSize(window, &width, &height);
-        glViewport(0, 0, width, height);
-        
-        // Update text renderer with current window size
-        text_renderer_set_window_size(width, height);
-        
-        glMatrixMode(GL_PROJECTION);
-        glLoadIdentity();
-        float aspectRatio = (float)width / (float)height;
-        // Use orthographic projection that accounts for aspect ratio
-        // This prevents horizontal stretching on wider windows
-        // Keep Y range as -1 to 1 to maintain proper vertical proportions
-        glOrtho(-aspectRatio, aspectRatio, -1.0, 1.0, -1.0, 1.0);
-        
-        // Update text renderer with current aspect ratio
-        text_renderer_set_aspect_ratio(aspectRatio);
-        text_renderer_set_y_scale(1.0f);  // No Y scaling needed
-        
-        glMatrixMode(GL_MODELVIEW);
-        glLoadIdentity();
-        
-        // Update hovered connection (use world-space cursor)
-        // Transformation: screen = scale * (world - scrollOffset/scale) = scale * world - scrollOffset
-        // So: world = (screen + scrollOffset) / scale
-        double worldCursorX = (cursorX + scrollOffsetX) / FLOWCHART_SCALE;
-        double worldCursorY = (cursorY + scrollOffsetY) / FLOWCHART_SCALE;
-        hoveredConnection = hit_connection(worldCursorX, worldCursorY, 0.05f);
-        
-        drawFlowchart(window);
-        
-        // Ensure scroll offsets and flowchart scale are reset for buttons (already reset in drawFlowchart, but be safe)
-        text_renderer_set_scroll_offsets(0.0, 0.0);
-        text_renderer_set_flowchart_scale(1.0f);
+        FRAME_PHASE_END(FRAME_PHASE_FILE_ACTIONS);
+        if (flowchart_revision() != drawnRevision) {
+            request_redraw();
+        }
         
-        // Draw buttons in screen space (not affected by scroll)
-        drawButtons(window);
-
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (redrawRequested) {
+            redrawRequested = false;
+            drawnRevision = flowchart_revision();
+            if (isPanning != vsync) {
+                vsync = isPanning;
+                glfwSwapInterval(vsync ? 1 : 0);
+            }
+            // The chart or the view may have moved under the cursor
+            FRAME_STATS_BEGIN_FRAME();
+            update_hover(window);
+            render_frame(window);
+            glfwSwapBuffers(window);
+            FRAME_STATS_END_FRAME();
+        }
+
+        // Flag unsaved changes in the title bar (only touched when that changes)
+        bool dirty = undo_journal_dirty();
+        if (dirty != titleDirty) {
+            glfwSetWindowTitle(window, dirty ? "Flowchart Editor *" : "Flowchart Editor");
+            titleDirty = dirty;
+        }
+
+        edit_journal_tick(glfwGetTime());
+        double wait = edit_journal_next_tick(glfwGetTime());
+        if (redrawRequested || wait == 0.0) {
+            glfwPollEvents();
+        } else if (wait > 0.0) {
+            glfwWaitEventsTimeout(wait);
+        } else {
+            glfwWaitEvents();
+        }
     }
 
+    // Nothing to recover after a clean exit
+    edit_journal_close(false);
     cleanup_text_renderer();
     glfwTerminate();
     return 0;
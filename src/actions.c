@@ -13,6 +13,8 @@
 #include "text_renderer.h"
 #include "file_io.h"
 #include "code_exporter.h"
+#include "arena.h"
+#include "frame_stats.h"
 #define TINYFD_NOLIB
 #include "../imports/tinyfiledialogs.h"
 
@@ -56,6 +58,7 @@ static DWORD WINAPI file_dialog_thread(LPVOID param) {
         pending_file_action = PENDING_NONE;
     }
     file_dialog_done = 1;
+    glfwPostEmptyEvent();  // Wake the main loop to act on the result
     return 0;
 }
 
@@ -91,9 +94,13 @@ int get_if_branch_type(int connIndex);
 void reposition_convergence_point(int ifBlockIndex, bool shouldPushNodesBelow);
 void update_all_branch_positions(void);
 bool is_valid_if_converge_connection(int fromNode, int toNode);
-void save_state_for_undo(void);
+void begin_edit(void);
+void mark_edit_dirty(int flags);
+void commit_edit(void);
+void abort_edit(void);
 void perform_undo(void);
 void perform_redo(void);
+void perform_switch_branch(int direction);
 int hit_node(double x, double y);
 int hit_connection(double x, double y, float threshold);
 bool cursor_over_button(float buttonX, float buttonY, GLFWwindow* window);
@@ -119,29 +126,156 @@ Variable* find_variable(const char* name);
 _Bool is_valid_variable_name(const char* name);
 bool variable_name_exists(const char* name, int excludeNodeIndex);
 void extract_variables_from_expression(const char* expr, char varNames[][MAX_VAR_NAME_LENGTH], int* varCount);
-int find_cycle_block_by_cycle_node(int nodeIndex);
-int find_cycle_block_by_end_node(int nodeIndex);
+int count_char_occurrences(const char* text, char c);
 bool is_cycle_loopback(int connIndex);
 int calculate_cycle_depth(int cycleIndex);
 int tinyfd_listDialog(const char* aTitle, const char* aMessage, int numOptions, const char* const* options);
 bool validate_expression(const char* expr, VariableType expectedType, VariableType* actualType, char* errorMsg);
 bool validate_assignment(const char* value);
 CycleType prompt_cycle_type(void);
+// Growable list of node indices for the delete paths below
+typedef struct {
+    int *items;
+    int count;
+    int capacity;
+} NodeList;
+
+static bool node_list_add(NodeList *list, int nodeIndex) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity > 0 ? list->capacity * 2 : 16;
+        int *grown = realloc(list->items, (size_t)capacity * sizeof(int));
+        if (!grown) {
+            return false;
+        }
+        list->items = grown;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = nodeIndex;
+    return true;
+}
+
+// Per node slot stamp for graph walks: a node has been visited by the current
+// walk when its stamp matches. Starting a walk does not touch the stamps, so a
+// walk costs only what it visits.
+static unsigned int *visitStamps = NULL;
+static int visitStampCapacity = 0;
+static unsigned int visitStamp = 0;
+
+static bool begin_node_walk(void) {
+    if (visitStampCapacity < nodeCount) {
+        int capacity = visitStampCapacity > 0 ? visitStampCapacity : 64;
+        while (capacity < nodeCount) {
+            capacity *= 2;
+        }
+        unsigned int *grown = realloc(visitStamps, (size_t)capacity * sizeof(unsigned int));
+        if (!grown) {
+            return false;
+        }
+        memset(grown + visitStampCapacity, 0, (size_t)(capacity - visitStampCapacity) * sizeof(unsigned int));
+        visitStamps = grown;
+        visitStampCapacity = capacity;
+    }
+    if (++visitStamp == 0) {
+        // The stamp wrapped around: old stamps could match again
+        memset(visitStamps, 0, (size_t)visitStampCapacity * sizeof(unsigned int));
+        visitStamp = 1;
+    }
+    return true;
+}
+
+// Mark a node as visited; returns false if the current walk already had it
+static bool visit_node(int nodeIndex) {
+    if (visitStamps[nodeIndex] == visitStamp) {
+        return false;
+    }
+    visitStamps[nodeIndex] = visitStamp;
+    return true;
+}
+
+// Append both branch lists of an IF block to a node list
+static bool add_if_branch_nodes(int ifBlockIndex, NodeList *list) {
+    for (int branchType = 0; branchType < 2; branchType++) {
+        for (int n = first_if_branch_node(&ifBlocks[ifBlockIndex], branchType); n >= 0; n = next_if_branch_node(n)) {
+            if (!node_list_add(list, n)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Collect everything inside an IF block's branches by walking the branch lists,
+// down through the IFs nested in them. A nested IF node is in its parent's list
+// but its convergence point is not, so that is added from the nested block.
+static bool collect_if_branch_nodes(int ifBlockIndex, NodeList *list) {
+    int first = list->count;
+    if (!add_if_branch_nodes(ifBlockIndex, list)) {
+        return false;
+    }
+    for (int k = first; k < list->count; k++) {
+        if (nodes[list->items[k]].type != NODE_IF) {
+            continue;
+        }
+        int nestedIfIdx = find_if_block_by_if_node(list->items[k]);
+        if (nestedIfIdx < 0 || nestedIfIdx == ifBlockIndex) {
+            continue;
+        }
+        if ((node_is_live(ifBlocks[nestedIfIdx].convergeNodeIndex) &&
+             !node_list_add(list, ifBlocks[nestedIfIdx].convergeNodeIndex)) ||
+            !add_if_branch_nodes(nestedIfIdx, list)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Free the IF and cycle blocks opened or closed by any of the listed nodes
+static void free_blocks_of_nodes(const NodeList *list) {
+    for (int k = 0; k < list->count; k++) {
+        int nodeIdx = list->items[k];
+        free_if_block(find_if_block_by_if_node(nodeIdx));
+        free_if_block(find_if_block_by_converge_node(nodeIdx));
+        free_cycle_block(find_cycle_block_by_cycle_node(nodeIdx));
+        free_cycle_block(find_cycle_block_by_end_node(nodeIdx));
+    }
+}
+
+static void shift_node_y(int nodeIndex, double deltaY, bool branchesOnly) {
+    if (!branchesOnly || nodes[nodeIndex].branchColumn != 0) {
+        nodes[nodeIndex].y = snap_to_grid_y(nodes[nodeIndex].y + deltaY);
+    }
+}
+
+// Move the nodes owned by an IF block (its branch lists and the convergence
+// points of the IFs nested directly in them) by deltaY. With branchesOnly,
+// nodes in the main column stay where they are.
+static void shift_if_block_nodes(int ifBlockIndex, double deltaY, bool branchesOnly) {
+    for (int branchType = 0; branchType < 2; branchType++) {
+        for (int n = first_if_branch_node(&ifBlocks[ifBlockIndex], branchType); n >= 0; n = next_if_branch_node(n)) {
+            shift_node_y(n, deltaY, branchesOnly);
+            int nestedIfIdx = nodes[n].type == NODE_IF ? find_if_block_by_if_node(n) : -1;
+            if (nestedIfIdx >= 0) {
+                int nestedConverge = ifBlocks[nestedIfIdx].convergeNodeIndex;
+                if (node_is_live(nestedConverge) && nodes[nestedConverge].owningIfBlock == ifBlockIndex) {
+                    shift_node_y(nestedConverge, deltaY, branchesOnly);
+                }
+            }
+        }
+    }
+}
+
 // tinyfd_listDialog implementation
-void delete_node(int nodeIndex) {
-    if (nodeIndex < 0 || nodeIndex >= nodeCount) {
+static void apply_delete_node(int nodeIndex) {
+    if (!node_is_live(nodeIndex)) {
         return;
     }
     
     // Special handling for IF and CONVERGE nodes
     if (nodes[nodeIndex].type == NODE_IF || nodes[nodeIndex].type == NODE_CONVERGE) {
         // Find the IF block that this node belongs to
-        int ifBlockIndex = -1;
-        for (int i = 0; i < ifBlockCount; i++) {
-            if (ifBlocks[i].ifNodeIndex == nodeIndex || ifBlocks[i].convergeNodeIndex == nodeIndex) {
-                ifBlockIndex = i;
-                break;
-            }
+        int ifBlockIndex = find_if_block_by_if_node(nodeIndex);
+        if (ifBlockIndex < 0) {
+            ifBlockIndex = find_if_block_by_converge_node(nodeIndex);
         }
         
         if (ifBlockIndex >= 0) {
@@ -151,285 +285,94 @@ void delete_node(int nodeIndex) {
             
             // Find the connection coming into the IF block
             int incomingFromNode = -1;
-            for (int i = 0; i < connectionCount; i++) {
-                if (connections[i].toNode == ifIdx) {
-                    incomingFromNode = connections[i].fromNode;
-                    break;
-                }
+            int incomingConn = first_incoming_connection(ifIdx);
+            if (incomingConn >= 0) {
+                incomingFromNode = connections[incomingConn].fromNode;
             }
             
             // Find the connection going out of the convergence point
             int outgoingToNode = -1;
-            for (int i = 0; i < connectionCount; i++) {
-                if (connections[i].fromNode == convergeIdx) {
-                    outgoingToNode = connections[i].toNode;
-                    break;
-                }
+            int outgoingConn = first_outgoing_connection(convergeIdx);
+            if (outgoingConn >= 0) {
+                outgoingToNode = connections[outgoingConn].toNode;
             }
             
-            // Find all nodes owned by this IF block (branch nodes)
-            int branchNodes[MAX_NODES];
-            int branchNodeCount = 0;
-            for (int i = 0; i < nodeCount; i++) {
-                if (nodes[i].owningIfBlock == ifBlockIndex) {
-                    branchNodes[branchNodeCount++] = i;
-                }
+            // Collect the IF, its convergence point and everything in its branches
+            NodeList removed = {0};
+            if (!node_list_add(&removed, ifIdx) || !node_list_add(&removed, convergeIdx) ||
+                !collect_if_branch_nodes(ifBlockIndex, &removed)) {
+                free(removed.items);
+                return;
             }
+            int parentIfIdx = ifBlock->parentIfIndex;
             
             // Remove all connections involving IF, convergence, or branch nodes
-            for (int i = connectionCount - 1; i >= 0; i--) {
-                bool shouldDelete = false;
-                
-                // Check if connection involves IF or convergence
-                if (connections[i].fromNode == ifIdx || connections[i].toNode == ifIdx ||
-                    connections[i].fromNode == convergeIdx || connections[i].toNode == convergeIdx) {
-                    shouldDelete = true;
-                }
-                
-                // Check if connection involves any branch node
-                for (int j = 0; j < branchNodeCount; j++) {
-                    if (connections[i].fromNode == branchNodes[j] || connections[i].toNode == branchNodes[j]) {
-                        shouldDelete = true;
-                        break;
-                    }
-                }
-                
-                if (shouldDelete) {
-                    // Remove this connection by shifting others down
-                    for (int j = i; j < connectionCount - 1; j++) {
-                        connections[j] = connections[j + 1];
-                    }
-                    connectionCount--;
-                }
-            }
+            remove_node_connections(removed.items, removed.count);
             
             // Create direct connection from incoming to outgoing
             if (incomingFromNode >= 0 && outgoingToNode >= 0) {
-                connections[connectionCount].fromNode = incomingFromNode;
-                connections[connectionCount].toNode = outgoingToNode;
-                connectionCount++;
+                add_connection(incomingFromNode, outgoingToNode);
             }
             
-            // Build list of all nodes to delete: IF, convergence, and all branch nodes
-            // Sort from highest to lowest index to avoid shifting issues
-            int nodesToDelete[MAX_NODES];
-            int deleteCount = 0;
-            nodesToDelete[deleteCount++] = ifIdx;
-            nodesToDelete[deleteCount++] = convergeIdx;
-            for (int i = 0; i < branchNodeCount; i++) {
-                nodesToDelete[deleteCount++] = branchNodes[i];
+            // Free this IF block and the IF/cycle blocks nested in its branches,
+            // then the nodes. Node and block indices are stable, so nothing else
+            // needs renumbering.
+            free_blocks_of_nodes(&removed);
+            for (int i = 0; i < removed.count; i++) {
+                free_node(removed.items[i]);
             }
-            
-            // Sort in descending order (highest index first)
-            for (int i = 0; i < deleteCount - 1; i++) {
-                for (int j = i + 1; j < deleteCount; j++) {
-                    if (nodesToDelete[i] < nodesToDelete[j]) {
-                        int temp = nodesToDelete[i];
-                        nodesToDelete[i] = nodesToDelete[j];
-                        nodesToDelete[j] = temp;
-                    }
-                }
-            }
-            
-            // Delete the nodes (higher index first)
-            for (int i = 0; i < deleteCount; i++) {
-                int delIdx = nodesToDelete[i];
-                
-                // Shift all nodes after this one down
-                for (int j = delIdx; j < nodeCount - 1; j++) {
-                    nodes[j] = nodes[j + 1];
-                }
-                nodeCount--;
-                
-                // Update all connections to account for shifted indices
-                for (int j = 0; j < connectionCount; j++) {
-                    if (connections[j].fromNode > delIdx) {
-                        connections[j].fromNode--;
-                    }
-                    if (connections[j].toNode > delIdx) {
-                        connections[j].toNode--;
-                    }
-                }
-                
-                // Update IF blocks to account for shifted indices
-                for (int j = 0; j < ifBlockCount; j++) {
-                    if (ifBlocks[j].ifNodeIndex > delIdx) {
-                        ifBlocks[j].ifNodeIndex--;
-                    }
-                    if (ifBlocks[j].convergeNodeIndex > delIdx) {
-                        ifBlocks[j].convergeNodeIndex--;
-                    }
-                    
-                    // Update branch arrays - shift node indices that are greater than delIdx
-                    for (int k = 0; k < ifBlocks[j].trueBranchCount; k++) {
-                        if (ifBlocks[j].trueBranchNodes[k] > delIdx) {
-                            ifBlocks[j].trueBranchNodes[k]--;
-                        }
-                    }
-                    for (int k = 0; k < ifBlocks[j].falseBranchCount; k++) {
-                        if (ifBlocks[j].falseBranchNodes[k] > delIdx) {
-                            ifBlocks[j].falseBranchNodes[k]--;
-                        }
-                    }
-                }
-                
-                // Update owningIfBlock for all remaining nodes
-                for (int j = 0; j < nodeCount; j++) {
-                    if (nodes[j].owningIfBlock > delIdx) {
-                        // Node index shifted, but owningIfBlock references haven't been updated yet
-                        // This will be handled after we remove the IF block from tracking
-                    }
-                }
-            }
-            
-            // Remove the IF block from the tracking array
-            for (int i = ifBlockIndex; i < ifBlockCount - 1; i++) {
-                ifBlocks[i] = ifBlocks[i + 1];
-            }
-            ifBlockCount--;
+            free(removed.items);
             
             // If this IF had a parent IF, reposition the parent's convergence
             // because the parent's branch depth has changed
-            int parentIfIdx = (ifBlockIndex < ifBlockCount && ifBlock->parentIfIndex >= 0) ? 
-                             ifBlock->parentIfIndex : -1;
-            // Adjust parent index if it's after the deleted IF block
-            if (parentIfIdx > ifBlockIndex) {
-                parentIfIdx--;
-            }
-            
-            // Clean up branch arrays: remove references to deleted nodes
-            // nodesToDelete contains all node indices that were deleted
-            for (int i = 0; i < ifBlockCount; i++) {
-                // Clean up true branch
-                int newTrueCount = 0;
-                for (int j = 0; j < ifBlocks[i].trueBranchCount; j++) {
-                    int nodeIdx = ifBlocks[i].trueBranchNodes[j];
-                    bool wasDeleted = false;
-                    for (int k = 0; k < deleteCount; k++) {
-                        if (nodeIdx == nodesToDelete[k]) {
-                            wasDeleted = true;
-                            break;
-                        }
-                    }
-                    if (!wasDeleted) {
-                        // Keep this node (it wasn't deleted)
-                        ifBlocks[i].trueBranchNodes[newTrueCount++] = nodeIdx;
-                    }
-                }
-                ifBlocks[i].trueBranchCount = newTrueCount;
-                
-                // Clean up false branch
-                int newFalseCount = 0;
-                for (int j = 0; j < ifBlocks[i].falseBranchCount; j++) {
-                    int nodeIdx = ifBlocks[i].falseBranchNodes[j];
-                    bool wasDeleted = false;
-                    for (int k = 0; k < deleteCount; k++) {
-                        if (nodeIdx == nodesToDelete[k]) {
-                            wasDeleted = true;
-                            break;
-                        }
-                    }
-                    if (!wasDeleted) {
-                        // Keep this node (it wasn't deleted)
-                        ifBlocks[i].falseBranchNodes[newFalseCount++] = nodeIdx;
-                    }
-                }
-                ifBlocks[i].falseBranchCount = newFalseCount;
-            }
-            
-            // Reposition parent IF's convergence if it exists
-            if (parentIfIdx >= 0 && parentIfIdx < ifBlockCount) {
-                
+            if (if_block_is_live(parentIfIdx)) {
                 reposition_convergence_point(parentIfIdx, true);
             }
             
-            // Update owningIfBlock for all remaining nodes
-            // Any nodes that were owned by IF blocks after this one need their index decremented
-            for (int i = 0; i < nodeCount; i++) {
-                if (nodes[i].owningIfBlock > ifBlockIndex) {
-                    nodes[i].owningIfBlock--;
-                } else if (nodes[i].owningIfBlock == ifBlockIndex) {
-                    // This shouldn't happen - all nodes owned by this IF should have been deleted
-                    nodes[i].owningIfBlock = -1;
-                }
-            }
-            
             // Pull up the outgoing node and everything below it to maintain normal connection length
-            if (incomingFromNode >= 0 && outgoingToNode >= 0) {
-                // Calculate how many nodes were deleted that were above outgoingToNode
-                int deletedAboveOutgoing = 0;
-                for (int i = 0; i < deleteCount; i++) {
-                    if (nodesToDelete[i] < outgoingToNode) {
-                        deletedAboveOutgoing++;
-                    }
-                }
+            if (node_is_live(incomingFromNode) && node_is_live(outgoingToNode)) {
+                FlowNode *incoming = &nodes[incomingFromNode];
+                FlowNode *outgoing = &nodes[outgoingToNode];
                 
-                // The new index of the outgoing node after deletions
-                int newOutgoingIdx = outgoingToNode - deletedAboveOutgoing;
+                // Calculate the desired connection length (normal)
+                const double initialConnectionLength = 0.28;
+                double desiredOutgoingY = incoming->y - incoming->height * 0.5 - outgoing->height * 0.5 - initialConnectionLength;
                 
-                // Similarly, calculate the new index of the incoming node
-                int deletedAboveIncoming = 0;
-                for (int i = 0; i < deleteCount; i++) {
-                    if (nodesToDelete[i] < incomingFromNode) {
-                        deletedAboveIncoming++;
-                    }
-                }
-                int newIncomingIdx = incomingFromNode - deletedAboveIncoming;
+                // Calculate how much to move up
+                double deltaY = desiredOutgoingY - outgoing->y;
                 
-                if (newIncomingIdx >= 0 && newIncomingIdx < nodeCount && 
-                    newOutgoingIdx >= 0 && newOutgoingIdx < nodeCount) {
-                    
-                    FlowNode *incoming = &nodes[newIncomingIdx];
-                    FlowNode *outgoing = &nodes[newOutgoingIdx];
+                // Only pull up if deltaY is positive (moving up)
+                if (deltaY > 0.001) {
                     
-                    // Calculate the desired connection length (normal)
-                    const double initialConnectionLength = 0.28;
-                    double desiredOutgoingY = incoming->y - incoming->height * 0.5 - outgoing->height * 0.5 - initialConnectionLength;
+                    // First pass: move main branch nodes and track which IF blocks are moved
+                    // (at most one per IF node)
+                    int *movedIfBlocks = malloc((size_t)(ifBlockCount + 1) * sizeof(int));
+                    int movedIfBlockCount = 0;
                     
-                    // Calculate how much to move up
-                    double deltaY = desiredOutgoingY - outgoing->y;
-                    
-                    // Only pull up if deltaY is positive (moving up)
-                    if (deltaY > 0.001) {
-                        
-                        // First pass: move main branch nodes and track which IF blocks are moved
-                        int movedIfBlocks[MAX_IF_BLOCKS];
-                        int movedIfBlockCount = 0;
-                        
-                        for (int i = 0; i < nodeCount; i++) {
-                            if (nodes[i].y <= outgoing->y && nodes[i].branchColumn == 0) {
-                                nodes[i].y = snap_to_grid_y(nodes[i].y + deltaY);
-                                
-                                // If this is an IF node, track its IF block for moving branches
-                                if (nodes[i].type == NODE_IF) {
-                                    for (int j = 0; j < ifBlockCount; j++) {
-                                        if (ifBlocks[j].ifNodeIndex == i) {
-                                            movedIfBlocks[movedIfBlockCount++] = j;
-                                            break;
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                        
-                        // Second pass: move all branch nodes of the IF blocks that were moved
-                        for (int i = 0; i < movedIfBlockCount; i++) {
-                            int ifBlockIdx = movedIfBlocks[i];
-                            for (int j = 0; j < nodeCount; j++) {
-                                if (nodes[j].owningIfBlock == ifBlockIdx && nodes[j].branchColumn != 0) {
-                                    nodes[j].y = snap_to_grid_y(nodes[j].y + deltaY);
+                    for (int i = 0; movedIfBlocks && i < nodeCount; i++) {
+                        if (node_is_live(i) && nodes[i].y <= outgoing->y && nodes[i].branchColumn == 0) {
+                            nodes[i].y = snap_to_grid_y(nodes[i].y + deltaY);
+                            
+                            // If this is an IF node, track its IF block for moving branches
+                            if (nodes[i].type == NODE_IF) {
+                                int j = find_if_block_by_if_node(i);
+                                if (j >= 0) {
+                                    movedIfBlocks[movedIfBlockCount++] = j;
                                 }
                             }
                         }
                     }
+                    
+                    // Second pass: move all branch nodes of the IF blocks that were moved
+                    for (int i = 0; i < movedIfBlockCount; i++) {
+                        shift_if_block_nodes(movedIfBlocks[i], deltaY, true);
+                    }
+                    free(movedIfBlocks);
                 }
             }
             
             // Rebuild variable table after deletion
-            rebuild_variable_table();
-            
-            // Save state AFTER operation completes (for redo to work correctly)
-            save_state_for_undo();
+            mark_edit_dirty(EDIT_VARIABLES);
             
             return;  // Done handling IF/CONVERGE deletion
         }
@@ -464,272 +407,117 @@ void delete_node(int nodeIndex) {
             int outgoingToNode = -1;
             if (cycle->cycleType == CYCLE_DO) {
                 // Incoming goes INTO the cycle_end (top). Loopback (cycle->end) is excluded.
-                for (int i = 0; i < connectionCount; i++) {
-                    if (connections[i].toNode == endIdx && !is_cycle_loopback(i)) {
+                for (int i = first_incoming_connection(endIdx); i >= 0; i = next_incoming_connection(i)) {
+                    if (!is_cycle_loopback(i)) {
                         incomingFromNode = connections[i].fromNode;
                         break;
                     }
                 }
                 // Outgoing goes OUT OF the cycle node (bottom). Loopback (cycle->end) is excluded.
-                for (int i = 0; i < connectionCount; i++) {
-                    if (connections[i].fromNode == cycleIdx && !is_cycle_loopback(i)) {
+                for (int i = first_outgoing_connection(cycleIdx); i >= 0; i = next_outgoing_connection(i)) {
+                    if (!is_cycle_loopback(i)) {
                         outgoingToNode = connections[i].toNode;
                         break;
                     }
                 }
             } else {
                 // WHILE/FOR: incoming goes INTO the cycle node (top), outgoing goes OUT OF the cycle_end (bottom).
-                for (int i = 0; i < connectionCount; i++) {
-                    if (connections[i].toNode == cycleIdx && !is_cycle_loopback(i)) {
+                for (int i = first_incoming_connection(cycleIdx); i >= 0; i = next_incoming_connection(i)) {
+                    if (!is_cycle_loopback(i)) {
                         incomingFromNode = connections[i].fromNode;
                         break;
                     }
                 }
-                for (int i = 0; i < connectionCount; i++) {
-                    if (connections[i].fromNode == endIdx && !is_cycle_loopback(i)) {
+                for (int i = first_outgoing_connection(endIdx); i >= 0; i = next_outgoing_connection(i)) {
+                    if (!is_cycle_loopback(i)) {
                         outgoingToNode = connections[i].toNode;
                         break;
                     }
                 }
             }
             
-            // Find all nodes inside the cycle using BFS.
+            // Find all nodes inside the cycle using BFS over the adjacency lists.
             // For DO loops, the body starts from cycle_end; for WHILE/FOR, it starts from cycle.
-            int nodesInside[MAX_NODES];
-            int nodesInsideCount = 0;
-            bool visited[MAX_NODES] = {false};
+            // The list doubles as the BFS queue.
+            NodeList removed = {0};
+            if (!begin_node_walk()) {
+                return;
+            }
             
             // Mark cycle and end nodes as visited (we don't want to include them in body)
-            visited[cycleIdx] = true;
-            visited[endIdx] = true;
-            
-            // BFS queue
-            int queue[MAX_NODES];
-            int queueFront = 0, queueBack = 0;
+            visit_node(cycleIdx);
+            visit_node(endIdx);
             
+            bool listed = true;
             int bodyEntryNode = (cycle->cycleType == CYCLE_DO) ? endIdx : cycleIdx;
-            for (int i = 0; i < connectionCount; i++) {
-                if (connections[i].fromNode == bodyEntryNode && !is_cycle_loopback(i)) {
+            for (int i = first_outgoing_connection(bodyEntryNode); listed && i >= 0; i = next_outgoing_connection(i)) {
+                if (!is_cycle_loopback(i)) {
                     int bodyStart = connections[i].toNode;
-                    if (bodyStart >= 0 && bodyStart < nodeCount && !visited[bodyStart]) {
-                        queue[queueBack++] = bodyStart;
-                        visited[bodyStart] = true;
+                    if (node_is_live(bodyStart) && visit_node(bodyStart)) {
+                        listed = node_list_add(&removed, bodyStart);
                     }
                 }
             }
             
             // BFS to find all nodes in the loop body
-            while (queueFront < queueBack) {
-                int current = queue[queueFront++];
-                
-                // Don't include cycle end node
-                if (current == endIdx) {
-                    continue;
-                }
-                
-                // Add to body nodes
-                nodesInside[nodesInsideCount++] = current;
-                
-                // Continue BFS from this node
-                for (int i = 0; i < connectionCount; i++) {
-                    if (connections[i].fromNode == current) {
-                        int next = connections[i].toNode;
-                        // Don't follow loopback connections or connections to cycle/end nodes
-                        if (next >= 0 && next < nodeCount && !visited[next] && 
-                            next != cycleIdx && next != endIdx &&
-                            !is_cycle_loopback(i)) {
-                            queue[queueBack++] = next;
-                            visited[next] = true;
-                        }
+            for (int k = 0; listed && k < removed.count; k++) {
+                for (int i = first_outgoing_connection(removed.items[k]); listed && i >= 0;
+                     i = next_outgoing_connection(i)) {
+                    int next = connections[i].toNode;
+                    // Don't follow loopback connections (cycle and end nodes are already visited)
+                    if (node_is_live(next) && !is_cycle_loopback(i) && visit_node(next)) {
+                        listed = node_list_add(&removed, next);
                     }
                 }
             }
             
-            // Remove all connections involving cycle, end, or body nodes
-            for (int i = connectionCount - 1; i >= 0; i--) {
-                bool shouldDelete = false;
-                
-                // Check if connection involves cycle or end node
-                if (connections[i].fromNode == cycleIdx || connections[i].toNode == cycleIdx ||
-                    connections[i].fromNode == endIdx || connections[i].toNode == endIdx) {
-                    shouldDelete = true;
-                }
-                
-                // Check if connection involves any body node
-                for (int j = 0; j < nodesInsideCount; j++) {
-                    if (connections[i].fromNode == nodesInside[j] || connections[i].toNode == nodesInside[j]) {
-                        shouldDelete = true;
-                        break;
-                    }
-                }
-                
-                if (shouldDelete) {
-                    // Remove this connection by shifting others down
-                    for (int j = i; j < connectionCount - 1; j++) {
-                        connections[j] = connections[j + 1];
-                    }
-                    connectionCount--;
-                }
+            if (!listed || !node_list_add(&removed, cycleIdx) || !node_list_add(&removed, endIdx)) {
+                free(removed.items);
+                return;
             }
             
+            // Remove all connections involving cycle, end, or body nodes
+            remove_node_connections(removed.items, removed.count);
+            
             // Create direct connection from incoming to outgoing
             if (incomingFromNode >= 0 && outgoingToNode >= 0) {
-                connections[connectionCount].fromNode = incomingFromNode;
-                connections[connectionCount].toNode = outgoingToNode;
-                connectionCount++;
+                add_connection(incomingFromNode, outgoingToNode);
             }
             
-            // Build list of all nodes to delete: cycle, end, and all body nodes
-            // Sort from highest to lowest index to avoid shifting issues
-            int nodesToDelete[MAX_NODES];
-            int deleteCount = 0;
-            nodesToDelete[deleteCount++] = cycleIdx;
-            nodesToDelete[deleteCount++] = endIdx;
-            for (int i = 0; i < nodesInsideCount; i++) {
-                nodesToDelete[deleteCount++] = nodesInside[i];
+            // Free this cycle block and the IF/cycle blocks nested in its body,
+            // then the nodes (they leave their IF branch lists in free_node()).
+            // Node and block indices are stable, so nothing else needs renumbering.
+            free_blocks_of_nodes(&removed);
+            for (int i = 0; i < removed.count; i++) {
+                free_node(removed.items[i]);
             }
-            
-            // Sort in descending order (highest index first)
-            for (int i = 0; i < deleteCount - 1; i++) {
-                for (int j = i + 1; j < deleteCount; j++) {
-                    if (nodesToDelete[i] < nodesToDelete[j]) {
-                        int temp = nodesToDelete[i];
-                        nodesToDelete[i] = nodesToDelete[j];
-                        nodesToDelete[j] = temp;
-                    }
-                }
-            }
-            
-            // Delete the nodes (higher index first)
-            for (int i = 0; i < deleteCount; i++) {
-                int delIdx = nodesToDelete[i];
-                
-                // Shift all nodes after this one down
-                for (int j = delIdx; j < nodeCount - 1; j++) {
-                    nodes[j] = nodes[j + 1];
-                }
-                nodeCount--;
-                
-                // Update all connections to account for shifted indices
-                for (int j = 0; j < connectionCount; j++) {
-                    if (connections[j].fromNode > delIdx) {
-                        connections[j].fromNode--;
-                    }
-                    if (connections[j].toNode > delIdx) {
-                        connections[j].toNode--;
-                    }
-                }
-                
-                // Update IF blocks to account for shifted indices
-                for (int j = 0; j < ifBlockCount; j++) {
-                    if (ifBlocks[j].ifNodeIndex > delIdx) {
-                        ifBlocks[j].ifNodeIndex--;
-                    }
-                    if (ifBlocks[j].convergeNodeIndex > delIdx) {
-                        ifBlocks[j].convergeNodeIndex--;
-                    }
-                    for (int k = 0; k < ifBlocks[j].trueBranchCount; k++) {
-                        if (ifBlocks[j].trueBranchNodes[k] > delIdx) {
-                            ifBlocks[j].trueBranchNodes[k]--;
-                        }
-                    }
-                    for (int k = 0; k < ifBlocks[j].falseBranchCount; k++) {
-                        if (ifBlocks[j].falseBranchNodes[k] > delIdx) {
-                            ifBlocks[j].falseBranchNodes[k]--;
-                        }
-                    }
-                }
-                
-                // Update cycle blocks to account for shifted indices
-                for (int j = 0; j < cycleBlockCount; j++) {
-                    if (cycleBlocks[j].cycleNodeIndex > delIdx) {
-                        cycleBlocks[j].cycleNodeIndex--;
-                    }
-                    if (cycleBlocks[j].cycleEndNodeIndex > delIdx) {
-                        cycleBlocks[j].cycleEndNodeIndex--;
-                    }
-                }
-            }
-            
-            // Remove the cycle block
-            for (int i = cycleBlockIndex; i < cycleBlockCount - 1; i++) {
-                cycleBlocks[i] = cycleBlocks[i + 1];
-            }
-            cycleBlockCount--;
-            
-            // Update parent cycle indices
-            for (int i = 0; i < cycleBlockCount; i++) {
-                if (cycleBlocks[i].parentCycleIndex > cycleBlockIndex) {
-                    cycleBlocks[i].parentCycleIndex--;
-                }
-            }
-            
-            // Update owningIfBlock for all remaining nodes
-            // Any nodes that were owned by IF blocks need their index checked
-            for (int i = 0; i < nodeCount; i++) {
-                // Check if this node's owningIfBlock references a deleted node
-                // (This shouldn't happen for cycle nodes, but we check for safety)
-                if (nodes[i].owningIfBlock >= 0) {
-                    // The owningIfBlock index should still be valid after deletions
-                    // since we only deleted cycle-related nodes, not IF blocks
-                }
-            }
-            
-            // Rebuild variable table after deletion
-            rebuild_variable_table();
+            free(removed.items);
             
             // Pull up the outgoing node and everything below it to maintain normal connection length
-            if (incomingFromNode >= 0 && outgoingToNode >= 0) {
-                // Calculate how many nodes were deleted that were above outgoingToNode
-                int deletedAboveOutgoing = 0;
-                for (int i = 0; i < deleteCount; i++) {
-                    if (nodesToDelete[i] < outgoingToNode) {
-                        deletedAboveOutgoing++;
-                    }
-                }
+            if (node_is_live(incomingFromNode) && node_is_live(outgoingToNode)) {
+                FlowNode *incoming = &nodes[incomingFromNode];
+                FlowNode *outgoing = &nodes[outgoingToNode];
                 
-                // The new index of the outgoing node after deletions
-                int newOutgoingIdx = outgoingToNode - deletedAboveOutgoing;
+                // Calculate the desired connection length (normal)
+                const double initialConnectionLength = 0.28;
+                double desiredOutgoingY = incoming->y - incoming->height * 0.5 - outgoing->height * 0.5 - initialConnectionLength;
                 
-                // Similarly, calculate the new index of the incoming node
-                int deletedAboveIncoming = 0;
-                for (int i = 0; i < deleteCount; i++) {
-                    if (nodesToDelete[i] < incomingFromNode) {
-                        deletedAboveIncoming++;
-                    }
-                }
-                int newIncomingIdx = incomingFromNode - deletedAboveIncoming;
+                // Calculate how much to move up
+                double deltaY = desiredOutgoingY - outgoing->y;
                 
-                if (newIncomingIdx >= 0 && newIncomingIdx < nodeCount && 
-                    newOutgoingIdx >= 0 && newOutgoingIdx < nodeCount) {
-                    
-                    FlowNode *incoming = &nodes[newIncomingIdx];
-                    FlowNode *outgoing = &nodes[newOutgoingIdx];
-                    
-                    // Calculate the desired connection length (normal)
-                    const double initialConnectionLength = 0.28;
-                    double desiredOutgoingY = incoming->y - incoming->height * 0.5 - outgoing->height * 0.5 - initialConnectionLength;
-                    
-                    // Calculate how much to move up
-                    double deltaY = desiredOutgoingY - outgoing->y;
-                    
-                    // Only pull up if deltaY is positive (moving up)
-                    if (deltaY > 0.001) {
-                        // Move all nodes below the outgoing node up
-                        for (int i = 0; i < nodeCount; i++) {
-                            if (nodes[i].y <= outgoing->y) {
-                                nodes[i].y = snap_to_grid_y(nodes[i].y + deltaY);
-                            }
+                // Only pull up if deltaY is positive (moving up)
+                if (deltaY > 0.001) {
+                    // Move all nodes below the outgoing node up
+                    for (int i = 0; i < nodeCount; i++) {
+                        if (node_is_live(i) && nodes[i].y <= outgoing->y) {
+                            nodes[i].y = snap_to_grid_y(nodes[i].y + deltaY);
                         }
                     }
                 }
             }
             
             // Rebuild variable table after deletion
-            rebuild_variable_table();
-            
-            // Save state AFTER operation completes (for redo to work correctly)
-            save_state_for_undo();
+            mark_edit_dirty(EDIT_VARIABLES);
             
             return;  // Done handling CYCLE/CYCLE_END deletion
         }
@@ -745,47 +533,54 @@ void delete_node(int nodeIndex) {
         int ifIdx = nodes[nodeIndex].owningIfBlock;
         IFBlock *ifBlock = &ifBlocks[ifIdx];
         
-        // Check if it's in the true branch
-        for (int i = 0; i < ifBlock->trueBranchCount; i++) {
-            if (ifBlock->trueBranchNodes[i] == nodeIndex) {
-                // Found it - shift remaining nodes down
-                for (int j = i; j < ifBlock->trueBranchCount - 1; j++) {
-                    ifBlock->trueBranchNodes[j] = ifBlock->trueBranchNodes[j + 1];
-                }
-                ifBlock->trueBranchCount--;
-                break;
-            }
-        }
-        
-        // Check if it's in the false branch
-        for (int i = 0; i < ifBlock->falseBranchCount; i++) {
-            if (ifBlock->falseBranchNodes[i] == nodeIndex) {
-                // Found it - shift remaining nodes down
-                for (int j = i; j < ifBlock->falseBranchCount - 1; j++) {
-                    ifBlock->falseBranchNodes[j] = ifBlock->falseBranchNodes[j + 1];
-                }
-                ifBlock->falseBranchCount--;
-                break;
-            }
-        }
+        remove_if_branch_node(ifBlock, nodeIndex);
     }
     
-    int incomingConnections[MAX_CONNECTIONS];
-    int outgoingConnections[MAX_CONNECTIONS];
     int incomingCount = 0;
     int outgoingCount = 0;
+    for (int i = first_outgoing_connection(nodeIndex); i >= 0; i = next_outgoing_connection(i)) {
+        outgoingCount++;
+    }
+    for (int i = first_incoming_connection(nodeIndex); i >= 0; i = next_incoming_connection(i)) {
+        incomingCount++;
+    }
     
-    for (int i = 0; i < connectionCount; i++) {
-        if (connections[i].fromNode == nodeIndex) {
-            outgoingConnections[outgoingCount++] = i;
-        }
-        if (connections[i].toNode == nodeIndex) {
-            incomingConnections[incomingCount++] = i;
-        }
+    // Scratch buffers for reconnection and the position adjustment below. Each
+    // new connection moves at most one node, and each moved node pulls at most
+    // one IF block along.
+    int newConnectionCapacity = incomingCount * outgoingCount + 1;
+    int *incomingConnections = malloc((size_t)(incomingCount + 1) * sizeof(int));
+    int *outgoingConnections = malloc((size_t)(outgoingCount + 1) * sizeof(int));
+    int *newConnections = malloc((size_t)newConnectionCapacity * sizeof(int));
+    double *originalYPositions = malloc((size_t)nodeCount * sizeof(double));
+    double *nodePositionDeltas = malloc((size_t)newConnectionCapacity * sizeof(double));
+    int *nodesToMove = malloc((size_t)newConnectionCapacity * sizeof(int));
+    int *pulledIfBlocks = malloc((size_t)newConnectionCapacity * sizeof(int));
+    int *pulledIfBlocksInDeletion = malloc((size_t)(ifBlockCount + 1) * sizeof(int));
+    if (!incomingConnections || !outgoingConnections || !newConnections ||
+        !originalYPositions || !nodePositionDeltas ||
+        !nodesToMove || !pulledIfBlocks || !pulledIfBlocksInDeletion) {
+        free(incomingConnections);
+        free(outgoingConnections);
+        free(newConnections);
+        free(originalYPositions);
+        free(nodePositionDeltas);
+        free(nodesToMove);
+        free(pulledIfBlocks);
+        free(pulledIfBlocksInDeletion);
+        return;
+    }
+    
+    incomingCount = 0;
+    outgoingCount = 0;
+    for (int i = first_outgoing_connection(nodeIndex); i >= 0; i = next_outgoing_connection(i)) {
+        outgoingConnections[outgoingCount++] = i;
+    }
+    for (int i = first_incoming_connection(nodeIndex); i >= 0; i = next_incoming_connection(i)) {
+        incomingConnections[incomingCount++] = i;
     }
     
     // Track newly created connections for position adjustment
-    int newConnections[MAX_CONNECTIONS];
     int newConnectionCount = 0;
     
     // Reconnect: for each incoming connection (A -> deleted) and each outgoing connection (deleted -> B),
@@ -831,8 +626,8 @@ void delete_node(int nodeIndex) {
             bool connectionExists = false;
             int deletedBranch = nodes[nodeIndex].branchColumn;
             
-            for (int k = 0; k < connectionCount; k++) {
-                if (connections[k].fromNode == fromNode && connections[k].toNode == toNode) {
+            for (int k = first_outgoing_connection(fromNode); k >= 0; k = next_outgoing_connection(k)) {
+                if (connections[k].toNode == toNode) {
                     // Found a matching connection, but is it for the correct branch?
                     if (nodes[fromNode].type == NODE_IF && nodes[toNode].type == NODE_CONVERGE) {
                         // This is an IF->convergence connection
@@ -859,28 +654,24 @@ void delete_node(int nodeIndex) {
             }
             
             // Create new connection if it doesn't exist and we have room
-            if (!connectionExists && connectionCount < MAX_CONNECTIONS) {
-                
-                connections[connectionCount].fromNode = fromNode;
-                connections[connectionCount].toNode = toNode;
-                newConnections[newConnectionCount++] = connectionCount;
-                connectionCount++;
+            if (!connectionExists) {
+                int newConn = add_connection(fromNode, toNode);
+                if (newConn >= 0) {
+                    newConnections[newConnectionCount++] = newConn;
+                }
             }
         }
     }
     
     // Store original Y positions before any adjustments
-    double originalYPositions[MAX_NODES];
     for (int i = 0; i < nodeCount; i++) {
         originalYPositions[i] = nodes[i].y;
     }
     
     // Adjust positions of reconnected nodes to maintain standard connection length
     // Only adjust based on newly created connections
-    // Track which nodes need to move and by how much
-    double nodePositionDeltas[MAX_NODES] = {0.0};
-    bool nodeNeedsMove[MAX_NODES] = {false};
-    
+    // Track which nodes need to move and by how much (nodesToMove, nodePositionDeltas)
+    int nodesToMoveCount = 0;
     for (int i = 0; i < newConnectionCount; i++) {
         int connIdx = newConnections[i];
         int fromNodeIdx = connections[connIdx].fromNode;
@@ -897,24 +688,21 @@ void delete_node(int nodeIndex) {
             double deltaY = newY - originalYPositions[toNodeIdx];
             
             // Track the movement (use the maximum delta if node is moved multiple times)
-            if (!nodeNeedsMove[toNodeIdx] || fabs(deltaY) > fabs(nodePositionDeltas[toNodeIdx])) {
-                nodePositionDeltas[toNodeIdx] = deltaY;
-                nodeNeedsMove[toNodeIdx] = true;
+            int m = 0;
+            while (m < nodesToMoveCount && nodesToMove[m] != toNodeIdx) {
+                m++;
+            }
+            if (m == nodesToMoveCount) {
+                nodesToMove[nodesToMoveCount++] = toNodeIdx;
+                nodePositionDeltas[m] = deltaY;
+            } else if (fabs(deltaY) > fabs(nodePositionDeltas[m])) {
+                nodePositionDeltas[m] = deltaY;
             }
         }
     }
     
     // Apply movements: move each node and all nodes below it
     // Process nodes from top to bottom (highest Y first) to avoid double-moving
-    // Create sorted list of nodes that need to move
-    int nodesToMove[MAX_NODES];
-    int nodesToMoveCount = 0;
-    for (int i = 0; i < nodeCount; i++) {
-        if (nodeNeedsMove[i] && i != nodeIndex) {
-            nodesToMove[nodesToMoveCount++] = i;
-        }
-    }
-    
     // Sort by original Y position (highest first, since Y decreases downward)
     for (int i = 0; i < nodesToMoveCount - 1; i++) {
         for (int j = i + 1; j < nodesToMoveCount; j++) {
@@ -922,18 +710,20 @@ void delete_node(int nodeIndex) {
                 int temp = nodesToMove[i];
                 nodesToMove[i] = nodesToMove[j];
                 nodesToMove[j] = temp;
+                double tempDelta = nodePositionDeltas[i];
+                nodePositionDeltas[i] = nodePositionDeltas[j];
+                nodePositionDeltas[j] = tempDelta;
             }
         }
     }
     
     // Track IF blocks that are pulled up so we can reposition their convergence points
-    int pulledIfBlocks[MAX_NODES];
     int pulledIfBlockCount = 0;
     
     // Apply movements in order from top to bottom
     for (int i = 0; i < nodesToMoveCount; i++) {
         int nodeIdx = nodesToMove[i];
-        double deltaY = nodePositionDeltas[nodeIdx];
+        double deltaY = nodePositionDeltas[i];
         double originalY = originalYPositions[nodeIdx];
         
         // Move this node and snap to grid
@@ -943,13 +733,7 @@ void delete_node(int nodeIndex) {
         // If so, also move its branch nodes (works for both main branch and nested IFs)
         if (nodes[nodeIdx].type == NODE_IF) {
             // Find the IF block index for this IF node
-            int pulledIfBlockIdx = -1;
-            for (int k = 0; k < ifBlockCount; k++) {
-                if (ifBlocks[k].ifNodeIndex == nodeIdx) {
-                    pulledIfBlockIdx = k;
-                    break;
-                }
-            }
+            int pulledIfBlockIdx = find_if_block_by_if_node(nodeIdx);
             
             if (pulledIfBlockIdx >= 0) {
                 // Track this IF block for convergence repositioning later
@@ -960,28 +744,23 @@ void delete_node(int nodeIndex) {
                         break;
                     }
                 }
-                if (!alreadyTracked && pulledIfBlockCount < MAX_NODES) {
+                if (!alreadyTracked) {
                     pulledIfBlocks[pulledIfBlockCount++] = pulledIfBlockIdx;
                 }
                 
-                // Pull all branch nodes owned by this IF block
-                for (int k = 0; k < nodeCount; k++) {
-                    if (k != nodeIndex && nodes[k].owningIfBlock == pulledIfBlockIdx) {
-                        
-                        nodes[k].y = snap_to_grid_y(nodes[k].y + deltaY);
-                    }
-                }
+                // Pull all branch nodes owned by this IF block (the deleted node
+                // already left its branch list above)
+                shift_if_block_nodes(pulledIfBlockIdx, deltaY, false);
             }
         }
         
         // Move all nodes below this one (based on original positions) up by the same amount
         // Use original positions to determine what's below, but apply to current positions
         // IMPORTANT: Only pull nodes in the SAME BRANCH, but also track IF blocks that move
-        int pulledIfBlocksInDeletion[MAX_IF_BLOCKS];
         int pulledIfBlockCountInDeletion = 0;
         
         for (int j = 0; j < nodeCount; j++) {
-            if (j != nodeIdx && j != nodeIndex && originalYPositions[j] < originalY) {
+            if (j != nodeIdx && j != nodeIndex && node_is_live(j) && originalYPositions[j] < originalY) {
                 // Only pull nodes in the same branch as the deleted node
                 // Case 1: Both in main branch (0)
                 // Case 2: Both in same non-zero branch AND same IF block
@@ -1003,11 +782,9 @@ void delete_node(int nodeIndex) {
                 
                 // If this is an IF node in main branch, track it to pull its branches too
                 if (nodes[j].type == NODE_IF && nodes[j].branchColumn == 0) {
-                    for (int k = 0; k < ifBlockCount; k++) {
-                        if (ifBlocks[k].ifNodeIndex == j) {
-                            pulledIfBlocksInDeletion[pulledIfBlockCountInDeletion++] = k;
-                            break;
-                        }
+                    int k = find_if_block_by_if_node(j);
+                    if (k >= 0) {
+                        pulledIfBlocksInDeletion[pulledIfBlockCountInDeletion++] = k;
                     }
                 }
             }
@@ -1015,12 +792,7 @@ void delete_node(int nodeIndex) {
         
         // Second pass: pull all branch nodes of IF blocks that were moved
         for (int i = 0; i < pulledIfBlockCountInDeletion; i++) {
-            int ifBlockIdx = pulledIfBlocksInDeletion[i];
-            for (int j = 0; j < nodeCount; j++) {
-                if (nodes[j].owningIfBlock == ifBlockIdx && nodes[j].branchColumn != 0) {
-                    nodes[j].y = snap_to_grid_y(nodes[j].y + deltaY);
-                }
-            }
+            shift_if_block_nodes(pulledIfBlocksInDeletion[i], deltaY, true);
         }
     }
     
@@ -1029,61 +801,21 @@ void delete_node(int nodeIndex) {
         reposition_convergence_point(pulledIfBlocks[i], false);  // Don't push nodes below when deleting
     }
     
-    // Remove all connections involving the deleted node
-    // Work backwards to avoid index shifting issues
-    for (int i = connectionCount - 1; i >= 0; i--) {
-        if (connections[i].fromNode == nodeIndex || connections[i].toNode == nodeIndex) {
-            
-            // Shift remaining connections down
-            for (int j = i; j < connectionCount - 1; j++) {
-                connections[j] = connections[j + 1];
-            }
-            connectionCount--;
-        }
-    }
+    free(incomingConnections);
+    free(outgoingConnections);
+    free(newConnections);
+    free(originalYPositions);
+    free(nodePositionDeltas);
+    free(nodesToMove);
+    free(pulledIfBlocks);
+    free(pulledIfBlocksInDeletion);
     
-    // Update connection indices that reference nodes after the deleted one
-    for (int i = 0; i < connectionCount; i++) {
-        if (connections[i].fromNode > nodeIndex) {
-            connections[i].fromNode--;
-        }
-        if (connections[i].toNode > nodeIndex) {
-            connections[i].toNode--;
-        }
-    }
-    
-    // Remove the node and shift remaining nodes
-    for (int i = nodeIndex; i < nodeCount - 1; i++) {
-        
-        nodes[i] = nodes[i + 1];
-    }
-    nodeCount--;
-    
-    // Update branch node indices in all IF blocks after deletion
-    // Any node index > nodeIndex needs to be decremented
+    // Remove all connections involving the deleted node
+    remove_connections_of_node(nodeIndex);
     
-    for (int i = 0; i < ifBlockCount; i++) {
-        // Update IF and CONVERGE node indices
-        if (ifBlocks[i].ifNodeIndex > nodeIndex) {
-            ifBlocks[i].ifNodeIndex--;
-        }
-        if (ifBlocks[i].convergeNodeIndex > nodeIndex) {
-            ifBlocks[i].convergeNodeIndex--;
-        }
-        
-        // Update true branch nodes
-        for (int j = 0; j < ifBlocks[i].trueBranchCount; j++) {
-            if (ifBlocks[i].trueBranchNodes[j] > nodeIndex) {
-                ifBlocks[i].trueBranchNodes[j]--;
-            }
-        }
-        // Update false branch nodes
-        for (int j = 0; j < ifBlocks[i].falseBranchCount; j++) {
-            if (ifBlocks[i].falseBranchNodes[j] > nodeIndex) {
-                ifBlocks[i].falseBranchNodes[j]--;
-            }
-        }
-    }
+    // Free the node's slot. Other node indices don't shift, so connections
+    // and IF/cycle blocks are left as they are.
+    free_node(nodeIndex);
     
     // NOW reposition convergence point after the node has been deleted
     // This ensures we count the correct number of remaining nodes in each branch
@@ -1092,24 +824,57 @@ void delete_node(int nodeIndex) {
         reposition_convergence_point(deletedNodeOwningIfBlock, false);
     }
     
-    // Recalculate all branch widths and positions after deletion
-    // This ensures parent IF branches shrink when nested IFs are removed
-    update_all_branch_positions();
-    
-    // Rebuild variable table after deletion
-    rebuild_variable_table();
-    
-    // Save state AFTER operation completes (for redo to work correctly)
-    save_state_for_undo();
+    // Recalculate all branch widths and positions after deletion (so parent IF
+    // branches shrink when nested IFs are removed) and rebuild the variable table
+    mark_edit_dirty(EDIT_LAYOUT | EDIT_VARIABLES);
 }
 
-void edit_node_value(int nodeIndex) {
+void delete_node(int nodeIndex) {
+    begin_edit();
+    apply_delete_node(nodeIndex);
+    commit_edit();
+}
+
+// Check that the placeholders of an output format string name declared variables
+// and that array placeholders index arrays within bounds
+static bool validate_output_placeholders(char varNames[][MAX_VAR_NAME_LENGTH], char indexExprs[][MAX_VALUE_LENGTH],
+                                         const bool* isArrayAccess, int varCount, char* errorMsg) {
+    for (int i = 0; i < varCount; i++) {
+        Variable* var = find_variable(varNames[i]);
+        if (!var) {
+            snprintf(errorMsg, MAX_VALUE_LENGTH, 
+                "Variable '%s' referenced in format string is not declared", varNames[i]);
+            return false;
+        }
+        
+        // If it's an array access, validate the index
+        if (isArrayAccess[i]) {
+            if (!var->is_array) {
+                snprintf(errorMsg, MAX_VALUE_LENGTH, 
+                    "Variable '%s' is not an array, but array access syntax was used", varNames[i]);
+                return false;
+            }
+            
+            // Validate index expression
+            int dummyIndex;
+            if (!evaluate_index_expression(indexExprs[i], &dummyIndex, errorMsg)) {
+                return false;
+            }
+            
+            // Check array bounds
+            if (!check_array_bounds(varNames[i], indexExprs[i], errorMsg)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void apply_edit_node_value(int nodeIndex) {
     if (nodeIndex < 0 || nodeIndex >= nodeCount) {
         return;
     }
     
-    save_state_for_undo();
-    
     FlowNode *node = &nodes[nodeIndex];
     
     if (node->type == NODE_DECLARE) {
@@ -1127,12 +892,12 @@ void edit_node_value(int nodeIndex) {
         char currentName[MAX_VAR_NAME_LENGTH] = "";
         int currentArraySize = 0;
         // Try to extract current name if block already has a value
-        if (node->value[0] != '\0') {
+        if (node_label(nodeIndex)[0] != '\0') {
             char varName[MAX_VAR_NAME_LENGTH];
             VariableType varType;
             bool isArray;
             int arraySize;
-            if (parse_declare_block(node->value, varName, &varType, &isArray, &arraySize)) {
+            if (parse_declare_block(node_label(nodeIndex), varName, &varType, &isArray, &arraySize)) {
                 strncpy(currentName, varName, MAX_VAR_NAME_LENGTH - 1);
                 currentArraySize = arraySize;
             }
@@ -1211,15 +976,14 @@ void edit_node_value(int nodeIndex) {
             snprintf(newValue, sizeof(newValue), "%s %s", typeName, varName);
         }
         
-        strncpy(node->value, newValue, MAX_VALUE_LENGTH - 1);
-        node->value[MAX_VALUE_LENGTH - 1] = '\0';
+        set_node_label(nodeIndex, newValue);
         
         // Recalculate width based on text content
         float fontSize = node->height * 0.3f;
-        node->width = calculate_block_width(node->value, fontSize, 0.35f);
+        node->width = calculate_block_width(node_label(nodeIndex), fontSize, 0.35f);
         
         // Rebuild variable table
-        rebuild_variable_table();
+        mark_edit_dirty(EDIT_VARIABLES);
         
     } else if (node->type == NODE_ASSIGNMENT) {
         // ASSIGNMENT BLOCK: Step 1 - Select variable
@@ -1271,10 +1035,10 @@ void edit_node_value(int nodeIndex) {
         
         if (selectedVar->is_array) {
             // Extract current index if block already has a value
-            if (node->value[0] != '\0') {
+            if (node_label(nodeIndex)[0] != '\0') {
                 char arrayName[MAX_VAR_NAME_LENGTH];
                 char currentIndex[MAX_VALUE_LENGTH];
-                if (parse_array_access(node->value, arrayName, currentIndex)) {
+                if (parse_array_access(node_label(nodeIndex), arrayName, currentIndex)) {
                     if (strcmp(arrayName, selectedVar->name) == 0) {
                         strncpy(indexExpr, currentIndex, MAX_VALUE_LENGTH - 1);
                     }
@@ -1317,12 +1081,12 @@ void edit_node_value(int nodeIndex) {
         // Step 3 - Get expression
         char currentExpr[MAX_VALUE_LENGTH] = "";
         // Try to extract current expression if block already has a value
-        if (node->value[0] != '\0') {
+        if (node_label(nodeIndex)[0] != '\0') {
             char leftVar[MAX_VAR_NAME_LENGTH];
             char rightValue[MAX_VALUE_LENGTH];
             bool isRightVar = false;
             bool isQuotedString = false;
-            if (parse_assignment(node->value, leftVar, rightValue, &isRightVar, &isQuotedString)) {
+            if (parse_assignment(node_label(nodeIndex), leftVar, rightValue, &isRightVar, &isQuotedString)) {
                 strncpy(currentExpr, rightValue, MAX_VALUE_LENGTH - 1);
             }
         }
@@ -1416,18 +1180,30 @@ void edit_node_value(int nodeIndex) {
         VariableType actualType;
         char errorMsg[MAX_VALUE_LENGTH];
         
-        // Check for array accesses in the expression
-        char exprArrayNames[MAX_VARIABLES][MAX_VAR_NAME_LENGTH];
-        char exprIndexExprs[MAX_VARIABLES][MAX_VALUE_LENGTH];
+        // Check for array accesses in the expression (at most one per '[')
+        int maxAccesses = count_char_occurrences(exprResult, '[');
+        if (maxAccesses > MAX_VARIABLES) maxAccesses = MAX_VARIABLES;
+        ArenaMark scratch = arena_mark(&scratchArena);
+        char (*exprArrayNames)[MAX_VAR_NAME_LENGTH] = arena_alloc(&scratchArena, (size_t)maxAccesses * MAX_VAR_NAME_LENGTH);
+        char (*exprIndexExprs)[MAX_VALUE_LENGTH] = arena_alloc(&scratchArena, (size_t)maxAccesses * MAX_VALUE_LENGTH);
+        if (!exprArrayNames || !exprIndexExprs) {
+            arena_release(&scratchArena, scratch);
+            return;
+        }
         int exprAccessCount = 0;
-        extract_array_accesses(exprResult, exprArrayNames, exprIndexExprs, &exprAccessCount);
+        if (maxAccesses > 0) {
+            extract_array_accesses(exprResult, exprArrayNames, exprIndexExprs, &exprAccessCount);
+        }
         
         // Validate each array access in expression
-        for (int i = 0; i < exprAccessCount; i++) {
-            if (!check_array_bounds(exprArrayNames[i], exprIndexExprs[i], errorMsg)) {
-                tinyfd_messageBox("Validation Error", errorMsg, "ok", "error", 1);
-                return;
-            }
+        bool boundsOk = true;
+        for (int i = 0; i < exprAccessCount && boundsOk; i++) {
+            boundsOk = check_array_bounds(exprArrayNames[i], exprIndexExprs[i], errorMsg);
+        }
+        arena_release(&scratchArena, scratch);
+        if (!boundsOk) {
+            tinyfd_messageBox("Validation Error", errorMsg, "ok", "error", 1);
+            return;
         }
         
         if (!validate_expression(exprResult, selectedVar->type, &actualType, errorMsg)) {
@@ -1439,12 +1215,11 @@ void edit_node_value(int nodeIndex) {
         char newValue[MAX_VALUE_LENGTH];
         snprintf(newValue, sizeof(newValue), "%s = %s", leftSide, exprResult);
         
-        strncpy(node->value, newValue, MAX_VALUE_LENGTH - 1);
-        node->value[MAX_VALUE_LENGTH - 1] = '\0';
+        set_node_label(nodeIndex, newValue);
         
         // Recalculate width based on text content
         float fontSize = node->height * 0.3f;
-        node->width = calculate_block_width(node->value, fontSize, 0.35f);
+        node->width = calculate_block_width(node_label(nodeIndex), fontSize, 0.35f);
         
     } else if (node->type == NODE_INPUT) {
         // INPUT BLOCK: Step 1 - Check if variables exist
@@ -1496,11 +1271,11 @@ void edit_node_value(int nodeIndex) {
         
         if (selectedVar->is_array) {
             // Extract current index if block already has a value
-            if (node->value[0] != '\0') {
+            if (node_label(nodeIndex)[0] != '\0') {
                 char varName[MAX_VAR_NAME_LENGTH];
                 char currentIndex[MAX_VALUE_LENGTH];
                 bool isArray;
-                if (parse_input_block(node->value, varName, currentIndex, &isArray)) {
+                if (parse_input_block(node_label(nodeIndex), varName, currentIndex, &isArray)) {
                     if (strcmp(varName, selectedVar->name) == 0 && isArray) {
                         strncpy(indexExpr, currentIndex, MAX_VALUE_LENGTH - 1);
                     }
@@ -1541,19 +1316,18 @@ void edit_node_value(int nodeIndex) {
         }
         
         // Step 4 - Save input block value
-        strncpy(node->value, newValue, MAX_VALUE_LENGTH - 1);
-        node->value[MAX_VALUE_LENGTH - 1] = '\0';
+        set_node_label(nodeIndex, newValue);
         
         // Recalculate width based on text content
         float fontSize = node->height * 0.3f;
-        node->width = calculate_block_width(node->value, fontSize, 0.35f);
+        node->width = calculate_block_width(node_label(nodeIndex), fontSize, 0.35f);
         
     } else if (node->type == NODE_OUTPUT) {
         // OUTPUT BLOCK: Step 1 - Get format string
         char currentFormat[MAX_VALUE_LENGTH] = "";
         // Try to extract current format if block already has a value
-        if (node->value[0] != '\0') {
-            strncpy(currentFormat, node->value, MAX_VALUE_LENGTH - 1);
+        if (node_label(nodeIndex)[0] != '\0') {
+            strncpy(currentFormat, node_label(nodeIndex), MAX_VALUE_LENGTH - 1);
             currentFormat[MAX_VALUE_LENGTH - 1] = '\0';
         }
         
@@ -1639,55 +1413,38 @@ void edit_node_value(int nodeIndex) {
         
         if (!formatResult || formatResult[0] == '\0') return;
         
-        // Step 2 - Extract and validate placeholders (including array accesses)
-        char varNames[MAX_VARIABLES][MAX_VAR_NAME_LENGTH];
-        char indexExprs[MAX_VARIABLES][MAX_VALUE_LENGTH];
-        bool isArrayAccess[MAX_VARIABLES];
+        // Step 2 - Extract and validate placeholders (including array accesses),
+        // at most one per '{'
+        int maxPlaceholders = count_char_occurrences(formatResult, '{');
+        if (maxPlaceholders > MAX_VARIABLES) maxPlaceholders = MAX_VARIABLES;
+        ArenaMark scratch = arena_mark(&scratchArena);
+        char (*varNames)[MAX_VAR_NAME_LENGTH] = arena_alloc(&scratchArena, (size_t)maxPlaceholders * MAX_VAR_NAME_LENGTH);
+        char (*indexExprs)[MAX_VALUE_LENGTH] = arena_alloc(&scratchArena, (size_t)maxPlaceholders * MAX_VALUE_LENGTH);
+        bool *isArrayAccess = arena_alloc(&scratchArena, (size_t)maxPlaceholders * sizeof(bool));
+        if (!varNames || !indexExprs || !isArrayAccess) {
+            arena_release(&scratchArena, scratch);
+            return;
+        }
         int varCount = 0;
-        extract_output_placeholders_with_arrays(formatResult, varNames, indexExprs, isArrayAccess, &varCount);
+        if (maxPlaceholders > 0) {
+            extract_output_placeholders_with_arrays(formatResult, varNames, indexExprs, isArrayAccess, &varCount);
+        }
         
         // Validate that all referenced variables exist and array accesses are valid
         char errorMsg[MAX_VALUE_LENGTH];
-        for (int i = 0; i < varCount; i++) {
-            Variable* var = find_variable(varNames[i]);
-            if (!var) {
-                snprintf(errorMsg, MAX_VALUE_LENGTH, 
-                    "Variable '%s' referenced in format string is not declared", varNames[i]);
-                tinyfd_messageBox("Validation Error", errorMsg, "ok", "error", 1);
-                return;
-            }
-            
-            // If it's an array access, validate the index
-            if (isArrayAccess[i]) {
-                if (!var->is_array) {
-                    snprintf(errorMsg, MAX_VALUE_LENGTH, 
-                        "Variable '%s' is not an array, but array access syntax was used", varNames[i]);
-                    tinyfd_messageBox("Validation Error", errorMsg, "ok", "error", 1);
-                    return;
-                }
-                
-                // Validate index expression
-                int dummyIndex;
-                if (!evaluate_index_expression(indexExprs[i], &dummyIndex, errorMsg)) {
-                    tinyfd_messageBox("Validation Error", errorMsg, "ok", "error", 1);
-                    return;
-                }
-                
-                // Check array bounds
-                if (!check_array_bounds(varNames[i], indexExprs[i], errorMsg)) {
-                    tinyfd_messageBox("Validation Error", errorMsg, "ok", "error", 1);
-                    return;
-                }
-            }
+        bool placeholdersOk = validate_output_placeholders(varNames, indexExprs, isArrayAccess, varCount, errorMsg);
+        arena_release(&scratchArena, scratch);
+        if (!placeholdersOk) {
+            tinyfd_messageBox("Validation Error", errorMsg, "ok", "error", 1);
+            return;
         }
         
         // Step 3 - Save output block value
-        strncpy(node->value, formatResult, MAX_VALUE_LENGTH - 1);
-        node->value[MAX_VALUE_LENGTH - 1] = '\0';
+        set_node_label(nodeIndex, formatResult);
         
         // Recalculate width based on text content
         float fontSize = node->height * 0.3f;
-        node->width = calculate_block_width(node->value, fontSize, 0.35f);
+        node->width = calculate_block_width(node_label(nodeIndex), fontSize, 0.35f);
         
     } else if (node->type == NODE_CYCLE) {
         int cycleIdx = find_cycle_block_by_cycle_node(nodeIndex);
@@ -1741,18 +1498,13 @@ void edit_node_value(int nodeIndex) {
         // - For DO: next target is connected FROM cycle node (cycle is at bottom)
         // - For WHILE/FOR: next target is connected FROM end node (end is at bottom)
         // We use prevType because we're looking for the current state's next connection
-        for (int i = 0; i < connectionCount; i++) {
-            int f = connections[i].fromNode;
+        // DO: exit is from cycle node, WHILE/FOR: exit is from end node
+        int exitFromNode = (prevType == CYCLE_DO) ? cycleNodeIndex : endNodeIndex;
+        int loopPartnerNode = (prevType == CYCLE_DO) ? endNodeIndex : cycleNodeIndex;
+        for (int i = first_outgoing_connection(exitFromNode); i >= 0; i = next_outgoing_connection(i)) {
             int t = connections[i].toNode;
             // Use prevType to find the current next connection (before rewiring)
-            bool isExitConnection = false;
-            if (prevType == CYCLE_DO) {
-                // DO: exit is from cycle node
-                isExitConnection = (f == cycleNodeIndex && t != endNodeIndex);
-            } else {
-                // WHILE/FOR: exit is from end node
-                isExitConnection = (f == endNodeIndex && t != cycleNodeIndex);
-            }
+            bool isExitConnection = (t != loopPartnerNode);
             if (isExitConnection) {
                 nextConn = i;
                 nextTarget = t;
@@ -1762,23 +1514,31 @@ void edit_node_value(int nodeIndex) {
         
         // Identify all body nodes (nodes that are part of the loop body)
         // Body nodes are those that are reachable from cycle/end through the loop body
-        bool isBodyNode[MAX_NODES] = {false};
+        bool *isBodyNode = calloc((size_t)nodeCount, sizeof(bool));
+        if (!isBodyNode) {
+            return;
+        }
         bool changed = true;
         // Start with nodes directly connected to cycle/end (excluding next target)
-        for (int i = 0; i < connectionCount; i++) {
-            int f = connections[i].fromNode;
-            int t = connections[i].toNode;
+        int loopNodes[2] = {cycleNodeIndex, endNodeIndex};
+        for (int n = 0; n < 2; n++) {
             // If a node connects from cycle/end (and is not next target), it's a body node
-            if ((f == cycleNodeIndex || f == endNodeIndex) && t != cycleNodeIndex && t != endNodeIndex && t != nextTarget) {
-                isBodyNode[t] = true;
+            for (int i = first_outgoing_connection(loopNodes[n]); i >= 0; i = next_outgoing_connection(i)) {
+                int t = connections[i].toNode;
+                if (t != cycleNodeIndex && t != endNodeIndex && t != nextTarget) {
+                    isBodyNode[t] = true;
+                }
             }
             // If a node connects to cycle/end (and is not the parent), it might be a body node
             // We'll mark it as body node if it's also reachable from cycle/end
-            if ((t == cycleNodeIndex || t == endNodeIndex) && f != cycleNodeIndex && f != endNodeIndex) {
+            for (int i = first_incoming_connection(loopNodes[n]); i >= 0; i = next_incoming_connection(i)) {
+                int f = connections[i].fromNode;
+                if (f == cycleNodeIndex || f == endNodeIndex) {
+                    continue;
+                }
                 // Check if 'f' is reachable from cycle/end (making it a body node)
-                for (int j = 0; j < connectionCount; j++) {
-                    if ((connections[j].fromNode == cycleNodeIndex || connections[j].fromNode == endNodeIndex) && 
-                        connections[j].toNode == f) {
+                for (int j = first_incoming_connection(f); j >= 0; j = next_incoming_connection(j)) {
+                    if (connections[j].fromNode == cycleNodeIndex || connections[j].fromNode == endNodeIndex) {
                         isBodyNode[f] = true;
                         break;
                     }
@@ -1789,6 +1549,9 @@ void edit_node_value(int nodeIndex) {
         while (changed) {
             changed = false;
             for (int i = 0; i < connectionCount; i++) {
+                if (!connection_is_live(i)) {
+                    continue;
+                }
                 int f = connections[i].fromNode;
                 int t = connections[i].toNode;
                 // Skip connections involving cycle/end/nextTarget
@@ -1817,12 +1580,12 @@ void edit_node_value(int nodeIndex) {
         //   -> first body block needs to move UP by 0.07 to compensate
         const double CONNECTOR_POSITION_DIFF = 0.07; // 0.13 - 0.06 = 0.07
         int firstBodyNode = -1;
-        for (int i = 0; i < connectionCount; i++) {
-            int f = connections[i].fromNode;
+        // Find the first body entry connection (the one that goes into the first body block)
+        // Use prevType to find the connection in the current state
+        int bodyEntryFromNode = (prevType == CYCLE_DO) ? endNodeIndex : cycleNodeIndex;
+        for (int i = first_outgoing_connection(bodyEntryFromNode); i >= 0; i = next_outgoing_connection(i)) {
             int t = connections[i].toNode;
-            // Find the first body entry connection (the one that goes into the first body block)
-            // Use prevType to find the connection in the current state
-            if (isBodyNode[t] && ((prevType == CYCLE_DO && f == endNodeIndex) || (prevType != CYCLE_DO && f == cycleNodeIndex))) {
+            if (isBodyNode[t]) {
                 firstBodyNode = t;
                 break;
             }
@@ -1845,22 +1608,27 @@ void edit_node_value(int nodeIndex) {
             }
         }
         
-        for (int i = 0; i < connectionCount; i++) {
+        // Find parent connections - exclude body nodes (the last match wins)
+        for (int i = first_incoming_connection(cycleNodeIndex); i >= 0; i = next_incoming_connection(i)) {
             int f = connections[i].fromNode;
-            int t = connections[i].toNode;
-            // Find parent connections - exclude body nodes
-            if (t == cycleNodeIndex && f != cycleNodeIndex && f != endNodeIndex && !isBodyNode[f]) {
+            if (f != cycleNodeIndex && f != endNodeIndex && !isBodyNode[f]) {
                 parentToCycle = i;
             }
-            if (t == endNodeIndex && f != cycleNodeIndex && f != endNodeIndex && !isBodyNode[f]) {
+            if (f == endNodeIndex && i > middleConn) {
+                middleConn = i;
+            }
+        }
+        for (int i = first_incoming_connection(endNodeIndex); i >= 0; i = next_incoming_connection(i)) {
+            int f = connections[i].fromNode;
+            if (f != cycleNodeIndex && f != endNodeIndex && !isBodyNode[f]) {
                 parentToEnd = i;
             }
-            if ((f == cycleNodeIndex && t == endNodeIndex) || (f == endNodeIndex && t == cycleNodeIndex)) {
+            if (f == cycleNodeIndex && i > middleConn) {
                 middleConn = i;
             }
-            // NOTE: nextConn is already found above using prevType to determine correct exit point
-            // Don't overwrite it here - this would incorrectly use the last matching connection
         }
+        // NOTE: nextConn is already found above using prevType to determine correct exit point
+        // Don't overwrite it here - this would incorrectly use the last matching connection
         // Prefer parent to cycle (for WHILE/FOR), but use parent to end if that's all we have
         // However, we must ensure the selected parent is NOT a body node
         if (parentToCycle >= 0 && !isBodyNode[connections[parentToCycle].fromNode]) {
@@ -1876,7 +1644,7 @@ void edit_node_value(int nodeIndex) {
         // Rewire body connections to keep loop body intact
         int bodyRewireCount = 0;
         for (int i = 0; i < connectionCount; i++) {
-            if (i == parentConn || i == middleConn || i == nextConn) {
+            if (i == parentConn || i == middleConn || i == nextConn || !connection_is_live(i)) {
                 continue;
             }
             int f = connections[i].fromNode;
@@ -1886,12 +1654,12 @@ void edit_node_value(int nodeIndex) {
                 // DO: end -> [body] -> cycle
                 // Rewire FROM cycle to FROM end (body entry)
                 if (f == cycleNodeIndex && t != endNodeIndex && t != nextTarget) {
-                    connections[i].fromNode = endNodeIndex;
+                    set_connection(i, endNodeIndex, connections[i].toNode);
                     bodyRewireCount++;
                 }
                 // Rewire TO end to TO cycle (body exit)
                 if (t == endNodeIndex && f != cycleNodeIndex && f != parentNode && f != endNodeIndex) {
-                    connections[i].toNode = cycleNodeIndex;
+                    set_connection(i, connections[i].fromNode, cycleNodeIndex);
                     bodyRewireCount++;
                 }
             } else {
@@ -1905,13 +1673,13 @@ void edit_node_value(int nodeIndex) {
                 // Rewire FROM end to FROM cycle (body entry)
                 // This handles: end→body connections that need to become cycle→body
                 if (f == endNodeIndex && t != cycleNodeIndex && t != nextTarget) {
-                    connections[i].fromNode = cycleNodeIndex;
+                    set_connection(i, cycleNodeIndex, connections[i].toNode);
                     bodyRewireCount++;
                 }
                 // Rewire TO cycle to TO end (body exit)
                 // This handles: body→cycle connections that need to become body→end
                 if (t == cycleNodeIndex && f != endNodeIndex && f != parentNode && f != cycleNodeIndex) {
-                    connections[i].toNode = endNodeIndex;
+                    set_connection(i, connections[i].fromNode, endNodeIndex);
                     bodyRewireCount++;
                 }
             }
@@ -1921,20 +1689,16 @@ void edit_node_value(int nodeIndex) {
             // Positions already swapped above, now rewire connections
             // Rewire: parent -> end, end -> cycle, cycle -> next
             if (parentConn >= 0) {
-                connections[parentConn].toNode = endNodeIndex;
+                set_connection(parentConn, connections[parentConn].fromNode, endNodeIndex);
             }
             // Ensure middle connection exists for DO (cycle -> end for loopback)
-            if (middleConn < 0 && connectionCount < MAX_CONNECTIONS) {
-                middleConn = connectionCount++;
-                connections[middleConn].fromNode = cycleNodeIndex;
-                connections[middleConn].toNode = endNodeIndex;
-            } else if (middleConn >= 0) {
-                connections[middleConn].fromNode = cycleNodeIndex;
-                connections[middleConn].toNode = endNodeIndex;
+            if (middleConn < 0) {
+                middleConn = add_connection(cycleNodeIndex, endNodeIndex);
+            } else {
+                set_connection(middleConn, cycleNodeIndex, endNodeIndex);
             }
             if (nextConn >= 0 && nextTarget >= 0) {
-                connections[nextConn].fromNode = cycleNodeIndex;
-                connections[nextConn].toNode = nextTarget;
+                set_connection(nextConn, cycleNodeIndex, nextTarget);
             }
             
             // CRITICAL FIX: Ensure body entry connection exists (end -> first body node)
@@ -1942,9 +1706,8 @@ void edit_node_value(int nodeIndex) {
             // This is the connection where blocks are placed
             bool hasBodyEntryConnection = false;
             int bodyEntryConn = -1;
-            for (int i = 0; i < connectionCount; i++) {
-                if (connections[i].fromNode == endNodeIndex && 
-                    connections[i].toNode != cycleNodeIndex && 
+            for (int i = first_outgoing_connection(endNodeIndex); i >= 0; i = next_outgoing_connection(i)) {
+                if (connections[i].toNode != cycleNodeIndex && 
                     connections[i].toNode != nextTarget &&
                     isBodyNode[connections[i].toNode]) {
                     hasBodyEntryConnection = true;
@@ -1956,9 +1719,8 @@ void edit_node_value(int nodeIndex) {
             // Also check if firstBodyNode was found - if not, find it from current connections
             if (firstBodyNode < 0) {
                 // Find first body node from current connections (after rewiring)
-                for (int i = 0; i < connectionCount; i++) {
-                    if (connections[i].fromNode == endNodeIndex && 
-                        connections[i].toNode != cycleNodeIndex && 
+                for (int i = first_outgoing_connection(endNodeIndex); i >= 0; i = next_outgoing_connection(i)) {
+                    if (connections[i].toNode != cycleNodeIndex && 
                         connections[i].toNode != nextTarget &&
                         isBodyNode[connections[i].toNode]) {
                         firstBodyNode = connections[i].toNode;
@@ -1966,20 +1728,18 @@ void edit_node_value(int nodeIndex) {
                     }
                 }
             }
-            if (!hasBodyEntryConnection && firstBodyNode >= 0 && connectionCount < MAX_CONNECTIONS) {
-                connections[connectionCount].fromNode = endNodeIndex;
-                connections[connectionCount].toNode = firstBodyNode;
-                connectionCount++;
+            if (!hasBodyEntryConnection && firstBodyNode >= 0) {
+                add_connection(endNodeIndex, firstBodyNode);
             }
             // SPECIAL CASE: Empty loop (no body nodes)
             // For empty DO loops, we need a connection FROM end where blocks can be placed
             // This connection goes to the cycle node as a placeholder
             // When blocks are added, they'll be inserted in this connection
-            if (!hasBodyEntryConnection && firstBodyNode < 0 && connectionCount < MAX_CONNECTIONS) {
+            if (!hasBodyEntryConnection && firstBodyNode < 0) {
                 // Check if there's already a connection end -> cycle (shouldn't exist, but check anyway)
                 bool hasEndToCycle = false;
-                for (int i = 0; i < connectionCount; i++) {
-                    if (connections[i].fromNode == endNodeIndex && connections[i].toNode == cycleNodeIndex) {
+                for (int i = first_outgoing_connection(endNodeIndex); i >= 0; i = next_outgoing_connection(i)) {
+                    if (connections[i].toNode == cycleNodeIndex) {
                         hasEndToCycle = true;
                         break;
                     }
@@ -1987,16 +1747,14 @@ void edit_node_value(int nodeIndex) {
                 // Create end -> cycle connection as body entry point for empty loops
                 // Note: This is different from the loopback (cycle -> end)
                 if (!hasEndToCycle) {
-                    connections[connectionCount].fromNode = endNodeIndex;
-                    connections[connectionCount].toNode = cycleNodeIndex;
-                    connectionCount++;
+                    add_connection(endNodeIndex, cycleNodeIndex);
                 }
             }
         } else {
             // Positions already swapped above, now rewire connections
             // Rewire: parent -> cycle, cycle -> end, end -> next
             if (parentConn >= 0) {
-                connections[parentConn].toNode = cycleNodeIndex;
+                set_connection(parentConn, connections[parentConn].fromNode, cycleNodeIndex);
             }
             // CRITICAL FIX: Also rewire parentToEnd if it exists and is different from parentConn
             // This handles the case when switching from DO to WHILE/FOR where an old connection
@@ -2006,24 +1764,21 @@ void edit_node_value(int nodeIndex) {
                 int fromNode = connections[parentToEnd].fromNode;
                 bool isFromBodyNode = isBodyNode[fromNode];
                 if (!isFromBodyNode) {
-                    connections[parentToEnd].toNode = cycleNodeIndex;
+                    set_connection(parentToEnd, fromNode, cycleNodeIndex);
                 }
             }
             // Ensure middle connection exists for WHILE/FOR (end -> cycle for loopback)
             // CRITICAL FIX: For WHILE/FOR, loopback must be end->cycle (not cycle->end) so is_cycle_loopback() recognizes it
-            if (middleConn < 0 && connectionCount < MAX_CONNECTIONS) {
-                middleConn = connectionCount++;
-                connections[middleConn].fromNode = endNodeIndex;  // FIXED: was cycleNodeIndex
-                connections[middleConn].toNode = cycleNodeIndex;  // FIXED: was endNodeIndex
-            } else if (middleConn >= 0) {
-                connections[middleConn].fromNode = endNodeIndex;  // FIXED: was cycleNodeIndex
-                connections[middleConn].toNode = cycleNodeIndex;  // FIXED: was endNodeIndex
+            if (middleConn < 0) {
+                middleConn = add_connection(endNodeIndex, cycleNodeIndex);  // FIXED: was cycle -> end
+            } else {
+                set_connection(middleConn, endNodeIndex, cycleNodeIndex);  // FIXED: was cycle -> end
             }
             if (nextConn >= 0 && nextTarget >= 0) {
-                connections[nextConn].fromNode = endNodeIndex;
-                connections[nextConn].toNode = nextTarget;
+                set_connection(nextConn, endNodeIndex, nextTarget);
             }
         }
+        free(isBodyNode);
         } // End of else block for type change
         
         // Update value/condition for all types (whether rewired or not)
@@ -2150,7 +1905,9 @@ void edit_node_value(int nodeIndex) {
                 v->array_size = 0;
             }
             
-            snprintf(node->value, MAX_VALUE_LENGTH, "FOR|%s|%s|%s", cycle->initVar, cycle->condition, cycle->increment);
+            char label[MAX_VALUE_LENGTH];
+            snprintf(label, sizeof(label), "FOR|%s|%s|%s", cycle->initVar, cycle->condition, cycle->increment);
+            set_node_label(nodeIndex, label);
         } else {
             const char* condPrompt = (chosenType == CYCLE_DO) ? "Enter post-condition (evaluated after body):" : "Enter condition (evaluated before body):";
             const char* condResult = tinyfd_inputBox(
@@ -2163,9 +1920,11 @@ void edit_node_value(int nodeIndex) {
             strncpy(cycle->condition, condResult, sizeof(cycle->condition) - 1);
             cycle->condition[sizeof(cycle->condition) - 1] = '\0';
             
-            snprintf(node->value, MAX_VALUE_LENGTH, "%s|%s",
+            char label[MAX_VALUE_LENGTH];
+            snprintf(label, sizeof(label), "%s|%s",
                      (chosenType == CYCLE_DO) ? "DO" : "WHILE",
                      cycle->condition);
+            set_node_label(nodeIndex, label);
         }
         
         // Slight offset if inside an IF to avoid overlap
@@ -2175,39 +1934,44 @@ void edit_node_value(int nodeIndex) {
         
         // Adjust width to fit label
         float fontSize = node->height * 0.3f;
-        node->width = calculate_block_width(node->value, fontSize, 0.35f);
+        node->width = calculate_block_width(node_label(nodeIndex), fontSize, 0.35f);
         
     } else {
         // Other block types - use simple input dialog
         const char* result = tinyfd_inputBox(
             "Edit Block Value",
             "Enter the value for this block:",
-            node->value
+            node_label(nodeIndex)
         );
         
         if (result != NULL) {
-            strncpy(node->value, result, MAX_VALUE_LENGTH - 1);
-            node->value[MAX_VALUE_LENGTH - 1] = '\0';
+            set_node_label(nodeIndex, result);
             
             // Recalculate width based on text content for content blocks
             if (node->type == NODE_PROCESS || node->type == NODE_NORMAL) {
                 float fontSize = node->height * 0.3f;
-                node->width = calculate_block_width(node->value, fontSize, 0.35f);
+                node->width = calculate_block_width(node_label(nodeIndex), fontSize, 0.35f);
             }
         }
     }
     
-    // Save state AFTER operation completes (for redo to work correctly)
-    save_state_for_undo();
+    mark_edit_dirty(EDIT_UNDO);
 }
 
-void insert_node_in_connection(int connIndex, NodeType nodeType) {
-    if (nodeCount >= MAX_NODES || connectionCount >= MAX_CONNECTIONS) {
-        return;
+void edit_node_value(int nodeIndex) {
+    begin_edit();
+    apply_edit_node_value(nodeIndex);
+    commit_edit();
+}
+
+static bool apply_insert_node(int connIndex, NodeType nodeType) {
+    if (!connection_is_live(connIndex)) {
+        return false;
+    }
+    // Reserve room up front: growing the arrays would invalidate the node pointers below
+    if (!ensure_node_capacity(nodeCount + 1) || !ensure_connection_capacity(connectionCount + 1)) {
+        return false;
     }
-    
-    // Save state BEFORE the operation (for undo)
-    save_state_for_undo();
     
     Connection oldConn = connections[connIndex];
     FlowNode *from = &nodes[oldConn.fromNode];
@@ -2215,7 +1979,7 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
     
     // Validate that this isn't a cross-IF connection
     if (!is_valid_if_converge_connection(oldConn.fromNode, oldConn.toNode)) {
-        return;  // Reject this operation
+        return false;  // Reject this operation
     }
     
     // Store the original Y position of the "to" node before we modify anything
@@ -2244,13 +2008,11 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
         // newNodeOwningIfBlock stays as from->owningIfBlock
     } else if (to->type == NODE_CONVERGE) {
         // Case 3: 'to' is a convergence point - check if its IF is below 'from'
-        for (int i = 0; i < ifBlockCount; i++) {
-            if (ifBlocks[i].convergeNodeIndex == oldConn.toNode) {
-                int ifNodeIdx = ifBlocks[i].ifNodeIndex;
-                if (ifNodeIdx >= 0 && ifNodeIdx < nodeCount && nodes[ifNodeIdx].y < from->y) {
-                    insertingAboveNestedIF = true;
-                    break;
-                }
+        int convergeIfIdx = find_if_block_by_converge_node(oldConn.toNode);
+        if (convergeIfIdx >= 0) {
+            int ifNodeIdx = ifBlocks[convergeIfIdx].ifNodeIndex;
+            if (ifNodeIdx >= 0 && ifNodeIdx < nodeCount && nodes[ifNodeIdx].y < from->y) {
+                insertingAboveNestedIF = true;
             }
         }
     } else if (to->owningIfBlock >= 0 && to->owningIfBlock < ifBlockCount) {
@@ -2305,34 +2067,32 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
     // connection source is not the IF), check if TO is a convergence of an IF we should own
     if (!insertingAboveNestedIF && to->type == NODE_CONVERGE) {
         // Find which IF this convergence belongs to
-        for (int i = 0; i < ifBlockCount; i++) {
-            if (ifBlocks[i].convergeNodeIndex == oldConn.toNode) {
-                // Found the IF - check if FROM is this IF node
-                if (ifBlocks[i].ifNodeIndex == oldConn.fromNode) {
-                    // We're inserting into a connection directly from this IF
-                    newNodeOwningIfBlock = i;
-                    branchType = get_if_branch_type(connIndex);
-                    
-                    int ifBlockIdx = i;
-                    double leftWidth = ifBlocks[ifBlockIdx].leftBranchWidth;
-                    double rightWidth = ifBlocks[ifBlockIdx].rightBranchWidth;
-                    
-                    if (branchType == 0) {
-                        targetBranchColumn = from->branchColumn - 2;
-                        targetX = from->x - leftWidth;
-                    } else if (branchType == 1) {
-                        // False branch should always have positive branchColumn (or at least != 0)
-                        // If from is at -2, false branch would be 0, which conflicts with main branch
-                        // So we need to use absolute values to ensure false branch is always distinguishable
-                        int falseBranchColumn = from->branchColumn + 2;
-                        if (falseBranchColumn <= 0) {
-                            // Convert to positive to ensure it's recognizable as a right/false branch
-                            falseBranchColumn = abs(from->branchColumn) + 2;
-                        }
-                        targetBranchColumn = falseBranchColumn;
-                        targetX = from->x + rightWidth;
+        int i = find_if_block_by_converge_node(oldConn.toNode);
+        if (i >= 0) {
+            // Found the IF - check if FROM is this IF node
+            if (ifBlocks[i].ifNodeIndex == oldConn.fromNode) {
+                // We're inserting into a connection directly from this IF
+                newNodeOwningIfBlock = i;
+                branchType = get_if_branch_type(connIndex);
+                
+                int ifBlockIdx = i;
+                double leftWidth = ifBlocks[ifBlockIdx].leftBranchWidth;
+                double rightWidth = ifBlocks[ifBlockIdx].rightBranchWidth;
+                
+                if (branchType == 0) {
+                    targetBranchColumn = from->branchColumn - 2;
+                    targetX = from->x - leftWidth;
+                } else if (branchType == 1) {
+                    // False branch should always have positive branchColumn (or at least != 0)
+                    // If from is at -2, false branch would be 0, which conflicts with main branch
+                    // So we need to use absolute values to ensure false branch is always distinguishable
+                    int falseBranchColumn = from->branchColumn + 2;
+                    if (falseBranchColumn <= 0) {
+                        // Convert to positive to ensure it's recognizable as a right/false branch
+                        falseBranchColumn = abs(from->branchColumn) + 2;
                     }
-                    break;
+                    targetBranchColumn = falseBranchColumn;
+                    targetX = from->x + rightWidth;
                 }
             }
         }
@@ -2341,13 +2101,7 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
     if (!insertingAboveNestedIF && from->type == NODE_IF && branchType < 0) {
         branchType = get_if_branch_type(connIndex);
 
-        int ifBlockIdx = -1;
-        for (int i = 0; i < ifBlockCount; i++) {
-            if (ifBlocks[i].ifNodeIndex == oldConn.fromNode) {
-                ifBlockIdx = i;
-                break;
-            }
-        }
+        int ifBlockIdx = find_if_block_by_if_node(oldConn.fromNode);
 
         double leftWidth = (ifBlockIdx >= 0) ? ifBlocks[ifBlockIdx].leftBranchWidth : 1.0;
         double rightWidth = (ifBlockIdx >= 0) ? ifBlocks[ifBlockIdx].rightBranchWidth : 1.0;
@@ -2373,21 +2127,21 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
     
     // Create new node positioned one grid cell below the "from" node
     int newGridY = fromGridY - 1;
-    FlowNode *newNode = &nodes[nodeCount];
+    int newNodeIndex = allocate_node();
+    if (newNodeIndex < 0) {
+        return false;
+    }
+    FlowNode *newNode = &nodes[newNodeIndex];
     newNode->x = snap_to_grid_x(targetX);  // Position in correct branch column
     newNode->y = snap_to_grid_y(grid_to_world_y(newGridY));  // One grid cell below
     newNode->height = 0.22f;
-    newNode->value[0] = '\0';  // Initialize value as empty string
     newNode->type = nodeType;
     newNode->branchColumn = targetBranchColumn;  // Set correct branch column
     newNode->owningIfBlock = newNodeOwningIfBlock;  // Set IF block ownership
     
     // Calculate initial width (will be recalculated when value is set)
     float fontSize = newNode->height * 0.3f;
-    newNode->width = calculate_block_width(newNode->value, fontSize, 0.35f);
-    
-    int newNodeIndex = nodeCount;
-    nodeCount++;
+    newNode->width = calculate_block_width(node_label(newNodeIndex), fontSize, 0.35f);
     
     
     // Determine which IF block to reposition later (after push-down)
@@ -2395,34 +2149,28 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
     bool nodeAddedToBranch = false;  // Track if we added a node to a branch array
     if (from->type == NODE_IF) {
         // Inserting directly from IF block - find this IF block's index
-        for (int i = 0; i < ifBlockCount; i++) {
-            if (ifBlocks[i].ifNodeIndex == oldConn.fromNode) {
-                relevantIfBlock = i;
-                
-                // Add the new node to the appropriate branch array
-                int resolvedBranchType = (branchType >= 0) ? branchType : get_if_branch_type(connIndex);
-                if (resolvedBranchType == 0) {
-                    // True branch (left)
-                    if (ifBlocks[i].trueBranchCount < MAX_NODES) {
-                        ifBlocks[i].trueBranchNodes[ifBlocks[i].trueBranchCount] = newNodeIndex;
-                        ifBlocks[i].trueBranchCount++;
-                        nodeAddedToBranch = true;
-                        // Update node's owningIfBlock to match the branch it was added to
-                        nodes[newNodeIndex].owningIfBlock = i;
-                        newNodeOwningIfBlock = i;
-                    }
-                } else if (resolvedBranchType == 1) {
-                    // False branch (right)
-                    if (ifBlocks[i].falseBranchCount < MAX_NODES) {
-                        ifBlocks[i].falseBranchNodes[ifBlocks[i].falseBranchCount] = newNodeIndex;
-                        ifBlocks[i].falseBranchCount++;
-                        nodeAddedToBranch = true;
-                        // Update node's owningIfBlock to match the branch it was added to
-                        nodes[newNodeIndex].owningIfBlock = i;
-                        newNodeOwningIfBlock = i;
-                    }
+        int i = find_if_block_by_if_node(oldConn.fromNode);
+        if (i >= 0) {
+            relevantIfBlock = i;
+            
+            // Add the new node to the appropriate branch array
+            int resolvedBranchType = (branchType >= 0) ? branchType : get_if_branch_type(connIndex);
+            if (resolvedBranchType == 0) {
+                // True branch (left)
+                if (append_if_branch_node(&ifBlocks[i], 0, newNodeIndex)) {
+                    nodeAddedToBranch = true;
+                    // Update node's owningIfBlock to match the branch it was added to
+                    nodes[newNodeIndex].owningIfBlock = i;
+                    newNodeOwningIfBlock = i;
+                }
+            } else if (resolvedBranchType == 1) {
+                // False branch (right)
+                if (append_if_branch_node(&ifBlocks[i], 1, newNodeIndex)) {
+                    nodeAddedToBranch = true;
+                    // Update node's owningIfBlock to match the branch it was added to
+                    nodes[newNodeIndex].owningIfBlock = i;
+                    newNodeOwningIfBlock = i;
                 }
-                break;
             }
         }
     } else if (from->owningIfBlock >= 0) {
@@ -2435,24 +2183,9 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
             // BranchColumn can be ambiguous for deeply nested IFs (e.g., false->false->true
             // can have positive branchColumn values). The branch arrays are the source of truth.
             bool addToTrueBranch = false;
-            bool foundInTrueBranch = false;
-            bool foundInFalseBranch = false;
-            
-            // Check true branch array
-            for (int i = 0; i < ifBlocks[relevantIfBlock].trueBranchCount; i++) {
-                if (ifBlocks[relevantIfBlock].trueBranchNodes[i] == oldConn.fromNode) {
-                    foundInTrueBranch = true;
-                    break;
-                }
-            }
-            
-            // Check false branch array
-            for (int i = 0; i < ifBlocks[relevantIfBlock].falseBranchCount; i++) {
-                if (ifBlocks[relevantIfBlock].falseBranchNodes[i] == oldConn.fromNode) {
-                    foundInFalseBranch = true;
-                    break;
-                }
-            }
+            int fromBranch = if_branch_of_node(&ifBlocks[relevantIfBlock], oldConn.fromNode);
+            bool foundInTrueBranch = (fromBranch == 0);
+            bool foundInFalseBranch = (fromBranch == 1);
             
             if (foundInTrueBranch) {
                 addToTrueBranch = true;
@@ -2477,9 +2210,7 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
             
             if (addToTrueBranch) {
                 // Add to true branch
-                if (ifBlocks[relevantIfBlock].trueBranchCount < MAX_NODES) {
-                    ifBlocks[relevantIfBlock].trueBranchNodes[ifBlocks[relevantIfBlock].trueBranchCount] = newNodeIndex;
-                    ifBlocks[relevantIfBlock].trueBranchCount++;
+                if (append_if_branch_node(&ifBlocks[relevantIfBlock], 0, newNodeIndex)) {
                     nodeAddedToBranch = true;
                     // Update node's owningIfBlock to match the branch it was added to
                     nodes[newNodeIndex].owningIfBlock = relevantIfBlock;
@@ -2487,9 +2218,7 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
                 }
             } else {
                 // Add to false branch
-                if (ifBlocks[relevantIfBlock].falseBranchCount < MAX_NODES) {
-                    ifBlocks[relevantIfBlock].falseBranchNodes[ifBlocks[relevantIfBlock].falseBranchCount] = newNodeIndex;
-                    ifBlocks[relevantIfBlock].falseBranchCount++;
+                if (append_if_branch_node(&ifBlocks[relevantIfBlock], 1, newNodeIndex)) {
                     nodeAddedToBranch = true;
                     // Update node's owningIfBlock to match the branch it was added to
                     nodes[newNodeIndex].owningIfBlock = relevantIfBlock;
@@ -2502,9 +2231,20 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
     // Push the "to" node and all nodes below it further down by one grid cell
     // IMPORTANT: When pushing an IF block, we need to push its branches and reposition convergence
     double gridSpacing = GRID_CELL_SIZE;
-    int pushedIfBlocks[MAX_NODES];  // Track IF blocks that were pushed
+    // Track IF blocks that were pushed (an IF can be recorded once as a pushed node
+    // and once more as the target/nested IF, so allow two entries per node)
+    int pushedIfBlockCapacity = nodeCount * 2 + 1;
+    int *pushedIfBlocks = malloc((size_t)pushedIfBlockCapacity * sizeof(int));
     int pushedIfBlockCount = 0;
     
+    // Original convergence Y positions, indexed by ifBlockIdx
+    double *originalConvergeYs = malloc((size_t)(ifBlockCount + 1) * sizeof(double));
+    if (!pushedIfBlocks || !originalConvergeYs) {
+        free(pushedIfBlocks);
+        free(originalConvergeYs);
+        return false;
+    }
+    
     // When inserting above a nested IF, identify which nested IF we're inserting above
     // Also handle the case where we're inserting above a regular IF (not nested)
     int targetNestedIfBlock = -1;  // The nested IF we're inserting above (if any)
@@ -2515,12 +2255,10 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
     if (insertingAboveNestedIF) {
         if (to->type == NODE_IF) {
             // Case 1: 'to' is the nested IF node itself
-            for (int j = 0; j < ifBlockCount; j++) {
-                if (ifBlocks[j].ifNodeIndex == oldConn.toNode) {
-                    targetNestedIfBlock = j;
-                    targetNestedIfConvergeIdx = ifBlocks[j].convergeNodeIndex;
-                    break;
-                }
+            int j = find_if_block_by_if_node(oldConn.toNode);
+            if (j >= 0) {
+                targetNestedIfBlock = j;
+                targetNestedIfConvergeIdx = ifBlocks[j].convergeNodeIndex;
             }
         } else if (to->owningIfBlock >= 0 && to->owningIfBlock < ifBlockCount) {
             // Case 2: 'to' is owned by a nested IF
@@ -2531,28 +2269,22 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
         }
     } else if (to->type == NODE_IF && to->y < from->y) {
         // Inserting above a regular IF (not nested) - detect it
-        for (int j = 0; j < ifBlockCount; j++) {
-            if (ifBlocks[j].ifNodeIndex == oldConn.toNode) {
-                // Check if it's actually a regular IF (not nested)
-                if (ifBlocks[j].parentIfIndex < 0) {
-                    targetRegularIfBlock = j;
-                    targetRegularIfConvergeIdx = ifBlocks[j].convergeNodeIndex;
-                    break;
-                }
-            }
+        int j = find_if_block_by_if_node(oldConn.toNode);
+        // Check if it's actually a regular IF (not nested)
+        if (j >= 0 && ifBlocks[j].parentIfIndex < 0) {
+            targetRegularIfBlock = j;
+            targetRegularIfConvergeIdx = ifBlocks[j].convergeNodeIndex;
         }
     } else if (to->type == NODE_CONVERGE && to->y < from->y) {
         // 'to' is a convergence point - check if it's a regular IF
-        for (int j = 0; j < ifBlockCount; j++) {
-            if (ifBlocks[j].convergeNodeIndex == oldConn.toNode) {
-                int ifNodeIdx = ifBlocks[j].ifNodeIndex;
-                if (ifNodeIdx >= 0 && ifNodeIdx < nodeCount && nodes[ifNodeIdx].y < from->y) {
-                    // Check if it's a regular IF (not nested)
-                    if (ifBlocks[j].parentIfIndex < 0) {
-                        targetRegularIfBlock = j;
-                        targetRegularIfConvergeIdx = oldConn.toNode;
-                        break;
-                    }
+        int j = find_if_block_by_converge_node(oldConn.toNode);
+        if (j >= 0) {
+            int ifNodeIdx = ifBlocks[j].ifNodeIndex;
+            if (ifNodeIdx >= 0 && ifNodeIdx < nodeCount && nodes[ifNodeIdx].y < from->y) {
+                // Check if it's a regular IF (not nested)
+                if (ifBlocks[j].parentIfIndex < 0) {
+                    targetRegularIfBlock = j;
+                    targetRegularIfConvergeIdx = oldConn.toNode;
                 }
             }
         }
@@ -2601,13 +2333,12 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
     
     // Store original convergence Y positions for all IF blocks that will be pushed
     // (we need this before the loop starts, since convergence points may be pushed during the loop)
-    double originalConvergeYs[MAX_NODES]; // Indexed by ifBlockIdx
-    for (int i = 0; i < MAX_NODES; i++) {
+    for (int i = 0; i < ifBlockCount; i++) {
         originalConvergeYs[i] = -999999.0; // Invalid marker
     }
     
     for (int i = 0; i < nodeCount; ++i) {
-        if (nodes[i].y <= originalToY && i != newNodeIndex) {
+        if (node_is_live(i) && nodes[i].y <= originalToY && i != newNodeIndex) {
             // Determine if this node should be pushed
             bool shouldPush = false;
             
@@ -2617,13 +2348,8 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
                 bool isPartOfTargetRegularIF = false;
                 
                 // Check if it's the IF node itself
-                if (nodes[i].type == NODE_IF) {
-                    for (int j = 0; j < ifBlockCount; j++) {
-                        if (ifBlocks[j].ifNodeIndex == i && j == targetRegularIfBlock) {
-                            isPartOfTargetRegularIF = true;
-                            break;
-                        }
-                    }
+                if (nodes[i].type == NODE_IF && find_if_block_by_if_node(i) == targetRegularIfBlock) {
+                    isPartOfTargetRegularIF = true;
                 }
                 
                 // Check if it's owned by the target regular IF (including nested IFs within it)
@@ -2673,13 +2399,8 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
                 bool isPartOfTargetNestedIF = false;
                 
                 // Check if it's the nested IF node itself
-                if (nodes[i].type == NODE_IF) {
-                    for (int j = 0; j < ifBlockCount; j++) {
-                        if (ifBlocks[j].ifNodeIndex == i && j == targetNestedIfBlock) {
-                            isPartOfTargetNestedIF = true;
-                            break;
-                        }
-                    }
+                if (nodes[i].type == NODE_IF && find_if_block_by_if_node(i) == targetNestedIfBlock) {
+                    isPartOfTargetNestedIF = true;
                 }
                 
                 // Check if it's owned by the target nested IF (including nested IFs within it)
@@ -2802,16 +2523,10 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
             // If this node should be pushed AND it's an IF block, track it for branch node pushing
             if (shouldPush && nodes[i].type == NODE_IF) {
                 // Find the IF block index
-                int pushedIfBlockIdx = -1;
-                for (int j = 0; j < ifBlockCount; j++) {
-                    if (ifBlocks[j].ifNodeIndex == i) {
-                        pushedIfBlockIdx = j;
-                        break;
-                    }
-                }
+                int pushedIfBlockIdx = find_if_block_by_if_node(i);
                 
                 // Track this IF block for branch pushing and convergence repositioning later
-                if (pushedIfBlockIdx >= 0 && pushedIfBlockCount < MAX_NODES) {
+                if (pushedIfBlockIdx >= 0 && pushedIfBlockCount < pushedIfBlockCapacity) {
                     pushedIfBlocks[pushedIfBlockCount++] = pushedIfBlockIdx;
                     
                     // Store original convergence Y position BEFORE any pushes
@@ -2831,7 +2546,7 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
                         break;
                     }
                 }
-                if (!alreadyTracked && pushedIfBlockCount < MAX_NODES) {
+                if (!alreadyTracked && pushedIfBlockCount < pushedIfBlockCapacity) {
                     pushedIfBlocks[pushedIfBlockCount++] = targetRegularIfBlock;
                     int convergeIdx = ifBlocks[targetRegularIfBlock].convergeNodeIndex;
                     if (convergeIdx >= 0 && convergeIdx < nodeCount) {
@@ -2845,13 +2560,7 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
                 // Check if this node is a nested IF within the target nested IF
                 if (nodes[i].type == NODE_IF && nodes[i].owningIfBlock == targetNestedIfBlock) {
                     // Find the nested IF block index
-                    int nestedIfBlockIdx = -1;
-                    for (int j = 0; j < ifBlockCount; j++) {
-                        if (ifBlocks[j].ifNodeIndex == i) {
-                            nestedIfBlockIdx = j;
-                            break;
-                        }
-                    }
+                    int nestedIfBlockIdx = find_if_block_by_if_node(i);
                     
                     // Track this nested IF for branch pushing
                     if (nestedIfBlockIdx >= 0) {
@@ -2863,7 +2572,7 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
                                 break;
                             }
                         }
-                        if (!alreadyTracked && pushedIfBlockCount < MAX_NODES) {
+                        if (!alreadyTracked && pushedIfBlockCount < pushedIfBlockCapacity) {
                             pushedIfBlocks[pushedIfBlockCount++] = nestedIfBlockIdx;
                         }
                     }
@@ -2920,23 +2629,11 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
                             originalConvergeY = (convergeIdx >= 0 && convergeIdx < nodeCount) ? nodes[convergeIdx].y : 0.0;
                         }
                         
-                        // Check if this node is in the true branch
-                        for (int j = 0; j < ifBlocks[ifBlockIdx].trueBranchCount; j++) {
-                            if (ifBlocks[ifBlockIdx].trueBranchNodes[j] == i) {
-                                shouldPush = true;
-                                break;
-                            }
-                        }
-                        if (shouldPush) break;
-                        
-                        // Check if this node is in the false branch
-                        for (int j = 0; j < ifBlocks[ifBlockIdx].falseBranchCount; j++) {
-                            if (ifBlocks[ifBlockIdx].falseBranchNodes[j] == i) {
-                                shouldPush = true;
-                                break;
-                            }
+                        // Check if this node is in either branch
+                        if (if_branch_of_node(&ifBlocks[ifBlockIdx], i) >= 0) {
+                            shouldPush = true;
+                            break;
                         }
-                        if (shouldPush) break;
                         
                         // Check if this node is the convergence point
                         if (convergeIdx == i) {
@@ -3132,6 +2829,9 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
         reposition_convergence_point(pushedIfBlocks[i], true);  // Push nodes below when inserting
     }
     
+    free(pushedIfBlocks);
+    free(originalConvergeYs);
+    
     // When inserting above a nested IF, also reposition its convergence point
     if (insertingAboveNestedIF && targetNestedIfBlock >= 0) {
         reposition_convergence_point(targetNestedIfBlock, true);
@@ -3235,29 +2935,35 @@ void insert_node_in_connection(int connIndex, NodeType nodeType) {
     }
     
     // Replace old connection with two new ones
-    connections[connIndex].fromNode = oldConn.fromNode;
-    connections[connIndex].toNode = newNodeIndex;
-    
-    connections[connectionCount].fromNode = newNodeIndex;
-    connections[connectionCount].toNode = oldConn.toNode;
-    
-    connectionCount++;
+    set_connection(connIndex, oldConn.fromNode, newNodeIndex);
+    add_connection(newNodeIndex, oldConn.toNode);
 
 
     // Recalculate branch widths and positions after insertion
-    update_all_branch_positions();
-    
-    // Save state AFTER operation completes (for redo to work correctly)
-    save_state_for_undo();
+    mark_edit_dirty(EDIT_LAYOUT);
+    return true;
+}
+
+void insert_node_in_connection(int connIndex, NodeType nodeType) {
+    begin_edit();
+    if (apply_insert_node(connIndex, nodeType)) {
+        commit_edit();
+    } else {
+        abort_edit();
+    }
 }
 
 // Calculate the depth (in grid cells) of a branch, recursively accounting for nested IFs
 // branchType: 0 = true/left, 1 = false/right
 // Returns: depth in grid cells from IF node to end of branch
-void insert_if_block_in_connection(int connIndex) {
-    save_state_for_undo();
-    if (nodeCount + 2 >= MAX_NODES || connectionCount + 6 >= MAX_CONNECTIONS || ifBlockCount >= MAX_IF_BLOCKS) {
-        return;
+static bool apply_insert_if_block(int connIndex) {
+    if (!connection_is_live(connIndex)) {
+        return false;
+    }
+    // Reserve room up front: growing the arrays would invalidate the node/IF pointers below
+    if (!ensure_node_capacity(nodeCount + 2) || !ensure_connection_capacity(connectionCount + 3) ||
+        !ensure_if_block_capacity(ifBlockCount + 1)) {
+        return false;
     }
     
     Connection oldConn = connections[connIndex];
@@ -3266,7 +2972,7 @@ void insert_if_block_in_connection(int connIndex) {
     
     // Validate that this isn't a cross-IF connection
     if (!is_valid_if_converge_connection(oldConn.fromNode, oldConn.toNode)) {
-        return;  // Reject this operation
+        return false;  // Reject this operation
     }
     
     // Store the original Y position of the "to" node before we modify anything
@@ -3278,40 +2984,41 @@ void insert_if_block_in_connection(int connIndex) {
     
     // Create IF block positioned one grid cell below the "from" node
     int ifGridY = fromGridY - 1;
-    FlowNode *ifNode = &nodes[nodeCount];
+    int ifNodeIndex = allocate_node();
+    int convergeNodeIndex = allocate_node();
+    int currentIfIndex = allocate_if_block();
+    if (ifNodeIndex < 0 || convergeNodeIndex < 0 || currentIfIndex < 0) {
+        free_node(ifNodeIndex);
+        free_node(convergeNodeIndex);
+        free_if_block(currentIfIndex);
+        return false;
+    }
+    FlowNode *ifNode = &nodes[ifNodeIndex];
     ifNode->x = snap_to_grid_x(from->x);  // Keep same X grid position
     ifNode->y = snap_to_grid_y(grid_to_world_y(ifGridY));
     ifNode->height = 0.525f;  // 1.5x larger for diamond shape (0.35 * 1.5)
     ifNode->width = 0.525f;   // 1.5x larger for diamond shape (0.35 * 1.5)
-    ifNode->value[0] = '\0';  // Initialize value as empty string
     ifNode->type = NODE_IF;
     ifNode->branchColumn = from->branchColumn;  // Inherit branch column
     ifNode->owningIfBlock = from->owningIfBlock;  // Inherit IF block ownership
     
-    int ifNodeIndex = nodeCount;
-    nodeCount++;
-    
     // Create convergence point positioned 2 grid cells below IF block
     // This gives empty IFs the same height as IFs with 1 element in their branches
     int convergeGridY = ifGridY - 2;
-    FlowNode *convergeNode = &nodes[nodeCount];
+    FlowNode *convergeNode = &nodes[convergeNodeIndex];
     convergeNode->x = ifNode->x;  // Same X as IF block
     convergeNode->y = snap_to_grid_y(grid_to_world_y(convergeGridY));
     convergeNode->height = 0.15f;  // Small circle
     convergeNode->width = 0.15f;
-    convergeNode->value[0] = '\0';
     convergeNode->type = NODE_CONVERGE;
     convergeNode->branchColumn = from->branchColumn;  // Same as IF block
     convergeNode->owningIfBlock = from->owningIfBlock;
     
-    int convergeNodeIndex = nodeCount;
-    nodeCount++;
-    
     // Push the "to" node and all nodes below the convergence point further down
     // Need to make room for: IF block (1) + branch space (2) = 3 grid cells total
     double gridSpacing = GRID_CELL_SIZE * 3;  // 3 grid cells (IF + 2 for branch space)
     for (int i = 0; i < nodeCount; ++i) {
-        if (nodes[i].y <= originalToY && i != ifNodeIndex && i != convergeNodeIndex) {
+        if (node_is_live(i) && nodes[i].y <= originalToY && i != ifNodeIndex && i != convergeNodeIndex) {
             nodes[i].y -= gridSpacing;
             // Snap to grid after moving
             nodes[i].y = snap_to_grid_y(nodes[i].y);
@@ -3319,18 +3026,15 @@ void insert_if_block_in_connection(int connIndex) {
     }
     
     // Create IF block tracking structure
-    IFBlock *ifBlock = &ifBlocks[ifBlockCount];
+    IFBlock *ifBlock = &ifBlocks[currentIfIndex];
     ifBlock->ifNodeIndex = ifNodeIndex;
     ifBlock->convergeNodeIndex = convergeNodeIndex;
     ifBlock->parentIfIndex = from->owningIfBlock;  // Parent IF (or -1 if none)
     ifBlock->branchColumn = from->branchColumn;
-    ifBlock->trueBranchCount = 0;
-    ifBlock->falseBranchCount = 0;
+    init_if_branches(ifBlock);
     ifBlock->leftBranchWidth = 1.0;
     ifBlock->rightBranchWidth = 1.0;
-    
-    int currentIfIndex = ifBlockCount;
-    ifBlockCount++;
+    register_if_block(currentIfIndex);
     
     // If this IF is nested inside another IF's branch, add it to the parent's branch array
     int parentIfIdx = -1;
@@ -3339,12 +3043,10 @@ void insert_if_block_in_connection(int connIndex) {
     if (from->type == NODE_IF) {
         // Creating IF directly from another IF's branch connection
         // Find which IF block the from node represents
-        for (int i = 0; i < ifBlockCount; i++) {
-            if (ifBlocks[i].ifNodeIndex == oldConn.fromNode) {
-                parentIfIdx = i;
-                branchType = get_if_branch_type(connIndex);
-                break;
-            }
+        int i = find_if_block_by_if_node(oldConn.fromNode);
+        if (i >= 0) {
+            parentIfIdx = i;
+            branchType = get_if_branch_type(connIndex);
         }
     } else if (from->owningIfBlock >= 0) {
         // Creating IF from a regular node that's in a branch
@@ -3385,44 +3087,38 @@ void insert_if_block_in_connection(int connIndex) {
         
         if (branchType == 0) {
             // Add to parent's true branch
-            if (ifBlocks[parentIfIdx].trueBranchCount < MAX_NODES) {
-                ifBlocks[parentIfIdx].trueBranchNodes[ifBlocks[parentIfIdx].trueBranchCount] = ifNodeIndex;
-                ifBlocks[parentIfIdx].trueBranchCount++;
-            }
+            append_if_branch_node(&ifBlocks[parentIfIdx], 0, ifNodeIndex);
         } else if (branchType == 1) {
             // Add to parent's false branch
-            if (ifBlocks[parentIfIdx].falseBranchCount < MAX_NODES) {
-                ifBlocks[parentIfIdx].falseBranchNodes[ifBlocks[parentIfIdx].falseBranchCount] = ifNodeIndex;
-                ifBlocks[parentIfIdx].falseBranchCount++;
-            }
+            append_if_branch_node(&ifBlocks[parentIfIdx], 1, ifNodeIndex);
         }
     }
     
     // Replace old connection and create new connections:
     // from -> IF
-    connections[connIndex].fromNode = oldConn.fromNode;
-    connections[connIndex].toNode = ifNodeIndex;
+    set_connection(connIndex, oldConn.fromNode, ifNodeIndex);
     
     // IF -> converge (true branch - initially empty, exits left)
-    connections[connectionCount].fromNode = ifNodeIndex;
-    connections[connectionCount].toNode = convergeNodeIndex;
-    connectionCount++;
+    add_connection(ifNodeIndex, convergeNodeIndex);
     
     // IF -> converge (false branch - initially empty, exits right)
-    connections[connectionCount].fromNode = ifNodeIndex;
-    connections[connectionCount].toNode = convergeNodeIndex;
-    connectionCount++;
+    add_connection(ifNodeIndex, convergeNodeIndex);
     
     // converge -> to
-    connections[connectionCount].fromNode = convergeNodeIndex;
-    connections[connectionCount].toNode = oldConn.toNode;
-    connectionCount++;
+    add_connection(convergeNodeIndex, oldConn.toNode);
 
     // Recalculate branch widths and positions after creating IF block
-    update_all_branch_positions();
-    
-    // Save state AFTER operation completes (for redo to work correctly)
-    save_state_for_undo();
+    mark_edit_dirty(EDIT_LAYOUT);
+    return true;
+}
+
+void insert_if_block_in_connection(int connIndex) {
+    begin_edit();
+    if (apply_insert_if_block(connIndex)) {
+        commit_edit();
+    } else {
+        abort_edit();
+    }
 }
 
 // Get all parent IF blocks from a given IF block to the root
@@ -3431,6 +3127,7 @@ void insert_if_block_in_connection(int connIndex) {
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     (void)window;
     (void)scancode;
+    request_redraw();
     
     // Undo: Ctrl+Z
     if (key == GLFW_KEY_Z && action == GLFW_PRESS && (mods & GLFW_MOD_CONTROL) && !(mods & GLFW_MOD_SHIFT)) {
@@ -3444,6 +3141,19 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
         return;
     }
     
+    // Switch between versions of the last edit kept in the undo tree:
+    // Ctrl+Left / Ctrl+Right
+    if ((key == GLFW_KEY_LEFT || key == GLFW_KEY_RIGHT) && action == GLFW_PRESS && (mods & GLFW_MOD_CONTROL)) {
+        perform_switch_branch(key == GLFW_KEY_LEFT ? -1 : 1);
+        return;
+    }
+    
+    // Toggle the frame statistics overlay with F3 (builds with FRAME_STATS=1)
+    if (key == GLFW_KEY_F3 && action == GLFW_PRESS) {
+        FRAME_STATS_TOGGLE();
+        return;
+    }
+    
     // Toggle deletion with 'D' key
     if (key == GLFW_KEY_D && action == GLFW_PRESS) {
         deletionEnabled = !deletionEnabled;
@@ -3472,10 +3182,14 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
         }
     }
 }
-void insert_cycle_block_in_connection(int connIndex) {
-    save_state_for_undo();
-    if (nodeCount + 2 >= MAX_NODES || connectionCount + 2 >= MAX_CONNECTIONS || cycleBlockCount >= MAX_CYCLE_BLOCKS) {
-        return;
+static bool apply_insert_cycle_block(int connIndex) {
+    if (!connection_is_live(connIndex)) {
+        return false;
+    }
+    // Reserve room up front: growing the arrays would invalidate the node/cycle pointers below
+    if (!ensure_node_capacity(nodeCount + 2) || !ensure_connection_capacity(connectionCount + 2) ||
+        !ensure_cycle_block_capacity(cycleBlockCount + 1)) {
+        return false;
     }
     
     Connection oldConn = connections[connIndex];
@@ -3505,13 +3219,7 @@ void insert_cycle_block_in_connection(int connIndex) {
         // Inserting directly from IF block - determine branch from connection
         branchType = get_if_branch_type(connIndex);
         
-        int ifBlockIdx = -1;
-        for (int i = 0; i < ifBlockCount; i++) {
-            if (ifBlocks[i].ifNodeIndex == oldConn.fromNode) {
-                ifBlockIdx = i;
-                break;
-            }
-        }
+        int ifBlockIdx = find_if_block_by_if_node(oldConn.fromNode);
         
         if (ifBlockIdx >= 0) {
             double leftWidth = ifBlocks[ifBlockIdx].leftBranchWidth;
@@ -3539,27 +3247,32 @@ void insert_cycle_block_in_connection(int connIndex) {
     int endGridY = cycleGridY - 1;
     
     // Create cycle block
-    int cycleNodeIndex = nodeCount;
-    FlowNode *cycleNode = &nodes[nodeCount++];
+    int cycleNodeIndex = allocate_node();
+    int endNodeIndex = allocate_node();
+    int cycleBlockIndex = allocate_cycle_block();
+    if (cycleNodeIndex < 0 || endNodeIndex < 0 || cycleBlockIndex < 0) {
+        free_node(cycleNodeIndex);
+        free_node(endNodeIndex);
+        free_cycle_block(cycleBlockIndex);
+        return false;
+    }
+    FlowNode *cycleNode = &nodes[cycleNodeIndex];
     cycleNode->x = snap_to_grid_x(targetX);  // Use calculated branch position
     double cycleWorldY = grid_to_world_y(cycleGridY);
     cycleNode->y = snap_to_grid_y(cycleWorldY);
     cycleNode->height = 0.26f;
     cycleNode->width = 0.34f;
-    cycleNode->value[0] = '\0';
     cycleNode->type = NODE_CYCLE;
     cycleNode->branchColumn = targetBranchColumn;  // Use calculated branch column
     cycleNode->owningIfBlock = cycleOwningIfBlock;
     
     // Create cycle end point
-    int endNodeIndex = nodeCount;
-    FlowNode *endNode = &nodes[nodeCount++];
+    FlowNode *endNode = &nodes[endNodeIndex];
     endNode->x = cycleNode->x;
     double endWorldY = grid_to_world_y(endGridY);
     endNode->y = snap_to_grid_y(endWorldY);
     endNode->height = 0.12f;
     endNode->width = 0.12f;
-    endNode->value[0] = '\0';
     endNode->type = NODE_CYCLE_END;
     endNode->branchColumn = targetBranchColumn;  // Use calculated branch column
     endNode->owningIfBlock = cycleOwningIfBlock;
@@ -3612,37 +3325,29 @@ void insert_cycle_block_in_connection(int connIndex) {
     bool cycleAddedToBranch = false;
     if (from->type == NODE_IF) {
         // Inserting directly from IF block
-        for (int i = 0; i < ifBlockCount; i++) {
-            if (ifBlocks[i].ifNodeIndex == oldConn.fromNode) {
-                int resolvedBranchType = (branchType >= 0) ? branchType : get_if_branch_type(connIndex);
-                if (resolvedBranchType == 0) {
-                    // True branch (left)
-                    if (ifBlocks[i].trueBranchCount + 1 < MAX_NODES) {  // Need space for both cycle and end nodes
-                        ifBlocks[i].trueBranchNodes[ifBlocks[i].trueBranchCount] = cycleNodeIndex;
-                        ifBlocks[i].trueBranchCount++;
+        int i = find_if_block_by_if_node(oldConn.fromNode);
+        if (i >= 0) {
+            int resolvedBranchType = (branchType >= 0) ? branchType : get_if_branch_type(connIndex);
+            if (resolvedBranchType == 0) {
+                // True branch (left)
+                if (append_if_branch_node(&ifBlocks[i], 0, cycleNodeIndex) &&
                         // Also add end node to branch array so it's counted in depth calculation
-                        ifBlocks[i].trueBranchNodes[ifBlocks[i].trueBranchCount] = endNodeIndex;
-                        ifBlocks[i].trueBranchCount++;
-                        cycleNode->owningIfBlock = i;
-                        endNode->owningIfBlock = i;
-                        cycleOwningIfBlock = i;
-                        cycleAddedToBranch = true;
-                    }
-                } else if (resolvedBranchType == 1) {
-                    // False branch (right)
-                    if (ifBlocks[i].falseBranchCount + 1 < MAX_NODES) {  // Need space for both cycle and end nodes
-                        ifBlocks[i].falseBranchNodes[ifBlocks[i].falseBranchCount] = cycleNodeIndex;
-                        ifBlocks[i].falseBranchCount++;
+                        append_if_branch_node(&ifBlocks[i], 0, endNodeIndex)) {
+                    cycleNode->owningIfBlock = i;
+                    endNode->owningIfBlock = i;
+                    cycleOwningIfBlock = i;
+                    cycleAddedToBranch = true;
+                }
+            } else if (resolvedBranchType == 1) {
+                // False branch (right)
+                if (append_if_branch_node(&ifBlocks[i], 1, cycleNodeIndex) &&
                         // Also add end node to branch array so it's counted in depth calculation
-                        ifBlocks[i].falseBranchNodes[ifBlocks[i].falseBranchCount] = endNodeIndex;
-                        ifBlocks[i].falseBranchCount++;
-                        cycleNode->owningIfBlock = i;
-                        endNode->owningIfBlock = i;
-                        cycleOwningIfBlock = i;
-                        cycleAddedToBranch = true;
-                    }
+                        append_if_branch_node(&ifBlocks[i], 1, endNodeIndex)) {
+                    cycleNode->owningIfBlock = i;
+                    endNode->owningIfBlock = i;
+                    cycleOwningIfBlock = i;
+                    cycleAddedToBranch = true;
                 }
-                break;
             }
         }
     } else if (from->owningIfBlock >= 0 && from->owningIfBlock < ifBlockCount) {
@@ -3656,23 +3361,9 @@ void insert_cycle_block_in_connection(int connIndex) {
         // Check if from node is actually in a branch array to determine correct branch
         if (from->branchColumn == 0 && from->owningIfBlock >= 0 && from->owningIfBlock < ifBlockCount) {
             // Check which branch array the from node is actually in
-            bool foundInTrueBranch = false;
-            bool foundInFalseBranch = false;
-            
-            for (int i = 0; i < ifBlocks[relevantIfBlock].trueBranchCount; i++) {
-                if (ifBlocks[relevantIfBlock].trueBranchNodes[i] == oldConn.fromNode) {
-                    foundInTrueBranch = true;
-                    break;
-                }
-            }
-            if (!foundInTrueBranch) {
-                for (int i = 0; i < ifBlocks[relevantIfBlock].falseBranchCount; i++) {
-                    if (ifBlocks[relevantIfBlock].falseBranchNodes[i] == oldConn.fromNode) {
-                        foundInFalseBranch = true;
-                        break;
-                    }
-                }
-            }
+            int fromBranch = if_branch_of_node(&ifBlocks[relevantIfBlock], oldConn.fromNode);
+            bool foundInTrueBranch = (fromBranch == 0);
+            bool foundInFalseBranch = (fromBranch == 1);
             
             if (foundInTrueBranch) {
                 addToTrueBranch = true;
@@ -3683,12 +3374,9 @@ void insert_cycle_block_in_connection(int connIndex) {
         
         if (addToTrueBranch) {
             // Add to true branch
-            if (ifBlocks[relevantIfBlock].trueBranchCount + 1 < MAX_NODES) {  // Need space for both cycle and end nodes
-                ifBlocks[relevantIfBlock].trueBranchNodes[ifBlocks[relevantIfBlock].trueBranchCount] = cycleNodeIndex;
-                ifBlocks[relevantIfBlock].trueBranchCount++;
-                // Also add end node to branch array so it's counted in depth calculation
-                ifBlocks[relevantIfBlock].trueBranchNodes[ifBlocks[relevantIfBlock].trueBranchCount] = endNodeIndex;
-                ifBlocks[relevantIfBlock].trueBranchCount++;
+            if (append_if_branch_node(&ifBlocks[relevantIfBlock], 0, cycleNodeIndex) &&
+                    // Also add end node to branch array so it's counted in depth calculation
+                    append_if_branch_node(&ifBlocks[relevantIfBlock], 0, endNodeIndex)) {
                 cycleNode->owningIfBlock = relevantIfBlock;
                 endNode->owningIfBlock = relevantIfBlock;
                 cycleOwningIfBlock = relevantIfBlock;
@@ -3696,12 +3384,9 @@ void insert_cycle_block_in_connection(int connIndex) {
             }
         } else if (from->branchColumn > 0) {
             // Add to false branch
-            if (ifBlocks[relevantIfBlock].falseBranchCount + 1 < MAX_NODES) {  // Need space for both cycle and end nodes
-                ifBlocks[relevantIfBlock].falseBranchNodes[ifBlocks[relevantIfBlock].falseBranchCount] = cycleNodeIndex;
-                ifBlocks[relevantIfBlock].falseBranchCount++;
-                // Also add end node to branch array so it's counted in depth calculation
-                ifBlocks[relevantIfBlock].falseBranchNodes[ifBlocks[relevantIfBlock].falseBranchCount] = endNodeIndex;
-                ifBlocks[relevantIfBlock].falseBranchCount++;
+            if (append_if_branch_node(&ifBlocks[relevantIfBlock], 1, cycleNodeIndex) &&
+                    // Also add end node to branch array so it's counted in depth calculation
+                    append_if_branch_node(&ifBlocks[relevantIfBlock], 1, endNodeIndex)) {
                 cycleNode->owningIfBlock = relevantIfBlock;
                 endNode->owningIfBlock = relevantIfBlock;
                 cycleOwningIfBlock = relevantIfBlock;
@@ -3713,23 +3398,16 @@ void insert_cycle_block_in_connection(int connIndex) {
     // Push nodes below to make room (2 grid cells)
     double gridSpacing = GRID_CELL_SIZE * 2;
     for (int i = 0; i < nodeCount; ++i) {
-        if (nodes[i].y <= originalToY && i != cycleNodeIndex && i != endNodeIndex) {
+        if (node_is_live(i) && nodes[i].y <= originalToY && i != cycleNodeIndex && i != endNodeIndex) {
             nodes[i].y -= gridSpacing;
             nodes[i].y = snap_to_grid_y(nodes[i].y);
         }
     }
     
     // Wire connections to keep the branch intact (default WHILE/FOR order)
-    connections[connIndex].fromNode = oldConn.fromNode;
-    connections[connIndex].toNode = cycleNodeIndex;
-    
-    connections[connectionCount].fromNode = cycleNodeIndex;
-    connections[connectionCount].toNode = endNodeIndex;
-    connectionCount++;
-    
-    connections[connectionCount].fromNode = endNodeIndex;
-    connections[connectionCount].toNode = oldConn.toNode;
-    connectionCount++;
+    set_connection(connIndex, oldConn.fromNode, cycleNodeIndex);
+    add_connection(cycleNodeIndex, endNodeIndex);
+    add_connection(endNodeIndex, oldConn.toNode);
     
     // Register cycle metadata
     int parentCycle = -1;
@@ -3739,7 +3417,7 @@ void insert_cycle_block_in_connection(int connIndex) {
         parentCycle = find_cycle_block_by_end_node(oldConn.fromNode);
     }
     
-    CycleBlock *cycle = &cycleBlocks[cycleBlockCount];
+    CycleBlock *cycle = &cycleBlocks[cycleBlockIndex];
     cycle->cycleNodeIndex = cycleNodeIndex;
     cycle->cycleEndNodeIndex = endNodeIndex;
     cycle->parentCycleIndex = parentCycle;
@@ -3748,8 +3426,7 @@ void insert_cycle_block_in_connection(int connIndex) {
     cycle->initVar[0] = '\0';
     cycle->condition[0] = '\0';
     cycle->increment[0] = '\0';
-    
-    cycleBlockCount++;
+    register_cycle_block(cycleBlockIndex);
     
     // Reposition convergence points for IF blocks that contain the cycle
     // Similar to insert_node_in_connection, we need to reposition the IF's convergence
@@ -3766,15 +3443,23 @@ void insert_cycle_block_in_connection(int connIndex) {
     }
     
     // Recalculate branch widths and positions after insertion
-    update_all_branch_positions();
-    
-    // Save state AFTER operation completes (for redo to work correctly)
-    save_state_for_undo();
+    mark_edit_dirty(EDIT_LAYOUT);
+    return true;
+}
+
+void insert_cycle_block_in_connection(int connIndex) {
+    begin_edit();
+    if (apply_insert_cycle_block(connIndex)) {
+        commit_edit();
+    } else {
+        abort_edit();
+    }
 }
 
 // Mouse button callback
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
     (void)mods;    // Mark as intentionally unused
+    request_redraw();
     
     // Calculate world-space cursor position (accounting for scroll and flowchart scale)
     // Transformation: screen = scale * (world - scrollOffset/scale) = scale * world - scrollOffset
@@ -3906,13 +3591,14 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
                             insert_node_in_connection(popupMenu.connectionIndex, selectedType);
                         }
                     } else if (popupMenu.type == MENU_TYPE_NODE) {
-                        // Handle node menu actions
-                        if (nodeMenuItems[clickedItem].action == 0) {
+                        // Handle node menu actions (ignored if the clicked node no longer exists)
+                        int menuNode = resolve_node_handle(popupMenu.node);
+                        if (menuNode >= 0 && nodeMenuItems[clickedItem].action == 0) {
                             // Delete action
-                            delete_node(popupMenu.nodeIndex);
-                        } else if (nodeMenuItems[clickedItem].action == 1) {
+                            delete_node(menuNode);
+                        } else if (menuNode >= 0 && nodeMenuItems[clickedItem].action == 1) {
                             // Value action - edit node value
-                            edit_node_value(popupMenu.nodeIndex);
+                            edit_node_value(menuNode);
                         }
                     }
                     popupMenu.active = false;
@@ -3949,7 +3635,7 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
             popupMenu.type = MENU_TYPE_NODE;
             popupMenu.x = cursorX;
             popupMenu.y = cursorY;  // Use screen space, not world space
-            popupMenu.nodeIndex = nodeIndex;
+            popupMenu.node = get_node_handle(nodeIndex);
             popupMenu.connectionIndex = -1;
         } else {
             // Check if we're clicking on a connection (use world-space coordinates)
@@ -3962,7 +3648,7 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
                 popupMenu.x = cursorX;
                 popupMenu.y = cursorY;  // Use screen space, not world space
                 popupMenu.connectionIndex = connIndex;
-                popupMenu.nodeIndex = -1;
+                popupMenu.node = get_node_handle(-1);
             } else {
                 // Close menu if clicking elsewhere
                 popupMenu.active = false;
@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+// Header rounded up so data[] starts aligned
+#define ARENA_HEADER_SIZE ((sizeof(ArenaChunk) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+Arena scratchArena = { NULL, NULL };
+
+static unsigned char* chunk_data(ArenaChunk *chunk) {
+    return (unsigned char*)chunk + ARENA_HEADER_SIZE;
+}
+
+static ArenaChunk* new_chunk(size_t minSize) {
+    size_t size = minSize > ARENA_CHUNK_SIZE ? minSize : ARENA_CHUNK_SIZE;
+    ArenaChunk *chunk = malloc(ARENA_HEADER_SIZE + size);
+    if (!chunk) {
+        fprintf(stderr, "Out of memory allocating %zu byte arena chunk\n", size);
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+void* arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    if (!arena->current) {
+        if (!arena->first) {
+            arena->first = new_chunk(size);
+            if (!arena->first) return NULL;
+        }
+        arena->current = arena->first;
+    }
+
+    // Move along (or extend) the chunk list until one has room. Chunks past
+    // current are empty leftovers from earlier, larger operations.
+    ArenaChunk *chunk = arena->current;
+    while (chunk->size - chunk->used < size) {
+        if (!chunk->next) {
+            chunk->next = new_chunk(size);
+            if (!chunk->next) return NULL;
+        }
+        chunk = chunk->next;
+        chunk->used = 0;
+    }
+    arena->current = chunk;
+
+    void *ptr = chunk_data(chunk) + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+ArenaMark arena_mark(Arena *arena) {
+    ArenaMark mark;
+    mark.chunk = arena->current;
+    mark.used = arena->current ? arena->current->used : 0;
+    return mark;
+}
+
+void arena_release(Arena *arena, ArenaMark mark) {
+    if (!mark.chunk) {
+        arena_reset(arena);
+        return;
+    }
+    mark.chunk->used = mark.used;
+    arena->current = mark.chunk;
+}
+
+void arena_reset(Arena *arena) {
+    if (arena->first) {
+        arena->first->used = 0;
+    }
+    arena->current = arena->first;
+}
+
+void arena_free(Arena *arena) {
+    ArenaChunk *chunk = arena->first;
+    while (chunk) {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->first = NULL;
+    arena->current = NULL;
+}
@@ -0,0 +1,47 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// One block of arena memory; allocations are carved from data[] in order
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;
+    size_t size;    // Usable bytes in data[]
+    size_t used;    // Bytes handed out so far
+    // data[] follows the header
+} ArenaChunk;
+
+// Bump allocator for short-lived buffers (arena.c)
+// Chunks are never moved or freed while the arena is in use, so pointers stay
+// valid until the allocation is released. Callers take a mark before a
+// parse/export step and release back to it when done, which keeps nested and
+// recursive users (the exporter, validation inside edit dialogs) from growing
+// the arena.
+typedef struct {
+    ArenaChunk *first;
+    ArenaChunk *current;
+} Arena;
+
+// Position in an arena to release back to
+typedef struct {
+    ArenaChunk *chunk;
+    size_t used;
+} ArenaMark;
+
+// Shared scratch arena for expression parsing and code export temporaries
+extern Arena scratchArena;
+
+// Allocate size bytes (16-byte aligned); returns NULL if memory could not be allocated
+void* arena_alloc(Arena *arena, size_t size);
+
+// Remember the current position / free everything allocated after a mark
+ArenaMark arena_mark(Arena *arena);
+void arena_release(Arena *arena, ArenaMark mark);
+
+// Free everything allocated, keeping the chunks for reuse
+void arena_reset(Arena *arena);
+
+// Return all chunks to the system
+void arena_free(Arena *arena);
+
+#endif // ARENA_H
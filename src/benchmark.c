@@ -0,0 +1,556 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <GLFW/glfw3.h>
+#include "benchmark.h"
+#include "flowchart_state.h"
+#include "actions.h"
+#include "file_io.h"
+#include "undo_journal.h"
+#include "edit_journal.h"
+#include "drawing.h"
+
+// Forward declarations for helper functions (defined in main.c)
+void initialize_flowchart();
+void render_frame(GLFWwindow* window);
+float calculate_block_width(const char* text, float fontSize, float minWidth);
+void rebuild_variable_table(void);
+void save_state_for_undo(void);
+void perform_undo(void);
+void perform_redo(void);
+void perform_switch_branch(int direction);
+void begin_edit(void);
+void commit_edit(void);
+int hit_node(double x, double y);
+int hit_connection(double x, double y, float threshold);
+
+// Number of timed repetitions per operation
+#define BENCH_INSERTS 100
+#define BENCH_DELETES 100
+#define BENCH_FRAMES 10
+#define BENCH_HITS 1000
+#define BENCH_UNDOS 10
+#define BENCH_JOURNAL_INSERTS 100
+#define BENCH_JOURNAL_ROUNDS 10
+#define BENCH_BRANCH_DEPTH 10
+#define BENCH_BRANCH_SWITCHES 100
+#define BENCH_PRUNE_BUDGET (64 * 1024)
+#define BENCH_RANDOM_STEPS 200
+#define BENCH_LAYOUT_BLOCKS 50000
+
+static const char* benchFile = "flower_bench.txt";
+
+// Chart as loaded from benchFile, to replay the journal on top of
+static FlowchartState benchLoaded = { 0 };
+
+// Build a straight START -> n process blocks -> END chart directly in the arrays.
+// Going through insert_node_in_connection would be quadratic, so the chart is laid
+// out the same way the editor would place the blocks (one grid cell apart).
+static bool build_chain(int blockCount) {
+    initialize_flowchart();
+    if (!ensure_node_capacity(blockCount + 2) || !ensure_connection_capacity(blockCount + 1)) {
+        return false;
+    }
+
+    int endIndex = 1;
+    int prevIndex = 0;  // START
+    for (int i = 0; i < blockCount; i++) {
+        int nodeIndex = allocate_node();
+        if (nodeIndex < 0) {
+            return false;
+        }
+        FlowNode *node = &nodes[nodeIndex];
+        node->x = 0.0;
+        node->y = -(i + 1) * GRID_CELL_SIZE;
+        node->height = 0.22f;
+        char label[MAX_VALUE_LENGTH];
+        snprintf(label, sizeof(label), "step %d", i + 1);
+        set_node_label(nodeIndex, label);
+        node->type = NODE_PROCESS;
+        node->branchColumn = 0;
+        node->owningIfBlock = -1;
+        node->width = calculate_block_width(label, node->height * 0.3f, 0.35f);
+
+        // The first block reuses START -> END, later blocks append a new connection
+        if (i == 0) {
+            set_connection(0, prevIndex, nodeIndex);
+        } else {
+            add_connection(prevIndex, nodeIndex);
+        }
+        prevIndex = nodeIndex;
+    }
+
+    if (blockCount > 0) {
+        add_connection(prevIndex, endIndex);
+    }
+    nodes[endIndex].y = -(blockCount + 1) * GRID_CELL_SIZE;
+
+    rebuild_variable_table();
+    mark_flowchart_changed();
+    undo_journal_reset();
+    return true;
+}
+
+// States in the undo tree, walked from the root without recursion
+static int count_undo_states(void) {
+    int root = undo_current_state();
+    if (root < 0) {
+        return 0;
+    }
+    while (undo_state_parent(root) >= 0) {
+        root = undo_state_parent(root);
+    }
+
+    int count = 0;
+    int state = root;
+    while (state >= 0) {
+        count++;
+        if (undo_state_first_child(state) >= 0) {
+            state = undo_state_first_child(state);
+            continue;
+        }
+        while (state != root && undo_state_next_sibling(state) < 0) {
+            state = undo_state_parent(state);
+        }
+        state = (state == root) ? -1 : undo_state_next_sibling(state);
+    }
+    return count;
+}
+
+// Compare what undo and redo keep up to date without rebuilding (the free slot
+// count, the adjacency lists and the block maps) against indexes built here from
+// the arrays. Reading them does not touch the chart. Returns the mismatches.
+static int count_index_mismatches(void) {
+    int *outHead = malloc(((size_t)nodeCount + 1) * 4 * sizeof(int));
+    int *nextLink = malloc(((size_t)connectionCount + 1) * 2 * sizeof(int));
+    int *blockOf = malloc(((size_t)nodeCount + 1) * 4 * sizeof(int));
+    if (!outHead || !nextLink || !blockOf) {
+        free(outHead);
+        free(nextLink);
+        free(blockOf);
+        return 0;
+    }
+    int *inHead = outHead + nodeCount;
+    int *nextOut = nextLink;
+    int *nextIn = nextLink + connectionCount;
+    for (int n = 0; n < 4 * nodeCount; n++) {
+        outHead[n] = -1;
+        blockOf[n] = -1;
+    }
+
+    // Walk backwards so the lists come out in connection order and the lowest
+    // block naming a node wins
+    for (int c = connectionCount - 1; c >= 0; c--) {
+        int fromNode = connections[c].fromNode;
+        int toNode = connections[c].toNode;
+        if (fromNode >= 0 && fromNode < nodeCount) {
+            nextOut[c] = outHead[fromNode];
+            outHead[fromNode] = c;
+        }
+        if (toNode >= 0 && toNode < nodeCount) {
+            nextIn[c] = inHead[toNode];
+            inHead[toNode] = c;
+        }
+    }
+    for (int i = ifBlockCount - 1; i >= 0; i--) {
+        int ifNode = ifBlocks[i].ifNodeIndex;
+        int convergeNode = ifBlocks[i].convergeNodeIndex;
+        if (ifNode >= 0 && ifNode < nodeCount) blockOf[4 * ifNode] = i;
+        if (convergeNode >= 0 && convergeNode < nodeCount) blockOf[4 * convergeNode + 1] = i;
+    }
+    for (int i = cycleBlockCount - 1; i >= 0; i--) {
+        int cycleNode = cycleBlocks[i].cycleNodeIndex;
+        int endNode = cycleBlocks[i].cycleEndNodeIndex;
+        if (cycleNode >= 0 && cycleNode < nodeCount) blockOf[4 * cycleNode + 2] = i;
+        if (endNode >= 0 && endNode < nodeCount) blockOf[4 * endNode + 3] = i;
+    }
+
+    int mismatches = 0;
+    int liveNodes = 0;
+    for (int n = 0; n < nodeCount; n++) {
+        liveNodes += node_is_live(n);
+        int expected = outHead[n];
+        int c = first_outgoing_connection(n);
+        for (; c >= 0 && c == expected; c = next_outgoing_connection(c)) {
+            expected = nextOut[c];
+        }
+        mismatches += c != expected;
+        expected = inHead[n];
+        c = first_incoming_connection(n);
+        for (; c >= 0 && c == expected; c = next_incoming_connection(c)) {
+            expected = nextIn[c];
+        }
+        mismatches += c != expected;
+        mismatches += find_if_block_by_if_node(n) != blockOf[4 * n];
+        mismatches += find_if_block_by_converge_node(n) != blockOf[4 * n + 1];
+        mismatches += find_cycle_block_by_cycle_node(n) != blockOf[4 * n + 2];
+        mismatches += find_cycle_block_by_end_node(n) != blockOf[4 * n + 3];
+    }
+    mismatches += live_node_count() != liveNodes;
+
+    free(outHead);
+    free(nextLink);
+    free(blockOf);
+    return mismatches;
+}
+
+// Random inserts (blocks, IFs and loops), deletes, undos and redos from a fixed
+// seed, checking the indexes after every step
+static void run_random_undo_check(void) {
+    unsigned int seed = 12345u;
+    int mismatches = 0;
+    double start = glfwGetTime();
+    for (int step = 0; step < BENCH_RANDOM_STEPS; step++) {
+        seed = seed * 1103515245u + 12345u;
+        unsigned int pick = seed >> 8;
+        if (pick % 4 == 0) {
+            perform_undo();
+        } else if (pick % 4 == 1) {
+            perform_redo();
+        } else if (pick % 4 == 2) {
+            int connIndex = (int)((pick / 4) % (unsigned int)connectionCount);
+            while (connIndex < connectionCount - 1 && !connection_is_live(connIndex)) {
+                connIndex++;
+            }
+            if (pick / 64 % 3 == 0) {
+                insert_if_block_in_connection(connIndex);
+            } else if (pick / 64 % 3 == 1) {
+                insert_cycle_block_in_connection(connIndex);
+            } else {
+                insert_node_in_connection(connIndex, NODE_PROCESS);
+            }
+        } else {
+            int nodeIndex = (int)((pick / 4) % (unsigned int)nodeCount);
+            while (nodeIndex < nodeCount && (!node_is_live(nodeIndex) || nodes[nodeIndex].type == NODE_START ||
+                                             nodes[nodeIndex].type == NODE_END)) {
+                nodeIndex++;
+            }
+            delete_node(nodeIndex);
+        }
+        mismatches += count_index_mismatches();
+    }
+    printf("  %-22s %10.3f ms   (%d steps, indexes checked after each)\n", "random undo/redo",
+           (glfwGetTime() - start) * 1000.0, BENCH_RANDOM_STEPS);
+    if (mismatches > 0) {
+        printf("  ERROR: %d index entries differ from a rebuild after undo/redo\n", mismatches);
+    }
+}
+
+static void print_timing(const char* label, double seconds, int repetitions) {
+    printf("  %-22s %10.3f ms", label, seconds * 1000.0);
+    if (repetitions > 1) {
+        printf("   (%d runs, %.3f ms each)", repetitions, seconds * 1000.0 / repetitions);
+    }
+    printf("\n");
+}
+
+static void run_size(GLFWwindow* window, int blockCount) {
+    printf("\n%d blocks\n", blockCount);
+
+    double start = glfwGetTime();
+    if (!build_chain(blockCount)) {
+        fprintf(stderr, "  Failed to allocate a chart with %d blocks\n", blockCount);
+        return;
+    }
+    print_timing("build", glfwGetTime() - start, 1);
+
+    // Interactive inserts spread over the chart (each one also records an undo step)
+    start = glfwGetTime();
+    for (int i = 0; i < BENCH_INSERTS; i++) {
+        int connIndex = (int)(((long long)i * connectionCount) / BENCH_INSERTS);
+        insert_node_in_connection(connIndex, NODE_PROCESS);
+    }
+    print_timing("insert block", glfwGetTime() - start, BENCH_INSERTS);
+
+    // The same inserts as one edit: layout and the undo snapshot run once at commit
+    start = glfwGetTime();
+    begin_edit();
+    for (int i = 0; i < BENCH_INSERTS; i++) {
+        int connIndex = (int)(((long long)i * connectionCount) / BENCH_INSERTS);
+        insert_node_in_connection(connIndex, NODE_PROCESS);
+    }
+    commit_edit();
+    print_timing("bulk insert", glfwGetTime() - start, BENCH_INSERTS);
+
+    // Deletes spread over the chart (the freed slots are reused by later inserts)
+    start = glfwGetTime();
+    for (int i = 0; i < BENCH_DELETES; i++) {
+        int nodeIndex = (int)(((long long)i * nodeCount) / BENCH_DELETES);
+        while (nodeIndex < nodeCount && (!node_is_live(nodeIndex) || nodes[nodeIndex].type != NODE_PROCESS)) {
+            nodeIndex++;
+        }
+        delete_node(nodeIndex);
+    }
+    print_timing("delete block", glfwGetTime() - start, BENCH_DELETES);
+
+    // Cursor hit tests: half land on blocks spread over the chart, half miss
+    // everything and have to look at every node
+    start = glfwGetTime();
+    for (int i = 0; i < BENCH_HITS; i++) {
+        int nodeIndex = (int)(((long long)i * nodeCount) / BENCH_HITS);
+        double missOffset = (i % 2) ? 1000.0 : 0.0;
+        hit_node(nodes[nodeIndex].x + missOffset, nodes[nodeIndex].y);
+    }
+    print_timing("hit test", glfwGetTime() - start, BENCH_HITS);
+
+    // Hover tests against the connections, at the same points
+    start = glfwGetTime();
+    for (int i = 0; i < BENCH_HITS; i++) {
+        int nodeIndex = (int)(((long long)i * nodeCount) / BENCH_HITS);
+        double missOffset = (i % 2) ? 1000.0 : 0.0;
+        hit_connection(nodes[nodeIndex].x + missOffset, nodes[nodeIndex].y, 0.05f);
+    }
+    print_timing("connection hit test", glfwGetTime() - start, BENCH_HITS);
+
+    start = glfwGetTime();
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        render_frame(window);
+        glFinish();
+    }
+    print_timing("draw frame", glfwGetTime() - start, BENCH_FRAMES);
+
+    // The same with the view halfway down the chart: only the blocks on screen
+    // are drawn, wherever they are
+    double savedScrollX = scrollOffsetX;
+    double savedScrollY = scrollOffsetY;
+    scrollOffsetY = nodes[nodeCount / 2].y * FLOWCHART_SCALE;
+    start = glfwGetTime();
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        render_frame(window);
+        glFinish();
+    }
+    print_timing("draw frame mid-chart", glfwGetTime() - start, BENCH_FRAMES);
+    scrollOffsetX = savedScrollX;
+    scrollOffsetY = savedScrollY;
+
+    // Frames right after an edit: the scene and the label quads are rebuilt, but
+    // no label needs to be laid out again
+    start = glfwGetTime();
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        mark_flowchart_changed();
+        render_frame(window);
+        glFinish();
+    }
+    print_timing("redraw after edit", glfwGetTime() - start, BENCH_FRAMES);
+
+    // Shape geometry alone: every block, connection and loopback turned into
+    // vertices (and uploaded), reported per block
+    start = glfwGetTime();
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        buildFlowchartScene();
+    }
+    double seconds = glfwGetTime() - start;
+    printf("  %-22s %10.3f ms   (%d runs, %.1f ns per block)\n", "scene build", seconds * 1000.0,
+           BENCH_FRAMES, seconds * 1e9 / ((double)BENCH_FRAMES * live_node_count()));
+
+    // Snapshots of an unchanged chart: compared against the last state, but
+    // nothing is recorded
+    start = glfwGetTime();
+    for (int i = 0; i < BENCH_UNDOS; i++) {
+        save_state_for_undo();
+    }
+    print_timing("undo snapshot", glfwGetTime() - start, BENCH_UNDOS);
+
+    // Undo and redo the last deletes
+    start = glfwGetTime();
+    for (int i = 0; i < BENCH_UNDOS; i++) {
+        perform_undo();
+    }
+    print_timing("undo", glfwGetTime() - start, BENCH_UNDOS);
+
+    start = glfwGetTime();
+    for (int i = 0; i < BENCH_UNDOS; i++) {
+        perform_redo();
+    }
+    print_timing("redo", glfwGetTime() - start, BENCH_UNDOS);
+    printf("  %-22s %10.1f KB   (%d states)\n", "undo memory", undo_memory_used() / 1024.0, undoHistoryCount);
+
+    run_random_undo_check();
+
+    // Editing after undoing keeps the undone steps as a second branch. Switch
+    // between the two versions of that edit, then walk down the old branch and
+    // check it comes back as it was. The budget is lifted meanwhile, or on a big
+    // chart the new edit alone would push the old branch out.
+    unsigned long long oldTip = undo_journal_hash();
+    set_undo_memory_budget(SIZE_MAX);
+    for (int i = 0; i < BENCH_BRANCH_DEPTH; i++) {
+        perform_undo();
+    }
+    insert_node_in_connection(0, NODE_PROCESS);
+    start = glfwGetTime();
+    for (int i = 0; i < BENCH_BRANCH_SWITCHES; i++) {
+        perform_switch_branch(1);
+    }
+    print_timing("switch branch", glfwGetTime() - start, BENCH_BRANCH_SWITCHES);
+    perform_switch_branch(1);
+    for (int i = 1; i < BENCH_BRANCH_DEPTH; i++) {
+        perform_redo();
+    }
+    if (undo_journal_hash() != oldTip) {
+        printf("  ERROR: the undone branch did not come back as it was\n");
+    }
+
+    // Shrinking the budget prunes the least recently visited states first: the
+    // branch just left goes before any state on the path to the current one
+    int statesBefore = count_undo_states();
+    start = glfwGetTime();
+    set_undo_memory_budget(BENCH_PRUNE_BUDGET);
+    double pruneSeconds = glfwGetTime() - start;
+    int statesAfter = count_undo_states();
+    printf("  %-22s %10.3f ms   (%d -> %d states)\n", "prune to budget", pruneSeconds * 1000.0,
+           statesBefore, statesAfter);
+    if (statesAfter < statesBefore && statesAfter != undoHistoryIndex + 1) {
+        printf("  ERROR: pruning kept a branch off the current path\n");
+    }
+    if (undo_journal_hash() != oldTip) {
+        printf("  ERROR: pruning changed the current state\n");
+    }
+    set_undo_memory_budget(DEFAULT_UNDO_MEMORY_BUDGET);
+
+    start = glfwGetTime();
+    save_flowchart(benchFile);
+    print_timing("save", glfwGetTime() - start, 1);
+
+    start = glfwGetTime();
+    load_flowchart(benchFile);
+    print_timing("load", glfwGetTime() - start, 1);
+
+    // Edits after the load go to the crash journal: inserts above END, then
+    // rounds of undoing and redoing all of them
+    capture_flowchart_state(&benchLoaded);
+    int endNode = 0;
+    while (endNode < nodeCount && nodes[endNode].type != NODE_END) {
+        endNode++;
+    }
+    for (int i = 0; i < BENCH_JOURNAL_INSERTS && endNode < nodeCount; i++) {
+        insert_node_in_connection(first_incoming_connection(endNode), NODE_PROCESS);
+    }
+    for (int round = 0; round < BENCH_JOURNAL_ROUNDS; round++) {
+        for (int i = 0; i < BENCH_JOURNAL_INSERTS; i++) {
+            perform_undo();
+        }
+        for (int i = 0; i < BENCH_JOURNAL_INSERTS; i++) {
+            perform_redo();
+        }
+    }
+
+    // Keep the journal as if the editor had died, and replay it over the loaded chart
+    edit_journal_close(true);
+    apply_flowchart_state(&benchLoaded);
+    start = glfwGetTime();
+    int replayed = edit_journal_replay(benchFile);
+    double replaySeconds = glfwGetTime() - start;
+    printf("  %-22s %10.3f ms   (%d edits, %.0f per ms)\n", "journal replay", replaySeconds * 1000.0,
+           replayed, replaySeconds > 0.0 ? replayed / (replaySeconds * 1000.0) : 0.0);
+
+    char journalFile[256];
+    snprintf(journalFile, sizeof(journalFile), "%s%s", benchFile, EDIT_JOURNAL_SUFFIX);
+    remove(journalFile);
+    remove(benchFile);
+
+    int liveConnections = 0;
+    for (int i = 0; i < connectionCount; i++) {
+        if (connection_is_live(i)) {
+            liveConnections++;
+        }
+    }
+    printf("  %d nodes, %d connections after run\n", live_node_count(), liveConnections);
+}
+
+// FlowNode as it was before the labels moved out: the label stored inline, so a
+// scan over the geometry pulls the whole label through the cache as well
+typedef struct {
+    FlowNode node;
+    char value[MAX_VALUE_LENGTH];
+} InlineLabelNode;
+
+// hit_node over the old layout
+static int hit_inline_label_node(const InlineLabelNode *inlineNodes, double x, double y) {
+    for (int i = 0; i < nodeCount; ++i) {
+        const FlowNode *n = &inlineNodes[i].node;
+        if (n->type == NODE_FREE) continue;
+        if (x >= n->x - n->width * 0.5f && x <= n->x + n->width * 0.5f &&
+            y >= n->y - n->height * 0.5f && y <= n->y + n->height * 0.5f) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Hit tests on a BENCH_LAYOUT_BLOCKS chart with the labels inline (the baseline)
+// and split out of FlowNode (the current layout). Same nodes, same cursor points.
+static void run_layout_comparison(void) {
+    if (!build_chain(BENCH_LAYOUT_BLOCKS)) {
+        printf("  Out of memory building %d blocks\n", BENCH_LAYOUT_BLOCKS);
+        return;
+    }
+    InlineLabelNode *inlineNodes = malloc((size_t)nodeCount * sizeof(InlineLabelNode));
+    if (!inlineNodes) {
+        printf("  Out of memory copying %d blocks\n", BENCH_LAYOUT_BLOCKS);
+        return;
+    }
+    for (int i = 0; i < nodeCount; i++) {
+        inlineNodes[i].node = nodes[i];
+        strncpy(inlineNodes[i].value, node_label(i), MAX_VALUE_LENGTH - 1);
+        inlineNodes[i].value[MAX_VALUE_LENGTH - 1] = '\0';
+    }
+
+    printf("\nNode layout, %d blocks\n", BENCH_LAYOUT_BLOCKS);
+    long long inlineFound = 0;
+    double start = glfwGetTime();
+    for (int i = 0; i < BENCH_HITS; i++) {
+        int nodeIndex = (int)(((long long)i * nodeCount) / BENCH_HITS);
+        double missOffset = (i % 2) ? 1000.0 : 0.0;
+        inlineFound += hit_inline_label_node(inlineNodes, nodes[nodeIndex].x + missOffset, nodes[nodeIndex].y);
+    }
+    double inlineSeconds = glfwGetTime() - start;
+
+    long long splitFound = 0;
+    start = glfwGetTime();
+    for (int i = 0; i < BENCH_HITS; i++) {
+        int nodeIndex = (int)(((long long)i * nodeCount) / BENCH_HITS);
+        double missOffset = (i % 2) ? 1000.0 : 0.0;
+        splitFound += hit_node(nodes[nodeIndex].x + missOffset, nodes[nodeIndex].y);
+    }
+    double splitSeconds = glfwGetTime() - start;
+
+    printf("  %-22s %10.3f ms   (%d runs, %.3f ms each, %d bytes per node)\n", "hit test, inline label",
+           inlineSeconds * 1000.0, BENCH_HITS, inlineSeconds * 1000.0 / BENCH_HITS, (int)sizeof(InlineLabelNode));
+    printf("  %-22s %10.3f ms   (%d runs, %.3f ms each, %d bytes per node)\n", "hit test, split label",
+           splitSeconds * 1000.0, BENCH_HITS, splitSeconds * 1000.0 / BENCH_HITS, (int)sizeof(FlowNode));
+    if (splitSeconds > 0.0) {
+        printf("  %-22s %10.2fx\n", "speedup", inlineSeconds / splitSeconds);
+    }
+    if (inlineFound != splitFound) {
+        printf("  ERROR: the two layouts found different blocks\n");
+    }
+    free(inlineNodes);
+}
+
+int run_benchmark(GLFWwindow* window, int argc, char** argv) {
+    int defaultSizes[] = {10000, 100000};
+    int sizeCount = 0;
+    int sizes[16];
+
+    for (int i = 0; i < argc && sizeCount < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+        int size = atoi(argv[i]);
+        if (size > 0) {
+            sizes[sizeCount++] = size;
+        }
+    }
+    if (sizeCount == 0) {
+        memcpy(sizes, defaultSizes, sizeof(defaultSizes));
+        sizeCount = (int)(sizeof(defaultSizes) / sizeof(defaultSizes[0]));
+    }
+
+    printf("Flowchart stress benchmark\n");
+    for (int i = 0; i < sizeCount; i++) {
+        run_size(window, sizes[i]);
+    }
+    run_layout_comparison();
+
+    // Leave the editor state as a fresh chart
+    initialize_flowchart();
+    return 0;
+}
@@ -0,0 +1,13 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <GLFW/glfw3.h>
+
+// Stress benchmark, started with: flower --bench [nodeCount ...]
+// Builds large flowcharts and prints timings for insert, delete, draw, save/load and undo,
+// then compares hit tests on a 50k-block chart with node labels inline (the old
+// FlowNode layout) and split out.
+// The window's GL context must be current (it can be hidden).
+int run_benchmark(GLFWwindow* window, int argc, char** argv);
+
+#endif // BENCHMARK_H
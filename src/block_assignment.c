@@ -1,8 +1,8 @@
-#include <GLFW/glfw3.h>
 #include <stdio.h>
 #include <math.h>
 #include "block_assignment.h"
 #include "text_renderer.h"
+#include "scene_renderer.h"
 
 // FlowNode structure definition (must match main.c)
 typedef struct FlowNode {
@@ -10,63 +10,46 @@ typedef struct FlowNode {
     double y;
     float width;
     float height;
-    char value[256];
     int type;  // NodeType enum value
 } FlowNode;
 
-void draw_block_assignment(const struct FlowNode *n) {
+void build_block_assignment_template(void) {
     // Assignment block: Rectangle with purple/pink color
-    glColor3f(0.9f, 0.6f, 0.9f); // Light purple/pink
+    TemplatePoint corners[4] = {
+        {.sx = -0.5f, .sy = 0.5f},
+        {.sx = 0.5f, .sy = 0.5f},
+        {.sx = 0.5f, .sy = -0.5f},
+        {.sx = -0.5f, .sy = -0.5f}
+    };
     
-    glBegin(GL_QUADS);
-    glVertex2f(n->x - n->width * 0.5f, n->y + n->height * 0.5f);
-    glVertex2f(n->x + n->width * 0.5f, n->y + n->height * 0.5f);
-    glVertex2f(n->x + n->width * 0.5f, n->y - n->height * 0.5f);
-    glVertex2f(n->x - n->width * 0.5f, n->y - n->height * 0.5f);
-    glEnd();
+    // Fill comes from each instance
+    scene_template_polygon(SCENE_FILLS, corners, 4);
     
     // Border
-    glColor3f(0.2f, 0.2f, 0.0f);
-    glBegin(GL_LINE_LOOP);
-    glVertex2f(n->x - n->width * 0.5f, n->y + n->height * 0.5f);
-    glVertex2f(n->x + n->width * 0.5f, n->y + n->height * 0.5f);
-    glVertex2f(n->x + n->width * 0.5f, n->y - n->height * 0.5f);
-    glVertex2f(n->x - n->width * 0.5f, n->y - n->height * 0.5f);
-    glEnd();
-    
-    // Draw connectors
-    float r = 0.03f;
-    glColor3f(0.1f, 0.1f, 0.1f);
-    
-    // Input connector (top)
-    float cx = (float)n->x;
-    float cy = (float)(n->y + n->height * 0.5f);
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(cx, cy);
-    for (int i = 0; i <= 20; ++i) {
-        float a = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(cx + cosf(a) * r, cy + sinf(a) * r);
-    }
-    glEnd();
-    
-    // Output connector (bottom)
-    cy = (float)(n->y - n->height * 0.5f);
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(cx, cy);
-    for (int i = 0; i <= 20; ++i) {
-        float a = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(cx + cosf(a) * r, cy + sinf(a) * r);
-    }
-    glEnd();
+    scene_color(0.2f, 0.2f, 0.0f);
+    scene_template_polygon(SCENE_BORDERS, corners, 4);
     
+    // Input connector (top) and output connector (bottom)
+    scene_color(0.1f, 0.1f, 0.1f);
+    scene_template_circle(SCENE_CONNECTORS, (TemplatePoint){.sx = 0.0f, .sy = 0.5f}, 0.0f, 0.03f, 20);
+    scene_template_circle(SCENE_CONNECTORS, (TemplatePoint){.sx = 0.0f, .sy = -0.5f}, 0.0f, 0.03f, 20);
+}
+
+void build_block_assignment(const struct FlowNode *n) {
+    scene_color(0.9f, 0.6f, 0.9f); // Light purple/pink
+    scene_instance(n->type, (float)n->x, (float)n->y, n->width, n->height);
+}
+
+void draw_block_assignment_label(const struct FlowNode *n, const char *label) {
     // Draw value text centered in the block (no ":=" prefix, just the assignment expression)
-    if (n->value[0] != '\0') {
+    if (label[0] != '\0') {
         float fontSize = n->height * 0.3f;
+        
         // Calculate text width and center it in the block
-        float textWidth = get_text_width(n->value, fontSize);
+        float textWidth = get_text_width(label, fontSize);
         float textX = n->x - textWidth * 0.5f;  // Center the text
         float textY = n->y;
-        draw_text(textX, textY, n->value, fontSize, 0.0f, 0.0f, 0.0f);
+        
+        draw_text(textX, textY, label, fontSize, 0.0f, 0.0f, 0.0f);
     }
 }
-
@@ -4,8 +4,12 @@
 // Forward declaration
 struct FlowNode;
 
-// Draw an Assignment block (rectangle with := symbol)
-void draw_block_assignment(const struct FlowNode *node);
+// Add the shape of an Assignment block (rectangle with := symbol) to the scene
+void build_block_assignment_template(void);
+void build_block_assignment(const struct FlowNode *node);
+
+// Draw the label of an Assignment block
+void draw_block_assignment_label(const struct FlowNode *node, const char *label);
 
 #endif // BLOCK_ASSIGNMENT_H
 
@@ -1,8 +1,8 @@
-#include <GLFW/glfw3.h>
 #include <stdio.h>
 #include <math.h>
 #include "block_converge.h"
 #include "text_renderer.h"
+#include "scene_renderer.h"
 
 // FlowNode structure definition (must match main.c)
 typedef struct FlowNode {
@@ -10,76 +10,31 @@ typedef struct FlowNode {
     double y;
     float width;
     float height;
-    char value[256];
     int type;  // NodeType enum value
     int branchColumn;
     int owningIfBlock;
 } FlowNode;
 
-void draw_block_converge(const struct FlowNode *n) {
-    // Convergence point: Small gray circle
-    float radius = n->width * 0.5f;  // Use width as diameter
+void build_block_converge_template(void) {
+    // Convergence point: Small gray circle, width as diameter
+    TemplatePoint centre = {0};
     
-    // Draw filled circle
-    glColor3f(0.6f, 0.6f, 0.6f);  // Gray
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(n->x, n->y);
-    for (int i = 0; i <= 32; ++i) {
-        float angle = (float)i / 32.0f * 6.2831853f;
-        glVertex2f(n->x + cosf(angle) * radius, n->y + sinf(angle) * radius);
-    }
-    glEnd();
+    // Filled circle, fill comes from each instance
+    scene_template_circle(SCENE_FILLS, centre, 0.5f, 0.0f, 32);
     
     // Border
-    glColor3f(0.2f, 0.2f, 0.2f);  // Dark gray border
-    glBegin(GL_LINE_LOOP);
-    for (int i = 0; i <= 32; ++i) {
-        float angle = (float)i / 32.0f * 6.2831853f;
-        glVertex2f(n->x + cosf(angle) * radius, n->y + sinf(angle) * radius);
-    }
-    glEnd();
+    scene_color(0.2f, 0.2f, 0.2f);  // Dark gray border
+    scene_template_circle(SCENE_BORDERS, centre, 0.5f, 0.0f, 32);
     
-    // Draw connectors
+    // Connectors: left and right inputs (true/false branches), bottom output
     float r = 0.02f;  // Smaller connector size for smaller node
-    glColor3f(0.1f, 0.1f, 0.1f);
-    
-    // Left input connector (for true branch)
-    float cx = (float)(n->x - radius);
-    float cy = (float)n->y;
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(cx, cy);
-    for (int i = 0; i <= 20; ++i) {
-        float a = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(cx + cosf(a) * r, cy + sinf(a) * r);
-    }
-    glEnd();
-    
-    // Right input connector (for false branch)
-    cx = (float)(n->x + radius);
-    cy = (float)n->y;
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(cx, cy);
-    for (int i = 0; i <= 20; ++i) {
-        float a = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(cx + cosf(a) * r, cy + sinf(a) * r);
-    }
-    glEnd();
-    
-    // Bottom output connector
-    cx = (float)n->x;
-    cy = (float)(n->y - radius);
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(cx, cy);
-    for (int i = 0; i <= 20; ++i) {
-        float a = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(cx + cosf(a) * r, cy + sinf(a) * r);
-    }
-    glEnd();
+    scene_color(0.1f, 0.1f, 0.1f);
+    scene_template_circle(SCENE_CONNECTORS, (TemplatePoint){.kx = -0.5f, .ky = 0.0f}, 0.0f, r, 20);
+    scene_template_circle(SCENE_CONNECTORS, (TemplatePoint){.kx = 0.5f, .ky = 0.0f}, 0.0f, r, 20);
+    scene_template_circle(SCENE_CONNECTORS, (TemplatePoint){.kx = 0.0f, .ky = -0.5f}, 0.0f, r, 20);
 }
 
-
-
-
-
-
-
+void build_block_converge(const struct FlowNode *n) {
+    scene_color(0.6f, 0.6f, 0.6f);  // Gray
+    scene_instance(n->type, (float)n->x, (float)n->y, n->width, n->height);
+}
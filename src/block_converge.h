@@ -3,7 +3,8 @@
 
 struct FlowNode;
 
-void draw_block_converge(const struct FlowNode *n);
+void build_block_converge_template(void);
+void build_block_converge(const struct FlowNode *n);
 
 #endif // BLOCK_CONVERGE_H
 
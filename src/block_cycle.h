@@ -3,7 +3,9 @@
 
 struct FlowNode;
 
-void draw_block_cycle(const struct FlowNode *n);
+void build_block_cycle_template(void);
+void build_block_cycle(const struct FlowNode *n);
+void draw_block_cycle_label(const struct FlowNode *n, const char *label);
 
 #endif
 
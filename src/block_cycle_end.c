@@ -1,7 +1,7 @@
-#include <GLFW/glfw3.h>
 #include <math.h>
 #include "block_cycle_end.h"
 #include "text_renderer.h"
+#include "scene_renderer.h"
 
 // FlowNode structure definition (must match main.c layout)
 typedef struct FlowNode {
@@ -9,56 +9,30 @@ typedef struct FlowNode {
     double y;
     float width;
     float height;
-    char value[256];
     int type;  // NodeType enum value
     int branchColumn;
     int owningIfBlock;
 } FlowNode;
 
-void draw_block_cycle_end(const struct FlowNode *n) {
-    // Cycle end point: circular marker with same color as cycle block
-    float radius = n->width * 0.5f;
+void build_block_cycle_end_template(void) {
+    // Cycle end point: circular marker with same color as cycle block, width as
+    // diameter
+    TemplatePoint centre = {0};
     
-    glColor3f(0.95f, 0.6f, 0.15f);  // Orange fill
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(n->x, n->y);
-    for (int i = 0; i <= 32; ++i) {
-        float angle = (float)i / 32.0f * 6.2831853f;
-        glVertex2f(n->x + cosf(angle) * radius, n->y + sinf(angle) * radius);
-    }
-    glEnd();
+    // Fill comes from each instance
+    scene_template_circle(SCENE_FILLS, centre, 0.5f, 0.0f, 32);
     
-    glColor3f(0.55f, 0.3f, 0.05f); // Border
-    glBegin(GL_LINE_LOOP);
-    for (int i = 0; i <= 32; ++i) {
-        float angle = (float)i / 32.0f * 6.2831853f;
-        glVertex2f(n->x + cosf(angle) * radius, n->y + sinf(angle) * radius);
-    }
-    glEnd();
+    scene_color(0.55f, 0.3f, 0.05f); // Border
+    scene_template_circle(SCENE_BORDERS, centre, 0.5f, 0.0f, 32);
     
     // Connectors (top/bottom) to match converge style
     float r = 0.02f;
-    glColor3f(0.1f, 0.1f, 0.1f);
-    
-    // Top connector
-    float cx = (float)n->x;
-    float cy = (float)(n->y + radius);
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(cx, cy);
-    for (int i = 0; i <= 20; ++i) {
-        float a = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(cx + cosf(a) * r, cy + sinf(a) * r);
-    }
-    glEnd();
-    
-    // Bottom connector
-    cy = (float)(n->y - radius);
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(cx, cy);
-    for (int i = 0; i <= 20; ++i) {
-        float a = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(cx + cosf(a) * r, cy + sinf(a) * r);
-    }
-    glEnd();
+    scene_color(0.1f, 0.1f, 0.1f);
+    scene_template_circle(SCENE_CONNECTORS, (TemplatePoint){.kx = 0.0f, .ky = 0.5f}, 0.0f, r, 20);
+    scene_template_circle(SCENE_CONNECTORS, (TemplatePoint){.kx = 0.0f, .ky = -0.5f}, 0.0f, r, 20);
 }
 
+void build_block_cycle_end(const struct FlowNode *n) {
+    scene_color(0.95f, 0.6f, 0.15f);  // Orange fill
+    scene_instance(n->type, (float)n->x, (float)n->y, n->width, n->height);
+}
@@ -3,7 +3,8 @@
 
 struct FlowNode;
 
-void draw_block_cycle_end(const struct FlowNode *n);
+void build_block_cycle_end_template(void);
+void build_block_cycle_end(const struct FlowNode *n);
 
 #endif
 
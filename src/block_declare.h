@@ -4,8 +4,12 @@
 // Forward declaration
 struct FlowNode;
 
-// Draw a Declare block (rectangle with special styling)
-void draw_block_declare(const struct FlowNode *node);
+// Add the shape of a Declare block (rectangle with special styling) to the scene
+void build_block_declare_template(void);
+void build_block_declare(const struct FlowNode *node);
+
+// Draw the label of a Declare block
+void draw_block_declare_label(const struct FlowNode *node, const char *label);
 
 #endif // BLOCK_DECLARE_H
 
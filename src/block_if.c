@@ -1,9 +1,9 @@
-#include <GLFW/glfw3.h>
 #include <stdio.h>
 #include <math.h>
 #include <string.h>
 #include "block_if.h"
 #include "text_renderer.h"
+#include "scene_renderer.h"
 
 // FlowNode structure definition (must match main.c)
 typedef struct FlowNode {
@@ -11,74 +11,43 @@ typedef struct FlowNode {
     double y;
     float width;
     float height;
-    char value[256];
     int type;  // NodeType enum value
     int branchColumn;
     int owningIfBlock;
 } FlowNode;
 
-void draw_block_if(const struct FlowNode *n) {
+void build_block_if_template(void) {
     // IF block: Diamond shape with light blue/cyan color
-    glColor3f(0.5f, 0.8f, 1.0f); // Light blue/cyan
-    
-    // Calculate diamond vertices (rotated square)
     // Diamond extends width/2 horizontally and height/2 vertically
-    float halfW = n->width * 0.5f;
-    float halfH = n->height * 0.5f;
+    TemplatePoint corners[4] = {
+        {.sx = 0.0f, .sy = 0.5f},    // Top
+        {.sx = 0.5f, .sy = 0.0f},    // Right
+        {.sx = 0.0f, .sy = -0.5f},   // Bottom
+        {.sx = -0.5f, .sy = 0.0f}    // Left
+    };
     
-    // Draw filled diamond
-    glBegin(GL_QUADS);
-    glVertex2f(n->x, n->y + halfH);           // Top
-    glVertex2f(n->x + halfW, n->y);           // Right
-    glVertex2f(n->x, n->y - halfH);           // Bottom
-    glVertex2f(n->x - halfW, n->y);           // Left
-    glEnd();
+    // Fill comes from each instance
+    scene_template_polygon(SCENE_FILLS, corners, 4);
     
     // Border
-    glColor3f(0.1f, 0.3f, 0.5f);  // Dark blue border
-    glBegin(GL_LINE_LOOP);
-    glVertex2f(n->x, n->y + halfH);           // Top
-    glVertex2f(n->x + halfW, n->y);           // Right
-    glVertex2f(n->x, n->y - halfH);           // Bottom
-    glVertex2f(n->x - halfW, n->y);           // Left
-    glEnd();
-    
-    // Draw connectors
-    float r = 0.03f;
-    glColor3f(0.1f, 0.1f, 0.1f);
-    
-    // Input connector (top vertex of diamond)
-    float cx = (float)n->x;
-    float cy = (float)(n->y + halfH);
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(cx, cy);
-    for (int i = 0; i <= 20; ++i) {
-        float a = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(cx + cosf(a) * r, cy + sinf(a) * r);
-    }
-    glEnd();
-    
-    // Left connector (true branch - left vertex of diamond)
-    cx = (float)(n->x - halfW);
-    cy = (float)n->y;
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(cx, cy);
-    for (int i = 0; i <= 20; ++i) {
-        float a = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(cx + cosf(a) * r, cy + sinf(a) * r);
-    }
-    glEnd();
+    scene_color(0.1f, 0.3f, 0.5f);
+    scene_template_polygon(SCENE_BORDERS, corners, 4);
     
-    // Right connector (false branch - right vertex of diamond)
-    cx = (float)(n->x + halfW);
-    cy = (float)n->y;
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(cx, cy);
-    for (int i = 0; i <= 20; ++i) {
-        float a = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(cx + cosf(a) * r, cy + sinf(a) * r);
-    }
-    glEnd();
+    // Connectors: input (top vertex), true branch (left vertex), false branch (right vertex)
+    scene_color(0.1f, 0.1f, 0.1f);
+    scene_template_circle(SCENE_CONNECTORS, (TemplatePoint){.sx = 0.0f, .sy = 0.5f}, 0.0f, 0.03f, 20);
+    scene_template_circle(SCENE_CONNECTORS, (TemplatePoint){.sx = -0.5f, .sy = 0.0f}, 0.0f, 0.03f, 20);
+    scene_template_circle(SCENE_CONNECTORS, (TemplatePoint){.sx = 0.5f, .sy = 0.0f}, 0.0f, 0.03f, 20);
+}
+
+void build_block_if(const struct FlowNode *n) {
+    scene_color(0.5f, 0.8f, 1.0f); // Light blue/cyan
+    scene_instance(n->type, (float)n->x, (float)n->y, n->width, n->height);
+}
+
+void draw_block_if_label(const struct FlowNode *n, const char *label) {
+    float halfW = n->width * 0.5f;
+    float halfH = n->height * 0.5f;
     
     // Draw "True" label on the left side
     // Keep font size fixed (not scaled with block size) - use size for 0.35f block
@@ -95,9 +64,9 @@ void draw_block_if(const struct FlowNode *n) {
     // Draw condition text - inside diamond if short, scale font size if > 11 characters,
     // move below if font size would reach minimum (50%)
     // Keep base font size fixed (not scaled with block size) - use size for 0.35f block
-    if (n->value[0] != '\0') {
+    if (label[0] != '\0') {
         float baseFontSize = 0.35f * 0.2f;  // Fixed base size, equivalent to original
-        int valueLen = strlen(n->value);
+        int valueLen = strlen(label);
         
         // Calculate when scale factor would hit 0.5 (minimum)
         // scaleFactor = 1.0f - (extraChars * 0.04f) = 0.5
@@ -120,9 +89,9 @@ void draw_block_if(const struct FlowNode *n) {
             condFontSize = baseFontSize * scaleFactor;
         }
         
-        float textWidth = get_text_width(n->value, condFontSize);
+        float textWidth = get_text_width(label, condFontSize);
         float textX = n->x - textWidth * 0.5f;  // Center the text
-        draw_text(textX, textY, n->value, condFontSize, 0.0f, 0.0f, 0.0f);
+        draw_text(textX, textY, label, condFontSize, 0.0f, 0.0f, 0.0f);
     }
 }
 
@@ -3,7 +3,9 @@
 
 struct FlowNode;
 
-void draw_block_if(const struct FlowNode *n);
+void build_block_if_template(void);
+void build_block_if(const struct FlowNode *n);
+void draw_block_if_label(const struct FlowNode *n, const char *label);
 
 #endif // BLOCK_IF_H
 
@@ -4,8 +4,12 @@
 // Forward declaration
 struct FlowNode;
 
-// Draw an Input block (parallelogram slanted left)
-void draw_block_input(const struct FlowNode *node);
+// Add the shape of an Input block (parallelogram slanted left) to the scene
+void build_block_input_template(void);
+void build_block_input(const struct FlowNode *node);
+
+// Draw the label of an Input block
+void draw_block_input_label(const struct FlowNode *node, const char *label);
 
 #endif // BLOCK_INPUT_H
 
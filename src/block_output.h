@@ -4,8 +4,12 @@
 // Forward declaration
 struct FlowNode;
 
-// Draw an Output block (parallelogram slanted right)
-void draw_block_output(const struct FlowNode *node);
+// Add the shape of an Output block (parallelogram slanted right) to the scene
+void build_block_output_template(void);
+void build_block_output(const struct FlowNode *node);
+
+// Draw the label of an Output block
+void draw_block_output_label(const struct FlowNode *node, const char *label);
 
 #endif // BLOCK_OUTPUT_H
 
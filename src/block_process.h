@@ -4,8 +4,12 @@
 // Forward declaration
 struct FlowNode;
 
-// Draw a Process block (rectangle)
-void draw_block_process(const struct FlowNode *node);
+// Add the shape of a Process block (rectangle) to the scene
+void build_block_process_template(void);
+void build_block_process(const struct FlowNode *node);
+
+// Draw the label of a Process block
+void draw_block_process_label(const struct FlowNode *node, const char *label);
 
 #endif // BLOCK_PROCESS_H
 
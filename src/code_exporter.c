@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <time.h>
 #include "code_exporter.h"
+#include "arena.h"
 
 // Define FlowNode and Connection structures (must match main.c)
 #define MAX_VALUE_LENGTH 256
@@ -13,10 +14,14 @@ typedef struct FlowNode {
     double y;
     float width;
     float height;
-    char value[MAX_VALUE_LENGTH];
     int type;  // NodeType enum value
     int branchColumn;         // 0 = main, -2/-4/-6 = left branches, +2/+4/+6 = right
     int owningIfBlock;        // Index of IF block this node belongs to (-1 if main)
+    int branchIfNode;         // IF branch list membership (see flowchart_state.h)
+    int branchSide;
+    int branchPrev;
+    int branchNext;
+    int label;
 } FlowNode;
 
 typedef struct Connection {
@@ -24,10 +29,12 @@ typedef struct Connection {
     int toNode;
 } Connection;
 
+// Node labels are stored apart from FlowNode (defined in flowchart_state.c)
+const char* node_label(int nodeIndex);
+
 // Constants (must match main.c)
 #define MAX_VALUE_LENGTH 256
 #define MAX_VAR_NAME_LENGTH 64
-#define MAX_NODES 100
 
 // Node types (must match main.c)
 typedef enum {
@@ -131,7 +138,7 @@ static void build_var_table(struct FlowNode* nodes, int nodeCount) {
             bool isArray;
             int arraySize;
             
-            if (parse_declare_block(nodes[i].value, varName, &varType, &isArray, &arraySize)) {
+            if (parse_declare_block(node_label(i), varName, &varType, &isArray, &arraySize)) {
                 strncpy(varTable[varTableCount].name, varName, MAX_VAR_NAME_LENGTH - 1);
                 varTable[varTableCount].name[MAX_VAR_NAME_LENGTH - 1] = '\0';
                 varTable[varTableCount].type = varType;
@@ -152,58 +159,50 @@ static bool has_string_variables(void) {
     return false;
 }
 
+// Copy the next '|'-separated field of a cycle value into out (truncated to outSize).
+// Like strtok, empty fields are skipped. Returns false when there are no more fields.
+static bool next_cycle_field(const char** p, char* out, size_t outSize) {
+    while (**p == '|') (*p)++;
+    if (**p == '\0') return false;
+    
+    size_t len = 0;
+    while (**p != '\0' && **p != '|') {
+        if (len < outSize - 1) {
+            out[len++] = **p;
+        }
+        (*p)++;
+    }
+    out[len] = '\0';
+    return true;
+}
+
 // Parse serialized cycle value string: TYPE|cond or FOR|init|cond|inc
+// Reads the label in place (labels are shared, so it must not be modified).
 static void parse_cycle_value(const char* value, char* typeBuf, char* condBuf, char* initBuf, char* incrBuf) {
     typeBuf[0] = condBuf[0] = initBuf[0] = incrBuf[0] = '\0';
     if (!value) return;
     
-    char temp[MAX_VALUE_LENGTH];
-    strncpy(temp, value, sizeof(temp) - 1);
-    temp[sizeof(temp) - 1] = '\0';
-    
-    char* token = strtok(temp, "|");
-    if (token) {
-        strncpy(typeBuf, token, MAX_VAR_NAME_LENGTH - 1);
-        typeBuf[MAX_VAR_NAME_LENGTH - 1] = '\0';
-    }
+    const char* p = value;
+    if (!next_cycle_field(&p, typeBuf, MAX_VAR_NAME_LENGTH)) return;
     
     // Check if this is a FOR loop
     bool isFor = (strncmp(typeBuf, "FOR", 3) == 0);
     
-    token = strtok(NULL, "|");
-    if (token) {
-        if (isFor) {
-            // FOR: token 2 is init, token 3 is cond, token 4 is incr
-            strncpy(initBuf, token, MAX_VALUE_LENGTH - 1);
-            initBuf[MAX_VALUE_LENGTH - 1] = '\0';
-        } else {
-            // WHILE/DO: token 2 is cond
-            strncpy(condBuf, token, MAX_VALUE_LENGTH - 1);
-            condBuf[MAX_VALUE_LENGTH - 1] = '\0';
-        }
-    }
-    token = strtok(NULL, "|");
-    if (token) {
-        if (isFor) {
-            // FOR: token 3 is cond
-            strncpy(condBuf, token, MAX_VALUE_LENGTH - 1);
-            condBuf[MAX_VALUE_LENGTH - 1] = '\0';
-        }
-        // For WHILE/DO, token 3 doesn't exist
-    }
-    token = strtok(NULL, "|");
-    if (token) {
-        if (isFor) {
-            // FOR: token 4 is incr
-            strncpy(incrBuf, token, MAX_VALUE_LENGTH - 1);
-            incrBuf[MAX_VALUE_LENGTH - 1] = '\0';
+    if (isFor) {
+        // FOR: token 2 is init, token 3 is cond, token 4 is incr
+        if (next_cycle_field(&p, initBuf, MAX_VALUE_LENGTH) &&
+            next_cycle_field(&p, condBuf, MAX_VALUE_LENGTH)) {
+            next_cycle_field(&p, incrBuf, MAX_VALUE_LENGTH);
         }
-        // For WHILE/DO, token 4 doesn't exist
+    } else {
+        // WHILE/DO: token 2 is cond
+        next_cycle_field(&p, condBuf, MAX_VALUE_LENGTH);
     }
 }
 
 // Helper function to parse assignment
-static bool parse_assignment(const char* value, char* leftVar, char* rightValue) {
+// rightValue holds rightSize characters; strlen(value) + 1 is always enough
+static bool parse_assignment(const char* value, char* leftVar, char* rightValue, size_t rightSize) {
     if (!value || value[0] == '\0') return false;
     
     const char* p = value;
@@ -236,7 +235,7 @@ static bool parse_assignment(const char* value, char* leftVar, char* rightValue)
     // Extract right side
     int rightLen = 0;
     bool inQuotes = false;
-    while (*p != '\0' && rightLen < MAX_VALUE_LENGTH - 1) {
+    while (*p != '\0' && rightLen < (int)rightSize - 1) {
         if (*p == '"' && (rightLen == 0 || rightValue[rightLen - 1] != '\\')) {
             inQuotes = !inQuotes;
             p++;
@@ -293,14 +292,27 @@ static bool parse_input_block(const char* value, char* varName, char* indexExpr,
     return true;
 }
 
+// Most placeholders extract_output_placeholders returns for a format string
+#define MAX_OUTPUT_PLACEHOLDERS 100
+
+// Upper bound on the placeholders in a format string: one per '{'
+static int count_placeholder_braces(const char* formatStr) {
+    int count = 0;
+    for (const char* p = formatStr; *p != '\0'; p++) {
+        if (*p == '{') count++;
+    }
+    return count < MAX_OUTPUT_PLACEHOLDERS ? count : MAX_OUTPUT_PLACEHOLDERS;
+}
+
 // Extract variable placeholders from output format string
+// Arrays must hold count_placeholder_braces(formatStr) entries
 static void extract_output_placeholders(const char* formatStr, char varNames[][MAX_VAR_NAME_LENGTH], 
                                         char indexExprs[][MAX_VALUE_LENGTH], bool* isArrayAccess, int* varCount) {
     *varCount = 0;
     if (!formatStr || formatStr[0] == '\0') return;
     
     const char* p = formatStr;
-    while (*p != '\0' && *varCount < 100) {
+    while (*p != '\0' && *varCount < MAX_OUTPUT_PLACEHOLDERS) {
         while (*p != '\0' && *p != '{') p++;
         if (*p == '\0') break;
         
@@ -382,12 +394,90 @@ static const char* get_printf_format(VariableType type) {
     }
 }
 
+// Per-node edge lists, built once per export in CSR layout.
+// outEdges[outOffsets[n] .. outOffsets[n + 1]) are the connections leaving node n and
+// inEdges[inOffsets[n] .. inOffsets[n + 1]) the ones entering it, both in connection
+// order so the first edge found matches a scan of the connection array.
+static int *outOffsets = NULL;
+static int *outEdges = NULL;
+static int *inOffsets = NULL;
+static int *inEdges = NULL;
+static int adjacencyNodeCount = 0;
+
+static void free_adjacency(void) {
+    free(outOffsets);
+    free(outEdges);
+    free(inOffsets);
+    free(inEdges);
+    outOffsets = outEdges = inOffsets = inEdges = NULL;
+    adjacencyNodeCount = 0;
+}
+
+static bool build_adjacency(int nodeCount, Connection* connections, int connectionCount) {
+    outOffsets = calloc((size_t)nodeCount + 1, sizeof(int));
+    inOffsets = calloc((size_t)nodeCount + 1, sizeof(int));
+    outEdges = malloc((size_t)connectionCount * sizeof(int) + 1);
+    inEdges = malloc((size_t)connectionCount * sizeof(int) + 1);
+    if (!outOffsets || !inOffsets || !outEdges || !inEdges) {
+        free_adjacency();
+        return false;
+    }
+    adjacencyNodeCount = nodeCount;
+    
+    // Count degrees, turn them into start offsets, then place edges in order
+    for (int i = 0; i < connectionCount; i++) {
+        int from = connections[i].fromNode;
+        int to = connections[i].toNode;
+        if (from >= 0 && from < nodeCount) outOffsets[from + 1]++;
+        if (to >= 0 && to < nodeCount) inOffsets[to + 1]++;
+    }
+    for (int n = 0; n < nodeCount; n++) {
+        outOffsets[n + 1] += outOffsets[n];
+        inOffsets[n + 1] += inOffsets[n];
+    }
+    int *outFill = malloc(((size_t)nodeCount + 1) * sizeof(int));
+    int *inFill = malloc(((size_t)nodeCount + 1) * sizeof(int));
+    if (!outFill || !inFill) {
+        free(outFill);
+        free(inFill);
+        free_adjacency();
+        return false;
+    }
+    memcpy(outFill, outOffsets, (size_t)nodeCount * sizeof(int));
+    memcpy(inFill, inOffsets, (size_t)nodeCount * sizeof(int));
+    for (int i = 0; i < connectionCount; i++) {
+        int from = connections[i].fromNode;
+        int to = connections[i].toNode;
+        if (from >= 0 && from < nodeCount) outEdges[outFill[from]++] = i;
+        if (to >= 0 && to < nodeCount) inEdges[inFill[to]++] = i;
+    }
+    free(outFill);
+    free(inFill);
+    return true;
+}
+
+// Edge list bounds (empty for nodes outside the chart)
+static int out_begin(int node) {
+    return (node >= 0 && node < adjacencyNodeCount) ? outOffsets[node] : 0;
+}
+
+static int out_end(int node) {
+    return (node >= 0 && node < adjacencyNodeCount) ? outOffsets[node + 1] : 0;
+}
+
+static int in_begin(int node) {
+    return (node >= 0 && node < adjacencyNodeCount) ? inOffsets[node] : 0;
+}
+
+static int in_end(int node) {
+    return (node >= 0 && node < adjacencyNodeCount) ? inOffsets[node + 1] : 0;
+}
+
 // Find next node in flowchart (follow connections)
 static int find_next_node(int currentNode, Connection* connections, int connectionCount) {
-    for (int i = 0; i < connectionCount; i++) {
-        if (connections[i].fromNode == currentNode) {
-            return connections[i].toNode;
-        }
+    (void)connectionCount;
+    if (out_begin(currentNode) < out_end(currentNode)) {
+        return connections[outEdges[out_begin(currentNode)]].toNode;
     }
     return -1;
 }
@@ -395,86 +485,99 @@ static int find_next_node(int currentNode, Connection* connections, int connecti
 // Find all connections from a node
 static void find_connections_from(int fromNode, Connection* connections, int connectionCount, 
                                   int* outNodes, int* outCount, int maxOut) {
+    (void)connectionCount;
     *outCount = 0;
-    for (int i = 0; i < connectionCount && *outCount < maxOut; i++) {
-        if (connections[i].fromNode == fromNode) {
-            outNodes[(*outCount)++] = connections[i].toNode;
-        }
+    for (int k = out_begin(fromNode); k < out_end(fromNode) && *outCount < maxOut; k++) {
+        outNodes[(*outCount)++] = connections[outEdges[k]].toNode;
     }
 }
 
 // Find connection from a node
 static int find_connection_from(int fromNode, Connection* connections, int connectionCount) {
-    for (int i = 0; i < connectionCount; i++) {
-        if (connections[i].fromNode == fromNode) {
-            return i;
-        }
+    (void)connections;
+    (void)connectionCount;
+    if (out_begin(fromNode) < out_end(fromNode)) {
+        return outEdges[out_begin(fromNode)];
     }
     return -1;
 }
 
+// Check whether a connection fromNode -> toNode exists
+static bool has_connection(int fromNode, int toNode, Connection* connections) {
+    for (int k = out_begin(fromNode); k < out_end(fromNode); k++) {
+        if (connections[outEdges[k]].toNode == toNode) {
+            return true;
+        }
+    }
+    return false;
+}
+
 // Find convergence node for an IF node
 // The convergence is the node that both branches eventually reach
-static int find_convergence_for_if(int ifNode, Connection* connections, int connectionCount) {
+static int find_convergence_for_if(int ifNode, int nodeCount, Connection* connections, int connectionCount) {
     // Find all nodes reachable from the IF (branch nodes)
-    int branchNodes[MAX_NODES];
-    int branchCount = 0;
-    bool visited[MAX_NODES] = {false};
+    bool *visited = calloc((size_t)nodeCount, sizeof(bool));
+    // BFS queue (each node is queued at most once)
+    int *queue = malloc((size_t)nodeCount * sizeof(int));
+    if (!visited || !queue) {
+        free(visited);
+        free(queue);
+        return -1;
+    }
     
     // Start from all direct connections from IF
-    for (int i = 0; i < connectionCount; i++) {
-        if (connections[i].fromNode == ifNode) {
-            int startNode = connections[i].toNode;
-            if (startNode >= 0 && !visited[startNode]) {
-                // BFS to find all nodes in this branch
-                int queue[MAX_NODES];
-                int queueFront = 0, queueBack = 0;
-                queue[queueBack++] = startNode;
-                visited[startNode] = true;
+    for (int e = out_begin(ifNode); e < out_end(ifNode); e++) {
+        int startNode = connections[outEdges[e]].toNode;
+        if (startNode >= 0 && startNode < nodeCount && !visited[startNode]) {
+            // BFS to find all nodes in this branch
+            int queueFront = 0, queueBack = 0;
+            queue[queueBack++] = startNode;
+            visited[startNode] = true;
+            
+            while (queueFront < queueBack) {
+                int current = queue[queueFront++];
                 
-                while (queueFront < queueBack) {
-                    int current = queue[queueFront++];
-                    branchNodes[branchCount++] = current;
-                    
-                    // Follow connections from this node
-                    for (int j = 0; j < connectionCount; j++) {
-                        if (connections[j].fromNode == current && !visited[connections[j].toNode]) {
-                            visited[connections[j].toNode] = true;
-                            queue[queueBack++] = connections[j].toNode;
-                        }
+                // Follow connections from this node
+                for (int k = out_begin(current); k < out_end(current); k++) {
+                    int next = connections[outEdges[k]].toNode;
+                    if (next >= 0 && next < nodeCount && !visited[next]) {
+                        visited[next] = true;
+                        queue[queueBack++] = next;
                     }
                 }
             }
         }
     }
     
+    free(queue);
+    
+    // visited now marks exactly the branch nodes
+    bool *isBranchNode = visited;
+    
     // Find a node that has incoming connections from multiple branch nodes
     // This is the convergence point
-    for (int i = 0; i < connectionCount; i++) {
+    int convergeNode = -1;
+    for (int i = 0; i < connectionCount && convergeNode < 0; i++) {
         int toNode = connections[i].toNode;
         if (toNode == ifNode) continue; // Skip connections back to IF
         
         // Count how many branch nodes connect to this node
         int incomingFromBranches = 0;
-        for (int j = 0; j < connectionCount; j++) {
-            if (connections[j].toNode == toNode) {
-                // Check if the source is a branch node
-                for (int k = 0; k < branchCount; k++) {
-                    if (connections[j].fromNode == branchNodes[k]) {
-                        incomingFromBranches++;
-                        break;
-                    }
-                }
+        for (int k = in_begin(toNode); k < in_end(toNode); k++) {
+            int fromNode = connections[inEdges[k]].fromNode;
+            if (fromNode >= 0 && fromNode < nodeCount && isBranchNode[fromNode]) {
+                incomingFromBranches++;
             }
         }
         
         // If multiple branch nodes connect to this node, it's the convergence
         if (incomingFromBranches >= 2) {
-            return toNode;
+            convergeNode = toNode;
         }
     }
     
-    return -1;
+    free(visited);
+    return convergeNode;
 }
 
 // Check if a node is in a loop body (between cycle and cycle_end)
@@ -485,107 +588,107 @@ static bool is_in_loop_body(int nodeIdx, int cycleNode, int cycleEndNode,
     
     // Check if we can reach this node from cycle without going through cycle_end
     // This is a simplified check - in practice, we'd need proper graph traversal
-    for (int i = 0; i < connectionCount; i++) {
-        if (connections[i].fromNode == cycleNode && connections[i].toNode == nodeIdx) {
-            return true;
-        }
-        if (connections[i].fromNode == cycleEndNode && connections[i].toNode == nodeIdx) {
-            return true;
-        }
-    }
-    
-    return false;
+    (void)connectionCount;
+    return has_connection(cycleNode, nodeIdx, connections) ||
+           has_connection(cycleEndNode, nodeIdx, connections);
 }
 
 // Find cycle-end pair for a cycle node
 static int find_cycle_end(int cycleNode, FlowNode* nodes, int nodeCount, 
                           Connection* connections, int connectionCount) {
     // First, try direct connection (for DO loops, cycle_end might connect directly to cycle)
-    for (int i = 0; i < connectionCount; i++) {
-        if (connections[i].fromNode == cycleNode) {
-            int target = connections[i].toNode;
-            if (target >= 0 && target < nodeCount && nodes[target].type == NODE_CYCLE_END) {
-                return target;
-            }
+    // Either direction counts; the earliest such connection wins
+    (void)connectionCount;
+    int directConn = -1;
+    int directEnd = -1;
+    for (int k = out_begin(cycleNode); k < out_end(cycleNode); k++) {
+        int target = connections[outEdges[k]].toNode;
+        if (target >= 0 && target < nodeCount && nodes[target].type == NODE_CYCLE_END) {
+            directConn = outEdges[k];
+            directEnd = target;
+            break;
         }
-        if (connections[i].toNode == cycleNode) {
-            int source = connections[i].fromNode;
-            if (source >= 0 && source < nodeCount && nodes[source].type == NODE_CYCLE_END) {
-                return source;
-            }
+    }
+    for (int k = in_begin(cycleNode); k < in_end(cycleNode); k++) {
+        if (directConn >= 0 && inEdges[k] > directConn) {
+            break;
+        }
+        int source = connections[inEdges[k]].fromNode;
+        if (source >= 0 && source < nodeCount && nodes[source].type == NODE_CYCLE_END) {
+            directEnd = source;
+            break;
         }
     }
+    if (directEnd >= 0) {
+        return directEnd;
+    }
     
     // If no direct connection, find cycle_end by traversing from cycle node
     // Look for a NODE_CYCLE_END that is reachable from the cycle node
     // and has a connection back to the cycle (loopback) or to a node outside the loop
-    bool visited[MAX_NODES] = {false};
-    int queue[MAX_NODES];
+    bool *visited = calloc((size_t)nodeCount, sizeof(bool));
+    int *queue = malloc((size_t)nodeCount * sizeof(int));
     int queueFront = 0, queueBack = 0;
+    int cycleEnd = -1;
+    if (!visited || !queue) {
+        free(visited);
+        free(queue);
+        return -1;
+    }
     
     // Start BFS from cycle node's outgoing connections (body start)
-    for (int i = 0; i < connectionCount; i++) {
-        if (connections[i].fromNode == cycleNode) {
-            int bodyStart = connections[i].toNode;
-            if (bodyStart >= 0 && bodyStart < nodeCount && !visited[bodyStart]) {
-                queue[queueBack++] = bodyStart;
-                visited[bodyStart] = true;
-            }
+    for (int k = out_begin(cycleNode); k < out_end(cycleNode); k++) {
+        int bodyStart = connections[outEdges[k]].toNode;
+        if (bodyStart >= 0 && bodyStart < nodeCount && !visited[bodyStart]) {
+            queue[queueBack++] = bodyStart;
+            visited[bodyStart] = true;
         }
     }
     
     // BFS to find cycle_end
-    while (queueFront < queueBack) {
+    while (cycleEnd < 0 && queueFront < queueBack) {
         int current = queue[queueFront++];
         
         // Check if this is a cycle_end
         if (nodes[current].type == NODE_CYCLE_END) {
             // Verify it's the right one by checking if it has a loopback to cycle
             // or connects to a node that's not directly connected from cycle
-            for (int i = 0; i < connectionCount; i++) {
-                if (connections[i].fromNode == current && connections[i].toNode == cycleNode) {
-                    // This is a loopback - found the cycle_end
-                    return current;
-                }
+            if (has_connection(current, cycleNode, connections)) {
+                // This is a loopback - found the cycle_end
+                cycleEnd = current;
+                break;
             }
             // Also check if it connects to a node that's not in the immediate body
             // (for FOR/WHILE, cycle_end connects to exit, not back to cycle)
             bool connectsToExit = false;
-            for (int i = 0; i < connectionCount; i++) {
-                if (connections[i].fromNode == current) {
-                    int target = connections[i].toNode;
-                    // Check if target is not directly connected from cycle (exit node)
-                    bool isDirectFromCycle = false;
-                    for (int j = 0; j < connectionCount; j++) {
-                        if (connections[j].fromNode == cycleNode && connections[j].toNode == target) {
-                            isDirectFromCycle = true;
-                            break;
-                        }
-                    }
-                    if (!isDirectFromCycle && target != cycleNode) {
-                        connectsToExit = true;
-                        break;
-                    }
+            for (int k = out_begin(current); k < out_end(current); k++) {
+                int target = connections[outEdges[k]].toNode;
+                // Check if target is not directly connected from cycle (exit node)
+                bool isDirectFromCycle = has_connection(cycleNode, target, connections);
+                if (!isDirectFromCycle && target != cycleNode) {
+                    connectsToExit = true;
+                    break;
                 }
             }
             if (connectsToExit) {
-                return current;
+                cycleEnd = current;
+                break;
             }
         }
         
         // Continue BFS
-        for (int i = 0; i < connectionCount; i++) {
-            if (connections[i].fromNode == current) {
-                int next = connections[i].toNode;
-                if (next >= 0 && next < nodeCount && !visited[next] && next != cycleNode) {
-                    queue[queueBack++] = next;
-                    visited[next] = true;
-                }
+        for (int k = out_begin(current); k < out_end(current); k++) {
+            int next = connections[outEdges[k]].toNode;
+            if (next >= 0 && next < nodeCount && !visited[next] && next != cycleNode) {
+                queue[queueBack++] = next;
+                visited[next] = true;
             }
         }
     }
     
-    return -1;
+    free(visited);
+    free(queue);
+    return cycleEnd;
 }
 
 // Find START node
@@ -611,6 +714,7 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
     
     visited[nodeIdx] = true;
     FlowNode* node = &nodes[nodeIdx];
+    const char* label = node_label(nodeIdx);
     
     // Handle different node types
     switch (node->type) {
@@ -624,7 +728,7 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
             bool isArray;
             int arraySize;
             
-            if (parse_declare_block(node->value, varName, &varType, &isArray, &arraySize)) {
+            if (parse_declare_block(label, varName, &varType, &isArray, &arraySize)) {
                 for (int i = 0; i < *indentLevel; i++) fprintf(file, "    ");
                 
                 const char* cType = get_c_type_name(varType);
@@ -655,9 +759,11 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
         
         case NODE_ASSIGNMENT: {
             char leftVar[MAX_VALUE_LENGTH];
-            char rightValue[MAX_VALUE_LENGTH];
+            size_t rightSize = strlen(label) + 1;
+            ArenaMark scratch = arena_mark(&scratchArena);
+            char* rightValue = arena_alloc(&scratchArena, rightSize);
             
-            if (parse_assignment(node->value, leftVar, rightValue)) {
+            if (rightValue && parse_assignment(label, leftVar, rightValue, rightSize)) {
                 for (int i = 0; i < *indentLevel; i++) fprintf(file, "    ");
                 
                 char leftVarName[MAX_VAR_NAME_LENGTH];
@@ -670,7 +776,7 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
                 VarInfo* leftVarInfo = find_var(leftVarName);
                 bool isStringAssignment = (leftVarInfo && leftVarInfo->type == VAR_TYPE_STRING);
                 
-                const char* origValue = node->value;
+                const char* origValue = label;
                 const char* eqPos = strchr(origValue, '=');
                 bool isQuotedString = false;
                 if (eqPos) {
@@ -696,6 +802,7 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
                     fprintf(file, "%s = %s;\n", leftVar, rightValue);
                 }
             }
+            arena_release(&scratchArena, scratch);
             break;
         }
         
@@ -704,7 +811,7 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
             char indexExpr[MAX_VALUE_LENGTH];
             bool isArray;
             
-            if (parse_input_block(node->value, varName, indexExpr, &isArray)) {
+            if (parse_input_block(label, varName, indexExpr, &isArray)) {
                 for (int i = 0; i < *indentLevel; i++) fprintf(file, "    ");
                 
                 VarInfo* varInfo = find_var(varName);
@@ -721,23 +828,39 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
         }
         
         case NODE_OUTPUT: {
-            if (node->value[0] != '\0') {
-                char varNames[100][MAX_VAR_NAME_LENGTH];
-                char indexExprs[100][MAX_VALUE_LENGTH];
-                bool isArrayAccess[100];
+            if (label[0] != '\0') {
+                // Buffers come from the scratch arena and are sized for the label:
+                // at most one placeholder per '{', a placeholder can be as short as
+                // "{" and becomes at most 3 format characters, and each argument is
+                // a name plus index
+                ArenaMark scratch = arena_mark(&scratchArena);
+                int maxPlaceholders = count_placeholder_braces(label);
+                char (*varNames)[MAX_VAR_NAME_LENGTH] = arena_alloc(&scratchArena, (size_t)maxPlaceholders * MAX_VAR_NAME_LENGTH);
+                char (*indexExprs)[MAX_VALUE_LENGTH] = arena_alloc(&scratchArena, (size_t)maxPlaceholders * MAX_VALUE_LENGTH);
+                bool *isArrayAccess = arena_alloc(&scratchArena, (size_t)maxPlaceholders * sizeof(bool));
+                if (!varNames || !indexExprs || !isArrayAccess) {
+                    arena_release(&scratchArena, scratch);
+                    break;
+                }
                 int varCount = 0;
                 
-                extract_output_placeholders(node->value, varNames, indexExprs, isArrayAccess, &varCount);
+                extract_output_placeholders(label, varNames, indexExprs, isArrayAccess, &varCount);
                 
-                char formatStr[MAX_VALUE_LENGTH * 2];
-                char argsStr[MAX_VALUE_LENGTH * 2] = "";
+                size_t formatSize = strlen(label) * 3 + 1;
+                size_t argsSize = (size_t)varCount * (MAX_VAR_NAME_LENGTH + MAX_VALUE_LENGTH + 4) + 1;
+                char* formatStr = arena_alloc(&scratchArena, formatSize);
+                char* argsStr = arena_alloc(&scratchArena, argsSize);
+                if (!formatStr || !argsStr) {
+                    arena_release(&scratchArena, scratch);
+                    break;
+                }
                 int formatPos = 0;
                 int argsPos = 0;
                 
-                const char* p = node->value;
+                const char* p = label;
                 int placeholderIdx = 0;
                 
-                while (*p != '\0' && formatPos < (int)(sizeof(formatStr) - 1)) {
+                while (*p != '\0' && formatPos < (int)formatSize - 1) {
                     if (*p == '{') {
                         if (placeholderIdx < varCount) {
                             VarInfo* varInfo = find_var(varNames[placeholderIdx]);
@@ -745,7 +868,7 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
                             const char* format = get_printf_format(varType);
                             
                             int formatLen = strlen(format);
-                            for (int i = 0; i < formatLen && formatPos < (int)(sizeof(formatStr) - 1); i++) {
+                            for (int i = 0; i < formatLen && formatPos < (int)formatSize - 1; i++) {
                                 formatStr[formatPos++] = format[i];
                             }
                             
@@ -754,11 +877,11 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
                                 argsStr[argsPos++] = ' ';
                             }
                             if (isArrayAccess[placeholderIdx]) {
-                                int len = snprintf(argsStr + argsPos, sizeof(argsStr) - argsPos, 
+                                int len = snprintf(argsStr + argsPos, argsSize - argsPos, 
                                                    "%s[%s]", varNames[placeholderIdx], indexExprs[placeholderIdx]);
                                 argsPos += len;
                             } else {
-                                int len = snprintf(argsStr + argsPos, sizeof(argsStr) - argsPos, 
+                                int len = snprintf(argsStr + argsPos, argsSize - argsPos, 
                                                    "%s", varNames[placeholderIdx]);
                                 argsPos += len;
                             }
@@ -780,14 +903,15 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
                 } else {
                     fprintf(file, "printf(\"%s\");\n", formatStr);
                 }
+                arena_release(&scratchArena, scratch);
             }
             break;
         }
         
         case NODE_PROCESS: {
             for (int i = 0; i < *indentLevel; i++) fprintf(file, "    ");
-            if (node->value[0] != '\0') {
-                fprintf(file, "// Process: %s\n", node->value);
+            if (label[0] != '\0') {
+                fprintf(file, "// Process: %s\n", label);
             } else {
                 fprintf(file, "// Process\n");
             }
@@ -799,7 +923,7 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
             
         case NODE_IF: {
             // Find convergence node
-            int convergeNode = find_convergence_for_if(nodeIdx, connections, connectionCount);
+            int convergeNode = find_convergence_for_if(nodeIdx, nodeCount, connections, connectionCount);
             
             // Find all connections from IF node
             int outNodes[10];
@@ -809,7 +933,7 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
             
             // Generate if statement
             for (int i = 0; i < *indentLevel; i++) fprintf(file, "    ");
-            const char* condition = node->value[0] != '\0' ? node->value : "/* condition */";
+            const char* condition = label[0] != '\0' ? label : "/* condition */";
             fprintf(file, "if (%s) {\n", condition);
             (*indentLevel)++;
             
@@ -904,7 +1028,7 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
             char condBuf[MAX_VALUE_LENGTH];
             char initBuf[MAX_VALUE_LENGTH];
             char incrBuf[MAX_VALUE_LENGTH];
-            parse_cycle_value(node->value, typeBuf, condBuf, initBuf, incrBuf);
+            parse_cycle_value(label, typeBuf, condBuf, initBuf, incrBuf);
             
             char loopType = 'W';
             if (strncmp(typeBuf, "DO", 2) == 0) loopType = 'D';
@@ -917,9 +1041,9 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
                 if (cycleEndNode >= 0 && cycleEndNode < nodeCount) {
                     int exitNode = find_next_node(cycleEndNode, connections, connectionCount);
                     if (exitNode == nodeIdx) {
-                        for (int i = 0; i < connectionCount; i++) {
-                            if (connections[i].fromNode == cycleEndNode && connections[i].toNode != nodeIdx) {
-                                exitNode = connections[i].toNode;
+                        for (int k = out_begin(cycleEndNode); k < out_end(cycleEndNode); k++) {
+                            if (connections[outEdges[k]].toNode != nodeIdx) {
+                                exitNode = connections[outEdges[k]].toNode;
                                 break;
                             }
                         }
@@ -1009,17 +1133,8 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
                     // Check if we've already visited this node (except for cycle/cycle_end which we allow revisiting)
                     if (visited[nextNode] && nextNode != nodeIdx && nextNode != cycleEndNode) {
                         // Check if this node connects back to cycle or cycle_end (loopback)
-                        bool connectsToCycle = false;
-                        for (int i = 0; i < connectionCount; i++) {
-                            if (connections[i].fromNode == nextNode && connections[i].toNode == nodeIdx) {
-                                connectsToCycle = true;
-                                break;
-                            }
-                            if (connections[i].fromNode == nextNode && connections[i].toNode == cycleEndNode) {
-                                connectsToCycle = true;
-                                break;
-                            }
-                        }
+                        bool connectsToCycle = has_connection(nextNode, nodeIdx, connections) ||
+                                               has_connection(nextNode, cycleEndNode, connections);
                         if (!connectsToCycle) break;
                     }
                     
@@ -1064,9 +1179,9 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
                 int exitNode = find_next_node(cycleEndNode, connections, connectionCount);
                 if (exitNode == nodeIdx) {
                     // This is the loopback, find the actual exit
-                    for (int i = 0; i < connectionCount; i++) {
-                        if (connections[i].fromNode == cycleEndNode && connections[i].toNode != nodeIdx) {
-                            exitNode = connections[i].toNode;
+                    for (int k = out_begin(cycleEndNode); k < out_end(cycleEndNode); k++) {
+                        if (connections[outEdges[k]].toNode != nodeIdx) {
+                            exitNode = connections[outEdges[k]].toNode;
                             break;
                         }
                     }
@@ -1085,45 +1200,43 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
             int cycleNode = -1;
             
             // First, check connections FROM cycle_end (end -> body -> cycle)
-            for (int i = 0; i < connectionCount; i++) {
-                if (connections[i].fromNode == nodeIdx) {
-                    int target = connections[i].toNode;
-                    if (target >= 0 && target < nodeCount && nodes[target].type == NODE_CYCLE) {
+            for (int k = out_begin(nodeIdx); k < out_end(nodeIdx); k++) {
+                int i = outEdges[k];
+                int target = connections[i].toNode;
+                if (target >= 0 && target < nodeCount && nodes[target].type == NODE_CYCLE) {
+                    // Check if this is a DO loop by parsing the cycle value
+                    char typeBuf[MAX_VAR_NAME_LENGTH];
+                    char condBuf[MAX_VALUE_LENGTH];
+                    char initBuf[MAX_VALUE_LENGTH];
+                    char incrBuf[MAX_VALUE_LENGTH];
+                    parse_cycle_value(node_label(target), typeBuf, condBuf, initBuf, incrBuf);
+                    if (strncmp(typeBuf, "DO", 2) == 0) {
+                        cycleNode = target;
+                        break;
+                    }
+                }
+            }
+            
+            // Also check connections TO cycle_end (cycle -> end for loopback)
+            if (cycleNode < 0) {
+                for (int k = in_begin(nodeIdx); k < in_end(nodeIdx); k++) {
+                    int i = inEdges[k];
+                    int source = connections[i].fromNode;
+                    if (source >= 0 && source < nodeCount && nodes[source].type == NODE_CYCLE) {
                         // Check if this is a DO loop by parsing the cycle value
                         char typeBuf[MAX_VAR_NAME_LENGTH];
                         char condBuf[MAX_VALUE_LENGTH];
                         char initBuf[MAX_VALUE_LENGTH];
                         char incrBuf[MAX_VALUE_LENGTH];
-                        parse_cycle_value(nodes[target].value, typeBuf, condBuf, initBuf, incrBuf);
+                        parse_cycle_value(node_label(source), typeBuf, condBuf, initBuf, incrBuf);
                         if (strncmp(typeBuf, "DO", 2) == 0) {
-                            cycleNode = target;
+                            cycleNode = source;
                             break;
                         }
                     }
                 }
             }
             
-            // Also check connections TO cycle_end (cycle -> end for loopback)
-            if (cycleNode < 0) {
-                for (int i = 0; i < connectionCount; i++) {
-                    if (connections[i].toNode == nodeIdx) {
-                        int source = connections[i].fromNode;
-                        if (source >= 0 && source < nodeCount && nodes[source].type == NODE_CYCLE) {
-                            // Check if this is a DO loop by parsing the cycle value
-                            char typeBuf[MAX_VAR_NAME_LENGTH];
-                            char condBuf[MAX_VALUE_LENGTH];
-                            char initBuf[MAX_VALUE_LENGTH];
-                            char incrBuf[MAX_VALUE_LENGTH];
-                            parse_cycle_value(nodes[source].value, typeBuf, condBuf, initBuf, incrBuf);
-                            if (strncmp(typeBuf, "DO", 2) == 0) {
-                                cycleNode = source;
-                                break;
-                            }
-                        }
-                    }
-                }
-            }
-            
             // If this is a DO loop's cycle_end, process the entire DO loop here
             if (cycleNode >= 0 && !visited[cycleNode]) {
                 // Mark cycle node as visited so it doesn't get processed separately
@@ -1134,7 +1247,7 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
                 char condBuf[MAX_VALUE_LENGTH];
                 char initBuf[MAX_VALUE_LENGTH];
                 char incrBuf[MAX_VALUE_LENGTH];
-                parse_cycle_value(nodes[cycleNode].value, typeBuf, condBuf, initBuf, incrBuf);
+                parse_cycle_value(node_label(cycleNode), typeBuf, condBuf, initBuf, incrBuf);
                 
                 // Push to stack
                 if (*cycleTop < 32) {
@@ -1181,13 +1294,7 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
                         
                         // Check if we've already visited this node
                         if (visited[nextNode] && nextNode != nodeIdx && nextNode != cycleNode) {
-                            bool connectsToCycle = false;
-                            for (int j = 0; j < connectionCount; j++) {
-                                if (connections[j].fromNode == nextNode && connections[j].toNode == cycleNode) {
-                                    connectsToCycle = true;
-                                    break;
-                                }
-                            }
+                            bool connectsToCycle = has_connection(nextNode, cycleNode, connections);
                             if (!connectsToCycle) break;
                         }
                         
@@ -1219,9 +1326,9 @@ static int export_node_recursive(FILE* file, int nodeIdx, FlowNode* nodes, int n
                 int exitNode = find_next_node(cycleNode, connections, connectionCount);
                 if (exitNode == nodeIdx) {
                     // This is the loopback, find the actual exit
-                    for (int i = 0; i < connectionCount; i++) {
-                        if (connections[i].fromNode == cycleNode && connections[i].toNode != nodeIdx) {
-                            exitNode = connections[i].toNode;
+                    for (int k = out_begin(cycleNode); k < out_end(cycleNode); k++) {
+                        if (connections[outEdges[k]].toNode != nodeIdx) {
+                            exitNode = connections[outEdges[k]].toNode;
                             break;
                         }
                     }
@@ -1275,7 +1382,13 @@ static bool export_to_c(const char* filename, struct FlowNode* nodes, int nodeCo
     fprintf(file, "int main(void) {\n");
     
     // Initialize traversal state
-    bool visited[MAX_NODES] = {false};
+    bool *visited = calloc((size_t)nodeCount, sizeof(bool));
+    if (!visited || !build_adjacency(nodeCount, connections, connectionCount)) {
+        fprintf(stderr, "Out of memory exporting flowchart\n");
+        free(visited);
+        fclose(file);
+        return false;
+    }
     int indentLevel = 1;
     
     // Cycle stack
@@ -1300,6 +1413,8 @@ static bool export_to_c(const char* filename, struct FlowNode* nodes, int nodeCo
     fprintf(file, "return 0;\n");
     fprintf(file, "}\n");
     
+    free(visited);
+    free_adjacency();
     fclose(file);
     return true;
 }
@@ -0,0 +1,181 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <stdbool.h>
+#include "flowchart_state.h"
+#include "connection_routes.h"
+
+// Forward declarations for helper functions (defined in main.c)
+bool is_cycle_loopback(int connIndex);
+int get_if_branch_type(int connIndex);
+
+static ConnectionRoute *routes = NULL;
+static int routeCapacity = 0;
+static bool routesBuilt = false;
+static unsigned int routesRevision = 0;
+
+static void add_route_point(ConnectionRoute *route, float x, float y) {
+    route->x[route->pointCount] = x;
+    route->y[route->pointCount] = y;
+    route->pointCount++;
+}
+
+// IF -> branch route: exit the side of the diamond, run down the branch column,
+// then across to the target (branchType: 0 = true/left, 1 = false/right)
+static void route_if_branch(ConnectionRoute *route, int connIndex, int branchType) {
+    const FlowNode *from = &nodes[connections[connIndex].fromNode];
+    const FlowNode *to   = &nodes[connections[connIndex].toNode];
+    float side = (branchType == 0) ? -1.0f : 1.0f;
+
+    float x1 = (float)(from->x + side * from->width * 0.5f);  // Side of diamond
+    float y1 = (float)from->y;  // Middle of diamond
+
+    int ifBlockIdx = find_if_block_by_if_node(connections[connIndex].fromNode);
+    double branchWidth = 1.0;
+    if (ifBlockIdx >= 0) {
+        branchWidth = (branchType == 0) ? ifBlocks[ifBlockIdx].leftBranchWidth : ifBlocks[ifBlockIdx].rightBranchWidth;
+    }
+
+    // Target depends on whether it's a convergence point
+    float x2, y2;
+    if (to->type == NODE_CONVERGE) {
+        // Connect to the matching side of the convergence
+        x2 = (float)(to->x + side * to->width * 0.5f);
+        y2 = (float)to->y;
+    } else {
+        // Connect to top of normal block
+        x2 = (float)to->x;
+        y2 = (float)(to->y + to->height * 0.5f);
+    }
+
+    float branchX = (float)(from->x + side * branchWidth);  // Dynamic branch width
+
+    route->kind = (branchType == 0) ? CONNECTION_TRUE_BRANCH : CONNECTION_FALSE_BRANCH;
+    add_route_point(route, x1, y1);
+    add_route_point(route, branchX, y1);
+    add_route_point(route, branchX, y2);
+    add_route_point(route, x2, y2);
+}
+
+// Any other connection: vertical within a branch, down the branch column into
+// the side of a convergence point, or an L-shape (horizontal then vertical)
+static void route_normal(ConnectionRoute *route, int connIndex) {
+    const FlowNode *from = &nodes[connections[connIndex].fromNode];
+    const FlowNode *to   = &nodes[connections[connIndex].toNode];
+
+    // Check if both nodes are in the same branch (non-zero branchColumn and equal)
+    bool sameBranch = (from->branchColumn != 0 && from->branchColumn == to->branchColumn);
+
+    float x1 = (float)from->x;
+    // For cycle end blocks, use radius (width/2) instead of height/2 for connector position
+    float y1;
+    if (from->type == NODE_CYCLE_END) {
+        y1 = (float)(from->y - from->width * 0.5f);
+    } else {
+        y1 = (float)(from->y - from->height * 0.5f);
+    }
+
+    float x2 = (float)to->x;
+    float y2;
+    if (to->type == NODE_CYCLE_END) {
+        y2 = (float)(to->y + to->width * 0.5f);
+    } else {
+        y2 = (float)(to->y + to->height * 0.5f);
+    }
+
+    route->kind = CONNECTION_NORMAL;
+
+    // Connections TO a convergence point from branch blocks. This includes nodes in
+    // branches (branchColumn != 0) OR nodes owned by an IF (nested IF false branches
+    // can have branchColumn=0)
+    if (to->type == NODE_CONVERGE && (from->branchColumn != 0 || from->owningIfBlock >= 0)) {
+        float branchX = (float)from->x;  // Stay in branch column
+
+        // Which side of the convergence to connect to: for a convergence in the main
+        // branch use from's branchColumn, for a nested IF's convergence whether from
+        // is left or right of it
+        float convergeX;
+        bool leftSide = (to->branchColumn == 0) ? (from->branchColumn < 0)
+                                                : (from->branchColumn < to->branchColumn);
+        if (leftSide) {
+            convergeX = (float)(to->x - to->width * 0.5f);
+        } else {
+            convergeX = (float)(to->x + to->width * 0.5f);
+        }
+        float convergeY = (float)to->y;
+
+        route->kind = CONNECTION_INTO_CONVERGE;
+        add_route_point(route, x1, y1);
+        add_route_point(route, branchX, convergeY);
+        add_route_point(route, convergeX, convergeY);
+    } else if (sameBranch || fabs(x1 - x2) < 0.001f || fabs(y1 - y2) < 0.001f) {
+        // Same branch, same X or same Y: a single straight line
+        add_route_point(route, x1, y1);
+        add_route_point(route, x2, y2);
+    } else {
+        // Different X and Y: L-shape, horizontal to the target X then vertical
+        add_route_point(route, x1, y1);
+        add_route_point(route, x2, y1);
+        add_route_point(route, x2, y2);
+    }
+}
+
+static void build_route(ConnectionRoute *route, int connIndex) {
+    route->pointCount = 0;
+
+    if (!connection_is_live(connIndex)) {
+        route->kind = CONNECTION_REMOVED;
+        route->minX = route->minY = route->maxX = route->maxY = 0.0f;
+        return;
+    }
+
+    // Cycle loopbacks are drawn as bracket lines by the cycle code
+    if (is_cycle_loopback(connIndex)) {
+        route->kind = CONNECTION_LOOPBACK;
+        route->minX = route->minY = route->maxX = route->maxY = 0.0f;
+        return;
+    }
+
+    int branchType = get_if_branch_type(connIndex);
+    if (branchType == 0 || branchType == 1) {
+        route_if_branch(route, connIndex, branchType);
+    } else {
+        route_normal(route, connIndex);
+    }
+
+    route->minX = route->maxX = route->x[0];
+    route->minY = route->maxY = route->y[0];
+    for (int i = 1; i < route->pointCount; i++) {
+        route->minX = fminf(route->minX, route->x[i]);
+        route->maxX = fmaxf(route->maxX, route->x[i]);
+        route->minY = fminf(route->minY, route->y[i]);
+        route->maxY = fmaxf(route->maxY, route->y[i]);
+    }
+}
+
+const ConnectionRoute* get_connection_routes(void) {
+    if (routesBuilt && routesRevision == flowchart_revision()) {
+        return routes;
+    }
+
+    if (connectionCount > routeCapacity) {
+        int newCapacity = routeCapacity > 0 ? routeCapacity : 16;
+        while (newCapacity < connectionCount) {
+            newCapacity *= 2;
+        }
+        ConnectionRoute *grown = realloc(routes, (size_t)newCapacity * sizeof(ConnectionRoute));
+        if (!grown) {
+            fprintf(stderr, "Out of memory growing connection routes to %d entries\n", newCapacity);
+            return NULL;
+        }
+        routes = grown;
+        routeCapacity = newCapacity;
+    }
+
+    for (int i = 0; i < connectionCount; i++) {
+        build_route(&routes[i], i);
+    }
+    routesBuilt = true;
+    routesRevision = flowchart_revision();
+    return routes;
+}
@@ -0,0 +1,33 @@
+#ifndef CONNECTION_ROUTES_H
+#define CONNECTION_ROUTES_H
+
+// How a connection is routed on screen
+typedef enum {
+    CONNECTION_NORMAL,         // Straight or L-shaped line between two blocks
+    CONNECTION_TRUE_BRANCH,    // IF -> true (left) branch, three segments
+    CONNECTION_FALSE_BRANCH,   // IF -> false (right) branch, three segments
+    CONNECTION_INTO_CONVERGE,  // Branch block -> side of a convergence point
+    CONNECTION_LOOPBACK,       // Cycle loopback, drawn as a bracket and not clickable
+    CONNECTION_REMOVED         // Dead entry left by remove_connection, not drawn
+} ConnectionKind;
+
+// Most points any route needs (the three-segment IF branch routes)
+#define MAX_ROUTE_POINTS 4
+
+// Routed polyline of one connection, in world coordinates
+typedef struct {
+    ConnectionKind kind;
+    int pointCount;                 // 0 for loopbacks and removed entries
+    float x[MAX_ROUTE_POINTS];
+    float y[MAX_ROUTE_POINTS];
+    float minX, minY, maxX, maxY;   // Bounding box of the points
+} ConnectionRoute;
+
+// Connection route cache (connection_routes.c)
+// The kind and polyline of every connection are computed once and reused by the
+// renderer and the hover hit test until flowchart_revision() changes. Returns an
+// array indexed like connections[] (connectionCount entries), or NULL if memory
+// could not be allocated. The array is only valid until the flowchart changes.
+const ConnectionRoute* get_connection_routes(void);
+
+#endif // CONNECTION_ROUTES_H
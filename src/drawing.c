@@ -1,6 +1,9 @@
 #include <GLFW/glfw3.h>
 #include <math.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "flowchart_state.h"
 #include "text_renderer.h"
 #include "block_process.h"
@@ -12,207 +15,202 @@
 #include "block_converge.h"
 #include "block_cycle.h"
 #include "block_cycle_end.h"
+#include "connection_routes.h"
+#include "scene_renderer.h"
+#include "frame_stats.h"
 
 // Forward declarations for helper functions (defined in main.c)
-bool is_cycle_loopback(int connIndex);
-int get_if_branch_type(int connIndex);
 float get_cycle_loopback_offset(int cycleIndex);
 bool cursor_over_button(float buttonX, float buttonY, GLFWwindow* window);
 
 // Forward declaration for function defined later in this file
 void drawPopupMenu(GLFWwindow* window);
 
-static void draw_rounded_rectangle(float x, float y, float width, float height, float radius, bool filled) {
-    float halfW = width * 0.5f;
-    float halfH = height * 0.5f;
-    int segments = 12; // Number of segments per corner
-    
-    // Ensure radius doesn't exceed half the width or height
-    if (radius > halfW) radius = halfW;
-    if (radius > halfH) radius = halfH;
-    
-    // Corner arc centers (these are the inner corners where the arc starts)
-    float cx_tl = x - halfW + radius;  // Top-left
-    float cy_tl = y + halfH - radius;
-    float cx_tr = x + halfW - radius;  // Top-right
-    float cy_tr = y + halfH - radius;
-    float cx_br = x + halfW - radius;  // Bottom-right
-    float cy_br = y - halfH + radius;
-    float cx_bl = x - halfW + radius;  // Bottom-left
-    float cy_bl = y - halfH + radius;
-    
-    if (filled) {
-        // Draw filled rounded rectangle using a polygon
-        glBegin(GL_POLYGON);
-        
-        // Top-left corner arc (from left edge to top edge, going counter-clockwise)
-        for (int i = 0; i <= segments; ++i) {
-            float angle = 3.14159265f - 1.57079633f * (float)i / segments; // π to π/2
-            glVertex2f(cx_tl + cosf(angle) * radius, cy_tl + sinf(angle) * radius);
-        }
-        
-        // Top edge
-        glVertex2f(x + halfW - radius, y + halfH);
-        
-        // Top-right corner arc
-        for (int i = 1; i <= segments; ++i) {
-            float angle = 1.57079633f - 1.57079633f * (float)i / segments; // π/2 to 0
-            glVertex2f(cx_tr + cosf(angle) * radius, cy_tr + sinf(angle) * radius);
-        }
-        
-        // Right edge
-        glVertex2f(x + halfW, y - halfH + radius);
-        
-        // Bottom-right corner arc
-        for (int i = 1; i <= segments; ++i) {
-            float angle = 0.0f - 1.57079633f * (float)i / segments; // 0 to -π/2
-            glVertex2f(cx_br + cosf(angle) * radius, cy_br + sinf(angle) * radius);
-        }
-        
-        // Bottom edge
-        glVertex2f(x - halfW + radius, y - halfH);
-        
-        // Bottom-left corner arc
-        for (int i = 1; i <= segments; ++i) {
-            float angle = 4.71238898f - 1.57079633f * (float)i / segments; // 3π/2 to π
-            glVertex2f(cx_bl + cosf(angle) * radius, cy_bl + sinf(angle) * radius);
-        }
-        
-        // Left edge
-        glVertex2f(x - halfW, y + halfH - radius);
-        
-        glEnd();
-    } else {
-        // Draw rounded rectangle border (clockwise from top-left)
-        glBegin(GL_LINE_LOOP);
-        
-        // Top-left corner arc
-        for (int i = 0; i <= segments; ++i) {
-            float angle = 3.14159265f - 1.57079633f * (float)i / segments;
-            glVertex2f(cx_tl + cosf(angle) * radius, cy_tl + sinf(angle) * radius);
-        }
-        
-        // Top edge
-        glVertex2f(x + halfW - radius, y + halfH);
-        
-        // Top-right corner arc
-        for (int i = 1; i <= segments; ++i) {
-            float angle = 1.57079633f - 1.57079633f * (float)i / segments;
-            glVertex2f(cx_tr + cosf(angle) * radius, cy_tr + sinf(angle) * radius);
-        }
-        
-        // Right edge
-        glVertex2f(x + halfW, y - halfH + radius);
-        
-        // Bottom-right corner arc
-        for (int i = 1; i <= segments; ++i) {
-            float angle = 0.0f - 1.57079633f * (float)i / segments;
-            glVertex2f(cx_br + cosf(angle) * radius, cy_br + sinf(angle) * radius);
-        }
-        
-        // Bottom edge
-        glVertex2f(x - halfW + radius, y - halfH);
-        
-        // Bottom-left corner arc
-        for (int i = 1; i <= segments; ++i) {
-            float angle = 4.71238898f - 1.57079633f * (float)i / segments;
-            glVertex2f(cx_bl + cosf(angle) * radius, cy_bl + sinf(angle) * radius);
-        }
-        
-        // Left edge
-        glVertex2f(x - halfW, y + halfH - radius);
-        
-        glEnd();
-    }
+// Segments per corner of a rounded rectangle
+#define ROUNDED_CORNER_SEGMENTS 12
+
+// Template point at the corner of a block at (sx, sy) = (±0.5, ±0.5), moved in
+// by kx, ky shorter sides
+static TemplatePoint corner_point(float sx, float sy, float kx, float ky) {
+    TemplatePoint p = {.sx = sx, .sy = sy, .kx = kx, .ky = ky};
+    return p;
 }
 
-void drawFlowNode(const FlowNode *n) {
+// Points around a rounded rectangle with corners of radius 0.3 shorter sides
+// (clockwise from the left end of the top-left corner), for a template in
+// TEMPLATE_UNIT_SHORTER_SIDE; points needs room for 4 * (ROUNDED_CORNER_SEGMENTS + 2)
+// entries. Returns the number of points.
+static int rounded_rectangle_points(TemplatePoint *points) {
+    const float radius = 0.30f;
+    int segments = ROUNDED_CORNER_SEGMENTS;
+    const float *circle = unit_circle(4 * ROUNDED_CORNER_SEGMENTS);
+    int count = 0;
     
-    // Route to appropriate block drawing function based on type
-    if (n->type == NODE_START) {
-        // Start node: green rounded rectangle
-        glColor3f(0.3f, 0.9f, 0.3f); // green for start
-        float radius = (n->width < n->height ? n->width : n->height) * 0.30f; // 25% of smaller dimension
-        draw_rounded_rectangle((float)n->x, (float)n->y, n->width, n->height, radius, true);
+    // Point k of the circle on the arc of the corner at (sx, sy); the arc's centre
+    // is radius in from both edges
+#define ADD_ARC_POINT(cornerX, cornerY, k) \
+    (points[count++] = corner_point((cornerX), (cornerY), \
+                                    ((cornerX) < 0.0f ? radius : -radius) + circle[(k) * 2] * radius, \
+                                    ((cornerY) < 0.0f ? radius : -radius) + circle[(k) * 2 + 1] * radius))
+    
+    // The corner arcs are quarters of one circle of 4 * segments points, walked
+    // clockwise
+    
+    // Top-left corner arc (from left edge to top edge)
+    for (int i = 0; i <= segments; ++i) {
+        ADD_ARC_POINT(-0.5f, 0.5f, segments * 2 - i);  // π to π/2
+    }
+    
+    // Top edge
+    points[count++] = corner_point(0.5f, 0.5f, -radius, 0.0f);
+    
+    // Top-right corner arc
+    for (int i = 1; i <= segments; ++i) {
+        ADD_ARC_POINT(0.5f, 0.5f, segments - i);  // π/2 to 0
+    }
+    
+    // Right edge
+    points[count++] = corner_point(0.5f, -0.5f, 0.0f, radius);
+    
+    // Bottom-right corner arc
+    for (int i = 1; i <= segments; ++i) {
+        ADD_ARC_POINT(0.5f, -0.5f, segments * 4 - i);  // 2π (0) to 3π/2
+    }
+    
+    // Bottom edge
+    points[count++] = corner_point(-0.5f, -0.5f, radius, 0.0f);
+    
+    // Bottom-left corner arc
+    for (int i = 1; i <= segments; ++i) {
+        ADD_ARC_POINT(-0.5f, -0.5f, segments * 3 - i);  // 3π/2 to π
+    }
+    
+    // Left edge
+    points[count++] = corner_point(-0.5f, 0.5f, 0.0f, -radius);
+    
+#undef ADD_ARC_POINT
+    return count;
+}
 
+// START / END terminal: rounded rectangle with a single connector at the top
+// (connectorSy 0.5) or bottom (-0.5)
+static void build_terminal_template(float connectorSy) {
+    TemplatePoint points[4 * (ROUNDED_CORNER_SEGMENTS + 2)];
+    int count = rounded_rectangle_points(points);
+    
+    scene_template_polygon(SCENE_FILLS, points, count);
+    
     // Border
-    glColor3f(0.2f, 0.2f, 0.0f);
-    draw_rounded_rectangle((float)n->x, (float)n->y, n->width, n->height, radius, false);
+    scene_color(0.2f, 0.2f, 0.0f);
+    scene_template_polygon(SCENE_BORDERS, points, count);
+    
+    scene_color(0.1f, 0.1f, 0.1f);
+    scene_template_circle(SCENE_CONNECTORS, (TemplatePoint){.sy = connectorSy}, 0.0f, 0.03f, 20);
+}
 
-        // Output connector (bottom) only
-    float r = 0.03f;
-        float cx = (float)n->x;
-        float cy = (float)(n->y - n->height * 0.5f);
-    glColor3f(0.1f, 0.1f, 0.1f);
-        glBegin(GL_TRIANGLE_FAN);
-        glVertex2f(cx, cy);
-        for (int i = 0; i <= 20; ++i) {
-            float a = (float)i / 20.0f * 6.2831853f;
-            glVertex2f(cx + cosf(a) * r, cy + sinf(a) * r);
-        }
-        glEnd();
-        
-        // Always draw "START" label centered in the block
-        float fontSize = n->height * 0.3f;
-        const char* labelText = "START";
-        float textWidth = get_text_width(labelText, fontSize);
-        float textX = n->x - textWidth * 0.5f;  // Center the text
-        float textY = n->y;
-        draw_text(textX, textY, labelText, fontSize, 0.0f, 0.0f, 0.0f);
+// Record the shapes of every node type, one template per NodeType
+static void build_node_templates(void) {
+    // Start node: output connector (bottom) only; end node: input connector (top) only
+    scene_template_begin(NODE_START, TEMPLATE_UNIT_SHORTER_SIDE);
+    build_terminal_template(-0.5f);
+    scene_template_end();
+    scene_template_begin(NODE_END, TEMPLATE_UNIT_SHORTER_SIDE);
+    build_terminal_template(0.5f);
+    scene_template_end();
+    
+    // NODE_NORMAL maps to PROCESS for backward compatibility
+    scene_template_begin(NODE_NORMAL, TEMPLATE_UNIT_WIDTH);
+    build_block_process_template();
+    scene_template_end();
+    scene_template_begin(NODE_PROCESS, TEMPLATE_UNIT_WIDTH);
+    build_block_process_template();
+    scene_template_end();
+    
+    static const struct {
+        NodeType type;
+        void (*build)(void);
+    } blocks[] = {
+        {NODE_INPUT, build_block_input_template},
+        {NODE_OUTPUT, build_block_output_template},
+        {NODE_ASSIGNMENT, build_block_assignment_template},
+        {NODE_DECLARE, build_block_declare_template},
+        {NODE_IF, build_block_if_template},
+        {NODE_CONVERGE, build_block_converge_template},
+        {NODE_CYCLE, build_block_cycle_template},
+        {NODE_CYCLE_END, build_block_cycle_end_template}
+    };
+    for (size_t i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++) {
+        scene_template_begin(blocks[i].type, TEMPLATE_UNIT_WIDTH);
+        blocks[i].build();
+        scene_template_end();
+    }
+}
+
+// Add the shapes of a node to the scene
+static void build_flow_node(const FlowNode *n) {
+    
+    // Route to appropriate block builder based on type
+    if (n->type == NODE_START) {
+        // Start node: green rounded rectangle
+        scene_color(0.3f, 0.9f, 0.3f);
+        scene_instance(NODE_START, (float)n->x, (float)n->y, n->width, n->height);
     } else if (n->type == NODE_END) {
         // End node: red rounded rectangle
-        glColor3f(0.9f, 0.3f, 0.3f); // red for end
-        float radius = (n->width < n->height ? n->width : n->height) * 0.30f; // 25% of smaller dimension
-        draw_rounded_rectangle((float)n->x, (float)n->y, n->width, n->height, radius, true);
-        
-        // Border
-        glColor3f(0.2f, 0.2f, 0.0f);
-        draw_rounded_rectangle((float)n->x, (float)n->y, n->width, n->height, radius, false);
-        
-        // Input connector (top) only
-        float r = 0.03f;
-        float cx = (float)n->x;
-        float cy = (float)(n->y + n->height * 0.5f);
-        glColor3f(0.1f, 0.1f, 0.1f);
-        glBegin(GL_TRIANGLE_FAN);
-        glVertex2f(cx, cy);
-        for (int i = 0; i <= 20; ++i) {
-            float a = (float)i / 20.0f * 6.2831853f;
-            glVertex2f(cx + cosf(a) * r, cy + sinf(a) * r);
-        }
-        glEnd();
-        
-        // Always draw "END" label centered in the block
+        scene_color(0.9f, 0.3f, 0.3f);
+        scene_instance(NODE_END, (float)n->x, (float)n->y, n->width, n->height);
+    } else if (n->type == NODE_PROCESS || n->type == NODE_NORMAL) {
+        // Process block (NODE_NORMAL maps to PROCESS for backward compatibility)
+        build_block_process(n);
+    } else if (n->type == NODE_INPUT) {
+        build_block_input(n);
+    } else if (n->type == NODE_OUTPUT) {
+        build_block_output(n);
+    } else if (n->type == NODE_ASSIGNMENT) {
+        build_block_assignment(n);
+    } else if (n->type == NODE_DECLARE) {
+        build_block_declare(n);
+    } else if (n->type == NODE_IF) {
+        build_block_if(n);
+    } else if (n->type == NODE_CONVERGE) {
+        build_block_converge(n);
+    } else if (n->type == NODE_CYCLE) {
+        build_block_cycle(n);
+    } else if (n->type == NODE_CYCLE_END) {
+        build_block_cycle_end(n);
+    }
+}
+
+// Draw the text of a node (shapes come from the scene)
+static void draw_flow_node_label(const FlowNode *n, const char *label) {
+    if (n->type == NODE_START || n->type == NODE_END) {
+        // Always draw "START" / "END" centered in the block
         float fontSize = n->height * 0.3f;
-        const char* labelText = "END";
+        const char* labelText = (n->type == NODE_START) ? "START" : "END";
         float textWidth = get_text_width(labelText, fontSize);
         float textX = n->x - textWidth * 0.5f;  // Center the text
         float textY = n->y;
         draw_text(textX, textY, labelText, fontSize, 0.0f, 0.0f, 0.0f);
     } else if (n->type == NODE_PROCESS || n->type == NODE_NORMAL) {
-        // Process block (NODE_NORMAL maps to PROCESS for backward compatibility)
-        draw_block_process(n);
+        draw_block_process_label(n, label);
     } else if (n->type == NODE_INPUT) {
-        draw_block_input(n);
+        draw_block_input_label(n, label);
     } else if (n->type == NODE_OUTPUT) {
-        draw_block_output(n);
+        draw_block_output_label(n, label);
     } else if (n->type == NODE_ASSIGNMENT) {
-        draw_block_assignment(n);
+        draw_block_assignment_label(n, label);
     } else if (n->type == NODE_DECLARE) {
-        draw_block_declare(n);
+        draw_block_declare_label(n, label);
     } else if (n->type == NODE_IF) {
-        draw_block_if(n);
-    } else if (n->type == NODE_CONVERGE) {
-        draw_block_converge(n);
+        draw_block_if_label(n, label);
     } else if (n->type == NODE_CYCLE) {
-        draw_block_cycle(n);
-    } else if (n->type == NODE_CYCLE_END) {
-        draw_block_cycle_end(n);
+        draw_block_cycle_label(n, label);
     }
 }
 
-static void draw_cycle_loopbacks(void) {
-    glLineWidth(2.5f);
+static void build_cycle_loopbacks(void) {
+    // Use an orange tone for loops
+    scene_color(0.95f, 0.6f, 0.15f);
+    
     for (int i = 0; i < cycleBlockCount; i++) {
         const CycleBlock *cycle = &cycleBlocks[i];
         if (cycle->cycleNodeIndex < 0 || cycle->cycleNodeIndex >= nodeCount ||
@@ -222,9 +220,6 @@ static void draw_cycle_loopbacks(void) {
         const FlowNode *loopNode = &nodes[cycle->cycleNodeIndex];
         const FlowNode *endNode = &nodes[cycle->cycleEndNodeIndex];
         
-        // Use an orange tone for loops
-        glColor3f(0.95f, 0.6f, 0.15f);
-        
         float offset = get_cycle_loopback_offset(i);
         
         // Start from the left side center of the cycle block
@@ -243,21 +238,168 @@ static void draw_cycle_loopbacks(void) {
             targetY = (float)(endNode->y - endNode->height * 0.5f);
         }
         
-        glBegin(GL_LINES);
-        // Horizontal from cycle block left side center to offset
-        glVertex2f(startX, startY);
-        glVertex2f(anchorX, startY);
-        // Vertical segment
-        glVertex2f(anchorX, startY);
-        glVertex2f(anchorX, targetY);
-        // Back to end block
-        glVertex2f(anchorX, targetY);
-        glVertex2f(targetX, targetY);
-        glEnd();
+        // Horizontal from cycle block left side center to offset, vertical
+        // segment, then back to end block
+        scene_line(SCENE_LOOPBACKS, startX, startY, anchorX, startY);
+        scene_line(SCENE_LOOPBACKS, anchorX, startY, anchorX, targetY);
+        scene_line(SCENE_LOOPBACKS, anchorX, targetY, targetX, targetY);
     }
-    glLineWidth(1.0f);
 }
 
+static bool templatesBuilt = false;
+
+// Rebuild the retained geometry of the chart: connection lines, loopback
+// brackets and every block. Runs only when flowchart_revision() has moved on.
+void buildFlowchartScene(void) {
+    if (!templatesBuilt) {
+        build_node_templates();
+        templatesBuilt = true;
+    }
+    scene_begin();
+    
+    // Connections as right-angle L-shapes, using the cached routes
+    scene_color(0.0f, 0.6f, 0.8f);  // Normal cyan
+    const ConnectionRoute *routes = get_connection_routes();
+    for (int i = 0; routes && i < connectionCount; ++i) {
+        const ConnectionRoute *route = &routes[i];
+        
+        // Skip cycle loopback connections (they're drawn as bracket lines)
+        if (route->kind == CONNECTION_LOOPBACK) {
+            continue;
+        }
+        for (int k = 1; k < route->pointCount; k++) {
+            scene_line(SCENE_CONNECTIONS, route->x[k - 1], route->y[k - 1], route->x[k], route->y[k]);
+        }
+    }
+    
+    // Decorative cycle loopback brackets
+    build_cycle_loopbacks();
+    
+    // One instance per block, placed in the layers by scene_end
+    for (int i = 0; i < nodeCount; ++i) {
+        if (!node_is_live(i)) continue;
+        build_flow_node(&nodes[i]);
+    }
+    
+    scene_end();
+}
+
+// Label layout cache, one entry per node slot: the glyph quads of the node's text
+// relative to its centre. A layout is reused until the label, type or size of the
+// node changes, or text comes out at a different size (text_metrics_generation);
+// moving a node only moves its quads.
+typedef struct {
+    int label;           // Label handle laid out, -1 = none
+    NodeType type;
+    float width;
+    float height;
+    int firstVertex;     // In the current layout buffer
+    int vertexCount;
+} NodeLabelLayout;
+
+static NodeLabelLayout *labelLayouts = NULL;
+static int labelLayoutCapacity = 0;
+static TextBuffer layoutBuffers[2];     // Node-relative quads of this build and the last
+static int currentLayoutBuffer = 0;
+static unsigned int layoutMetrics = 0;
+
+// Every label placed in the chart, in world coordinates, drawn in cell order
+static TextBuffer chartLabels;
+static SpatialIndex chartLabelCells;
+static VertexArray chartLabelArray;
+
+static bool grow_label_layouts(int needed) {
+    if (needed <= labelLayoutCapacity) return true;
+    
+    int newCapacity = labelLayoutCapacity > 0 ? labelLayoutCapacity : 256;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    NodeLabelLayout *grown = realloc(labelLayouts, (size_t)newCapacity * sizeof(NodeLabelLayout));
+    if (!grown) {
+        fprintf(stderr, "Out of memory growing label layouts to %d nodes\n", newCapacity);
+        return false;
+    }
+    for (int i = labelLayoutCapacity; i < newCapacity; i++) {
+        grown[i].label = -1;
+    }
+    labelLayouts = grown;
+    labelLayoutCapacity = newCapacity;
+    return true;
+}
+
+// Rebuild the label quads of the chart, laying out only the labels whose node
+// changed since the last build
+static void build_labels(void) {
+    bool metricsChanged = (layoutMetrics != text_metrics_generation());
+    layoutMetrics = text_metrics_generation();
+    if (!grow_label_layouts(nodeCount)) return;
+    
+    const TextBuffer *previous = &layoutBuffers[currentLayoutBuffer];
+    TextBuffer *layouts = &layoutBuffers[1 - currentLayoutBuffer];
+    layouts->count = 0;
+    chartLabels.count = 0;
+    spatial_index_begin(&chartLabelCells);
+    
+    for (int i = 0; i < nodeCount; ++i) {
+        NodeLabelLayout *layout = &labelLayouts[i];
+        const FlowNode *n = &nodes[i];
+        if (!node_is_live(i)) {
+            layout->label = -1;
+            continue;
+        }
+        
+        int first = layouts->count;
+        if (!metricsChanged && layout->label == n->label && layout->type == n->type &&
+            layout->width == n->width && layout->height == n->height) {
+            TextVertex *v = reserve_text_vertices(layouts, layout->vertexCount);
+            if (v) {
+                memcpy(v, &previous->vertices[layout->firstVertex], (size_t)layout->vertexCount * sizeof(TextVertex));
+            }
+        } else {
+            // Lay the label out around the origin
+            FlowNode centred = *n;
+            centred.x = 0.0;
+            centred.y = 0.0;
+            text_renderer_capture(layouts);
+            draw_flow_node_label(&centred, node_label(i));
+            text_renderer_capture(NULL);
+            layout->label = n->label;
+            layout->type = n->type;
+            layout->width = n->width;
+            layout->height = n->height;
+        }
+        layout->firstVertex = first;
+        layout->vertexCount = layouts->count - first;
+        
+        int firstPlaced = chartLabels.count;
+        TextVertex *placed = reserve_text_vertices(&chartLabels, layout->vertexCount);
+        if (!placed) {
+            layout->label = -1;
+            continue;
+        }
+        float reachX = 0.0f, reachY = 0.0f;
+        for (int k = 0; k < layout->vertexCount; k++) {
+            placed[k] = layouts->vertices[first + k];
+            if (fabsf(placed[k].x) > reachX) reachX = fabsf(placed[k].x);
+            if (fabsf(placed[k].y) > reachY) reachY = fabsf(placed[k].y);
+            placed[k].x += (float)n->x;
+            placed[k].y += (float)n->y;
+        }
+        spatial_index_add(&chartLabelCells, (float)n->x, (float)n->y, reachX, reachY, firstPlaced, layout->vertexCount);
+    }
+    
+    currentLayoutBuffer = 1 - currentLayoutBuffer;
+    const void *sorted = spatial_index_sort(&chartLabelCells, chartLabels.vertices, chartLabels.count, sizeof(TextVertex));
+    vertex_array_upload(&chartLabelArray, sorted, chartLabels.count, sizeof(TextVertex));
+}
+
+// Revision of the chart the scene and the labels were last built from
+static bool sceneBuilt = false;
+static unsigned int sceneRevision = 0;
+static bool labelsBuilt = false;
+static unsigned int labelsRevision = 0;
+
 void drawFlowchart(GLFWwindow* window) {
     
     // Apply scroll transformation (both horizontal and vertical)
@@ -277,227 +419,71 @@ void drawFlowchart(GLFWwindow* window) {
     text_renderer_set_scroll_offsets((float)scrollOffsetX, (float)scrollOffsetY);
     text_renderer_set_flowchart_scale(FLOWCHART_SCALE);
     
-    // Draw connections as right-angle L-shapes
+    // Part of the chart on screen: the projection spans [-aspect, aspect] x [-1, 1]
+    // and screen = FLOWCHART_SCALE * world - scrollOffset
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+    float aspectRatio = height > 0 ? (float)width / (float)height : 1.0f;
+    WorldRect view = {
+        (float)((-aspectRatio + scrollOffsetX) / FLOWCHART_SCALE),
+        (float)((-1.0 + scrollOffsetY) / FLOWCHART_SCALE),
+        (float)((aspectRatio + scrollOffsetX) / FLOWCHART_SCALE),
+        (float)((1.0 + scrollOffsetY) / FLOWCHART_SCALE)
+    };
+    
+    if (!sceneBuilt || sceneRevision != flowchart_revision()) {
+        FRAME_PHASE_BEGIN(FRAME_PHASE_SCENE_BUILD);
+        buildFlowchartScene();
+        sceneBuilt = true;
+        sceneRevision = flowchart_revision();
+        FRAME_PHASE_END(FRAME_PHASE_SCENE_BUILD);
+    }
+    
+    FRAME_PHASE_BEGIN(FRAME_PHASE_CONNECTIONS);
     glLineWidth(3.0f);
-    for (int i = 0; i < connectionCount; ++i) {
-        // Skip drawing cycle loopback connections (they're drawn as bracket lines)
-        if (is_cycle_loopback(i)) {
-            continue;
-        }
-        
-        const FlowNode *from = &nodes[connections[i].fromNode];
-        const FlowNode *to   = &nodes[connections[i].toNode];
-        
-        // Highlight hovered connection
-        if (i == hoveredConnection) {
-            glColor3f(1.0f, 0.8f, 0.0f);  // Bright orange/yellow glow
-        } else {
-            glColor3f(0.0f, 0.6f, 0.8f);  // Normal cyan
-        }
-        
-        // Determine if this is an IF branch connection
-        int branchType = get_if_branch_type(i);
-        
-        if (branchType == 0) {
-            // True branch (exits left side of IF block)
-            float x1 = (float)(from->x - from->width * 0.5f);  // Left side of diamond
-            float y1 = (float)from->y;  // Middle of diamond
-
-            int ifBlockIdx = -1;
-            for (int j = 0; j < ifBlockCount; j++) {
-                if (ifBlocks[j].ifNodeIndex == connections[i].fromNode) {
-                    ifBlockIdx = j;
-                    break;
-                }
-            }
-            double branchWidth = (ifBlockIdx >= 0) ? ifBlocks[ifBlockIdx].leftBranchWidth : 1.0;
-            
-            // Target depends on whether it's a convergence point
-            float x2, y2;
-            if (to->type == NODE_CONVERGE) {
-                // Connect to left side of convergence
-                x2 = (float)(to->x - to->width * 0.5f);
-                y2 = (float)to->y;
-            } else {
-                // Connect to top of normal block
-                x2 = (float)to->x;
-                y2 = (float)(to->y + to->height * 0.5f);
-            }
-            
-            // Route: exit left -> go to branch column center -> down -> arrive at target
-            float branchX = (float)(from->x - branchWidth);  // Dynamic branch width
-            
-            glBegin(GL_LINES);
-            // Horizontal segment: from IF left to branch column center
-            glVertex2f(x1, y1);
-            glVertex2f(branchX, y1);
-            // Vertical segment: down to target Y level
-            glVertex2f(branchX, y1);
-            glVertex2f(branchX, y2);
-            // Horizontal segment: from branch column to target
-            glVertex2f(branchX, y2);
-            glVertex2f(x2, y2);
-            glEnd();
-            
-        } else if (branchType == 1) {
-            // False branch (exits right side of IF block)
-            float x1 = (float)(from->x + from->width * 0.5f);  // Right side of diamond
-            float y1 = (float)from->y;  // Middle of diamond
-
-            int ifBlockIdx = -1;
-            for (int j = 0; j < ifBlockCount; j++) {
-                if (ifBlocks[j].ifNodeIndex == connections[i].fromNode) {
-                    ifBlockIdx = j;
-                    break;
-                }
-            }
-            double branchWidth = (ifBlockIdx >= 0) ? ifBlocks[ifBlockIdx].rightBranchWidth : 1.0;
-            
-            // Target depends on whether it's a convergence point
-            float x2, y2;
-            if (to->type == NODE_CONVERGE) {
-                // Connect to right side of convergence
-                x2 = (float)(to->x + to->width * 0.5f);
-                y2 = (float)to->y;
-            } else {
-                // Connect to top of normal block
-                x2 = (float)to->x;
-                y2 = (float)(to->y + to->height * 0.5f);
-            }
-            
-            // Route: exit right -> go to branch column center -> down -> arrive at target
-            float branchX = (float)(from->x + branchWidth);  // Dynamic branch width
-            
-            glBegin(GL_LINES);
-            // Horizontal segment: from IF right to branch column center
-            glVertex2f(x1, y1);
-            glVertex2f(branchX, y1);
-            // Vertical segment: down to target Y level
-            glVertex2f(branchX, y1);
-            glVertex2f(branchX, y2);
-            // Horizontal segment: from branch column to target
-            glVertex2f(branchX, y2);
-            glVertex2f(x2, y2);
-            glEnd();
-            
-        } else {
-            // Normal connection (not an IF branch)
-            // Check if both nodes are in the same branch (non-zero branchColumn and equal)
-            bool sameBranch = (from->branchColumn != 0 && from->branchColumn == to->branchColumn);
-            
-            float x1 = (float)from->x;
-            // For cycle end blocks, use radius (width/2) instead of height/2 for connector position
-            float y1;
-            if (from->type == NODE_CYCLE_END) {
-                float fromRadius = from->width * 0.5f;
-                y1 = (float)(from->y - fromRadius);
-            } else {
-                y1 = (float)(from->y - from->height * 0.5f);
-            }
-            
-            float x2 = (float)to->x;
-            // For cycle end blocks, use radius (width/2) instead of height/2 for connector position
-            float y2;
-            if (to->type == NODE_CYCLE_END) {
-                float toRadius = to->width * 0.5f;
-                y2 = (float)(to->y + toRadius);
-            } else {
-                y2 = (float)(to->y + to->height * 0.5f);
-            }
-            
-            
-            // Special handling for connections TO convergence point from branch blocks
-            // This includes nodes in branches (branchColumn != 0) OR nodes that are owned by an IF (nested IF false branches can have branchColumn=0)
-            if (to->type == NODE_CONVERGE && (from->branchColumn != 0 || from->owningIfBlock >= 0)) {
-                // Source is in a branch, target is convergence
-                // Route: from block bottom -> stay in branch column -> horizontal to convergence side
-                float branchX = (float)from->x;  // Stay in branch column
-                
-                // Determine which side of convergence to connect to based on FROM's branchColumn
-                // relative to the convergence's branchColumn (for nested IFs)
-                float convergeX;
-                int connectSide = -1; // 0=left, 1=right
-                if (to->branchColumn == 0) {
-                    // Convergence is in main branch - use from's branchColumn
-                    if (from->branchColumn < 0) {
-                        convergeX = (float)(to->x - to->width * 0.5f);
-                        connectSide = 0;
-                    } else {
-                        convergeX = (float)(to->x + to->width * 0.5f);
-                        connectSide = 1;
-                    }
-                } else {
-                    // Convergence is in a branch (nested IF)
-                    // Connect based on whether from is LEFT or RIGHT of the convergence
-                    if (from->branchColumn < to->branchColumn) {
-                        // From is MORE negative (further left) - connect to left side
-                        convergeX = (float)(to->x - to->width * 0.5f);
-                        connectSide = 0;
-                    } else {
-                        // From is MORE positive (further right) - connect to right side
-                        convergeX = (float)(to->x + to->width * 0.5f);
-                        connectSide = 1;
-                    }
-                }
-                float convergeY = (float)to->y;
-                
-                glBegin(GL_LINES);
-                // Vertical segment: down in branch column
-                glVertex2f(x1, y1);
-                glVertex2f(branchX, convergeY);
-                // Horizontal segment: to convergence side
-                glVertex2f(branchX, convergeY);
-                glVertex2f(convergeX, convergeY);
-                glEnd();
-            } else if (sameBranch) {
-                // Both in same branch - draw vertical line
-                glBegin(GL_LINES);
-                glVertex2f(x1, y1);
-                glVertex2f(x2, y2);
-                glEnd();
-            } else {
-                // Different branches or normal routing
-                
-                // Handle different connection shapes
-        if (fabs(x1 - x2) < 0.001f) {
-            // Same X: vertical line only
+    FRAME_COUNT(FRAME_COUNT_STATE_CHANGES, 1);
+    scene_draw_layer(SCENE_CONNECTIONS, &view);
+    
+    // Highlight hovered connection on top of its line in the scene
+    const ConnectionRoute *routes = get_connection_routes();
+    if (routes && hoveredConnection >= 0 && hoveredConnection < connectionCount &&
+        routes[hoveredConnection].kind != CONNECTION_LOOPBACK) {
+        const ConnectionRoute *route = &routes[hoveredConnection];
+        glColor3f(1.0f, 0.8f, 0.0f);  // Bright orange/yellow glow
         glBegin(GL_LINES);
-        glVertex2f(x1, y1);
-        glVertex2f(x2, y2);
-        glEnd();
-        } else if (fabs(y1 - y2) < 0.001f) {
-            // Same Y: horizontal line only
-            glBegin(GL_LINES);
-            glVertex2f(x1, y1);
-            glVertex2f(x2, y2);
-            glEnd();
-        } else {
-            // Different X and Y: L-shape (horizontal then vertical)
-            float midX = x2;  // Horizontal segment goes to target X
-            float midY = y1;  // Vertical segment starts from source Y
-            
-            glBegin(GL_LINES);
-            // Horizontal segment: from source to (target X, source Y)
-            glVertex2f(x1, y1);
-            glVertex2f(midX, midY);
-            // Vertical segment: from (target X, source Y) to target
-            glVertex2f(midX, midY);
-            glVertex2f(x2, y2);
-            glEnd();
-                }
-            }
+        for (int k = 1; k < route->pointCount; k++) {
+            glVertex2f(route->x[k - 1], route->y[k - 1]);
+            glVertex2f(route->x[k], route->y[k]);
         }
+        glEnd();
     }
     
-    // Draw decorative cycle loopback brackets
-    draw_cycle_loopbacks();
+    // Decorative cycle loopback brackets
+    glLineWidth(2.5f);
+    FRAME_COUNT(FRAME_COUNT_STATE_CHANGES, 1);
+    scene_draw_layer(SCENE_LOOPBACKS, &view);
+    FRAME_PHASE_END(FRAME_PHASE_CONNECTIONS);
     
+    // Blocks: all bodies, then all outlines, then all connectors (only those on screen)
+    FRAME_PHASE_BEGIN(FRAME_PHASE_NODES);
     glLineWidth(1.0f);
+    FRAME_COUNT(FRAME_COUNT_STATE_CHANGES, 1);
+    scene_draw_layer(SCENE_FILLS, &view);
+    scene_draw_layer(SCENE_BORDERS, &view);
+    scene_draw_layer(SCENE_CONNECTORS, &view);
+    FRAME_PHASE_END(FRAME_PHASE_NODES);
 
-    // Draw nodes (block labels will use scroll offsets set above)
-    for (int i = 0; i < nodeCount; ++i) {
-        drawFlowNode(&nodes[i]);
+    // Block labels
+    FRAME_PHASE_BEGIN(FRAME_PHASE_TEXT);
+    if (!labelsBuilt || labelsRevision != flowchart_revision() || layoutMetrics != text_metrics_generation()) {
+        build_labels();
+        labelsBuilt = true;
+        labelsRevision = flowchart_revision();
     }
+    const VertexRange *labelRanges;
+    int labelRangeCount = spatial_index_query(&chartLabelCells, &view, &labelRanges);
+    draw_text_array(&chartLabelArray, labelRanges, labelRangeCount);
+    FRAME_PHASE_END(FRAME_PHASE_TEXT);
     
     glPopMatrix();
     
@@ -600,6 +586,7 @@ void drawPopupMenu(GLFWwindow* window) {
             draw_text(textX, textY, menuText, fontSize, 1.0f, 1.0f, 1.0f);
         }
     }
+    flush_text();
 }
 
 
@@ -713,7 +700,11 @@ static void draw_right_arrow(float centerX, float centerY, float size, float r,
     glEnd();
 }
 
+// Segments in the outline of a round button
+#define BUTTON_CIRCLE_SEGMENTS 20
+
 void drawButtons(GLFWwindow* window) {
+    FRAME_PHASE_BEGIN(FRAME_PHASE_BUTTONS);
     int width, height;
     glfwGetWindowSize(window, &width, &height);
     float aspectRatio = (float)width / (float)height;
@@ -722,6 +713,9 @@ void drawButtons(GLFWwindow* window) {
     // buttonX was -0.95 in old system (-1 to 1), now map to same visual position
     float buttonX_scaled = buttonX * aspectRatio;
     
+    // Button outline, shared by all of them
+    const float *buttonCircle = unit_circle(BUTTON_CIRCLE_SEGMENTS);
+    
     // Icon size and darkening factor
     float iconSize = buttonRadius * 1.2f;
     float darkenFactor = 0.6f;  // Make icon darker than button
@@ -741,10 +735,9 @@ void drawButtons(GLFWwindow* window) {
     }
     glBegin(GL_TRIANGLE_FAN);
     glVertex2f(buttonX_scaled, closeButtonY);
-    for (int i = 0; i <= 20; ++i) {
-        float angle = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(buttonX_scaled + cosf(angle) * buttonRadius, 
-                   closeButtonY + sinf(angle) * buttonRadius);
+    for (int i = 0; i <= BUTTON_CIRCLE_SEGMENTS; ++i) {
+        glVertex2f(buttonX_scaled + buttonCircle[i * 2] * buttonRadius, 
+                   closeButtonY + buttonCircle[i * 2 + 1] * buttonRadius);
     }
     glEnd();
     
@@ -755,10 +748,9 @@ void drawButtons(GLFWwindow* window) {
         glColor3f(0.5f, 0.1f, 0.1f);
     }
     glBegin(GL_LINE_LOOP);
-    for (int i = 0; i <= 20; ++i) {
-        float angle = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(buttonX_scaled + cosf(angle) * buttonRadius, 
-                   closeButtonY + sinf(angle) * buttonRadius);
+    for (int i = 0; i <= BUTTON_CIRCLE_SEGMENTS; ++i) {
+        glVertex2f(buttonX_scaled + buttonCircle[i * 2] * buttonRadius, 
+                   closeButtonY + buttonCircle[i * 2 + 1] * buttonRadius);
     }
     glEnd();
     
@@ -809,10 +801,9 @@ void drawButtons(GLFWwindow* window) {
     }
     glBegin(GL_TRIANGLE_FAN);
     glVertex2f(buttonX_scaled, saveButtonY);
-    for (int i = 0; i <= 20; ++i) {
-        float angle = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(buttonX_scaled + cosf(angle) * buttonRadius, 
-                   saveButtonY + sinf(angle) * buttonRadius);
+    for (int i = 0; i <= BUTTON_CIRCLE_SEGMENTS; ++i) {
+        glVertex2f(buttonX_scaled + buttonCircle[i * 2] * buttonRadius, 
+                   saveButtonY + buttonCircle[i * 2 + 1] * buttonRadius);
     }
     glEnd();
     
@@ -823,10 +814,9 @@ void drawButtons(GLFWwindow* window) {
         glColor3f(0.1f, 0.2f, 0.5f);
     }
     glBegin(GL_LINE_LOOP);
-    for (int i = 0; i <= 20; ++i) {
-        float angle = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(buttonX_scaled + cosf(angle) * buttonRadius, 
-                   saveButtonY + sinf(angle) * buttonRadius);
+    for (int i = 0; i <= BUTTON_CIRCLE_SEGMENTS; ++i) {
+        glVertex2f(buttonX_scaled + buttonCircle[i * 2] * buttonRadius, 
+                   saveButtonY + buttonCircle[i * 2 + 1] * buttonRadius);
     }
     glEnd();
     
@@ -844,10 +834,9 @@ void drawButtons(GLFWwindow* window) {
     }
     glBegin(GL_TRIANGLE_FAN);
     glVertex2f(buttonX_scaled, loadButtonY);
-    for (int i = 0; i <= 20; ++i) {
-        float angle = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(buttonX_scaled + cosf(angle) * buttonRadius, 
-                   loadButtonY + sinf(angle) * buttonRadius);
+    for (int i = 0; i <= BUTTON_CIRCLE_SEGMENTS; ++i) {
+        glVertex2f(buttonX_scaled + buttonCircle[i * 2] * buttonRadius, 
+                   loadButtonY + buttonCircle[i * 2 + 1] * buttonRadius);
     }
     glEnd();
     
@@ -858,10 +847,9 @@ void drawButtons(GLFWwindow* window) {
         glColor3f(0.5f, 0.5f, 0.1f);
     }
     glBegin(GL_LINE_LOOP);
-    for (int i = 0; i <= 20; ++i) {
-        float angle = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(buttonX_scaled + cosf(angle) * buttonRadius, 
-                   loadButtonY + sinf(angle) * buttonRadius);
+    for (int i = 0; i <= BUTTON_CIRCLE_SEGMENTS; ++i) {
+        glVertex2f(buttonX_scaled + buttonCircle[i * 2] * buttonRadius, 
+                   loadButtonY + buttonCircle[i * 2 + 1] * buttonRadius);
     }
     glEnd();
     
@@ -981,10 +969,9 @@ void drawButtons(GLFWwindow* window) {
     }
     glBegin(GL_TRIANGLE_FAN);
     glVertex2f(buttonX_scaled, exportButtonY);
-    for (int i = 0; i <= 20; ++i) {
-        float angle = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(buttonX_scaled + cosf(angle) * buttonRadius, 
-                   exportButtonY + sinf(angle) * buttonRadius);
+    for (int i = 0; i <= BUTTON_CIRCLE_SEGMENTS; ++i) {
+        glVertex2f(buttonX_scaled + buttonCircle[i * 2] * buttonRadius, 
+                   exportButtonY + buttonCircle[i * 2 + 1] * buttonRadius);
     }
     glEnd();
     
@@ -995,10 +982,9 @@ void drawButtons(GLFWwindow* window) {
         glColor3f(0.15f, 0.5f, 0.15f);
     }
     glBegin(GL_LINE_LOOP);
-    for (int i = 0; i <= 20; ++i) {
-        float angle = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(buttonX_scaled + cosf(angle) * buttonRadius, 
-                   exportButtonY + sinf(angle) * buttonRadius);
+    for (int i = 0; i <= BUTTON_CIRCLE_SEGMENTS; ++i) {
+        glVertex2f(buttonX_scaled + buttonCircle[i * 2] * buttonRadius, 
+                   exportButtonY + buttonCircle[i * 2 + 1] * buttonRadius);
     }
     glEnd();
     
@@ -1053,10 +1039,9 @@ void drawButtons(GLFWwindow* window) {
     }
     glBegin(GL_TRIANGLE_FAN);
     glVertex2f(buttonX_scaled, undoButtonY);
-    for (int i = 0; i <= 20; ++i) {
-        float angle = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(buttonX_scaled + cosf(angle) * buttonRadius, 
-                   undoButtonY + sinf(angle) * buttonRadius);
+    for (int i = 0; i <= BUTTON_CIRCLE_SEGMENTS; ++i) {
+        glVertex2f(buttonX_scaled + buttonCircle[i * 2] * buttonRadius, 
+                   undoButtonY + buttonCircle[i * 2 + 1] * buttonRadius);
     }
     glEnd();
     
@@ -1070,10 +1055,9 @@ void drawButtons(GLFWwindow* window) {
         glColor3f(undoBorderR, undoBorderG, undoBorderB);
     }
     glBegin(GL_LINE_LOOP);
-    for (int i = 0; i <= 20; ++i) {
-        float angle = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(buttonX_scaled + cosf(angle) * buttonRadius, 
-                   undoButtonY + sinf(angle) * buttonRadius);
+    for (int i = 0; i <= BUTTON_CIRCLE_SEGMENTS; ++i) {
+        glVertex2f(buttonX_scaled + buttonCircle[i * 2] * buttonRadius, 
+                   undoButtonY + buttonCircle[i * 2 + 1] * buttonRadius);
     }
     glEnd();
     
@@ -1095,10 +1079,9 @@ void drawButtons(GLFWwindow* window) {
     }
     glBegin(GL_TRIANGLE_FAN);
     glVertex2f(buttonX_scaled, redoButtonY);
-    for (int i = 0; i <= 20; ++i) {
-        float angle = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(buttonX_scaled + cosf(angle) * buttonRadius, 
-                   redoButtonY + sinf(angle) * buttonRadius);
+    for (int i = 0; i <= BUTTON_CIRCLE_SEGMENTS; ++i) {
+        glVertex2f(buttonX_scaled + buttonCircle[i * 2] * buttonRadius, 
+                   redoButtonY + buttonCircle[i * 2 + 1] * buttonRadius);
     }
     glEnd();
     
@@ -1112,10 +1095,9 @@ void drawButtons(GLFWwindow* window) {
         glColor3f(redoBorderR, redoBorderG, redoBorderB);
     }
     glBegin(GL_LINE_LOOP);
-    for (int i = 0; i <= 20; ++i) {
-        float angle = (float)i / 20.0f * 6.2831853f;
-        glVertex2f(buttonX_scaled + cosf(angle) * buttonRadius, 
-                   redoButtonY + sinf(angle) * buttonRadius);
+    for (int i = 0; i <= BUTTON_CIRCLE_SEGMENTS; ++i) {
+        glVertex2f(buttonX_scaled + buttonCircle[i * 2] * buttonRadius, 
+                   redoButtonY + buttonCircle[i * 2 + 1] * buttonRadius);
     }
     glEnd();
     
@@ -1190,4 +1172,8 @@ void drawButtons(GLFWwindow* window) {
         float textY = labelY - fontSize * 0.25f;
         draw_text(textX, textY, "REDO", fontSize, 1.0f, 1.0f, 1.0f);
     }
+    
+    FRAME_STATS_DRAW_OVERLAY(aspectRatio);
+    flush_text();
+    FRAME_PHASE_END(FRAME_PHASE_BUTTONS);
 }
@@ -3,8 +3,8 @@
 
 #include <GLFW/glfw3.h>
 
-void drawFlowNode(const FlowNode *n);
 void drawFlowchart(GLFWwindow* window);
+void buildFlowchartScene(void);
 void drawPopupMenu(GLFWwindow* window);
 void drawButtons(GLFWwindow* window);
 
@@ -0,0 +1,803 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <pthread.h>
+#endif
+#include "flowchart_state.h"
+#include "undo_journal.h"
+#include "edit_journal.h"
+
+#define JOURNAL_MAGIC 0x4A574C46u   // "FLWJ"
+#define JOURNAL_VERSION 1
+
+// stdio buffer of the open journal file
+#define JOURNAL_BUFFER_SIZE (64 * 1024)
+
+// Start of the journal file: the document save it continues from, and the record
+// sizes of the build that wrote it (records are stored as raw structs)
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int recordSizes[UNDO_TABLE_COUNT];
+    unsigned int padding;          // Zero; keeps the struct free of hidden padding
+    unsigned long long baseHash;   // Hash of the saved document's bytes
+    long long baseSize;
+} JournalHeader;
+
+// Each entry is this header followed by `size` bytes of payload:
+//   int counts[UNDO_TABLE_COUNT]             array lengths after the edit
+//   int labelCount, then per label:          handle, length, text (no terminator)
+//   UndoChange + records, until the end      new contents of the changed records
+// Handles are only meaningful inside their entry: every node record's label is
+// listed, so replay maps them to handles of its own label pool.
+typedef struct {
+    unsigned int size;
+    unsigned int checksum;     // Low bits of the payload's hash
+} JournalEntry;
+
+#define JOURNAL_PATH_SIZE 1100
+
+static char journalPath[JOURNAL_PATH_SIZE];
+static char compactPath[JOURNAL_PATH_SIZE + 8];
+static bool journalOpen = false;
+static FILE *journalFile = NULL;    // NULL while only a compaction can hold new entries
+static JournalHeader header;
+static bool unflushed = false;
+static bool unsynced = false;
+static double lastSync = 0.0;
+static size_t bytesSinceCheckpoint = 0;
+static size_t checkpointSize = 0;
+static bool checkpointNextEntry = false;  // Live records are numbered unlike the saved file
+
+// Entry being built (reused between edits)
+static unsigned char *entry = NULL;
+static size_t entrySize = 0;
+static size_t entryCapacity = 0;
+static UndoChange *runs = NULL;
+static int runCapacity = 0;
+
+// Labels already listed in the entry being built: labelStamp[handle] == stampClock
+static unsigned int *labelStamp = NULL;
+static int labelStampCapacity = 0;
+static unsigned int stampClock = 0;
+
+// Replay: journal label handle -> handle in this session's label pool
+static int *labelMap = NULL;
+static int labelMapCapacity = 0;
+static char *labelText = NULL;
+static size_t labelTextCapacity = 0;
+
+// Compaction: the writer thread puts compactData (header and checkpoint) in
+// compactPath; entries logged meanwhile wait in pending until it is renamed over
+// the journal
+static bool compacting = false;
+static unsigned char *compactData = NULL;
+static size_t compactSize = 0;
+static size_t compactCapacity = 0;
+static unsigned char *pending = NULL;
+static size_t pendingSize = 0;
+static size_t pendingCapacity = 0;
+static atomic_int compactDone = 0;  // Set by the writer thread once compactOk is final
+static bool compactOk = false;
+static bool compactThreadRunning = false;
+#ifdef _WIN32
+static HANDLE compactThread = NULL;
+#else
+static pthread_t compactThread;
+#endif
+
+// FNV-1a over 8-byte words (then the bytes left over), continued from `hash`.
+// Word steps keep hashing a large document or checkpoint cheap.
+static unsigned long long hash_bytes(unsigned long long hash, const unsigned char *data, size_t size) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        unsigned long long word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+#define HASH_START 14695981039346656037ull
+
+static bool hash_document(const char *path, unsigned long long *hash, long long *size) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    unsigned char buffer[64 * 1024];
+    size_t got;
+    *hash = HASH_START;
+    *size = 0;
+    while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        *hash = hash_bytes(*hash, buffer, got);
+        *size += (long long)got;
+    }
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+static bool reserve_bytes(unsigned char **buffer, size_t *capacity, size_t needed) {
+    if (needed <= *capacity) {
+        return true;
+    }
+    size_t newCapacity = *capacity > 0 ? *capacity : 4096;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    unsigned char *grown = realloc(*buffer, newCapacity);
+    if (!grown) {
+        fprintf(stderr, "Out of memory growing edit journal buffer to %zu bytes\n", newCapacity);
+        return false;
+    }
+    *buffer = grown;
+    *capacity = newCapacity;
+    return true;
+}
+
+static bool append_bytes(const void *data, size_t size) {
+    if (!reserve_bytes(&entry, &entryCapacity, entrySize + size)) {
+        return false;
+    }
+    memcpy(entry + entrySize, data, size);
+    entrySize += size;
+    return true;
+}
+
+// Write buffered data through to the disk
+static bool sync_file(FILE *file) {
+    if (fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+static bool replace_file(const char *from, const char *to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+static FILE* open_for_append(const char *path) {
+    FILE *file = fopen(path, "ab");
+    if (file) {
+        setvbuf(file, NULL, _IOFBF, JOURNAL_BUFFER_SIZE);
+    }
+    return file;
+}
+
+// List a label in the entry unless it already is
+static bool append_label(int label) {
+    if (label <= 0) {
+        return true;
+    }
+    if (label >= labelStampCapacity) {
+        int newCapacity = labelStampCapacity > 0 ? labelStampCapacity : 1024;
+        while (newCapacity <= label) {
+            newCapacity *= 2;
+        }
+        unsigned int *grown = realloc(labelStamp, (size_t)newCapacity * sizeof(unsigned int));
+        if (!grown) {
+            fprintf(stderr, "Out of memory growing edit journal label stamps\n");
+            return false;
+        }
+        memset(grown + labelStampCapacity, 0, (size_t)(newCapacity - labelStampCapacity) * sizeof(unsigned int));
+        labelStamp = grown;
+        labelStampCapacity = newCapacity;
+    }
+    if (labelStamp[label] == stampClock) {
+        return true;
+    }
+    labelStamp[label] = stampClock;
+
+    const char *text = label_text(label);
+    int length = (int)strlen(text);
+    return append_bytes(&label, sizeof(label)) &&
+           append_bytes(&length, sizeof(length)) &&
+           append_bytes(text, (size_t)length);
+}
+
+// Build an entry holding the live contents of the given runs. Runs may reach past
+// the live array (records an edit removed); only the part that exists is written.
+static bool build_entry(const UndoChange *changes, int changeCount) {
+    entrySize = 0;
+    JournalEntry blank = { 0, 0 };
+    if (!append_bytes(&blank, sizeof(blank))) {
+        return false;
+    }
+
+    int counts[UNDO_TABLE_COUNT];
+    for (int t = 0; t < UNDO_TABLE_COUNT; t++) {
+        undo_live_records(t, &counts[t]);
+    }
+    if (!append_bytes(counts, sizeof(counts))) {
+        return false;
+    }
+
+    // Every label the node records use, each listed once
+    if (++stampClock == 0 && labelStamp) {
+        memset(labelStamp, 0, (size_t)labelStampCapacity * sizeof(unsigned int));
+        stampClock = 1;
+    }
+    size_t labelCountOffset = entrySize;
+    int labelCount = 0;
+    if (!append_bytes(&labelCount, sizeof(labelCount))) {
+        return false;
+    }
+    for (int c = 0; c < changeCount; c++) {
+        if (changes[c].table != UNDO_NODES) {
+            continue;
+        }
+        int end = changes[c].index + changes[c].count;
+        if (end > nodeCount) end = nodeCount;
+        for (int i = changes[c].index; i < end; i++) {
+            size_t before = entrySize;
+            if (!append_label(nodes[i].label)) {
+                return false;
+            }
+            if (entrySize != before) {
+                labelCount++;
+            }
+        }
+    }
+    memcpy(entry + labelCountOffset, &labelCount, sizeof(labelCount));
+
+    for (int c = 0; c < changeCount; c++) {
+        UndoChange change = changes[c];
+        int liveCount;
+        const unsigned char *records = undo_live_records(change.table, &liveCount);
+        if (change.index + change.count > liveCount) {
+            change.count = liveCount - change.index;
+        }
+        if (change.count <= 0) {
+            continue;
+        }
+        size_t size = undo_record_size(change.table);
+        if (!append_bytes(&change, sizeof(change)) ||
+            !append_bytes(records + (size_t)change.index * size, (size_t)change.count * size)) {
+            return false;
+        }
+    }
+
+    JournalEntry entryHeader = { (unsigned int)(entrySize - sizeof(JournalEntry)), 0 };
+    entryHeader.checksum = (unsigned int)hash_bytes(HASH_START, entry + sizeof(JournalEntry), entryHeader.size);
+    memcpy(entry, &entryHeader, sizeof(entryHeader));
+    return true;
+}
+
+static void write_compaction(void) {
+    FILE *file = fopen(compactPath, "wb");
+    bool ok = file != NULL;
+    if (ok) {
+        ok = fwrite(compactData, 1, compactSize, file) == compactSize && sync_file(file);
+        if (fclose(file) != 0) {
+            ok = false;
+        }
+    }
+    compactOk = ok;
+    atomic_store(&compactDone, 1);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI compact_thread(LPVOID param) {
+    (void)param;
+    write_compaction();
+    return 0;
+}
+#else
+static void* compact_thread(void *param) {
+    (void)param;
+    write_compaction();
+    return NULL;
+}
+#endif
+
+static void wait_for_compaction(void) {
+    if (!compactThreadRunning) {
+        return;
+    }
+#ifdef _WIN32
+    WaitForSingleObject(compactThread, INFINITE);
+    CloseHandle(compactThread);
+#else
+    pthread_join(compactThread, NULL);
+#endif
+    compactThreadRunning = false;
+}
+
+// Rewrite the journal as a checkpoint of the live chart. The checkpoint is built
+// here (label text must be read on this thread); the writer thread only does the
+// file work.
+static void start_compaction(void) {
+    UndoChange all[UNDO_TABLE_COUNT];
+    for (int t = 0; t < UNDO_TABLE_COUNT; t++) {
+        all[t].table = t;
+        all[t].index = 0;
+        undo_live_records(t, &all[t].count);
+    }
+    if (!build_entry(all, UNDO_TABLE_COUNT) ||
+        !reserve_bytes(&compactData, &compactCapacity, sizeof(header) + entrySize)) {
+        return;
+    }
+    memcpy(compactData, &header, sizeof(header));
+    memcpy(compactData + sizeof(header), entry, entrySize);
+    compactSize = sizeof(header) + entrySize;
+    checkpointSize = entrySize;
+    pendingSize = 0;
+    bytesSinceCheckpoint = 0;
+    compacting = true;
+    atomic_store(&compactDone, 0);
+
+#ifdef _WIN32
+    compactThread = CreateThread(NULL, 0, compact_thread, NULL, 0, NULL);
+    compactThreadRunning = compactThread != NULL;
+#else
+    compactThreadRunning = pthread_create(&compactThread, NULL, compact_thread, NULL) == 0;
+#endif
+    if (!compactThreadRunning) {
+        write_compaction();
+    }
+}
+
+// Append the entries logged during the compaction to its file and put it in place
+// of the journal
+static void finish_compaction(void) {
+    wait_for_compaction();
+    compacting = false;
+
+    bool ok = compactOk;
+    FILE *file = ok ? fopen(compactPath, "ab") : NULL;
+    ok = file != NULL && fwrite(pending, 1, pendingSize, file) == pendingSize && sync_file(file);
+    if (file && fclose(file) != 0) {
+        ok = false;
+    }
+    if (ok) {
+        if (journalFile) {
+            fclose(journalFile);
+            journalFile = NULL;
+        }
+        ok = replace_file(compactPath, journalPath);
+    }
+    if (!ok) {
+        remove(compactPath);
+        fprintf(stderr, "Failed to compact edit journal %s\n", journalPath);
+        if (!journalFile) {
+            journalOpen = false;
+        }
+        return;
+    }
+
+    journalFile = open_for_append(journalPath);
+    if (!journalFile) {
+        fprintf(stderr, "Failed to reopen edit journal %s\n", journalPath);
+        journalOpen = false;
+        return;
+    }
+    bytesSinceCheckpoint = pendingSize;
+    unflushed = false;
+    unsynced = false;
+}
+
+void edit_journal_log_step(const unsigned char *changes, size_t size) {
+    if (!journalOpen || size == 0) {
+        return;
+    }
+    if (checkpointNextEntry && !compacting) {
+        // Replay starts from the file's numbering, which the records of this
+        // step do not use; a checkpoint of the chart (this edit included) does
+        checkpointNextEntry = false;
+        start_compaction();
+        return;
+    }
+
+    // Collect the run headers; the step's own records are not needed
+    int changeCount = 0;
+    size_t offset = 0;
+    while (offset < size) {
+        if (changeCount >= runCapacity) {
+            int newCapacity = runCapacity > 0 ? runCapacity * 2 : 64;
+            UndoChange *grown = realloc(runs, (size_t)newCapacity * sizeof(UndoChange));
+            if (!grown) {
+                fprintf(stderr, "Out of memory journaling an edit\n");
+                return;
+            }
+            runs = grown;
+            runCapacity = newCapacity;
+        }
+        memcpy(&runs[changeCount], changes + offset, sizeof(UndoChange));
+        offset += sizeof(UndoChange) + (size_t)runs[changeCount].count * undo_record_size(runs[changeCount].table);
+        changeCount++;
+    }
+    if (!build_entry(runs, changeCount)) {
+        return;
+    }
+
+    if (journalFile && fwrite(entry, 1, entrySize, journalFile) != entrySize) {
+        fprintf(stderr, "Failed to write edit journal %s\n", journalPath);
+        fclose(journalFile);
+        journalFile = NULL;
+    } else if (journalFile) {
+        unflushed = true;
+        unsynced = true;
+    }
+    if (!journalFile && !compacting) {
+        // Start over from a checkpoint of the chart, which includes this edit
+        start_compaction();
+        return;
+    }
+    if (compacting) {
+        if (reserve_bytes(&pending, &pendingCapacity, pendingSize + entrySize)) {
+            memcpy(pending + pendingSize, entry, entrySize);
+            pendingSize += entrySize;
+        }
+    }
+
+    bytesSinceCheckpoint += entrySize;
+    if (!compacting && bytesSinceCheckpoint > EDIT_JOURNAL_COMPACT_BYTES &&
+        bytesSinceCheckpoint > checkpointSize) {
+        start_compaction();
+    }
+}
+
+void edit_journal_tick(double now) {
+    if (compacting && atomic_load(&compactDone)) {
+        finish_compaction();
+        lastSync = now;
+    }
+    if (!journalFile) {
+        return;
+    }
+    if (unflushed) {
+        fflush(journalFile);
+        unflushed = false;
+    }
+    if (unsynced && now - lastSync >= EDIT_JOURNAL_SYNC_INTERVAL) {
+        sync_file(journalFile);
+        unsynced = false;
+        lastSync = now;
+    }
+}
+
+double edit_journal_next_tick(double now) {
+    if (compacting) {
+        // The thread does not wake the main loop, so look in on it now and then
+        return atomic_load(&compactDone) ? 0.0 : EDIT_JOURNAL_COMPACT_POLL;
+    }
+    if (!journalFile) {
+        return -1.0;
+    }
+    if (unflushed) {
+        return 0.0;
+    }
+    if (unsynced) {
+        double due = lastSync + EDIT_JOURNAL_SYNC_INTERVAL - now;
+        return due > 0.0 ? due : 0.0;
+    }
+    return -1.0;
+}
+
+static bool set_journal_paths(const char *documentPath) {
+    int length = snprintf(journalPath, sizeof(journalPath), "%s%s", documentPath, EDIT_JOURNAL_SUFFIX);
+    if (length < 0 || length + 4 >= (int)sizeof(journalPath)) {
+        fprintf(stderr, "Path too long for an edit journal: %s\n", documentPath);
+        return false;
+    }
+    snprintf(compactPath, sizeof(compactPath), "%s.tmp", journalPath);
+    return true;
+}
+
+static bool make_journal_header(JournalHeader *result, const char *documentPath) {
+    memset(result, 0, sizeof(*result));
+    result->magic = JOURNAL_MAGIC;
+    result->version = JOURNAL_VERSION;
+    for (int t = 0; t < UNDO_TABLE_COUNT; t++) {
+        result->recordSizes[t] = (unsigned int)undo_record_size(t);
+    }
+    if (!hash_document(documentPath, &result->baseHash, &result->baseSize)) {
+        fprintf(stderr, "Failed to read %s for its edit journal\n", documentPath);
+        return false;
+    }
+    return true;
+}
+
+static bool map_label(int handle, const unsigned char *text, int length) {
+    if (handle >= labelMapCapacity) {
+        int newCapacity = labelMapCapacity > 0 ? labelMapCapacity : 1024;
+        while (newCapacity <= handle) {
+            newCapacity *= 2;
+        }
+        int *grown = realloc(labelMap, (size_t)newCapacity * sizeof(int));
+        if (!grown) {
+            fprintf(stderr, "Out of memory replaying edit journal labels\n");
+            return false;
+        }
+        labelMap = grown;
+        labelMapCapacity = newCapacity;
+    }
+    if (!reserve_bytes((unsigned char**)&labelText, &labelTextCapacity, (size_t)length + 1)) {
+        return false;
+    }
+    memcpy(labelText, text, (size_t)length);
+    labelText[length] = '\0';
+    labelMap[handle] = intern_label(labelText);
+    return true;
+}
+
+// Apply one entry's records to the live arrays (counts and derived indexes are
+// fixed up by the caller once all entries are in)
+static bool apply_entry(const unsigned char *data, size_t size) {
+    const unsigned char *end = data + size;
+    int counts[UNDO_TABLE_COUNT];
+    int labelCount;
+    if (size < sizeof(counts) + sizeof(labelCount)) {
+        return false;
+    }
+    memcpy(counts, data, sizeof(counts));
+    data += sizeof(counts);
+    for (int t = 0; t < UNDO_TABLE_COUNT; t++) {
+        if (counts[t] < 0) {
+            return false;
+        }
+    }
+    if (counts[UNDO_VARIABLES] > MAX_VARIABLES ||
+        !ensure_node_capacity(counts[UNDO_NODES]) ||
+        !ensure_connection_capacity(counts[UNDO_CONNECTIONS]) ||
+        !ensure_if_block_capacity(counts[UNDO_IF_BLOCKS]) ||
+        !ensure_cycle_block_capacity(counts[UNDO_CYCLE_BLOCKS])) {
+        return false;
+    }
+
+    memcpy(&labelCount, data, sizeof(labelCount));
+    data += sizeof(labelCount);
+    for (int i = 0; i < labelCount; i++) {
+        int handle, length;
+        if (end - data < (long)(2 * sizeof(int))) {
+            return false;
+        }
+        memcpy(&handle, data, sizeof(handle));
+        memcpy(&length, data + sizeof(handle), sizeof(length));
+        data += 2 * sizeof(int);
+        if (handle <= 0 || length < 0 || end - data < length || !map_label(handle, data, length)) {
+            return false;
+        }
+        data += length;
+    }
+
+    while (data < end) {
+        UndoChange change;
+        if (end - data < (long)sizeof(change)) {
+            return false;
+        }
+        memcpy(&change, data, sizeof(change));
+        data += sizeof(change);
+        if (change.table < 0 || change.table >= UNDO_TABLE_COUNT || change.index < 0 ||
+            change.count <= 0 || change.count > counts[change.table] - change.index) {
+            return false;
+        }
+        size_t recordSize = undo_record_size(change.table);
+        size_t bytes = (size_t)change.count * recordSize;
+        if ((size_t)(end - data) < bytes) {
+            return false;
+        }
+        int liveCount;
+        unsigned char *records = undo_live_records(change.table, &liveCount);
+        memcpy(records + (size_t)change.index * recordSize, data, bytes);
+        data += bytes;
+
+        if (change.table == UNDO_NODES) {
+            for (int i = change.index; i < change.index + change.count; i++) {
+                int label = nodes[i].label;
+                nodes[i].label = (label > 0 && label < labelMapCapacity) ? labelMap[label] : 0;
+            }
+        }
+    }
+
+    nodeCount = counts[UNDO_NODES];
+    connectionCount = counts[UNDO_CONNECTIONS];
+    ifBlockCount = counts[UNDO_IF_BLOCKS];
+    cycleBlockCount = counts[UNDO_CYCLE_BLOCKS];
+    variableCount = counts[UNDO_VARIABLES];
+    return true;
+}
+
+// Replay the journal at journalPath if it continues from `expected`. Returns the
+// entries applied (-1 if the journal is missing or for another save) and where the
+// valid part of the file ends.
+static int replay_journal_file(const JournalHeader *expected, long *validEnd) {
+    *validEnd = 0;
+    FILE *file = fopen(journalPath, "rb");
+    if (!file) {
+        return -1;
+    }
+    unsigned char *data = NULL;
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        size = ftell(file);
+    }
+    if (size >= (long)sizeof(JournalHeader) && fseek(file, 0, SEEK_SET) == 0) {
+        data = malloc((size_t)size);
+        if (data && fread(data, 1, (size_t)size, file) != (size_t)size) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+    if (!data) {
+        return -1;
+    }
+    if (memcmp(data, expected, sizeof(JournalHeader)) != 0) {
+        free(data);
+        return -1;
+    }
+
+    // Apply entries up to the first one that is cut off or fails its checksum
+    int applied = 0;
+    long offset = (long)sizeof(JournalHeader);
+    while (size - offset >= (long)sizeof(JournalEntry)) {
+        JournalEntry entryHeader;
+        memcpy(&entryHeader, data + offset, sizeof(entryHeader));
+        long payload = offset + (long)sizeof(entryHeader);
+        if ((unsigned long)(size - payload) < entryHeader.size ||
+            (unsigned int)hash_bytes(HASH_START, data + payload, entryHeader.size) != entryHeader.checksum ||
+            !apply_entry(data + payload, entryHeader.size)) {
+            break;
+        }
+        offset = payload + (long)entryHeader.size;
+        applied++;
+    }
+    free(data);
+    *validEnd = offset;
+
+    if (applied > 0) {
+        rebuild_free_node_slots();
+        invalidate_adjacency();
+        invalidate_block_index();
+        mark_flowchart_changed();
+    }
+    return applied;
+}
+
+int edit_journal_replay(const char *documentPath) {
+    JournalHeader expected;
+    long validEnd;
+    if (journalOpen || !set_journal_paths(documentPath) || !make_journal_header(&expected, documentPath)) {
+        return -1;
+    }
+    return replay_journal_file(&expected, &validEnd);
+}
+
+// Cut a torn tail off the journal so new entries follow the last valid one
+static bool truncate_journal(long size) {
+#ifdef _WIN32
+    FILE *file = fopen(journalPath, "r+b");
+    if (!file) {
+        return false;
+    }
+    bool ok = _chsize(_fileno(file), size) == 0;
+    fclose(file);
+    return ok;
+#else
+    return truncate(journalPath, (off_t)size) == 0;
+#endif
+}
+
+// Whether the save numbered records differently from the live arrays: it leaves
+// out free node and block slots and removed connections
+static bool live_layout_has_gaps(void) {
+    if (live_node_count() != nodeCount) {
+        return true;
+    }
+    for (int i = 0; i < connectionCount; i++) {
+        if (!connection_is_live(i)) {
+            return true;
+        }
+    }
+    for (int i = 0; i < ifBlockCount; i++) {
+        if (!if_block_is_live(i)) {
+            return true;
+        }
+    }
+    for (int i = 0; i < cycleBlockCount; i++) {
+        if (!cycle_block_is_live(i)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Start a journal holding only the header: nothing to replay on top of the document
+static void start_empty_journal(void) {
+    journalFile = fopen(journalPath, "wb");
+    if (journalFile) {
+        setvbuf(journalFile, NULL, _IOFBF, JOURNAL_BUFFER_SIZE);
+        if (fwrite(&header, sizeof(header), 1, journalFile) != 1 || !sync_file(journalFile)) {
+            fclose(journalFile);
+            journalFile = NULL;
+        }
+    }
+    if (!journalFile) {
+        fprintf(stderr, "Failed to open edit journal %s\n", journalPath);
+        journalOpen = false;
+    }
+}
+
+int edit_journal_open(const char *documentPath, bool afterSave) {
+    edit_journal_close(false);
+    if (!set_journal_paths(documentPath) || !make_journal_header(&header, documentPath)) {
+        return 0;
+    }
+
+    journalOpen = true;
+    bytesSinceCheckpoint = 0;
+    checkpointSize = 0;
+    unflushed = false;
+    unsynced = false;
+    checkpointNextEntry = false;
+
+    if (afterSave) {
+        // The save holds everything journaled so far, so only edits made after it
+        // belong in the journal
+        checkpointNextEntry = live_layout_has_gaps();
+        start_empty_journal();
+        return 0;
+    }
+
+    long validEnd;
+    int replayed = replay_journal_file(&header, &validEnd);
+    if (replayed > 0) {
+        printf("Recovered %d unsaved edits from %s\n", replayed, journalPath);
+        if (truncate_journal(validEnd)) {
+            journalFile = open_for_append(journalPath);
+        }
+        if (!journalFile) {
+            // The recovered edits are only in memory now; checkpoint them
+            start_compaction();
+        }
+        return replayed;
+    }
+
+    start_empty_journal();
+    return 0;
+}
+
+void edit_journal_close(bool keepFile) {
+    if (compacting) {
+        if (keepFile) {
+            finish_compaction();
+        } else {
+            wait_for_compaction();
+            compacting = false;
+            remove(compactPath);
+        }
+    }
+    if (journalFile) {
+        if (keepFile) {
+            sync_file(journalFile);
+        }
+        fclose(journalFile);
+        journalFile = NULL;
+    }
+    if (journalOpen && !keepFile) {
+        remove(journalPath);
+    }
+    journalOpen = false;
+    unflushed = false;
+    unsynced = false;
+}
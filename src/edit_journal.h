@@ -0,0 +1,62 @@
+#ifndef EDIT_JOURNAL_H
+#define EDIT_JOURNAL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Appended to the document path to name its journal
+#define EDIT_JOURNAL_SUFFIX ".journal"
+
+// Seconds between fsyncs of the journal while edits keep coming
+#define EDIT_JOURNAL_SYNC_INTERVAL 1.0
+
+// Seconds between checks for a finished compaction while it runs
+#define EDIT_JOURNAL_COMPACT_POLL 0.05
+
+// Journal bytes written since the last checkpoint before it is compacted (the
+// journal may also grow to the size of the checkpoint itself)
+#define EDIT_JOURNAL_COMPACT_BYTES (4 * 1024 * 1024)
+
+// Crash journal (edit_journal.c)
+// While a document is open, every recorded edit, undo and redo is appended to
+// "<document>.journal" as the records it changed, in the undo step layout, with
+// the text of the labels those records use. Writes are buffered and reach the
+// file once per frame (edit_journal_tick); the file is fsynced at most every
+// EDIT_JOURNAL_SYNC_INTERVAL seconds. Each entry carries a checksum, so a write
+// torn by a crash is dropped on replay along with everything after it.
+// The journal header names the document save it continues from (size and hash of
+// the file). After a load or a save the journal starts out empty, and a journal
+// left over for the loaded file is replayed on top of it first. A save leaves out
+// free node slots and removed connections; if it left any out, the first edit
+// after it is journaled as a checkpoint of the chart. Once it has grown
+// past EDIT_JOURNAL_COMPACT_BYTES it is rewritten as a single checkpoint of the chart.
+// The checkpoint is written and fsynced to "<journal>.tmp" by a background thread
+// and then renamed over the journal. A clean exit removes the journal.
+
+// Start journaling for a document that was just saved (afterSave: the journal is
+// emptied, the save holds every edit so far) or just loaded (a journal left by a
+// session that did not exit cleanly is replayed first). Closes any open journal.
+// Returns the number of journaled edits replayed.
+int edit_journal_open(const char *documentPath, bool afterSave);
+
+// Stop journaling; the journal file is removed unless keepFile is set
+void edit_journal_close(bool keepFile);
+
+// Apply the journal next to a document on top of the chart loaded from it.
+// Returns the number of edits applied, or -1 if there is no journal for this
+// save of the document.
+int edit_journal_replay(const char *documentPath);
+
+// Append the changes of an undo step that was just recorded, undone or redone
+// (called by undo_journal.c; the live arrays hold the contents to write)
+void edit_journal_log_step(const unsigned char *changes, size_t size);
+
+// Per-frame work: hand buffered entries to the OS, fsync when due and finish a
+// compaction once its thread is done. now is in seconds (glfwGetTime).
+void edit_journal_tick(double now);
+
+// Seconds from now until edit_journal_tick has work to do (0 = at once), or a
+// negative value if nothing is waiting. An idle editor sleeps until then.
+double edit_journal_next_tick(double now);
+
+#endif // EDIT_JOURNAL_H
@@ -5,6 +5,8 @@
 #include <math.h>
 #include "flowchart_state.h"
 #include "text_renderer.h"
+#include "undo_journal.h"
+#include "edit_journal.h"
 
 // Forward declarations for helper functions (defined in main.c)
 double snap_to_grid_x(double x);
@@ -13,7 +15,6 @@ float calculate_block_width(const char* text, float fontSize, float minWidth);
 void update_all_branch_positions(void);
 void reposition_convergence_point(int ifBlockIndex, bool shouldPushNodesBelow);
 void rebuild_variable_table(void);
-void save_state_for_undo(void);
 
 // Grid helper functions (needed by load_flowchart)
 static double grid_to_world_x(int gridX) {
@@ -36,85 +37,152 @@ static int world_to_grid_y(double y) {
     return (int)round(y / GRID_CELL_SIZE);
 }
 
+// Make room for at least `needed` characters in the label read buffer
+static bool ensure_label_buffer(char **label, size_t *capacity, size_t needed) {
+    if (needed <= *capacity) {
+        return true;
+    }
+    size_t newCapacity = *capacity > 0 ? *capacity : MAX_VALUE_LENGTH;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    char *grown = realloc(*label, newCapacity);
+    if (!grown) {
+        fprintf(stderr, "Out of memory reading a block value\n");
+        return false;
+    }
+    *label = grown;
+    *capacity = newCapacity;
+    return true;
+}
+
+// File index of a node slot (free slots are not written), -1 if out of range
+static int saved_node_index(const int* slotToFile, int nodeIndex) {
+    if (nodeIndex < 0 || nodeIndex >= nodeCount) {
+        return -1;
+    }
+    return slotToFile[nodeIndex];
+}
+
 void save_flowchart(const char* filename) {
+    // Deleted nodes and blocks leave free slots behind; number the live ones
+    // 0..n-1 in the file
+    int* slotToFile = malloc((size_t)(nodeCount + 1) * sizeof(int));
+    int* ifBlockToFile = malloc((size_t)(ifBlockCount + 1) * sizeof(int));
+    int* cycleBlockToFile = malloc((size_t)(cycleBlockCount + 1) * sizeof(int));
+    if (!slotToFile || !ifBlockToFile || !cycleBlockToFile) {
+        fprintf(stderr, "Out of memory while saving %s\n", filename);
+        free(slotToFile);
+        free(ifBlockToFile);
+        free(cycleBlockToFile);
+        return;
+    }
+    int savedNodeCount = 0;
+    for (int i = 0; i < nodeCount; i++) {
+        slotToFile[i] = node_is_live(i) ? savedNodeCount++ : -1;
+    }
+    int savedIfBlockCount = 0;
+    for (int i = 0; i < ifBlockCount; i++) {
+        ifBlockToFile[i] = if_block_is_live(i) ? savedIfBlockCount++ : -1;
+    }
+    int savedCycleBlockCount = 0;
+    for (int i = 0; i < cycleBlockCount; i++) {
+        cycleBlockToFile[i] = cycle_block_is_live(i) ? savedCycleBlockCount++ : -1;
+    }
+    
     FILE* file = fopen(filename, "w");
     if (!file) {
         fprintf(stderr, "Failed to open file for writing: %s\n", filename);
+        free(slotToFile);
+        free(ifBlockToFile);
+        free(cycleBlockToFile);
         return;
     }
     
     // Write header
-    fprintf(file, "# Flowchart adjacency matrix\n");
-    fprintf(file, "# Nodes: %d\n", nodeCount);
-    fprintf(file, "%d\n", nodeCount);
+    fprintf(file, "# Flowchart edge list\n");
+    fprintf(file, "# Nodes: %d\n", savedNodeCount);
+    fprintf(file, "%d\n", savedNodeCount);
     
-    // Create adjacency matrix
-    for (int i = 0; i < nodeCount; i++) {
-        for (int j = 0; j < nodeCount; j++) {
-            int connected = 0;
-            // Check if there's a connection from i to j
-            for (int k = 0; k < connectionCount; k++) {
-                if (connections[k].fromNode == i && connections[k].toNode == j) {
-                    connected = 1;
-                    break;
-                }
-            }
-            fprintf(file, "%d", connected);
-            if (j < nodeCount - 1) fprintf(file, " ");
+    // Write connections as "from to" pairs, in connection order
+    // (the order matters: an IF's first outgoing edge to its convergence is the true branch)
+    // Removed entries are left out
+    int savedEdgeCount = 0;
+    for (int i = 0; i < connectionCount; i++) {
+        if (connection_is_live(i)) {
+            savedEdgeCount++;
         }
-        fprintf(file, "\n");
+    }
+    fprintf(file, "# Edges: %d\n", savedEdgeCount);
+    for (int i = 0; i < connectionCount; i++) {
+        if (!connection_is_live(i)) {
+            continue;
+        }
+        fprintf(file, "%d %d\n",
+                saved_node_index(slotToFile, connections[i].fromNode),
+                saved_node_index(slotToFile, connections[i].toNode));
     }
     
     // Write node data
     fprintf(file, "# Node data: x y width height type \"value_string\"\n");
     for (int i = 0; i < nodeCount; i++) {
-        // Escape quotes in value string
-        char escaped_value[MAX_VALUE_LENGTH * 2]; // Worst case: all chars are quotes
-        int j = 0;
-        for (int k = 0; nodes[i].value[k] != '\0' && j < (int)(sizeof(escaped_value) - 1); k++) {
-            if (nodes[i].value[k] == '"') {
-                escaped_value[j++] = '\\';
-            }
-            escaped_value[j++] = nodes[i].value[k];
+        if (slotToFile[i] < 0) {
+            continue;
         }
-        escaped_value[j] = '\0';
         
-        fprintf(file, "%.6f %.6f %.6f %.6f %d \"%s\"\n",
+        fprintf(file, "%.6f %.6f %.6f %.6f %d \"",
                 nodes[i].x, nodes[i].y, nodes[i].width, nodes[i].height,
-                (int)nodes[i].type, escaped_value);
+                (int)nodes[i].type);
+        
+        // Write the value string with quotes escaped (labels have no length limit)
+        for (const char *p = node_label(i); *p != '\0'; p++) {
+            if (*p == '"') {
+                fputc('\\', file);
+            }
+            fputc(*p, file);
+        }
+        fprintf(file, "\"\n");
     }
     
     // Write IF blocks data
-    fprintf(file, "# IF Blocks: %d\n", ifBlockCount);
+    fprintf(file, "# IF Blocks: %d\n", savedIfBlockCount);
     for (int i = 0; i < ifBlockCount; i++) {
+        if (ifBlockToFile[i] < 0) {
+            continue;
+        }
+        int parent = ifBlocks[i].parentIfIndex;
         fprintf(file, "%d %d %d %d %d %d\n",
-                ifBlocks[i].ifNodeIndex,
-                ifBlocks[i].convergeNodeIndex,
-                ifBlocks[i].parentIfIndex,
+                saved_node_index(slotToFile, ifBlocks[i].ifNodeIndex),
+                saved_node_index(slotToFile, ifBlocks[i].convergeNodeIndex),
+                if_block_is_live(parent) ? ifBlockToFile[parent] : -1,
                 ifBlocks[i].branchColumn,
                 ifBlocks[i].trueBranchCount,
                 ifBlocks[i].falseBranchCount);
         
         // Write true branch nodes (always write a newline, even if empty)
-        for (int j = 0; j < ifBlocks[i].trueBranchCount; j++) {
-            fprintf(file, "%d ", ifBlocks[i].trueBranchNodes[j]);
+        for (int n = first_if_branch_node(&ifBlocks[i], 0); n >= 0; n = next_if_branch_node(n)) {
+            fprintf(file, "%d ", saved_node_index(slotToFile, n));
         }
         fprintf(file, "\n");  // Always write newline, even for empty branches
         
         // Write false branch nodes (always write a newline, even if empty)
-        for (int j = 0; j < ifBlocks[i].falseBranchCount; j++) {
-            fprintf(file, "%d ", ifBlocks[i].falseBranchNodes[j]);
+        for (int n = first_if_branch_node(&ifBlocks[i], 1); n >= 0; n = next_if_branch_node(n)) {
+            fprintf(file, "%d ", saved_node_index(slotToFile, n));
         }
         fprintf(file, "\n");  // Always write newline, even for empty branches
     }
 
     // Write Cycle blocks data
-    fprintf(file, "# Cycle Blocks: %d\n", cycleBlockCount);
+    fprintf(file, "# Cycle Blocks: %d\n", savedCycleBlockCount);
     for (int i = 0; i < cycleBlockCount; i++) {
+        if (cycleBlockToFile[i] < 0) {
+            continue;
+        }
+        int parent = cycleBlocks[i].parentCycleIndex;
         fprintf(file, "%d %d %d %d %.3f\n",
-                cycleBlocks[i].cycleNodeIndex,
-                cycleBlocks[i].cycleEndNodeIndex,
-                cycleBlocks[i].parentCycleIndex,
+                saved_node_index(slotToFile, cycleBlocks[i].cycleNodeIndex),
+                saved_node_index(slotToFile, cycleBlocks[i].cycleEndNodeIndex),
+                cycle_block_is_live(parent) ? cycleBlockToFile[parent] : -1,
                 (int)cycleBlocks[i].cycleType,
                 cycleBlocks[i].loopbackOffset);
         fprintf(file, "%s|%s|%s\n",
@@ -124,10 +192,17 @@ void save_flowchart(const char* filename) {
     }
     
     fclose(file);
+    free(slotToFile);
+    free(ifBlockToFile);
+    free(cycleBlockToFile);
     printf("Flowchart saved to %s\n", filename);
+    undo_journal_set_saved(true);
+    
+    // Edits from here on are journaled next to the file in case the editor dies
+    edit_journal_open(filename, true);
 }
 
-// Load flowchart from adjacency matrix
+// Load flowchart from an edge list (or the older adjacency matrix format)
 void load_flowchart(const char* filename) {
     FILE* file = fopen(filename, "r");
     if (!file) {
@@ -145,24 +220,87 @@ void load_flowchart(const char* filename) {
         }
     }
     
-    if (loadedNodeCount <= 0 || loadedNodeCount > MAX_NODES) {
+    if (loadedNodeCount <= 0) {
         fprintf(stderr, "Invalid node count: %d\n", loadedNodeCount);
         fclose(file);
         return;
     }
     
-    // Read adjacency matrix
-    int adjMatrix[MAX_NODES][MAX_NODES] = {0};
-    for (int i = 0; i < loadedNodeCount; i++) {
-        for (int j = 0; j < loadedNodeCount; j++) {
-            if (fscanf(file, "%d", &adjMatrix[i][j]) != 1) {
-                fprintf(stderr, "Error reading adjacency matrix\n");
+    // Read connections into a temporary edge buffer (applied once the nodes are loaded)
+    Connection *loadedEdges = NULL;
+    int loadedEdgeCount = 0;
+    long edgesPos = ftell(file);
+    if (fgets(line, sizeof(line), file) && strncmp(line, "# Edges:", 8) == 0) {
+        // Edge list format: "# Edges: E" followed by E "from to" lines
+        int edgeTotal = 0;
+        sscanf(line + 8, "%d", &edgeTotal);
+        if (edgeTotal < 0) edgeTotal = 0;
+        loadedEdges = malloc((size_t)(edgeTotal + 1) * sizeof(Connection));
+        if (!loadedEdges) {
+            fprintf(stderr, "Out of memory reading %d edges\n", edgeTotal);
+            fclose(file);
+            return;
+        }
+        for (int i = 0; i < edgeTotal; i++) {
+            int fromNode, toNode;
+            if (fscanf(file, "%d %d", &fromNode, &toNode) != 2) {
+                fprintf(stderr, "Error reading edge list\n");
+                free(loadedEdges);
                 fclose(file);
                 return;
             }
+            if (fromNode >= 0 && fromNode < loadedNodeCount && toNode >= 0 && toNode < loadedNodeCount) {
+                loadedEdges[loadedEdgeCount].fromNode = fromNode;
+                loadedEdges[loadedEdgeCount].toNode = toNode;
+                loadedEdgeCount++;
+            }
+        }
+    } else {
+        // Older files store an N x N adjacency matrix; read it row by row
+        fseek(file, edgesPos, SEEK_SET);
+        int edgeCapacity = loadedNodeCount + 1;
+        loadedEdges = malloc((size_t)edgeCapacity * sizeof(Connection));
+        if (!loadedEdges) {
+            fprintf(stderr, "Out of memory reading adjacency matrix\n");
+            fclose(file);
+            return;
+        }
+        for (int i = 0; i < loadedNodeCount; i++) {
+            for (int j = 0; j < loadedNodeCount; j++) {
+                int connected;
+                if (fscanf(file, "%d", &connected) != 1) {
+                    fprintf(stderr, "Error reading adjacency matrix\n");
+                    free(loadedEdges);
+                    fclose(file);
+                    return;
+                }
+                if (!connected) {
+                    continue;
+                }
+                if (loadedEdgeCount == edgeCapacity) {
+                    Connection *grown = realloc(loadedEdges, (size_t)edgeCapacity * 2 * sizeof(Connection));
+                    if (!grown) {
+                        fprintf(stderr, "Out of memory reading adjacency matrix\n");
+                        free(loadedEdges);
+                        fclose(file);
+                        return;
+                    }
+                    loadedEdges = grown;
+                    edgeCapacity *= 2;
+                }
+                loadedEdges[loadedEdgeCount].fromNode = i;
+                loadedEdges[loadedEdgeCount].toNode = j;
+                loadedEdgeCount++;
+            }
         }
     }
     
+    if (!ensure_node_capacity(loadedNodeCount) || !ensure_connection_capacity(loadedEdgeCount)) {
+        free(loadedEdges);
+        fclose(file);
+        return;
+    }
+    
     // Skip comment line
     while (fgets(line, sizeof(line), file)) {
         if (line[0] == '#') break;
@@ -170,6 +308,9 @@ void load_flowchart(const char* filename) {
     
     // Read node data
     nodeCount = 0;
+    rebuild_free_node_slots();
+    char *label = NULL;          // Value string being read, grown as needed
+    size_t labelCapacity = 0;
     for (int i = 0; i < loadedNodeCount; i++) {
         int nodeType;
         double x, y;
@@ -178,9 +319,14 @@ void load_flowchart(const char* filename) {
         // Read x, y, width, height, type
         if (fscanf(file, "%lf %lf %f %f %d", &x, &y, &width, &height, &nodeType) != 5) {
             fprintf(stderr, "Error reading node data\n");
+            free(label);
+            free(loadedEdges);
             fclose(file);
             return;
         }
+        if (!ensure_label_buffer(&label, &labelCapacity, 1)) {
+            break;
+        }
         
         // Skip whitespace before quoted string
         int c;
@@ -188,19 +334,19 @@ void load_flowchart(const char* filename) {
         
         if (c == '"') {
             // Read quoted string
-            int j = 0;
+            size_t j = 0;
             bool escaped = false;
-            while (j < MAX_VALUE_LENGTH - 1) {
+            while (ensure_label_buffer(&label, &labelCapacity, j + 2)) {
                 c = fgetc(file);
                 if (c == EOF) break;
                 
                 if (escaped) {
                     if (c == '"') {
-                        nodes[i].value[j++] = '"';
+                        label[j++] = '"';
                     } else if (c == '\\') {
-                        nodes[i].value[j++] = '\\';
+                        label[j++] = '\\';
                     } else {
-                        nodes[i].value[j++] = c;
+                        label[j++] = c;
                     }
                     escaped = false;
                 } else if (c == '\\') {
@@ -209,16 +355,16 @@ void load_flowchart(const char* filename) {
                     // End of quoted string
                     break;
                 } else {
-                    nodes[i].value[j++] = c;
+                    label[j++] = c;
                 }
             }
-            nodes[i].value[j] = '\0';
+            label[j] = '\0';
             
             // Skip rest of line
             while ((c = fgetc(file)) != EOF && c != '\n');
         } else {
             // Old format or no value - set empty string
-            nodes[i].value[0] = '\0';
+            label[0] = '\0';
             // If we read something that wasn't a quote, it might be old format value
             // Try to read it as integer for backward compatibility
             if (c != EOF && c != '\n') {
@@ -235,9 +381,13 @@ void load_flowchart(const char* filename) {
         nodes[i].y = snap_to_grid_y(y);
         nodes[i].height = height;
         nodes[i].type = (NodeType)nodeType;
+        set_node_label(i, label);
         // Initialize branch tracking (will be updated when IF blocks are loaded)
         nodes[i].branchColumn = 0;
         nodes[i].owningIfBlock = -1;
+        nodes[i].branchIfNode = -1;
+        nodes[i].branchPrev = -1;
+        nodes[i].branchNext = -1;
         
         // Recalculate width for content blocks based on text content
         if (nodes[i].type == NODE_PROCESS || nodes[i].type == NODE_NORMAL ||
@@ -245,7 +395,7 @@ void load_flowchart(const char* filename) {
             nodes[i].type == NODE_ASSIGNMENT || nodes[i].type == NODE_DECLARE ||
             nodes[i].type == NODE_CYCLE) {
             float fontSize = nodes[i].height * 0.3f;
-            nodes[i].width = calculate_block_width(nodes[i].value, fontSize, 0.35f);
+            nodes[i].width = calculate_block_width(label, fontSize, 0.35f);
         } else {
             // START and END blocks keep their loaded width
             nodes[i].width = width;
@@ -253,18 +403,16 @@ void load_flowchart(const char* filename) {
         
         nodeCount++;
     }
+    free(label);
     
-    // Rebuild connections from adjacency matrix
-    connectionCount = 0;
-    for (int i = 0; i < nodeCount; i++) {
-        for (int j = 0; j < nodeCount; j++) {
-            if (adjMatrix[i][j] && connectionCount < MAX_CONNECTIONS) {
-                connections[connectionCount].fromNode = i;
-                connections[connectionCount].toNode = j;
-                connectionCount++;
-            }
-        }
+    // Rebuild connections from the loaded edges
+    if (loadedEdgeCount > 0) {
+        memcpy(connections, loadedEdges, (size_t)loadedEdgeCount * sizeof(Connection));
     }
+    connectionCount = loadedEdgeCount;
+    rebuild_free_node_slots();
+    invalidate_adjacency();
+    free(loadedEdges);
     
     // Try to read IF blocks section (may not exist in older files)
     ifBlockCount = 0;
@@ -274,20 +422,27 @@ void load_flowchart(const char* filename) {
             break;
         }
     }
+    if (ifBlockCount < 0 || !ensure_if_block_capacity(ifBlockCount)) {
+        ifBlockCount = 0;
+    }
     
     // Read IF blocks if any exist
-    for (int i = 0; i < ifBlockCount && i < MAX_IF_BLOCKS; i++) {
+    for (int i = 0; i < ifBlockCount; i++) {
+        int trueCount, falseCount;
         if (fscanf(file, "%d %d %d %d %d %d",
                    &ifBlocks[i].ifNodeIndex,
                    &ifBlocks[i].convergeNodeIndex,
                    &ifBlocks[i].parentIfIndex,
                    &ifBlocks[i].branchColumn,
-                   &ifBlocks[i].trueBranchCount,
-                   &ifBlocks[i].falseBranchCount) != 6) {
+                   &trueCount,
+                   &falseCount) != 6) {
             fprintf(stderr, "Error reading IF block data\n");
             ifBlockCount = i;
             break;
         }
+        // The branch lists are rebuilt from the node indices that follow
+        init_if_branches(&ifBlocks[i]);
+        invalidate_block_index();
         
         // Read true branch nodes
         // First, peek at the next line to check if it's "EMPTY"
@@ -312,20 +467,22 @@ void load_flowchart(const char* filename) {
         // Check if line is "EMPTY" marker
         if (strcmp(trimmed, "EMPTY") == 0) {
             // Empty branch - verify count matches
-            if (ifBlocks[i].trueBranchCount != 0) {
-                fprintf(stderr, "Warning: True branch marked EMPTY but count is %d, setting to 0\n", ifBlocks[i].trueBranchCount);
-                ifBlocks[i].trueBranchCount = 0;
+            if (trueCount != 0) {
+                fprintf(stderr, "Warning: True branch marked EMPTY but count is %d, setting to 0\n", trueCount);
             }
         } else {
             // Not empty - rewind and parse node indices
             fseek(file, filePos, SEEK_SET);
             
-            if (ifBlocks[i].trueBranchCount > 0) {
-                for (int j = 0; j < ifBlocks[i].trueBranchCount; j++) {
-                    if (fscanf(file, "%d", &ifBlocks[i].trueBranchNodes[j]) != 1) {
+            if (trueCount > 0) {
+                int expectedCount = trueCount;
+                for (int j = 0; j < expectedCount; j++) {
+                    int nodeIdx;
+                    if (fscanf(file, "%d", &nodeIdx) != 1) {
                         fprintf(stderr, "Error reading true branch nodes\n");
                         break;
                     }
+                    append_if_branch_node(&ifBlocks[i], 0, nodeIdx);
                 }
             }
             // Skip rest of line (spaces and newline)
@@ -357,20 +514,22 @@ void load_flowchart(const char* filename) {
         // Check if line is "EMPTY" marker
         if (strcmp(trimmedFalse, "EMPTY") == 0) {
             // Empty branch - verify count matches
-            if (ifBlocks[i].falseBranchCount != 0) {
-                fprintf(stderr, "Warning: False branch marked EMPTY but count is %d, setting to 0\n", ifBlocks[i].falseBranchCount);
-                ifBlocks[i].falseBranchCount = 0;
+            if (falseCount != 0) {
+                fprintf(stderr, "Warning: False branch marked EMPTY but count is %d, setting to 0\n", falseCount);
             }
         } else {
             // Not empty - rewind and parse node indices
             fseek(file, filePosFalse, SEEK_SET);
             
-            if (ifBlocks[i].falseBranchCount > 0) {
-                for (int j = 0; j < ifBlocks[i].falseBranchCount; j++) {
-                    if (fscanf(file, "%d", &ifBlocks[i].falseBranchNodes[j]) != 1) {
+            if (falseCount > 0) {
+                int expectedCount = falseCount;
+                for (int j = 0; j < expectedCount; j++) {
+                    int nodeIdx;
+                    if (fscanf(file, "%d", &nodeIdx) != 1) {
                         fprintf(stderr, "Error reading false branch nodes\n");
                         break;
                     }
+                    append_if_branch_node(&ifBlocks[i], 1, nodeIdx);
                 }
             }
             // Skip rest of line (spaces and newline)
@@ -405,8 +564,7 @@ void load_flowchart(const char* filename) {
         }
         
         // Update ownership and branch column for all branch nodes
-        for (int j = 0; j < ifBlocks[i].trueBranchCount; j++) {
-            int nodeIdx = ifBlocks[i].trueBranchNodes[j];
+        for (int nodeIdx = first_if_branch_node(&ifBlocks[i], 0); nodeIdx >= 0; nodeIdx = next_if_branch_node(nodeIdx)) {
             if (nodeIdx >= 0 && nodeIdx < nodeCount) {
                 nodes[nodeIdx].owningIfBlock = i;
                 // True branch is left: branchColumn = ifBlock's branchColumn - 2
@@ -414,8 +572,7 @@ void load_flowchart(const char* filename) {
             }
         }
         
-        for (int j = 0; j < ifBlocks[i].falseBranchCount; j++) {
-            int nodeIdx = ifBlocks[i].falseBranchNodes[j];
+        for (int nodeIdx = first_if_branch_node(&ifBlocks[i], 1); nodeIdx >= 0; nodeIdx = next_if_branch_node(nodeIdx)) {
             if (nodeIdx >= 0 && nodeIdx < nodeCount) {
                 nodes[nodeIdx].owningIfBlock = i;
                 // False branch is right: branchColumn calculation matches creation logic
@@ -436,23 +593,10 @@ void load_flowchart(const char* filename) {
             int ifNodeIdx = ifBlocks[i].ifNodeIndex;
             
             if (ifNodeIdx >= 0 && ifNodeIdx < nodeCount) {
-                // Check if this IF node is in the parent's true branch array
-                bool inTrueBranch = false;
-                for (int j = 0; j < ifBlocks[parentIdx].trueBranchCount; j++) {
-                    if (ifBlocks[parentIdx].trueBranchNodes[j] == ifNodeIdx) {
-                        inTrueBranch = true;
-                        break;
-                    }
-                }
-                
-                // Check if this IF node is in the parent's false branch array
-                bool inFalseBranch = false;
-                for (int j = 0; j < ifBlocks[parentIdx].falseBranchCount; j++) {
-                    if (ifBlocks[parentIdx].falseBranchNodes[j] == ifNodeIdx) {
-                        inFalseBranch = true;
-                        break;
-                    }
-                }
+                // Check which of the parent's branch lists holds this IF node
+                int parentBranch = if_branch_of_node(&ifBlocks[parentIdx], ifNodeIdx);
+                bool inTrueBranch = (parentBranch == 0);
+                bool inFalseBranch = (parentBranch == 1);
                 
                 // Correct branchColumn based on which branch array it's actually in
                 // If the branchColumn is wrong, we also need to swap the true/false branch arrays
@@ -472,13 +616,7 @@ void load_flowchart(const char* filename) {
                 
                 if (parentBranchesSwapped) {
                     // Swap parent's branch arrays
-                    int tempCount = ifBlocks[parentIdx].trueBranchCount;
-                    ifBlocks[parentIdx].trueBranchCount = ifBlocks[parentIdx].falseBranchCount;
-                    ifBlocks[parentIdx].falseBranchCount = tempCount;
-                    int tempNodes[MAX_NODES];
-                    memcpy(tempNodes, ifBlocks[parentIdx].trueBranchNodes, sizeof(ifBlocks[parentIdx].trueBranchNodes));
-                    memcpy(ifBlocks[parentIdx].trueBranchNodes, ifBlocks[parentIdx].falseBranchNodes, sizeof(ifBlocks[parentIdx].falseBranchNodes));
-                    memcpy(ifBlocks[parentIdx].falseBranchNodes, tempNodes, sizeof(ifBlocks[parentIdx].falseBranchNodes));
+                    swap_if_branches(&ifBlocks[parentIdx]);
                     // After swapping parent's branches, the nested IF's branchColumn needs to be inverted
                     // but its own branch arrays should NOT be swapped (they're correct)
                     // If it was in false branch (positive branchColumn), it's now in true branch (negative)
@@ -527,13 +665,7 @@ void load_flowchart(const char* filename) {
                                           (ifBlocks[i].branchColumn < 0 && correctBranchCol > 0);
                     if (needsCorrection) {
                         // Swap true and false branch arrays because they were saved with wrong branchColumn
-                        int tempCount = ifBlocks[i].trueBranchCount;
-                        ifBlocks[i].trueBranchCount = ifBlocks[i].falseBranchCount;
-                        ifBlocks[i].falseBranchCount = tempCount;
-                        int tempNodes[MAX_NODES];
-                        memcpy(tempNodes, ifBlocks[i].trueBranchNodes, sizeof(ifBlocks[i].trueBranchNodes));
-                        memcpy(ifBlocks[i].trueBranchNodes, ifBlocks[i].falseBranchNodes, sizeof(ifBlocks[i].falseBranchNodes));
-                        memcpy(ifBlocks[i].falseBranchNodes, tempNodes, sizeof(ifBlocks[i].falseBranchNodes));
+                        swap_if_branches(&ifBlocks[i]);
                         
                         ifBlocks[i].branchColumn = correctBranchCol;
                         nodes[ifNodeIdx].branchColumn = correctBranchCol;
@@ -555,13 +687,7 @@ void load_flowchart(const char* filename) {
                                           (ifBlocks[i].branchColumn > 0 && falseBranchCol < 0);
                     if (needsCorrection) {
                         // Swap true and false branch arrays because they were saved with wrong branchColumn
-                        int tempCount = ifBlocks[i].trueBranchCount;
-                        ifBlocks[i].trueBranchCount = ifBlocks[i].falseBranchCount;
-                        ifBlocks[i].falseBranchCount = tempCount;
-                        int tempNodes[MAX_NODES];
-                        memcpy(tempNodes, ifBlocks[i].trueBranchNodes, sizeof(ifBlocks[i].trueBranchNodes));
-                        memcpy(ifBlocks[i].trueBranchNodes, ifBlocks[i].falseBranchNodes, sizeof(ifBlocks[i].falseBranchNodes));
-                        memcpy(ifBlocks[i].falseBranchNodes, tempNodes, sizeof(ifBlocks[i].falseBranchNodes));
+                        swap_if_branches(&ifBlocks[i]);
                         
                         ifBlocks[i].branchColumn = falseBranchCol;
                         nodes[ifNodeIdx].branchColumn = falseBranchCol;
@@ -577,16 +703,14 @@ void load_flowchart(const char* filename) {
     // After verifying branchColumns, update branch node branchColumns again
     for (int i = 0; i < ifBlockCount; i++) {
         // Update true branch nodes
-        for (int j = 0; j < ifBlocks[i].trueBranchCount; j++) {
-            int nodeIdx = ifBlocks[i].trueBranchNodes[j];
+        for (int nodeIdx = first_if_branch_node(&ifBlocks[i], 0); nodeIdx >= 0; nodeIdx = next_if_branch_node(nodeIdx)) {
             if (nodeIdx >= 0 && nodeIdx < nodeCount) {
                 nodes[nodeIdx].branchColumn = ifBlocks[i].branchColumn - 2;
             }
         }
         
         // Update false branch nodes
-        for (int j = 0; j < ifBlocks[i].falseBranchCount; j++) {
-            int nodeIdx = ifBlocks[i].falseBranchNodes[j];
+        for (int nodeIdx = first_if_branch_node(&ifBlocks[i], 1); nodeIdx >= 0; nodeIdx = next_if_branch_node(nodeIdx)) {
             if (nodeIdx >= 0 && nodeIdx < nodeCount) {
                 int falseBranchCol = ifBlocks[i].branchColumn + 2;
                 if (falseBranchCol <= 0) {
@@ -608,8 +732,9 @@ void load_flowchart(const char* filename) {
             break;
         }
     }
-    if (cycleBlockCount < 0) cycleBlockCount = 0;
-    if (cycleBlockCount > MAX_CYCLE_BLOCKS) cycleBlockCount = MAX_CYCLE_BLOCKS;
+    if (cycleBlockCount < 0 || !ensure_cycle_block_capacity(cycleBlockCount)) {
+        cycleBlockCount = 0;
+    }
     
     for (int i = 0; i < cycleBlockCount; i++) {
         float offset = 0.0f;
@@ -636,6 +761,7 @@ void load_flowchart(const char* filename) {
             cycleBlocks[i].increment[0] = '\0';
         }
     }
+    invalidate_block_index();
     
     // After loading all IF blocks, update branch positions and reposition convergence points
     // This ensures nested IFs are properly positioned
@@ -650,8 +776,7 @@ void load_flowchart(const char* filename) {
     // This is critical for connection shapes to render correctly
     for (int i = 0; i < ifBlockCount; i++) {
         // Update true branch nodes
-        for (int j = 0; j < ifBlocks[i].trueBranchCount; j++) {
-            int nodeIdx = ifBlocks[i].trueBranchNodes[j];
+        for (int nodeIdx = first_if_branch_node(&ifBlocks[i], 0); nodeIdx >= 0; nodeIdx = next_if_branch_node(nodeIdx)) {
             if (nodeIdx >= 0 && nodeIdx < nodeCount) {
                 nodes[nodeIdx].branchColumn = ifBlocks[i].branchColumn - 2;
                 nodes[nodeIdx].owningIfBlock = i;
@@ -659,8 +784,7 @@ void load_flowchart(const char* filename) {
         }
         
         // Update false branch nodes
-        for (int j = 0; j < ifBlocks[i].falseBranchCount; j++) {
-            int nodeIdx = ifBlocks[i].falseBranchNodes[j];
+        for (int nodeIdx = first_if_branch_node(&ifBlocks[i], 1); nodeIdx >= 0; nodeIdx = next_if_branch_node(nodeIdx)) {
             if (nodeIdx >= 0 && nodeIdx < nodeCount) {
                 int falseBranchCol = ifBlocks[i].branchColumn + 2;
                 if (falseBranchCol <= 0) {
@@ -694,21 +818,7 @@ void load_flowchart(const char* filename) {
             for (int j = 0; j < nodeCount; j++) {
                 if (nodes[j].y < convergeY && j != ifBlocks[i].convergeNodeIndex) {
                     // Check if this node is NOT part of the nested IF (not in branch arrays)
-                    bool isInNestedIfBranch = false;
-                    for (int k = 0; k < ifBlocks[i].trueBranchCount; k++) {
-                        if (ifBlocks[i].trueBranchNodes[k] == j) {
-                            isInNestedIfBranch = true;
-                            break;
-                        }
-                    }
-                    if (!isInNestedIfBranch) {
-                        for (int k = 0; k < ifBlocks[i].falseBranchCount; k++) {
-                            if (ifBlocks[i].falseBranchNodes[k] == j) {
-                                isInNestedIfBranch = true;
-                                break;
-                            }
-                        }
-                    }
+                    bool isInNestedIfBranch = (if_branch_of_node(&ifBlocks[i], j) >= 0);
                     
                     // Also check if it's the nested IF node itself
                     if (j == ifBlocks[i].ifNodeIndex) {
@@ -740,8 +850,15 @@ void load_flowchart(const char* filename) {
     // Rebuild variable table after loading
     rebuild_variable_table();
     
-    // Reset undo history after loading
-    undoHistoryCount = 0;
-    undoHistoryIndex = -1;
-    save_state_for_undo();  // Save initial loaded state
+    // Bring back edits an earlier session journaled after this save but did not
+    // get to save, and journal the edits made from now on
+    int recovered = edit_journal_open(filename, false);
+    
+    // Reset undo history after loading, starting from the loaded state
+    mark_flowchart_changed();
+    undo_journal_reset();
+    if (recovered > 0) {
+        // The recovered edits are not in the file yet
+        undo_journal_set_saved(false);
+    }
 }
@@ -0,0 +1,1122 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "flowchart_state.h"
+
+// Smallest allocation made for any growable array
+#define MIN_ARRAY_CAPACITY 16
+
+// Grow a heap array to hold at least `needed` elements, doubling the capacity
+// so that repeated appends stay amortized O(1). New slots are zero-filled.
+static bool grow_array(void **data, int *capacity, int needed, size_t elemSize) {
+    if (needed <= *capacity) {
+        return true;
+    }
+
+    int newCapacity = *capacity > 0 ? *capacity : MIN_ARRAY_CAPACITY;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+
+    void *grown = realloc(*data, (size_t)newCapacity * elemSize);
+    if (!grown) {
+        fprintf(stderr, "Out of memory growing array to %d elements\n", newCapacity);
+        return false;
+    }
+
+    memset((char*)grown + (size_t)(*capacity) * elemSize, 0,
+           (size_t)(newCapacity - *capacity) * elemSize);
+    *data = grown;
+    *capacity = newCapacity;
+    return true;
+}
+
+bool ensure_node_capacity(int needed) {
+    return grow_array((void**)&nodes, &nodeCapacity, needed, sizeof(FlowNode));
+}
+
+bool ensure_connection_capacity(int needed) {
+    return grow_array((void**)&connections, &connectionCapacity, needed, sizeof(Connection));
+}
+
+bool ensure_if_block_capacity(int needed) {
+    return grow_array((void**)&ifBlocks, &ifBlockCapacity, needed, sizeof(IFBlock));
+}
+
+bool ensure_cycle_block_capacity(int needed) {
+    return grow_array((void**)&cycleBlocks, &cycleBlockCapacity, needed, sizeof(CycleBlock));
+}
+
+// Bumped on every change to the graph or layout (starts at 1 so 0 never matches)
+static unsigned int flowchartRevision = 1;
+
+void mark_flowchart_changed(void) {
+    flowchartRevision++;
+}
+
+unsigned int flowchart_revision(void) {
+    return flowchartRevision;
+}
+
+// Stack of free slots in one table (the most recently freed slot is reused
+// first), with each slot's position in the stack so any slot can be taken off
+// it in O(1)
+typedef struct {
+    int *slots;
+    int count;
+    int capacity;
+    int *position;          // per slot, -1 = not listed
+    int positionCapacity;
+} FreeSlotList;
+
+static bool ensure_free_slot_positions(FreeSlotList *list, int needed) {
+    int oldCapacity = list->positionCapacity;
+    if (!grow_array((void**)&list->position, &list->positionCapacity, needed, sizeof(int))) {
+        return false;
+    }
+    for (int i = oldCapacity; i < list->positionCapacity; i++) {
+        list->position[i] = -1;
+    }
+    return true;
+}
+
+// List a slot (a slot that is listed already stays where it is)
+static bool push_free_slot(FreeSlotList *list, int slot) {
+    if (slot < list->positionCapacity && list->position[slot] >= 0) {
+        return true;
+    }
+    if (!ensure_free_slot_positions(list, slot + 1) ||
+        !grow_array((void**)&list->slots, &list->capacity, list->count + 1, sizeof(int))) {
+        return false;
+    }
+    list->position[slot] = list->count;
+    list->slots[list->count++] = slot;
+    return true;
+}
+
+// Take a slot off the list, moving the top entry into its place
+static void drop_free_slot(FreeSlotList *list, int slot) {
+    int position = (slot >= 0 && slot < list->positionCapacity) ? list->position[slot] : -1;
+    if (position < 0) {
+        return;
+    }
+    int last = list->slots[--list->count];
+    list->slots[position] = last;
+    list->position[last] = position;
+    list->position[slot] = -1;
+}
+
+// Take the most recently freed slot off the list (-1 if it is empty)
+static int pop_free_slot(FreeSlotList *list) {
+    if (list->count == 0) {
+        return -1;
+    }
+    int slot = list->slots[list->count - 1];
+    drop_free_slot(list, slot);
+    return slot;
+}
+
+static void clear_free_slots(FreeSlotList *list) {
+    for (int i = 0; i < list->count; i++) {
+        list->position[list->slots[i]] = -1;
+    }
+    list->count = 0;
+}
+
+static FreeSlotList freeNodeSlots;
+
+// Per slot generation, bumped whenever the node in that slot goes away
+static unsigned int *nodeGenerations = NULL;
+static int nodeGenerationCapacity = 0;
+
+static bool ensure_node_generation_capacity(int needed) {
+    return grow_array((void**)&nodeGenerations, &nodeGenerationCapacity, needed, sizeof(unsigned int));
+}
+
+// Reset a slot to an empty main-branch node
+static void clear_node_slot(int nodeIndex, NodeType type) {
+    memset(&nodes[nodeIndex], 0, sizeof(FlowNode));
+    nodes[nodeIndex].type = type;
+    nodes[nodeIndex].owningIfBlock = -1;
+    nodes[nodeIndex].branchIfNode = -1;
+    nodes[nodeIndex].branchPrev = -1;
+    nodes[nodeIndex].branchNext = -1;
+}
+
+// Get a slot for a new node: a freed slot if there is one, otherwise a new one
+// at the end. The slot is cleared; returns -1 if memory could not be allocated.
+int allocate_node(void) {
+    int nodeIndex = pop_free_slot(&freeNodeSlots);
+    if (nodeIndex < 0) {
+        if (!ensure_node_capacity(nodeCount + 1) || !ensure_node_generation_capacity(nodeCount + 1)) {
+            return -1;
+        }
+        nodeIndex = nodeCount++;
+    }
+    clear_node_slot(nodeIndex, NODE_PROCESS);
+    mark_flowchart_changed();
+    return nodeIndex;
+}
+
+// Take a node out of the IF branch list it is in, if any
+static void leave_if_branch(int nodeIndex) {
+    if (nodes[nodeIndex].branchIfNode < 0) {
+        return;
+    }
+    int ifBlockIndex = find_if_block_by_if_node(nodes[nodeIndex].branchIfNode);
+    if (ifBlockIndex >= 0) {
+        remove_if_branch_node(&ifBlocks[ifBlockIndex], nodeIndex);
+    }
+}
+
+// Delete a node in O(1): the slot is marked free and nothing else moves.
+// It leaves its IF branch list; connections and IF/cycle blocks referring to
+// it must be removed by the caller.
+void free_node(int nodeIndex) {
+    if (!node_is_live(nodeIndex) || !push_free_slot(&freeNodeSlots, nodeIndex)) {
+        return;
+    }
+    leave_if_branch(nodeIndex);
+    clear_node_slot(nodeIndex, NODE_FREE);
+    nodeGenerations[nodeIndex]++;
+    mark_flowchart_changed();
+}
+
+bool node_is_live(int nodeIndex) {
+    return nodeIndex >= 0 && nodeIndex < nodeCount && nodes[nodeIndex].type != NODE_FREE;
+}
+
+int live_node_count(void) {
+    return nodeCount - freeNodeSlots.count;
+}
+
+// Recreate the free list after the node array was replaced wholesale (load, new
+// chart, crash recovery). Any handle taken before that no longer resolves.
+void rebuild_free_node_slots(void) {
+    clear_free_slots(&freeNodeSlots);
+    mark_flowchart_changed();
+    if (!ensure_node_generation_capacity(nodeCount)) {
+        return;
+    }
+    for (int i = nodeCount - 1; i >= 0; i--) {
+        nodeGenerations[i]++;
+        if (nodes[i].type == NODE_FREE) {
+            push_free_slot(&freeNodeSlots, i);
+        }
+    }
+}
+
+// Clip a run of records to the first `count` entries of its table
+static int clip_run(int first, int count, int tableCount) {
+    if (first < 0 || first >= tableCount) {
+        return 0;
+    }
+    return first + count > tableCount ? tableCount - first : count;
+}
+
+// Node slots [first, first + count) are about to be overwritten: take them off
+// the free list, and handles to them stop resolving
+void unindex_nodes(int first, int count) {
+    count = clip_run(first, count, nodeCount);
+    for (int i = first; i < first + count; i++) {
+        nodeGenerations[i]++;
+        drop_free_slot(&freeNodeSlots, i);
+    }
+}
+
+// Node slots [first, first + count) were overwritten: list the free ones
+void index_nodes(int first, int count) {
+    count = clip_run(first, count, nodeCount);
+    if (count > 0 && !ensure_node_generation_capacity(nodeCount)) {
+        return;
+    }
+    for (int i = first; i < first + count; i++) {
+        if (nodes[i].type == NODE_FREE) {
+            push_free_slot(&freeNodeSlots, i);
+        }
+    }
+}
+
+// Label pool: the text of every interned label lives in large chunks that are
+// never moved or freed, so label_text() pointers stay valid. A hash table with
+// linear probing maps text to its handle. Handle 0 is the empty string.
+#define LABEL_CHUNK_SIZE 65536
+
+static const char **labelTexts = NULL;
+static unsigned int *labelHashes = NULL;
+static int labelCount = 0;
+static int labelTextCapacity = 0;
+static int labelHashCapacity = 0;
+static int *labelTable = NULL;       // handle per bucket, -1 = empty
+static int labelTableSize = 0;       // power of two
+static char *labelChunk = NULL;
+static size_t labelChunkUsed = 0;
+static size_t labelChunkSize = 0;
+
+// FNV-1a
+static unsigned int hash_label(const char *text) {
+    unsigned int hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char*)text; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+// Resize the hash table to twice the size and reinsert every handle
+static bool grow_label_table(void) {
+    int newSize = labelTableSize > 0 ? labelTableSize * 2 : 1024;
+    int *table = malloc((size_t)newSize * sizeof(int));
+    if (!table) {
+        fprintf(stderr, "Out of memory growing label table\n");
+        return false;
+    }
+    for (int i = 0; i < newSize; i++) {
+        table[i] = -1;
+    }
+    for (int label = 1; label < labelCount; label++) {
+        int bucket = (int)(labelHashes[label] & (unsigned int)(newSize - 1));
+        while (table[bucket] >= 0) {
+            bucket = (bucket + 1) & (newSize - 1);
+        }
+        table[bucket] = label;
+    }
+    free(labelTable);
+    labelTable = table;
+    labelTableSize = newSize;
+    return true;
+}
+
+// Copy text into the current chunk, starting a new chunk when it is full
+static const char* store_label_text(const char *text, size_t length) {
+    if (!labelChunk || labelChunkUsed + length + 1 > labelChunkSize) {
+        size_t size = length + 1 > LABEL_CHUNK_SIZE ? length + 1 : LABEL_CHUNK_SIZE;
+        char *chunk = malloc(size);
+        if (!chunk) {
+            fprintf(stderr, "Out of memory storing a label\n");
+            return NULL;
+        }
+        // The previous chunk stays allocated: its labels are still referenced
+        labelChunk = chunk;
+        labelChunkUsed = 0;
+        labelChunkSize = size;
+    }
+    char *stored = labelChunk + labelChunkUsed;
+    memcpy(stored, text, length + 1);
+    labelChunkUsed += length + 1;
+    return stored;
+}
+
+// Return the handle for a label, adding it to the pool if it is new.
+// Returns 0 (the empty label) for NULL, "" or if memory runs out.
+int intern_label(const char *text) {
+    if (!text || text[0] == '\0') {
+        return 0;
+    }
+    if (labelCount == 0) {
+        if (!grow_array((void**)&labelTexts, &labelTextCapacity, 1, sizeof(const char*)) ||
+            !grow_array((void**)&labelHashes, &labelHashCapacity, 1, sizeof(unsigned int))) {
+            return 0;
+        }
+        labelTexts[0] = "";
+        labelHashes[0] = 0;
+        labelCount = 1;
+    }
+    if ((labelCount + 1) * 2 > labelTableSize && !grow_label_table()) {
+        return 0;
+    }
+
+    unsigned int hash = hash_label(text);
+    int bucket = (int)(hash & (unsigned int)(labelTableSize - 1));
+    while (labelTable[bucket] >= 0) {
+        int label = labelTable[bucket];
+        if (labelHashes[label] == hash && strcmp(labelTexts[label], text) == 0) {
+            return label;
+        }
+        bucket = (bucket + 1) & (labelTableSize - 1);
+    }
+
+    if (!grow_array((void**)&labelTexts, &labelTextCapacity, labelCount + 1, sizeof(const char*)) ||
+        !grow_array((void**)&labelHashes, &labelHashCapacity, labelCount + 1, sizeof(unsigned int))) {
+        return 0;
+    }
+    const char *stored = store_label_text(text, strlen(text));
+    if (!stored) {
+        return 0;
+    }
+    int label = labelCount++;
+    labelTexts[label] = stored;
+    labelHashes[label] = hash;
+    labelTable[bucket] = label;
+    return label;
+}
+
+const char* label_text(int label) {
+    if (label <= 0 || label >= labelCount) {
+        return "";
+    }
+    return labelTexts[label];
+}
+
+const char* node_label(int nodeIndex) {
+    if (nodeIndex < 0 || nodeIndex >= nodeCapacity) {
+        return "";
+    }
+    return label_text(nodes[nodeIndex].label);
+}
+
+void set_node_label(int nodeIndex, const char *text) {
+    if (nodeIndex < 0 || nodeIndex >= nodeCapacity) {
+        return;
+    }
+    nodes[nodeIndex].label = intern_label(text);
+    mark_flowchart_changed();
+}
+
+NodeHandle get_node_handle(int nodeIndex) {
+    NodeHandle handle = {-1, 0};
+    if (node_is_live(nodeIndex) && nodeIndex < nodeGenerationCapacity) {
+        handle.slot = nodeIndex;
+        handle.generation = nodeGenerations[nodeIndex];
+    }
+    return handle;
+}
+
+// Returns the node index for a handle, or -1 if that node has been deleted
+int resolve_node_handle(NodeHandle handle) {
+    if (!node_is_live(handle.slot) || handle.slot >= nodeGenerationCapacity ||
+        nodeGenerations[handle.slot] != handle.generation) {
+        return -1;
+    }
+    return handle.slot;
+}
+
+// Start an IF block with two empty branch lists
+void init_if_branches(IFBlock *ifBlock) {
+    ifBlock->trueBranchHead = -1;
+    ifBlock->trueBranchTail = -1;
+    ifBlock->trueBranchCount = 0;
+    ifBlock->falseBranchHead = -1;
+    ifBlock->falseBranchTail = -1;
+    ifBlock->falseBranchCount = 0;
+}
+
+int if_branch_of_node(const IFBlock *ifBlock, int nodeIndex) {
+    if (nodeIndex < 0 || nodeIndex >= nodeCount || nodes[nodeIndex].branchIfNode < 0 ||
+        nodes[nodeIndex].branchIfNode != ifBlock->ifNodeIndex) {
+        return -1;
+    }
+    return nodes[nodeIndex].branchSide;
+}
+
+int first_if_branch_node(const IFBlock *ifBlock, int branchType) {
+    return branchType == 0 ? ifBlock->trueBranchHead : ifBlock->falseBranchHead;
+}
+
+int next_if_branch_node(int nodeIndex) {
+    return nodes[nodeIndex].branchNext;
+}
+
+// Append a node to the end of one of an IF block's branch lists.
+// A node is in at most one list, so it leaves its current one first.
+bool append_if_branch_node(IFBlock *ifBlock, int branchType, int nodeIndex) {
+    if (!node_is_live(nodeIndex)) {
+        return false;
+    }
+    leave_if_branch(nodeIndex);
+
+    int *head = branchType == 0 ? &ifBlock->trueBranchHead : &ifBlock->falseBranchHead;
+    int *tail = branchType == 0 ? &ifBlock->trueBranchTail : &ifBlock->falseBranchTail;
+    int *count = branchType == 0 ? &ifBlock->trueBranchCount : &ifBlock->falseBranchCount;
+
+    FlowNode *node = &nodes[nodeIndex];
+    node->branchIfNode = ifBlock->ifNodeIndex;
+    node->branchSide = branchType == 0 ? 0 : 1;
+    node->branchPrev = *tail;
+    node->branchNext = -1;
+    if (*tail >= 0) {
+        nodes[*tail].branchNext = nodeIndex;
+    } else {
+        *head = nodeIndex;
+    }
+    *tail = nodeIndex;
+    (*count)++;
+    mark_flowchart_changed();
+    return true;
+}
+
+// Unlink a node from whichever branch list of this IF block holds it (O(1))
+void remove_if_branch_node(IFBlock *ifBlock, int nodeIndex) {
+    int branchType = if_branch_of_node(ifBlock, nodeIndex);
+    if (branchType < 0) {
+        return;
+    }
+
+    int *head = branchType == 0 ? &ifBlock->trueBranchHead : &ifBlock->falseBranchHead;
+    int *tail = branchType == 0 ? &ifBlock->trueBranchTail : &ifBlock->falseBranchTail;
+    int *count = branchType == 0 ? &ifBlock->trueBranchCount : &ifBlock->falseBranchCount;
+
+    FlowNode *node = &nodes[nodeIndex];
+    if (node->branchPrev >= 0) {
+        nodes[node->branchPrev].branchNext = node->branchNext;
+    } else {
+        *head = node->branchNext;
+    }
+    if (node->branchNext >= 0) {
+        nodes[node->branchNext].branchPrev = node->branchPrev;
+    } else {
+        *tail = node->branchPrev;
+    }
+    (*count)--;
+
+    node->branchIfNode = -1;
+    node->branchPrev = -1;
+    node->branchNext = -1;
+    mark_flowchart_changed();
+}
+
+// Empty both branch lists of an IF block
+void clear_if_branches(IFBlock *ifBlock) {
+    for (int branchType = 0; branchType <= 1; branchType++) {
+        int nodeIndex = first_if_branch_node(ifBlock, branchType);
+        while (nodeIndex >= 0) {
+            int next = nodes[nodeIndex].branchNext;
+            nodes[nodeIndex].branchIfNode = -1;
+            nodes[nodeIndex].branchPrev = -1;
+            nodes[nodeIndex].branchNext = -1;
+            nodeIndex = next;
+        }
+    }
+    init_if_branches(ifBlock);
+    mark_flowchart_changed();
+}
+
+// Exchange the true and false branch lists of an IF block
+void swap_if_branches(IFBlock *ifBlock) {
+    int tempHead = ifBlock->trueBranchHead;
+    int tempTail = ifBlock->trueBranchTail;
+    int tempCount = ifBlock->trueBranchCount;
+    ifBlock->trueBranchHead = ifBlock->falseBranchHead;
+    ifBlock->trueBranchTail = ifBlock->falseBranchTail;
+    ifBlock->trueBranchCount = ifBlock->falseBranchCount;
+    ifBlock->falseBranchHead = tempHead;
+    ifBlock->falseBranchTail = tempTail;
+    ifBlock->falseBranchCount = tempCount;
+
+    for (int branchType = 0; branchType <= 1; branchType++) {
+        for (int i = first_if_branch_node(ifBlock, branchType); i >= 0; i = nodes[i].branchNext) {
+            nodes[i].branchSide = branchType;
+        }
+    }
+    mark_flowchart_changed();
+}
+
+// Grow a snapshot's buffers to hold at least the given number of each record
+bool reserve_flowchart_state(FlowchartState *state, int neededNodes, int neededConnections,
+                             int neededIfBlocks, int neededCycleBlocks) {
+    return grow_array((void**)&state->nodes, &state->nodeCapacity, neededNodes, sizeof(FlowNode)) &&
+           grow_array((void**)&state->connections, &state->connectionCapacity, neededConnections, sizeof(Connection)) &&
+           grow_array((void**)&state->ifBlocks, &state->ifBlockCapacity, neededIfBlocks, sizeof(IFBlock)) &&
+           grow_array((void**)&state->cycleBlocks, &state->cycleBlockCapacity, neededCycleBlocks, sizeof(CycleBlock));
+}
+
+// Copy the live flowchart into a snapshot (buffers are reused between saves)
+bool capture_flowchart_state(FlowchartState *state) {
+    if (!reserve_flowchart_state(state, nodeCount, connectionCount, ifBlockCount, cycleBlockCount)) {
+        return false;
+    }
+
+    if (nodeCount > 0) {
+        memcpy(state->nodes, nodes, (size_t)nodeCount * sizeof(FlowNode));
+    }
+    if (connectionCount > 0) {
+        memcpy(state->connections, connections, (size_t)connectionCount * sizeof(Connection));
+    }
+    if (ifBlockCount > 0) {
+        memcpy(state->ifBlocks, ifBlocks, (size_t)ifBlockCount * sizeof(IFBlock));
+    }
+    if (cycleBlockCount > 0) {
+        memcpy(state->cycleBlocks, cycleBlocks, (size_t)cycleBlockCount * sizeof(CycleBlock));
+    }
+
+    state->nodeCount = nodeCount;
+    state->connectionCount = connectionCount;
+    state->ifBlockCount = ifBlockCount;
+    state->cycleBlockCount = cycleBlockCount;
+    return true;
+}
+
+// Replace the live flowchart with the contents of a snapshot
+bool apply_flowchart_state(const FlowchartState *state) {
+    if (!ensure_node_capacity(state->nodeCount) ||
+        !ensure_connection_capacity(state->connectionCount) ||
+        !ensure_if_block_capacity(state->ifBlockCount) ||
+        !ensure_cycle_block_capacity(state->cycleBlockCount)) {
+        return false;
+    }
+
+    if (state->nodeCount > 0) {
+        memcpy(nodes, state->nodes, (size_t)state->nodeCount * sizeof(FlowNode));
+    }
+    if (state->connectionCount > 0) {
+        memcpy(connections, state->connections, (size_t)state->connectionCount * sizeof(Connection));
+    }
+    if (state->ifBlockCount > 0) {
+        memcpy(ifBlocks, state->ifBlocks, (size_t)state->ifBlockCount * sizeof(IFBlock));
+    }
+    if (state->cycleBlockCount > 0) {
+        memcpy(cycleBlocks, state->cycleBlocks, (size_t)state->cycleBlockCount * sizeof(CycleBlock));
+    }
+
+    nodeCount = state->nodeCount;
+    connectionCount = state->connectionCount;
+    ifBlockCount = state->ifBlockCount;
+    cycleBlockCount = state->cycleBlockCount;
+    rebuild_free_node_slots();
+    invalidate_adjacency();
+    invalidate_block_index();
+    return true;
+}
+
+// Adjacency index: singly linked lists threaded through per-node heads and
+// per-connection next links, each list sorted by connection index
+static int *outgoingHead = NULL;     // per node, -1 = no outgoing connections
+static int *incomingHead = NULL;     // per node, -1 = no incoming connections
+static int adjacencyNodeCapacity = 0;
+static int *nextOutgoing = NULL;     // per connection
+static int *nextIncoming = NULL;     // per connection
+static int adjacencyConnectionCapacity = 0;
+static bool adjacencyValid = false;
+static int deadConnectionCount = 0;  // Removed entries still in connections[]
+
+// Grow a pair of index arrays sharing one capacity; new slots are set to -1
+static bool grow_index_arrays(int **first, int **second, int *capacity, int needed) {
+    int oldCapacity = *capacity;
+    int firstCapacity = oldCapacity;
+    int secondCapacity = oldCapacity;
+    if (!grow_array((void**)first, &firstCapacity, needed, sizeof(int)) ||
+        !grow_array((void**)second, &secondCapacity, needed, sizeof(int))) {
+        return false;
+    }
+    for (int i = oldCapacity; i < firstCapacity; i++) {
+        (*first)[i] = -1;
+        (*second)[i] = -1;
+    }
+    *capacity = firstCapacity;
+    return true;
+}
+
+// Insert a connection into a node's list, keeping the list in connection order
+static void link_edge(int *head, int *next, int nodeIndex, int connIndex) {
+    int *link = &head[nodeIndex];
+    while (*link >= 0 && *link < connIndex) {
+        link = &next[*link];
+    }
+    next[connIndex] = *link;
+    *link = connIndex;
+}
+
+static void unlink_edge(int *head, int *next, int nodeIndex, int connIndex) {
+    int *link = &head[nodeIndex];
+    while (*link >= 0 && *link != connIndex) {
+        link = &next[*link];
+    }
+    if (*link == connIndex) {
+        *link = next[connIndex];
+    }
+}
+
+// Add a connection to the lists of its endpoints (index must already be valid)
+static bool link_connection(int connIndex) {
+    int fromNode = connections[connIndex].fromNode;
+    int toNode = connections[connIndex].toNode;
+    int highestNode = fromNode > toNode ? fromNode : toNode;
+    if (!grow_index_arrays(&outgoingHead, &incomingHead, &adjacencyNodeCapacity, highestNode + 1) ||
+        !grow_index_arrays(&nextOutgoing, &nextIncoming, &adjacencyConnectionCapacity, connIndex + 1)) {
+        return false;
+    }
+    nextOutgoing[connIndex] = -1;
+    nextIncoming[connIndex] = -1;
+    if (fromNode >= 0) {
+        link_edge(outgoingHead, nextOutgoing, fromNode, connIndex);
+    }
+    if (toNode >= 0) {
+        link_edge(incomingHead, nextIncoming, toNode, connIndex);
+    }
+    return true;
+}
+
+static void unlink_connection(int connIndex) {
+    int fromNode = connections[connIndex].fromNode;
+    int toNode = connections[connIndex].toNode;
+    if (fromNode >= 0 && fromNode < adjacencyNodeCapacity) {
+        unlink_edge(outgoingHead, nextOutgoing, fromNode, connIndex);
+    }
+    if (toNode >= 0 && toNode < adjacencyNodeCapacity) {
+        unlink_edge(incomingHead, nextIncoming, toNode, connIndex);
+    }
+}
+
+// Rebuild every list from connections[] in O(nodes + connections)
+static void rebuild_adjacency(void) {
+    if (!grow_index_arrays(&outgoingHead, &incomingHead, &adjacencyNodeCapacity, nodeCount) ||
+        !grow_index_arrays(&nextOutgoing, &nextIncoming, &adjacencyConnectionCapacity, connectionCount)) {
+        return;
+    }
+
+    // Clear the whole capacity: slots past nodeCount may hold lists of deleted nodes
+    for (int i = 0; i < adjacencyNodeCapacity; i++) {
+        outgoingHead[i] = -1;
+        incomingHead[i] = -1;
+    }
+
+    // Walk backwards and push to the front so each list ends up in connection order
+    adjacencyValid = true;
+    deadConnectionCount = 0;
+    for (int i = connectionCount - 1; i >= 0; i--) {
+        int fromNode = connections[i].fromNode;
+        int toNode = connections[i].toNode;
+        if (!connection_is_live(i)) {
+            deadConnectionCount++;
+        }
+        int highestNode = fromNode > toNode ? fromNode : toNode;
+        if (highestNode >= adjacencyNodeCapacity &&
+            !grow_index_arrays(&outgoingHead, &incomingHead, &adjacencyNodeCapacity, highestNode + 1)) {
+            adjacencyValid = false;
+            return;
+        }
+        nextOutgoing[i] = -1;
+        nextIncoming[i] = -1;
+        if (fromNode >= 0) {
+            nextOutgoing[i] = outgoingHead[fromNode];
+            outgoingHead[fromNode] = i;
+        }
+        if (toNode >= 0) {
+            nextIncoming[i] = incomingHead[toNode];
+            incomingHead[toNode] = i;
+        }
+    }
+}
+
+void invalidate_adjacency(void) {
+    adjacencyValid = false;
+    mark_flowchart_changed();
+}
+
+// Append a connection and return its index (-1 if memory could not be allocated)
+int add_connection(int fromNode, int toNode) {
+    if (!ensure_connection_capacity(connectionCount + 1)) {
+        return -1;
+    }
+    int connIndex = connectionCount++;
+    connections[connIndex].fromNode = fromNode;
+    connections[connIndex].toNode = toNode;
+    mark_flowchart_changed();
+    if (adjacencyValid && !link_connection(connIndex)) {
+        adjacencyValid = false;
+    }
+    return connIndex;
+}
+
+// Point an existing connection at new endpoints
+void set_connection(int connIndex, int fromNode, int toNode) {
+    if (connIndex < 0 || connIndex >= connectionCount) {
+        return;
+    }
+    bool wasLive = connection_is_live(connIndex);
+    if (adjacencyValid) {
+        unlink_connection(connIndex);
+    }
+    connections[connIndex].fromNode = fromNode;
+    connections[connIndex].toNode = toNode;
+    deadConnectionCount += wasLive - connection_is_live(connIndex);
+    mark_flowchart_changed();
+    if (adjacencyValid && !link_connection(connIndex)) {
+        adjacencyValid = false;
+    }
+}
+
+// Remove a connection by unlinking it from its endpoints' lists and leaving a
+// dead entry (both ends -1) in its place, so later connections keep their index
+// and order. compact_connections() squeezes the dead entries out.
+void remove_connection(int connIndex) {
+    if (!connection_is_live(connIndex)) {
+        return;
+    }
+    if (adjacencyValid) {
+        unlink_connection(connIndex);
+    }
+    connections[connIndex].fromNode = -1;
+    connections[connIndex].toNode = -1;
+    deadConnectionCount++;
+    mark_flowchart_changed();
+}
+
+// Remove every connection that starts or ends at a node, walking its lists
+void remove_connections_of_node(int nodeIndex) {
+    int connIndex;
+    while ((connIndex = first_outgoing_connection(nodeIndex)) >= 0) {
+        remove_connection(connIndex);
+    }
+    while ((connIndex = first_incoming_connection(nodeIndex)) >= 0) {
+        remove_connection(connIndex);
+    }
+}
+
+// Remove every connection that starts or ends at one of the listed nodes
+void remove_node_connections(const int *nodeList, int count) {
+    for (int i = 0; i < count; i++) {
+        remove_connections_of_node(nodeList[i]);
+    }
+}
+
+bool connection_is_live(int connIndex) {
+    return connIndex >= 0 && connIndex < connectionCount &&
+           (connections[connIndex].fromNode >= 0 || connections[connIndex].toNode >= 0);
+}
+
+// Drop dead entries once they make up more than half of connections[]. The
+// shift renumbers connections, so the index is rebuilt on the next query; doing
+// it only past half keeps removals O(1) amortized.
+void compact_connections(void) {
+    if (deadConnectionCount * 2 <= connectionCount) {
+        return;
+    }
+    int kept = 0;
+    for (int i = 0; i < connectionCount; i++) {
+        if (connection_is_live(i)) {
+            connections[kept++] = connections[i];
+        }
+    }
+    connectionCount = kept;
+    deadConnectionCount = 0;
+    invalidate_adjacency();
+}
+
+// Connections [first, first + count) are about to be overwritten: unlink them
+// (their endpoints are still the old ones)
+void unindex_connections(int first, int count) {
+    count = clip_run(first, count, connectionCount);
+    for (int i = first; i < first + count; i++) {
+        if (!connection_is_live(i)) {
+            deadConnectionCount--;
+        } else if (adjacencyValid) {
+            unlink_connection(i);
+        }
+    }
+}
+
+// Connections [first, first + count) were overwritten: link them again
+void index_connections(int first, int count) {
+    count = clip_run(first, count, connectionCount);
+    for (int i = first; i < first + count; i++) {
+        if (!connection_is_live(i)) {
+            deadConnectionCount++;
+        } else if (adjacencyValid && !link_connection(i)) {
+            adjacencyValid = false;
+        }
+    }
+}
+
+int first_outgoing_connection(int nodeIndex) {
+    if (!adjacencyValid) {
+        rebuild_adjacency();
+    }
+    if (!adjacencyValid || nodeIndex < 0 || nodeIndex >= adjacencyNodeCapacity) {
+        return -1;
+    }
+    return outgoingHead[nodeIndex];
+}
+
+int next_outgoing_connection(int connIndex) {
+    return nextOutgoing[connIndex];
+}
+
+int first_incoming_connection(int nodeIndex) {
+    if (!adjacencyValid) {
+        rebuild_adjacency();
+    }
+    if (!adjacencyValid || nodeIndex < 0 || nodeIndex >= adjacencyNodeCapacity) {
+        return -1;
+    }
+    return incomingHead[nodeIndex];
+}
+
+int next_incoming_connection(int connIndex) {
+    return nextIncoming[connIndex];
+}
+
+// Node -> block reverse maps (per node slot, -1 = none)
+static int *ifBlockByIfNode = NULL;
+static int *ifBlockByConvergeNode = NULL;
+static int ifBlockMapCapacity = 0;
+static int *cycleBlockByCycleNode = NULL;
+static int *cycleBlockByEndNode = NULL;
+static int cycleBlockMapCapacity = 0;
+static bool blockIndexValid = false;
+
+// Free IF and cycle block slots, kept current together with the maps
+static FreeSlotList freeIfBlockSlots;
+static FreeSlotList freeCycleBlockSlots;
+
+static bool if_block_matches(int ifBlockIndex, int nodeIndex, bool converge) {
+    return ifBlockIndex >= 0 && ifBlockIndex < ifBlockCount &&
+           (converge ? ifBlocks[ifBlockIndex].convergeNodeIndex : ifBlocks[ifBlockIndex].ifNodeIndex) == nodeIndex;
+}
+
+static bool cycle_block_matches(int cycleBlockIndex, int nodeIndex, bool end) {
+    return cycleBlockIndex >= 0 && cycleBlockIndex < cycleBlockCount &&
+           (end ? cycleBlocks[cycleBlockIndex].cycleEndNodeIndex : cycleBlocks[cycleBlockIndex].cycleNodeIndex) == nodeIndex;
+}
+
+// Map a block's nodes to it. A node that already maps to a lower block naming it
+// keeps that entry, so as with a scan of the array the lowest index wins.
+static bool add_if_block_to_index(int ifBlockIndex) {
+    int ifNode = ifBlocks[ifBlockIndex].ifNodeIndex;
+    int convergeNode = ifBlocks[ifBlockIndex].convergeNodeIndex;
+    int highestNode = ifNode > convergeNode ? ifNode : convergeNode;
+    if (!grow_index_arrays(&ifBlockByIfNode, &ifBlockByConvergeNode, &ifBlockMapCapacity, highestNode + 1)) {
+        return false;
+    }
+    if (ifNode >= 0 && (ifBlockByIfNode[ifNode] > ifBlockIndex ||
+                        !if_block_matches(ifBlockByIfNode[ifNode], ifNode, false))) {
+        ifBlockByIfNode[ifNode] = ifBlockIndex;
+    }
+    if (convergeNode >= 0 && (ifBlockByConvergeNode[convergeNode] > ifBlockIndex ||
+                              !if_block_matches(ifBlockByConvergeNode[convergeNode], convergeNode, true))) {
+        ifBlockByConvergeNode[convergeNode] = ifBlockIndex;
+    }
+    return true;
+}
+
+static bool add_cycle_block_to_index(int cycleBlockIndex) {
+    int cycleNode = cycleBlocks[cycleBlockIndex].cycleNodeIndex;
+    int endNode = cycleBlocks[cycleBlockIndex].cycleEndNodeIndex;
+    int highestNode = cycleNode > endNode ? cycleNode : endNode;
+    if (!grow_index_arrays(&cycleBlockByCycleNode, &cycleBlockByEndNode, &cycleBlockMapCapacity, highestNode + 1)) {
+        return false;
+    }
+    if (cycleNode >= 0 && (cycleBlockByCycleNode[cycleNode] > cycleBlockIndex ||
+                           !cycle_block_matches(cycleBlockByCycleNode[cycleNode], cycleNode, false))) {
+        cycleBlockByCycleNode[cycleNode] = cycleBlockIndex;
+    }
+    if (endNode >= 0 && (cycleBlockByEndNode[endNode] > cycleBlockIndex ||
+                         !cycle_block_matches(cycleBlockByEndNode[endNode], endNode, true))) {
+        cycleBlockByEndNode[endNode] = cycleBlockIndex;
+    }
+    return true;
+}
+
+// Rebuild both maps and the free block lists from ifBlocks[] and cycleBlocks[]
+// in O(nodes + blocks)
+static void rebuild_block_index(void) {
+    for (int i = 0; i < ifBlockMapCapacity; i++) {
+        ifBlockByIfNode[i] = -1;
+        ifBlockByConvergeNode[i] = -1;
+    }
+    for (int i = 0; i < cycleBlockMapCapacity; i++) {
+        cycleBlockByCycleNode[i] = -1;
+        cycleBlockByEndNode[i] = -1;
+    }
+    clear_free_slots(&freeIfBlockSlots);
+    clear_free_slots(&freeCycleBlockSlots);
+    blockIndexValid = true;
+    for (int i = ifBlockCount - 1; i >= 0 && blockIndexValid; i--) {
+        blockIndexValid = if_block_is_live(i) ? add_if_block_to_index(i) : push_free_slot(&freeIfBlockSlots, i);
+    }
+    for (int i = cycleBlockCount - 1; i >= 0 && blockIndexValid; i--) {
+        blockIndexValid = cycle_block_is_live(i) ? add_cycle_block_to_index(i)
+                                                 : push_free_slot(&freeCycleBlockSlots, i);
+    }
+}
+
+void invalidate_block_index(void) {
+    blockIndexValid = false;
+    mark_flowchart_changed();
+}
+
+// Call after filling in ifBlocks[ifBlockIndex] for a newly allocated block
+void register_if_block(int ifBlockIndex) {
+    mark_flowchart_changed();
+    if (blockIndexValid && ifBlockIndex >= 0 && ifBlockIndex < ifBlockCount &&
+        !add_if_block_to_index(ifBlockIndex)) {
+        blockIndexValid = false;
+    }
+}
+
+// Call after filling in cycleBlocks[cycleBlockIndex] for a newly allocated block
+void register_cycle_block(int cycleBlockIndex) {
+    mark_flowchart_changed();
+    if (blockIndexValid && cycleBlockIndex >= 0 && cycleBlockIndex < cycleBlockCount &&
+        !add_cycle_block_to_index(cycleBlockIndex)) {
+        blockIndexValid = false;
+    }
+}
+
+// Clear a map entry that points at a block about to be overwritten
+static void unmap_block(int *map, int capacity, int nodeIndex, int blockIndex) {
+    if (nodeIndex >= 0 && nodeIndex < capacity && map[nodeIndex] == blockIndex) {
+        map[nodeIndex] = -1;
+    }
+}
+
+bool if_block_is_live(int ifBlockIndex) {
+    return ifBlockIndex >= 0 && ifBlockIndex < ifBlockCount && ifBlocks[ifBlockIndex].ifNodeIndex >= 0;
+}
+
+bool cycle_block_is_live(int cycleBlockIndex) {
+    return cycleBlockIndex >= 0 && cycleBlockIndex < cycleBlockCount &&
+           cycleBlocks[cycleBlockIndex].cycleNodeIndex >= 0;
+}
+
+// Reset a slot to an unused IF block: no nodes, no parent, empty branches
+static void clear_if_block_slot(int ifBlockIndex) {
+    memset(&ifBlocks[ifBlockIndex], 0, sizeof(IFBlock));
+    ifBlocks[ifBlockIndex].ifNodeIndex = -1;
+    ifBlocks[ifBlockIndex].convergeNodeIndex = -1;
+    ifBlocks[ifBlockIndex].parentIfIndex = -1;
+    init_if_branches(&ifBlocks[ifBlockIndex]);
+}
+
+static void clear_cycle_block_slot(int cycleBlockIndex) {
+    memset(&cycleBlocks[cycleBlockIndex], 0, sizeof(CycleBlock));
+    cycleBlocks[cycleBlockIndex].cycleNodeIndex = -1;
+    cycleBlocks[cycleBlockIndex].cycleEndNodeIndex = -1;
+    cycleBlocks[cycleBlockIndex].parentCycleIndex = -1;
+}
+
+// Get a slot for a new IF block: a freed slot if there is one, otherwise a new
+// one at the end. The slot is cleared; fill it in and call register_if_block().
+// Returns -1 if memory could not be allocated.
+int allocate_if_block(void) {
+    if (!blockIndexValid) {
+        rebuild_block_index();
+    }
+    int ifBlockIndex = pop_free_slot(&freeIfBlockSlots);
+    if (ifBlockIndex < 0) {
+        if (!ensure_if_block_capacity(ifBlockCount + 1)) {
+            return -1;
+        }
+        ifBlockIndex = ifBlockCount++;
+    }
+    clear_if_block_slot(ifBlockIndex);
+    mark_flowchart_changed();
+    return ifBlockIndex;
+}
+
+int allocate_cycle_block(void) {
+    if (!blockIndexValid) {
+        rebuild_block_index();
+    }
+    int cycleBlockIndex = pop_free_slot(&freeCycleBlockSlots);
+    if (cycleBlockIndex < 0) {
+        if (!ensure_cycle_block_capacity(cycleBlockCount + 1)) {
+            return -1;
+        }
+        cycleBlockIndex = cycleBlockCount++;
+    }
+    clear_cycle_block_slot(cycleBlockIndex);
+    mark_flowchart_changed();
+    return cycleBlockIndex;
+}
+
+// Delete an IF block in O(1): its map entries are dropped and the slot is
+// cleared and listed as free; no other block moves. Nodes still in its branch
+// lists are released from them. Its nodes and the blocks nested in it must be
+// removed by the caller.
+void free_if_block(int ifBlockIndex) {
+    if (ifBlockIndex < 0 || ifBlockIndex >= ifBlockCount) {
+        return;
+    }
+    clear_if_branches(&ifBlocks[ifBlockIndex]);
+    if (blockIndexValid) {
+        unmap_block(ifBlockByIfNode, ifBlockMapCapacity, ifBlocks[ifBlockIndex].ifNodeIndex, ifBlockIndex);
+        unmap_block(ifBlockByConvergeNode, ifBlockMapCapacity, ifBlocks[ifBlockIndex].convergeNodeIndex,
+                    ifBlockIndex);
+    }
+    clear_if_block_slot(ifBlockIndex);
+    if (blockIndexValid && !push_free_slot(&freeIfBlockSlots, ifBlockIndex)) {
+        blockIndexValid = false;
+    }
+    mark_flowchart_changed();
+}
+
+void free_cycle_block(int cycleBlockIndex) {
+    if (cycleBlockIndex < 0 || cycleBlockIndex >= cycleBlockCount) {
+        return;
+    }
+    if (blockIndexValid) {
+        unmap_block(cycleBlockByCycleNode, cycleBlockMapCapacity, cycleBlocks[cycleBlockIndex].cycleNodeIndex,
+                    cycleBlockIndex);
+        unmap_block(cycleBlockByEndNode, cycleBlockMapCapacity, cycleBlocks[cycleBlockIndex].cycleEndNodeIndex,
+                    cycleBlockIndex);
+    }
+    clear_cycle_block_slot(cycleBlockIndex);
+    if (blockIndexValid && !push_free_slot(&freeCycleBlockSlots, cycleBlockIndex)) {
+        blockIndexValid = false;
+    }
+    mark_flowchart_changed();
+}
+
+// IF blocks [first, first + count) are about to be overwritten: unmap them and
+// take them off the free list
+void unindex_if_blocks(int first, int count) {
+    count = clip_run(first, count, ifBlockCount);
+    for (int i = first; blockIndexValid && i < first + count; i++) {
+        unmap_block(ifBlockByIfNode, ifBlockMapCapacity, ifBlocks[i].ifNodeIndex, i);
+        unmap_block(ifBlockByConvergeNode, ifBlockMapCapacity, ifBlocks[i].convergeNodeIndex, i);
+        drop_free_slot(&freeIfBlockSlots, i);
+    }
+}
+
+// IF blocks [first, first + count) were overwritten: map them again, or list
+// them as free
+void index_if_blocks(int first, int count) {
+    count = clip_run(first, count, ifBlockCount);
+    for (int i = first; blockIndexValid && i < first + count; i++) {
+        blockIndexValid = if_block_is_live(i) ? add_if_block_to_index(i) : push_free_slot(&freeIfBlockSlots, i);
+    }
+}
+
+void unindex_cycle_blocks(int first, int count) {
+    count = clip_run(first, count, cycleBlockCount);
+    for (int i = first; blockIndexValid && i < first + count; i++) {
+        unmap_block(cycleBlockByCycleNode, cycleBlockMapCapacity, cycleBlocks[i].cycleNodeIndex, i);
+        unmap_block(cycleBlockByEndNode, cycleBlockMapCapacity, cycleBlocks[i].cycleEndNodeIndex, i);
+        drop_free_slot(&freeCycleBlockSlots, i);
+    }
+}
+
+void index_cycle_blocks(int first, int count) {
+    count = clip_run(first, count, cycleBlockCount);
+    for (int i = first; blockIndexValid && i < first + count; i++) {
+        blockIndexValid = cycle_block_is_live(i) ? add_cycle_block_to_index(i)
+                                                 : push_free_slot(&freeCycleBlockSlots, i);
+    }
+}
+
+// Shared lookup: make sure the maps are current, then read the entry for a node
+static int lookup_block(int **map, const int *capacity, int nodeIndex) {
+    if (!blockIndexValid) {
+        rebuild_block_index();
+    }
+    if (!blockIndexValid || nodeIndex < 0 || nodeIndex >= *capacity) {
+        return -1;
+    }
+    return (*map)[nodeIndex];
+}
+
+int find_if_block_by_if_node(int nodeIndex) {
+    return lookup_block(&ifBlockByIfNode, &ifBlockMapCapacity, nodeIndex);
+}
+
+int find_if_block_by_converge_node(int nodeIndex) {
+    return lookup_block(&ifBlockByConvergeNode, &ifBlockMapCapacity, nodeIndex);
+}
+
+int find_cycle_block_by_cycle_node(int nodeIndex) {
+    return lookup_block(&cycleBlockByCycleNode, &cycleBlockMapCapacity, nodeIndex);
+}
+
+int find_cycle_block_by_end_node(int nodeIndex) {
+    return lookup_block(&cycleBlockByEndNode, &cycleBlockMapCapacity, nodeIndex);
+}
@@ -4,14 +4,11 @@
 #include <stdbool.h>
 
 // Flowchart node and connection data
-#define MAX_NODES 100
-#define MAX_CONNECTIONS 200
+// Nodes, connections, IF blocks and cycle blocks live in growable heap arrays
+// (see flowchart_state.c), so there is no fixed limit on their count.
 #define MAX_VALUE_LENGTH 256
 #define MAX_VARIABLES 200
 #define MAX_VAR_NAME_LENGTH 64
-#define MAX_IF_BLOCKS 50
-#define MAX_CYCLE_BLOCKS 50
-#define MAX_UNDO_HISTORY 10
 
 typedef enum {
     NODE_NORMAL = 0,    // Deprecated, maps to NODE_PROCESS
@@ -25,7 +22,8 @@ typedef enum {
     NODE_IF = 8,
     NODE_CONVERGE = 9,
     NODE_CYCLE = 10,
-    NODE_CYCLE_END = 11
+    NODE_CYCLE_END = 11,
+    NODE_FREE = 12      // Unused slot left by a deleted node (see allocate_node)
 } NodeType;
 
 typedef struct FlowNode {
@@ -33,10 +31,14 @@ typedef struct FlowNode {
     double y;
     float width;
     float height;
-    char value[MAX_VALUE_LENGTH];
     NodeType type;
     int branchColumn;         // 0 = main, -2/-4/-6 = left branches, +2/+4/+6 = right
     int owningIfBlock;        // Index of IF block this node belongs to (-1 if main)
+    int branchIfNode;         // IF node whose branch list holds this node (-1 if none)
+    int branchSide;           // 0 = true branch, 1 = false branch (when branchIfNode >= 0)
+    int branchPrev;           // Neighbours in that branch list (-1 = none)
+    int branchNext;
+    int label;                // Interned label handle (0 = empty, see node_label)
 } FlowNode;
 
 typedef struct {
@@ -44,15 +46,24 @@ typedef struct {
     int toNode;
 } Connection;
 
+// Generational reference to a node slot. Use it to hold on to a node across
+// edits: it stops resolving once the node is deleted, even if the slot is reused.
+typedef struct {
+    int slot;
+    unsigned int generation;
+} NodeHandle;
+
 // IF Block tracking system
 typedef struct {
     int ifNodeIndex;          // Index of the IF block
     int convergeNodeIndex;    // Index of the convergence point
     int parentIfIndex;        // Parent IF block (-1 if none)
     int branchColumn;         // Column offset from parent (-2 or +2)
-    int trueBranchNodes[MAX_NODES];   // Nodes in true branch
+    int trueBranchHead;       // First/last node of the true branch list (-1 if empty)
+    int trueBranchTail;
     int trueBranchCount;
-    int falseBranchNodes[MAX_NODES];  // Nodes in false branch
+    int falseBranchHead;      // First/last node of the false branch list (-1 if empty)
+    int falseBranchTail;
     int falseBranchCount;
     double leftBranchWidth;   // Calculated width of left (true) branch
     double rightBranchWidth;  // Calculated width of right (false) branch
@@ -76,18 +87,30 @@ typedef struct {
     char increment[MAX_VALUE_LENGTH];    // FOR increment/decrement
 } CycleBlock;
 
-// Undo/Redo system
+// Copy of the whole flowchart (the undo journal keeps one, see undo_journal.h)
+// Each snapshot owns its buffers; they are kept and reused between saves.
 typedef struct {
-    FlowNode nodes[MAX_NODES];
+    FlowNode *nodes;
     int nodeCount;
-    Connection connections[MAX_CONNECTIONS];
+    int nodeCapacity;
+    Connection *connections;
     int connectionCount;
-    IFBlock ifBlocks[MAX_IF_BLOCKS];
+    int connectionCapacity;
+    IFBlock *ifBlocks;
     int ifBlockCount;
-    CycleBlock cycleBlocks[MAX_CYCLE_BLOCKS];
+    int ifBlockCapacity;
+    CycleBlock *cycleBlocks;
     int cycleBlockCount;
+    int cycleBlockCapacity;
 } FlowchartState;
 
+// What an edit transaction has to redo when it commits (see begin_edit in main.c)
+typedef enum {
+    EDIT_LAYOUT = 1,     // Branch widths and positions (update_all_branch_positions)
+    EDIT_VARIABLES = 2,  // Variable table (rebuild_variable_table)
+    EDIT_UNDO = 4        // Nothing to recalculate, but the edit needs an undo step
+} EditDirtyFlags;
+
 // Variable tracking system
 typedef enum {
     VAR_TYPE_INT = 0,
@@ -116,7 +139,7 @@ typedef struct {
     double x;
     double y;
     int connectionIndex;  // which connection was clicked (for connection menu)
-    int nodeIndex;  // which node was clicked (for node menu)
+    NodeHandle node;  // which node was clicked (for node menu)
 } PopupMenu;
 
 // Menu items
@@ -137,15 +160,18 @@ extern NodeMenuItem nodeMenuItems[];
 extern int nodeMenuItemCount;
 
 // Global variables (extern declarations)
-extern FlowNode nodes[];
+extern FlowNode *nodes;
 extern int nodeCount;
-extern Connection connections[];
+extern int nodeCapacity;
+extern Connection *connections;
 extern int connectionCount;
-extern IFBlock ifBlocks[];
+extern int connectionCapacity;
+extern IFBlock *ifBlocks;
 extern int ifBlockCount;
-extern CycleBlock cycleBlocks[];
+extern int ifBlockCapacity;
+extern CycleBlock *cycleBlocks;
 extern int cycleBlockCount;
-extern FlowchartState undoHistory[];
+extern int cycleBlockCapacity;
 extern int undoHistoryCount;
 extern int undoHistoryIndex;
 extern Variable variables[];
@@ -179,4 +205,139 @@ extern const float menuItemSpacing;
 extern const float menuPadding;
 extern const float menuMinWidth;
 
+// Storage management (flowchart_state.c)
+// The ensure_* functions grow the matching global array so it can hold at least
+// `needed` entries. Growing may move the array, so pointers into it must be
+// re-taken after a call. They return false if memory could not be allocated.
+bool ensure_node_capacity(int needed);
+bool ensure_connection_capacity(int needed);
+bool ensure_if_block_capacity(int needed);
+bool ensure_cycle_block_capacity(int needed);
+bool reserve_flowchart_state(FlowchartState *state, int neededNodes, int neededConnections,
+                             int neededIfBlocks, int neededCycleBlocks);
+bool capture_flowchart_state(FlowchartState *state);
+bool apply_flowchart_state(const FlowchartState *state);
+
+// Change tracking (flowchart_state.c)
+// flowchart_revision() changes whenever the graph or layout may have changed, so
+// caches derived from nodes and connections can tell when to rebuild. The node,
+// connection, branch and block functions below bump it themselves. Code that moves
+// or resizes nodes directly calls mark_flowchart_changed() when it is done; every
+// undoable edit gets this through save_state_for_undo().
+void mark_flowchart_changed(void);
+unsigned int flowchart_revision(void);
+
+// Redraw scheduling (main.c)
+// The editor sleeps until an event arrives and draws a frame only when asked to.
+// Input callbacks call request_redraw() when what is on screen may have changed;
+// edits need not, since a new flowchart_revision() is drawn anyway.
+void request_redraw(void);
+
+// IF branch membership (flowchart_state.c)
+// Each branch of an IF is a list threaded through the nodes (branchPrev/branchNext),
+// and every node records the IF node and side of the list it is in. "Which branch
+// of this IF is node X in" is O(1), and IF blocks stay fixed-size.
+// branchType: 0 = true/left, 1 = false/right
+void init_if_branches(IFBlock *ifBlock);
+bool append_if_branch_node(IFBlock *ifBlock, int branchType, int nodeIndex);
+void remove_if_branch_node(IFBlock *ifBlock, int nodeIndex);
+void clear_if_branches(IFBlock *ifBlock);
+void swap_if_branches(IFBlock *ifBlock);
+int if_branch_of_node(const IFBlock *ifBlock, int nodeIndex);  // branchType, or -1
+int first_if_branch_node(const IFBlock *ifBlock, int branchType);
+int next_if_branch_node(int nodeIndex);
+
+// Node slots (flowchart_state.c)
+// Node indices are stable: deleting a node frees its slot (type NODE_FREE)
+// instead of shifting later nodes down, so connections, IF blocks and cycle
+// blocks never need renumbering. Freed slots are reused by allocate_node().
+// nodeCount is the number of slots, so loops over nodes skip free slots with
+// node_is_live(). Saving compacts the slots away.
+int allocate_node(void);
+void free_node(int nodeIndex);
+bool node_is_live(int nodeIndex);
+int live_node_count(void);
+void rebuild_free_node_slots(void);
+NodeHandle get_node_handle(int nodeIndex);
+int resolve_node_handle(NodeHandle handle);
+
+// Node labels (flowchart_state.c)
+// Labels are interned: each distinct string is stored once in an append-only
+// pool and nodes hold a small handle (FlowNode.label, 0 = empty string).
+// Handles never change meaning, so undo snapshots copy them like any other
+// field. Labels have no length limit; the returned text must not be modified.
+int intern_label(const char *text);
+const char* label_text(int label);
+const char* node_label(int nodeIndex);
+void set_node_label(int nodeIndex, const char *text);
+
+// Block slots (flowchart_state.c)
+// IF and cycle block indices are stable too: deleting a block clears its slot
+// (no IF/cycle node, no parent) and lists it as free instead of shifting later
+// blocks down, so owningIfBlock, parentIfIndex and parentCycleIndex never need
+// renumbering. Loops over the block arrays skip free slots with if_block_is_live()
+// and cycle_block_is_live(). Saving compacts the slots away.
+int allocate_if_block(void);
+int allocate_cycle_block(void);
+void free_if_block(int ifBlockIndex);
+void free_cycle_block(int cycleBlockIndex);
+bool if_block_is_live(int ifBlockIndex);
+bool cycle_block_is_live(int cycleBlockIndex);
+
+// Block lookup by node (flowchart_state.c)
+// Reverse maps from a node to the IF block it opens or closes and the cycle block
+// it starts or ends, so these lookups are O(1). Newly allocated blocks are
+// registered right away, freed blocks are unmapped, and undo and redo update the
+// entries of the blocks they overwrite. Bulk replacement of the arrays (load,
+// new chart) invalidates the maps and they are rebuilt on the next query.
+// Each lookup returns the block index, or -1 if there is none.
+void register_if_block(int ifBlockIndex);
+void register_cycle_block(int cycleBlockIndex);
+void invalidate_block_index(void);
+int find_if_block_by_if_node(int nodeIndex);
+int find_if_block_by_converge_node(int nodeIndex);
+int find_cycle_block_by_cycle_node(int nodeIndex);
+int find_cycle_block_by_end_node(int nodeIndex);
+
+// Connection editing and adjacency index (flowchart_state.c)
+// Every node has a list of its outgoing and incoming connections, kept in
+// connection order, so "first connection from X" matches a scan of connections[].
+// Appends, rewires, removals, undo and redo update the lists in place; bulk
+// replacement of the arrays (load, new chart) calls invalidate_adjacency() and
+// the lists are rebuilt on the next query.
+// A removed connection stays in connections[] as a dead entry (both ends -1) so
+// the others keep their index; loops over connections[] skip it with
+// connection_is_live(). compact_connections() drops the dead entries once they
+// are the majority and is called when an edit is committed.
+int add_connection(int fromNode, int toNode);
+void set_connection(int connIndex, int fromNode, int toNode);
+void remove_connection(int connIndex);
+void remove_connections_of_node(int nodeIndex);
+void remove_node_connections(const int *nodeList, int count);
+bool connection_is_live(int connIndex);
+void compact_connections(void);
+void invalidate_adjacency(void);
+// Iterate with: for (int c = first_outgoing_connection(n); c >= 0; c = next_outgoing_connection(c))
+int first_outgoing_connection(int nodeIndex);
+int next_outgoing_connection(int connIndex);
+int first_incoming_connection(int nodeIndex);
+int next_incoming_connection(int connIndex);
+
+// Overwriting runs of records (flowchart_state.c)
+// Undo and redo overwrite a few runs of records in place. Each run is passed to
+// the unindex function of its table while it still holds the old records and
+// the old count, and to the index function once the new records and count are
+// in. The free slot lists, the adjacency lists and the block maps then stay
+// current in time proportional to the changed records. Runs are clipped to the
+// table. Only the slots in the runs get a new generation. A node that two blocks
+// name keeps its map entry only while the lower block is unchanged.
+void unindex_nodes(int first, int count);
+void index_nodes(int first, int count);
+void unindex_connections(int first, int count);
+void index_connections(int first, int count);
+void unindex_if_blocks(int first, int count);
+void index_if_blocks(int first, int count);
+void unindex_cycle_blocks(int first, int count);
+void index_cycle_blocks(int first, int count);
+
 #endif // FLOWCHART_STATE_H
@@ -0,0 +1,150 @@
+#ifdef FLOWER_FRAME_STATS
+
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "frame_stats.h"
+#include "text_renderer.h"
+
+typedef struct {
+    double phaseSeconds[FRAME_PHASE_COUNT];
+    int counts[FRAME_COUNTER_COUNT];
+} FrameSample;
+
+static const char *phaseNames[FRAME_PHASE_COUNT] = {
+    "file actions",
+    "hover",
+    "scene build",
+    "connections",
+    "nodes",
+    "text",
+    "buttons"
+};
+
+static bool overlayVisible = false;
+
+static FrameSample current;           // Accumulating since the last drawn frame
+static FrameSample lastFrame;         // What the overlay shows
+static double phaseStart[FRAME_PHASE_COUNT];
+static double frameStart = 0.0;
+
+// Ring of the last drawn frames: when each ended and how long it took
+static double frameEnds[FRAME_STATS_HISTORY];
+static double frameSeconds[FRAME_STATS_HISTORY];
+static int frameNext = 0;
+static int frameFilled = 0;
+
+void frame_stats_phase_begin(FramePhase phase) {
+    phaseStart[phase] = glfwGetTime();
+}
+
+void frame_stats_phase_end(FramePhase phase) {
+    current.phaseSeconds[phase] += glfwGetTime() - phaseStart[phase];
+}
+
+void frame_stats_count(FrameCounter counter, int amount) {
+    current.counts[counter] += amount;
+}
+
+void frame_stats_begin_frame(void) {
+    frameStart = glfwGetTime();
+}
+
+void frame_stats_end_frame(void) {
+    double now = glfwGetTime();
+    frameEnds[frameNext] = now;
+    frameSeconds[frameNext] = now - frameStart;
+    frameNext = (frameNext + 1) % FRAME_STATS_HISTORY;
+    if (frameFilled < FRAME_STATS_HISTORY) frameFilled++;
+
+    lastFrame = current;
+    current = (FrameSample){ 0 };
+}
+
+void frame_stats_toggle(void) {
+    overlayVisible = !overlayVisible;
+}
+
+static int compare_seconds(const void *a, const void *b) {
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return da < db ? -1 : (da > db);
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const double *sorted, int count, int pct) {
+    int rank = (pct * count + 99) / 100;
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1];
+}
+
+#define OVERLAY_LINES (FRAME_PHASE_COUNT + 4)
+
+void frame_stats_draw_overlay(float aspectRatio) {
+    if (!overlayVisible) return;
+
+    // Frames per second counts the frames actually drawn in the last second, so an
+    // idle editor reads close to 0 rather than the rate it could draw at
+    double now = glfwGetTime();
+    int recent = 0;
+    double sorted[FRAME_STATS_HISTORY];
+    for (int i = 0; i < frameFilled; i++) {
+        if (now - frameEnds[i] <= 1.0) recent++;
+        sorted[i] = frameSeconds[i];
+    }
+    qsort(sorted, (size_t)frameFilled, sizeof(double), compare_seconds);
+
+    char lines[OVERLAY_LINES][64];
+    int lineCount = 0;
+    snprintf(lines[lineCount++], sizeof(lines[0]), "%3d fps  (%d frames kept)", recent, frameFilled);
+    if (frameFilled > 0) {
+        snprintf(lines[lineCount++], sizeof(lines[0]), "frame p50 %.2f p95 %.2f p99 %.2f ms",
+                 percentile(sorted, frameFilled, 50) * 1000.0, percentile(sorted, frameFilled, 95) * 1000.0,
+                 percentile(sorted, frameFilled, 99) * 1000.0);
+    } else {
+        snprintf(lines[lineCount++], sizeof(lines[0]), "frame p50 - p95 - p99 - ms");
+    }
+    for (int p = 0; p < FRAME_PHASE_COUNT; p++) {
+        snprintf(lines[lineCount++], sizeof(lines[0]), "%-13s %8.3f ms", phaseNames[p],
+                 lastFrame.phaseSeconds[p] * 1000.0);
+    }
+    snprintf(lines[lineCount++], sizeof(lines[0]), "vertices %d  draw calls %d",
+             lastFrame.counts[FRAME_COUNT_VERTICES], lastFrame.counts[FRAME_COUNT_DRAW_CALLS]);
+    snprintf(lines[lineCount++], sizeof(lines[0]), "draw_text %d  state changes %d",
+             lastFrame.counts[FRAME_COUNT_TEXT_CALLS], lastFrame.counts[FRAME_COUNT_STATE_CHANGES]);
+
+    // Top-right corner, clear of the buttons on the left
+    float fontSize = 0.035f;
+    float lineHeight = fontSize * 1.4f;
+    float padding = 0.02f;
+    float textWidth = 0.0f;
+    for (int i = 0; i < lineCount; i++) {
+        float w = get_text_width(lines[i], fontSize);
+        if (w > textWidth) textWidth = w;
+    }
+    float right = aspectRatio - 0.03f;
+    float left = right - textWidth - 2.0f * padding;
+    float top = 0.97f;
+    float bottom = top - lineCount * lineHeight - 2.0f * padding;
+
+    // Translucent panel so the numbers stay readable over the chart
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glColor4f(1.0f, 1.0f, 1.0f, 0.85f);
+    glBegin(GL_QUADS);
+    glVertex2f(left, top);
+    glVertex2f(right, top);
+    glVertex2f(right, bottom);
+    glVertex2f(left, bottom);
+    glEnd();
+    glDisable(GL_BLEND);
+    frame_stats_count(FRAME_COUNT_STATE_CHANGES, 3);
+
+    for (int i = 0; i < lineCount; i++) {
+        float y = top - padding - (i + 1) * lineHeight + fontSize * 0.3f;
+        draw_text(left + padding, y, lines[i], fontSize, 0.1f, 0.1f, 0.1f);
+    }
+}
+
+#endif // FLOWER_FRAME_STATS
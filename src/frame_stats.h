@@ -0,0 +1,72 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+// Frame statistics (frame_stats.c)
+// Where the time of a frame goes: CPU milliseconds per phase, frame time
+// percentiles over the last FRAME_STATS_HISTORY frames, frames per second and
+// per-frame counts of vertices, draw calls, draw_text calls and GL state changes,
+// shown in an overlay toggled with F3.
+// Only built with FLOWER_FRAME_STATS defined (make FRAME_STATS=1); otherwise
+// every macro below expands to nothing and the instrumented code is unchanged.
+// Work done between two drawn frames (file actions, hover tests on cursor moves)
+// is credited to the next drawn frame. The overlay shows the last completed frame,
+// its own text included.
+
+typedef enum {
+    FRAME_PHASE_FILE_ACTIONS,   // process_pending_file_actions
+    FRAME_PHASE_HOVER,          // hit_connection under the cursor
+    FRAME_PHASE_SCENE_BUILD,    // Rebuilding the retained scene after a change
+    FRAME_PHASE_CONNECTIONS,    // Connection and loopback layers, hover highlight
+    FRAME_PHASE_NODES,          // Block fill, border and connector layers
+    FRAME_PHASE_TEXT,           // Chart labels (layout and drawing)
+    FRAME_PHASE_BUTTONS,        // Screen-space buttons and their text
+    FRAME_PHASE_COUNT
+} FramePhase;
+
+typedef enum {
+    FRAME_COUNT_VERTICES,       // Vertices drawn from vertex arrays
+    FRAME_COUNT_DRAW_CALLS,     // glDrawArrays calls
+    FRAME_COUNT_TEXT_CALLS,     // draw_text calls
+    FRAME_COUNT_STATE_CHANGES,  // Enables, binds, blend and line width changes
+    FRAME_COUNTER_COUNT
+} FrameCounter;
+
+// Frames kept for the percentiles
+#define FRAME_STATS_HISTORY 120
+
+#ifdef FLOWER_FRAME_STATS
+
+void frame_stats_phase_begin(FramePhase phase);
+void frame_stats_phase_end(FramePhase phase);
+void frame_stats_count(FrameCounter counter, int amount);
+
+// Bracket a drawn frame, from the hover update to the buffer swap
+void frame_stats_begin_frame(void);
+void frame_stats_end_frame(void);
+
+void frame_stats_toggle(void);
+
+// Queue the overlay text (screen space of drawButtons, before flush_text)
+void frame_stats_draw_overlay(float aspectRatio);
+
+#define FRAME_PHASE_BEGIN(phase) frame_stats_phase_begin(phase)
+#define FRAME_PHASE_END(phase) frame_stats_phase_end(phase)
+#define FRAME_COUNT(counter, amount) frame_stats_count((counter), (amount))
+#define FRAME_STATS_BEGIN_FRAME() frame_stats_begin_frame()
+#define FRAME_STATS_END_FRAME() frame_stats_end_frame()
+#define FRAME_STATS_TOGGLE() frame_stats_toggle()
+#define FRAME_STATS_DRAW_OVERLAY(aspectRatio) frame_stats_draw_overlay(aspectRatio)
+
+#else
+
+#define FRAME_PHASE_BEGIN(phase) ((void)0)
+#define FRAME_PHASE_END(phase) ((void)0)
+#define FRAME_COUNT(counter, amount) ((void)0)
+#define FRAME_STATS_BEGIN_FRAME() ((void)0)
+#define FRAME_STATS_END_FRAME() ((void)0)
+#define FRAME_STATS_TOGGLE() ((void)0)
+#define FRAME_STATS_DRAW_OVERLAY(aspectRatio) ((void)0)
+
+#endif // FLOWER_FRAME_STATS
+
+#endif // FRAME_STATS_H
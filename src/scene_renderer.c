@@ -0,0 +1,432 @@
+#include <GLFW/glfw3.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <math.h>
+#include "scene_renderer.h"
+#include "frame_stats.h"
+
+// Buffer object entry points are not in the OpenGL 1.1 headers (Windows ships
+// nothing newer), so they are declared here and loaded at run time
+#ifdef _WIN32
+#define SCENE_APIENTRY __stdcall
+#else
+#define SCENE_APIENTRY
+#endif
+
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_DYNAMIC_DRAW
+#define GL_DYNAMIC_DRAW 0x88E8
+#endif
+
+typedef void (SCENE_APIENTRY *GenBuffersProc)(GLsizei n, GLuint *buffers);
+typedef void (SCENE_APIENTRY *BindBufferProc)(GLenum target, GLuint buffer);
+typedef void (SCENE_APIENTRY *BufferDataProc)(GLenum target, ptrdiff_t size, const void *data, GLenum usage);
+
+static GenBuffersProc genBuffers = NULL;
+static BindBufferProc bindBuffer = NULL;
+static BufferDataProc bufferData = NULL;
+
+// One vertex: position and an RGBA color, 12 bytes
+typedef struct {
+    float x, y;
+    unsigned char r, g, b, a;
+} SceneVertex;
+
+typedef struct {
+    SceneVertex *vertices;
+    int count;
+    int capacity;
+    SpatialIndex cells;  // Where each shape's vertices are
+    VertexArray drawn;   // As of the last scene_end, in cell order
+} SceneBatch;
+
+static SceneBatch batches[SCENE_LAYER_COUNT];
+static unsigned char colorR = 0, colorG = 0, colorB = 0;
+static bool buffersChecked = false;
+static bool useBuffers = false;
+
+// unit_circle tables by segment count, filled on first use
+static float circleTables[SCENE_MAX_CIRCLE_SEGMENTS + 1][2 * (SCENE_MAX_CIRCLE_SEGMENTS + 1)];
+static bool circleReady[SCENE_MAX_CIRCLE_SEGMENTS + 1];
+
+// Template meshes: vertices in the primitive order of their layer, with points
+// relative to the block
+typedef struct {
+    TemplatePoint p;
+    unsigned char r, g, b;   // Unused on SCENE_FILLS (the instance color)
+} TemplateVertex;
+
+typedef struct {
+    TemplateVertex *vertices;
+    int count;
+    int capacity;
+    TemplatePoint reach;   // Largest magnitude of each term over the vertices
+} TemplateMesh;
+
+typedef struct {
+    TemplateUnit unit;
+    TemplateMesh layers[SCENE_LAYER_COUNT];
+} SceneTemplate;
+
+// One block to draw with a template
+typedef struct {
+    float x, y;
+    float width, height;
+    unsigned char r, g, b;
+} SceneInstance;
+
+typedef struct {
+    SceneInstance *items;
+    int count;
+    int capacity;
+} InstanceList;
+
+static SceneTemplate templates[SCENE_MAX_TEMPLATES];
+static InstanceList instances[SCENE_MAX_TEMPLATES];   // Since scene_begin
+static int recordingTemplate = -1;
+
+static const GLenum layerMode[SCENE_LAYER_COUNT] = {
+    GL_LINES,       // SCENE_CONNECTIONS
+    GL_LINES,       // SCENE_LOOPBACKS
+    GL_TRIANGLES,   // SCENE_FILLS
+    GL_LINES,       // SCENE_BORDERS
+    GL_TRIANGLES    // SCENE_CONNECTORS
+};
+
+// Pick buffer objects when the context has them: core since OpenGL 1.5, or the
+// ARB extension before that. A non-NULL entry point alone proves nothing, since
+// some loaders hand one out for any name.
+static void check_buffer_support(void) {
+    buffersChecked = true;
+
+    const char *version = (const char*)glGetString(GL_VERSION);
+    int major = 0, minor = 0;
+    if (version) {
+        sscanf(version, "%d.%d", &major, &minor);
+    }
+
+    if (major > 1 || (major == 1 && minor >= 5)) {
+        genBuffers = (GenBuffersProc)glfwGetProcAddress("glGenBuffers");
+        bindBuffer = (BindBufferProc)glfwGetProcAddress("glBindBuffer");
+        bufferData = (BufferDataProc)glfwGetProcAddress("glBufferData");
+    } else if (glfwExtensionSupported("GL_ARB_vertex_buffer_object")) {
+        genBuffers = (GenBuffersProc)glfwGetProcAddress("glGenBuffersARB");
+        bindBuffer = (BindBufferProc)glfwGetProcAddress("glBindBufferARB");
+        bufferData = (BufferDataProc)glfwGetProcAddress("glBufferDataARB");
+    }
+    useBuffers = genBuffers && bindBuffer && bufferData;
+}
+
+static SceneVertex* reserve_vertices(SceneLayer layer, int count) {
+    SceneBatch *batch = &batches[layer];
+    if (batch->count + count > batch->capacity) {
+        int newCapacity = batch->capacity > 0 ? batch->capacity : 1024;
+        while (newCapacity < batch->count + count) {
+            newCapacity *= 2;
+        }
+        SceneVertex *grown = realloc(batch->vertices, (size_t)newCapacity * sizeof(SceneVertex));
+        if (!grown) {
+            fprintf(stderr, "Out of memory growing scene layer to %d vertices\n", newCapacity);
+            return NULL;
+        }
+        batch->vertices = grown;
+        batch->capacity = newCapacity;
+    }
+    SceneVertex *out = &batch->vertices[batch->count];
+    batch->count += count;
+    return out;
+}
+
+static void set_vertex(SceneVertex *v, float x, float y) {
+    v->x = x;
+    v->y = y;
+    v->r = colorR;
+    v->g = colorG;
+    v->b = colorB;
+    v->a = 255;
+}
+
+static unsigned char color_byte(float c) {
+    if (c <= 0.0f) return 0;
+    if (c >= 1.0f) return 255;
+    return (unsigned char)(c * 255.0f + 0.5f);
+}
+
+const float* unit_circle(int segments) {
+    if (segments < 3) segments = 3;
+    if (segments > SCENE_MAX_CIRCLE_SEGMENTS) segments = SCENE_MAX_CIRCLE_SEGMENTS;
+
+    float *table = circleTables[segments];
+    if (!circleReady[segments]) {
+        for (int i = 0; i <= segments; i++) {
+            float a = (float)i / (float)segments * 6.2831853f;
+            table[i * 2] = cosf(a);
+            table[i * 2 + 1] = sinf(a);
+        }
+        circleReady[segments] = true;
+    }
+    return table;
+}
+
+void scene_begin(void) {
+    for (int i = 0; i < SCENE_LAYER_COUNT; i++) {
+        batches[i].count = 0;
+        spatial_index_begin(&batches[i].cells);
+    }
+    for (int id = 0; id < SCENE_MAX_TEMPLATES; id++) {
+        instances[id].count = 0;
+    }
+}
+
+void vertex_array_upload(VertexArray *array, const void *data, int count, size_t vertexSize) {
+    if (!buffersChecked) {
+        check_buffer_support();
+    }
+
+    array->data = data;
+    array->count = count;
+    if (!useBuffers) return;
+
+    if (array->buffer == 0) {
+        genBuffers(1, &array->buffer);
+    }
+    bindBuffer(GL_ARRAY_BUFFER, array->buffer);
+    bufferData(GL_ARRAY_BUFFER, (ptrdiff_t)count * (ptrdiff_t)vertexSize, data, GL_DYNAMIC_DRAW);
+    bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+const char* vertex_array_bind(const VertexArray *array) {
+    if (array->buffer == 0) {
+        return (const char*)array->data;
+    }
+    bindBuffer(GL_ARRAY_BUFFER, array->buffer);
+    FRAME_COUNT(FRAME_COUNT_STATE_CHANGES, 1);
+    return NULL;  // Offsets into the bound buffer
+}
+
+void vertex_array_unbind(const VertexArray *array) {
+    if (array->buffer != 0) {
+        bindBuffer(GL_ARRAY_BUFFER, 0);
+        FRAME_COUNT(FRAME_COUNT_STATE_CHANGES, 1);
+    }
+}
+
+void scene_color(float r, float g, float b) {
+    colorR = color_byte(r);
+    colorG = color_byte(g);
+    colorB = color_byte(b);
+}
+
+void scene_line(SceneLayer layer, float x0, float y0, float x1, float y1) {
+    // Long lines are cut into pieces no longer than a cell, so a connection
+    // running down the whole chart is only drawn where it is on screen
+    float dx = x1 - x0;
+    float dy = y1 - y0;
+    float length = fabsf(dx) > fabsf(dy) ? fabsf(dx) : fabsf(dy);
+    int pieces = (int)ceilf(length / SPATIAL_CELL_SIZE);
+    if (pieces < 1) pieces = 1;
+
+    SceneBatch *batch = &batches[layer];
+    for (int i = 0; i < pieces; i++) {
+        float ax = x0 + dx * (float)i / (float)pieces;
+        float ay = y0 + dy * (float)i / (float)pieces;
+        float bx = i + 1 == pieces ? x1 : x0 + dx * (float)(i + 1) / (float)pieces;
+        float by = i + 1 == pieces ? y1 : y0 + dy * (float)(i + 1) / (float)pieces;
+
+        int first = batch->count;
+        SceneVertex *v = reserve_vertices(layer, 2);
+        if (!v) return;
+        set_vertex(&v[0], ax, ay);
+        set_vertex(&v[1], bx, by);
+        spatial_index_add(&batch->cells, (ax + bx) * 0.5f, (ay + by) * 0.5f,
+                          fabsf(bx - ax) * 0.5f, fabsf(by - ay) * 0.5f, first, 2);
+    }
+}
+
+// Add a vertex to the template being recorded
+static void add_template_vertex(SceneLayer layer, TemplatePoint p) {
+    TemplateMesh *mesh = &templates[recordingTemplate].layers[layer];
+    if (mesh->count == mesh->capacity) {
+        int newCapacity = mesh->capacity > 0 ? mesh->capacity * 2 : 64;
+        TemplateVertex *grown = realloc(mesh->vertices, (size_t)newCapacity * sizeof(TemplateVertex));
+        if (!grown) {
+            fprintf(stderr, "Out of memory growing template %d to %d vertices\n", recordingTemplate, newCapacity);
+            return;
+        }
+        mesh->vertices = grown;
+        mesh->capacity = newCapacity;
+    }
+    TemplateVertex *v = &mesh->vertices[mesh->count++];
+    v->p = p;
+    if (fabsf(p.sx) > mesh->reach.sx) mesh->reach.sx = fabsf(p.sx);
+    if (fabsf(p.sy) > mesh->reach.sy) mesh->reach.sy = fabsf(p.sy);
+    if (fabsf(p.kx) > mesh->reach.kx) mesh->reach.kx = fabsf(p.kx);
+    if (fabsf(p.ky) > mesh->reach.ky) mesh->reach.ky = fabsf(p.ky);
+    if (fabsf(p.ax) > mesh->reach.ax) mesh->reach.ax = fabsf(p.ax);
+    if (fabsf(p.ay) > mesh->reach.ay) mesh->reach.ay = fabsf(p.ay);
+    v->r = colorR;
+    v->g = colorG;
+    v->b = colorB;
+}
+
+void scene_template_begin(int id, TemplateUnit unit) {
+    if (id < 0 || id >= SCENE_MAX_TEMPLATES) {
+        recordingTemplate = -1;
+        return;
+    }
+    recordingTemplate = id;
+    templates[id].unit = unit;
+    for (int i = 0; i < SCENE_LAYER_COUNT; i++) {
+        TemplateMesh *mesh = &templates[id].layers[i];
+        mesh->count = 0;
+        mesh->reach = (TemplatePoint){0};
+    }
+}
+
+void scene_template_end(void) {
+    recordingTemplate = -1;
+}
+
+void scene_template_polygon(SceneLayer layer, const TemplatePoint *points, int count) {
+    if (recordingTemplate < 0 || count < 3) return;
+
+    if (layerMode[layer] == GL_LINES) {
+        // Outline: one segment per edge, closing back to the first point
+        for (int i = 0; i < count; i++) {
+            add_template_vertex(layer, points[i]);
+            add_template_vertex(layer, points[(i + 1) % count]);
+        }
+    } else {
+        // Fill: fan of triangles around the first point
+        for (int i = 1; i < count - 1; i++) {
+            add_template_vertex(layer, points[0]);
+            add_template_vertex(layer, points[i]);
+            add_template_vertex(layer, points[i + 1]);
+        }
+    }
+}
+
+void scene_template_circle(SceneLayer layer, TemplatePoint centre, float unitRadius, float worldRadius, int segments) {
+    if (segments < 3) segments = 3;
+    if (segments > SCENE_MAX_CIRCLE_SEGMENTS) segments = SCENE_MAX_CIRCLE_SEGMENTS;
+    const float *circle = unit_circle(segments);
+
+    TemplatePoint points[SCENE_MAX_CIRCLE_SEGMENTS];
+    for (int i = 0; i < segments; i++) {
+        float c = circle[i * 2];
+        float s = circle[i * 2 + 1];
+        points[i] = centre;
+        points[i].kx += c * unitRadius;
+        points[i].ky += s * unitRadius;
+        points[i].ax += c * worldRadius;
+        points[i].ay += s * worldRadius;
+    }
+    scene_template_polygon(layer, points, segments);
+}
+
+void scene_instance(int id, float x, float y, float width, float height) {
+    if (id < 0 || id >= SCENE_MAX_TEMPLATES) return;
+
+    InstanceList *list = &instances[id];
+    if (list->count == list->capacity) {
+        int newCapacity = list->capacity > 0 ? list->capacity * 2 : 256;
+        SceneInstance *grown = realloc(list->items, (size_t)newCapacity * sizeof(SceneInstance));
+        if (!grown) {
+            fprintf(stderr, "Out of memory growing template %d to %d instances\n", id, newCapacity);
+            return;
+        }
+        list->items = grown;
+        list->capacity = newCapacity;
+    }
+    SceneInstance *instance = &list->items[list->count++];
+    instance->x = x;
+    instance->y = y;
+    instance->width = width;
+    instance->height = height;
+    instance->r = colorR;
+    instance->g = colorG;
+    instance->b = colorB;
+}
+
+// Place every instance of a template in the layers: one scaled and translated
+// copy of the template mesh per instance
+static void expand_instances(int id) {
+    const SceneTemplate *t = &templates[id];
+    const InstanceList *list = &instances[id];
+
+    for (int layer = 0; layer < SCENE_LAYER_COUNT; layer++) {
+        const TemplateMesh *mesh = &t->layers[layer];
+        if (mesh->count == 0) continue;
+
+        SceneBatch *batch = &batches[layer];
+        int first = batch->count;
+        SceneVertex *v = reserve_vertices((SceneLayer)layer, mesh->count * list->count);
+        if (!v) continue;
+        bool fill = (layer == SCENE_FILLS);
+        const TemplatePoint *reach = &mesh->reach;
+
+        for (int i = 0; i < list->count; i++) {
+            const SceneInstance *instance = &list->items[i];
+            float unit = instance->width;
+            if (t->unit == TEMPLATE_UNIT_SHORTER_SIDE && instance->height < unit) {
+                unit = instance->height;
+            }
+            for (int k = 0; k < mesh->count; k++) {
+                const TemplateVertex *tv = &mesh->vertices[k];
+                v->x = instance->x + tv->p.sx * instance->width + tv->p.kx * unit + tv->p.ax;
+                v->y = instance->y + tv->p.sy * instance->height + tv->p.ky * unit + tv->p.ay;
+                v->r = fill ? instance->r : tv->r;
+                v->g = fill ? instance->g : tv->g;
+                v->b = fill ? instance->b : tv->b;
+                v->a = 255;
+                v++;
+            }
+            spatial_index_add(&batch->cells, instance->x, instance->y,
+                              reach->sx * instance->width + reach->kx * unit + reach->ax,
+                              reach->sy * instance->height + reach->ky * unit + reach->ay,
+                              first + i * mesh->count, mesh->count);
+        }
+    }
+}
+
+void scene_end(void) {
+    for (int id = 0; id < SCENE_MAX_TEMPLATES; id++) {
+        if (instances[id].count > 0) {
+            expand_instances(id);
+        }
+    }
+    for (int i = 0; i < SCENE_LAYER_COUNT; i++) {
+        SceneBatch *batch = &batches[i];
+        const void *sorted = spatial_index_sort(&batch->cells, batch->vertices, batch->count, sizeof(SceneVertex));
+        vertex_array_upload(&batch->drawn, sorted, batch->count, sizeof(SceneVertex));
+    }
+}
+
+void scene_draw_layer(SceneLayer layer, const WorldRect *view) {
+    SceneBatch *batch = &batches[layer];
+    const VertexArray *array = &batch->drawn;
+    if (array->count == 0) return;
+
+    const VertexRange *ranges;
+    int rangeCount = spatial_index_query(&batch->cells, view, &ranges);
+    if (rangeCount == 0) return;
+
+    const char *base = vertex_array_bind(array);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(2, GL_FLOAT, sizeof(SceneVertex), base + offsetof(SceneVertex, x));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(SceneVertex), base + offsetof(SceneVertex, r));
+    for (int i = 0; i < rangeCount; i++) {
+        glDrawArrays(layerMode[layer], ranges[i].first, ranges[i].count);
+        FRAME_COUNT(FRAME_COUNT_VERTICES, ranges[i].count);
+    }
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    FRAME_COUNT(FRAME_COUNT_DRAW_CALLS, rangeCount);
+    FRAME_COUNT(FRAME_COUNT_STATE_CHANGES, 4);  // Client state on and off
+    vertex_array_unbind(array);
+}
@@ -0,0 +1,108 @@
+#ifndef SCENE_RENDERER_H
+#define SCENE_RENDERER_H
+
+#include <stddef.h>
+#include "spatial_index.h"
+
+// Vertices uploaded once and drawn on many frames. They live in a vertex buffer
+// object when the driver has them (OpenGL 1.5 or GL_ARB_vertex_buffer_object)
+// and are read from the caller's memory otherwise, which only needs OpenGL 1.1;
+// the caller keeps that memory unchanged until the next upload.
+typedef struct {
+    unsigned int buffer;   // 0 = drawn from data
+    const void *data;
+    int count;
+} VertexArray;
+
+// Hand count vertices of vertexSize bytes to OpenGL (needs a current context)
+void vertex_array_upload(VertexArray *array, const void *data, int count, size_t vertexSize);
+
+// Bind for drawing. Returns the base address to add attribute offsets to for
+// glVertexPointer and friends; unbind once the draw calls are made.
+const char* vertex_array_bind(const VertexArray *array);
+void vertex_array_unbind(const VertexArray *array);
+
+// Most segments a unit_circle table can have
+#define SCENE_MAX_CIRCLE_SEGMENTS 64
+
+// Retained geometry of the chart, drawn one layer at a time
+typedef enum {
+    SCENE_CONNECTIONS,   // Connection lines (lines)
+    SCENE_LOOPBACKS,     // Cycle loopback brackets (lines)
+    SCENE_FILLS,         // Block bodies (triangles)
+    SCENE_BORDERS,       // Block outlines (lines)
+    SCENE_CONNECTORS,    // Connector dots (triangles)
+    SCENE_LAYER_COUNT
+} SceneLayer;
+
+// Retained renderer (scene_renderer.c)
+// The chart is turned into one vertex array per layer (position and color per
+// vertex) when it changes, ordered by a SpatialIndex, and every frame draws the
+// visible runs of each layer with glDrawArrays from a VertexArray instead of
+// sending vertices one at a time.
+// Building works like immediate mode: set a color, then add lines or block
+// instances. Shapes added to a line layer are outlines, shapes added to a triangle
+// layer are filled.
+
+// Throw away the geometry of the last build
+void scene_begin(void);
+
+// Hand the geometry built since scene_begin to OpenGL (needs a current context)
+void scene_end(void);
+
+// Color of the shapes added next
+void scene_color(float r, float g, float b);
+
+// A single segment (line layers only)
+void scene_line(SceneLayer layer, float x0, float y0, float x1, float y1);
+
+// Template meshes (scene_renderer.c)
+// Every block of a type has the same shapes, only placed and sized differently.
+// A template records those shapes once, with each point given relative to the
+// block (TemplatePoint), and the scene keeps one instance per block: centre, size
+// and fill color. scene_end turns the instances of each template into vertices of
+// the layers, so blocks of every type are drawn together, layer by layer.
+
+// Most templates; ids run from 0 to SCENE_MAX_TEMPLATES - 1
+#define SCENE_MAX_TEMPLATES 16
+
+// What the k terms of a TemplatePoint are multiples of
+typedef enum {
+    TEMPLATE_UNIT_WIDTH,          // The block's width
+    TEMPLATE_UNIT_SHORTER_SIDE    // The smaller of the block's width and height
+} TemplateUnit;
+
+// Point of a template, as an offset from the block centre of
+// (sx * width + kx * unit + ax, sy * height + ky * unit + ay)
+typedef struct {
+    float sx, sy;   // Fractions of the width and height
+    float kx, ky;   // Multiples of the template unit
+    float ax, ay;   // World units
+} TemplatePoint;
+
+// Record template id (replacing what it held); shapes go to it until
+// scene_template_end. Templates survive scene_begin.
+void scene_template_begin(int id, TemplateUnit unit);
+void scene_template_end(void);
+
+// Shapes of the template being recorded. Shapes on SCENE_FILLS take the fill
+// color of each instance, the others the color set with scene_color.
+void scene_template_polygon(SceneLayer layer, const TemplatePoint *points, int count);
+
+// Circle of unitRadius template units plus worldRadius world units, made of the
+// given number of segments
+void scene_template_circle(SceneLayer layer, TemplatePoint centre, float unitRadius, float worldRadius, int segments);
+
+// One block drawn with template id, filled with the current color
+void scene_instance(int id, float x, float y, float width, float height);
+
+// Unit circle of the given number of segments (3 to SCENE_MAX_CIRCLE_SEGMENTS) as
+// segments + 1 cos,sin pairs from angle 0 counter-clockwise, the last repeating the
+// first. Each table is computed once.
+const float* unit_circle(int segments);
+
+// Draw one layer in the current modelview transform (line width is up to the
+// caller): only the shapes that may touch view, or all of them if view is NULL
+void scene_draw_layer(SceneLayer layer, const WorldRect *view);
+
+#endif // SCENE_RENDERER_H
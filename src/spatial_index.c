@@ -0,0 +1,257 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "spatial_index.h"
+
+// Grids spanning more cells than this per item are sorted with qsort instead of
+// counting, so one far-off block cannot make the count table huge
+#define COUNTING_CELLS_PER_ITEM 4
+
+// Row or column of the cell holding coordinate v
+static int cell_coord(float v) {
+    float c = floorf(v / SPATIAL_CELL_SIZE);
+    if (!(c > -1e9f)) return -1000000000;  // Also catches NaN
+    if (c > 1e9f) return 1000000000;
+    return (int)c;
+}
+
+static int compare_items(const void *a, const void *b) {
+    const SpatialItem *ia = (const SpatialItem*)a;
+    const SpatialItem *ib = (const SpatialItem*)b;
+    if (ia->row != ib->row) return ia->row < ib->row ? -1 : 1;
+    if (ia->col != ib->col) return ia->col < ib->col ? -1 : 1;
+    return ia->first < ib->first ? -1 : (ia->first > ib->first);  // Keep the order added
+}
+
+void spatial_index_begin(SpatialIndex *index) {
+    index->itemCount = 0;
+    index->reachX = 0.0f;
+    index->reachY = 0.0f;
+}
+
+void spatial_index_add(SpatialIndex *index, float x, float y, float halfW, float halfH, int first, int count) {
+    if (count <= 0) return;
+
+    if (index->itemCount == index->itemCapacity) {
+        int newCapacity = index->itemCapacity > 0 ? index->itemCapacity * 2 : 1024;
+        SpatialItem *grown = realloc(index->items, (size_t)newCapacity * sizeof(SpatialItem));
+        if (!grown) {
+            // The item is lost; spatial_index_sort notices and leaves the vertices unsorted
+            fprintf(stderr, "Out of memory growing spatial index to %d items\n", newCapacity);
+            return;
+        }
+        index->items = grown;
+        index->itemCapacity = newCapacity;
+    }
+
+    SpatialItem *item = &index->items[index->itemCount++];
+    item->row = cell_coord(y);
+    item->col = cell_coord(x);
+    item->first = first;
+    item->count = count;
+
+    // Queries widen the view by the furthest reach, so an item is found whenever
+    // any part of it is in view
+    if (halfW > index->reachX) index->reachX = halfW;
+    if (halfH > index->reachY) index->reachY = halfH;
+}
+
+// Order of the items by cell (stable) as indices into items, or NULL if out of memory
+static int* sort_item_order(SpatialIndex *index) {
+    int n = index->itemCount;
+    int *order = malloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+    if (!order) return NULL;
+
+    int minRow = index->items[0].row, maxRow = minRow;
+    int minCol = index->items[0].col, maxCol = minCol;
+    for (int i = 1; i < n; i++) {
+        const SpatialItem *item = &index->items[i];
+        if (item->row < minRow) minRow = item->row;
+        if (item->row > maxRow) maxRow = item->row;
+        if (item->col < minCol) minCol = item->col;
+        if (item->col > maxCol) maxCol = item->col;
+    }
+    long long cols = (long long)maxCol - minCol + 1;
+    long long cellSpan = ((long long)maxRow - minRow + 1) * cols;
+
+    int *counts = NULL;
+    if (cellSpan <= (long long)n * COUNTING_CELLS_PER_ITEM + 4096) {
+        counts = calloc((size_t)cellSpan + 1, sizeof(int));
+    }
+    if (counts) {
+        // Counting sort on the cell, which keeps the order added within a cell
+        for (int i = 0; i < n; i++) {
+            long long key = (long long)(index->items[i].row - minRow) * cols + (index->items[i].col - minCol);
+            counts[key + 1]++;
+        }
+        for (long long k = 1; k <= cellSpan; k++) {
+            counts[k] += counts[k - 1];
+        }
+        for (int i = 0; i < n; i++) {
+            long long key = (long long)(index->items[i].row - minRow) * cols + (index->items[i].col - minCol);
+            order[counts[key]++] = i;
+        }
+        free(counts);
+    } else {
+        qsort(index->items, (size_t)n, sizeof(SpatialItem), compare_items);
+        for (int i = 0; i < n; i++) {
+            order[i] = i;
+        }
+    }
+    return order;
+}
+
+static bool grow_cells(SpatialIndex *index, int needed) {
+    if (needed <= index->cellCapacity) return true;
+
+    int newCapacity = index->cellCapacity > 0 ? index->cellCapacity : 256;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    SpatialCell *grown = realloc(index->cells, (size_t)newCapacity * sizeof(SpatialCell));
+    if (!grown) {
+        fprintf(stderr, "Out of memory growing spatial index to %d cells\n", newCapacity);
+        return false;
+    }
+    index->cells = grown;
+    index->cellCapacity = newCapacity;
+    return true;
+}
+
+const void* spatial_index_sort(SpatialIndex *index, const void *vertices, int vertexCount, size_t vertexSize) {
+    index->vertexCount = vertexCount;
+    index->cellCount = 0;
+    index->cellsValid = false;
+    if (vertexCount == 0 || index->itemCount == 0) {
+        index->cellsValid = (vertexCount == 0);
+        return vertices;
+    }
+
+    // Every vertex has to belong to exactly one item, or runs would be lost
+    int covered = 0;
+    for (int i = 0; i < index->itemCount; i++) {
+        if (index->items[i].first != covered) return vertices;
+        covered += index->items[i].count;
+    }
+    if (covered != vertexCount) return vertices;
+
+    size_t bytes = (size_t)vertexCount * vertexSize;
+    if (bytes > index->sortedBytes) {
+        void *grown = realloc(index->sorted, bytes);
+        if (!grown) {
+            fprintf(stderr, "Out of memory sorting %d vertices by cell\n", vertexCount);
+            return vertices;
+        }
+        index->sorted = grown;
+        index->sortedBytes = bytes;
+    }
+
+    int *order = sort_item_order(index);
+    if (!order) return vertices;
+
+    const char *from = (const char*)vertices;
+    char *to = (char*)index->sorted;
+    int out = 0;
+    for (int i = 0; i < index->itemCount; i++) {
+        const SpatialItem *item = &index->items[order[i]];
+        SpatialCell *last = index->cellCount > 0 ? &index->cells[index->cellCount - 1] : NULL;
+        if (!last || last->row != item->row || last->col != item->col) {
+            if (!grow_cells(index, index->cellCount + 1)) {
+                free(order);
+                index->cellCount = 0;
+                return vertices;
+            }
+            SpatialCell *cell = &index->cells[index->cellCount++];
+            cell->row = item->row;
+            cell->col = item->col;
+            cell->first = out;
+        }
+        memcpy(to + (size_t)out * vertexSize, from + (size_t)item->first * vertexSize, (size_t)item->count * vertexSize);
+        out += item->count;
+    }
+    free(order);
+
+    index->cellsValid = true;
+    return index->sorted;
+}
+
+// First cell at or after (row, col)
+static int lower_bound(const SpatialIndex *index, int row, int col) {
+    int lo = 0, hi = index->cellCount;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        const SpatialCell *cell = &index->cells[mid];
+        if (cell->row < row || (cell->row == row && cell->col < col)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static bool add_range(SpatialIndex *index, int *count, int first, int end) {
+    if (*count > 0) {
+        VertexRange *last = &index->ranges[*count - 1];
+        if (last->first + last->count == first) {
+            last->count = end - last->first;
+            return true;
+        }
+    }
+    if (*count == index->rangeCapacity) {
+        int newCapacity = index->rangeCapacity > 0 ? index->rangeCapacity * 2 : 16;
+        VertexRange *grown = realloc(index->ranges, (size_t)newCapacity * sizeof(VertexRange));
+        if (!grown) return false;
+        index->ranges = grown;
+        index->rangeCapacity = newCapacity;
+    }
+    index->ranges[*count].first = first;
+    index->ranges[*count].count = end - first;
+    (*count)++;
+    return true;
+}
+
+int spatial_index_query(SpatialIndex *index, const WorldRect *view, const VertexRange **ranges) {
+    int count = 0;
+    *ranges = index->ranges;
+    if (index->vertexCount == 0) return 0;
+
+    if (!view || !index->cellsValid) {
+        add_range(index, &count, 0, index->vertexCount);
+        *ranges = index->ranges;
+        return count;
+    }
+    if (index->cellCount == 0) return 0;
+
+    int row0 = cell_coord(view->minY - index->reachY);
+    int row1 = cell_coord(view->maxY + index->reachY);
+    int col0 = cell_coord(view->minX - index->reachX);
+    int col1 = cell_coord(view->maxX + index->reachX);
+    if (row0 < index->cells[0].row) row0 = index->cells[0].row;
+    if (row1 > index->cells[index->cellCount - 1].row) row1 = index->cells[index->cellCount - 1].row;
+
+    // Cells are in row then column order, so the visible cells of a row are one run
+    for (int row = row0; row <= row1; row++) {
+        int lo = lower_bound(index, row, col0);
+        int hi = lower_bound(index, row, col1 + 1);
+        if (lo >= hi) continue;
+        int end = hi < index->cellCount ? index->cells[hi].first : index->vertexCount;
+        if (!add_range(index, &count, index->cells[lo].first, end)) {
+            // Out of memory: draw everything rather than a partial screen
+            count = 0;
+            add_range(index, &count, 0, index->vertexCount);
+            break;
+        }
+    }
+    *ranges = index->ranges;
+    return count;
+}
+
+void free_spatial_index(SpatialIndex *index) {
+    free(index->items);
+    free(index->cells);
+    free(index->sorted);
+    free(index->ranges);
+    memset(index, 0, sizeof(*index));
+}
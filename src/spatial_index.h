@@ -0,0 +1,73 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Side of a grid cell in world units (about two thirds of the visible height)
+#define SPATIAL_CELL_SIZE 2.0f
+
+// Axis-aligned rectangle in world coordinates
+typedef struct {
+    float minX, minY, maxX, maxY;
+} WorldRect;
+
+// Run of vertices [first, first + count)
+typedef struct {
+    int first;
+    int count;
+} VertexRange;
+
+typedef struct {
+    int row, col;
+    int first, count;   // Vertices of the item in the unsorted array
+} SpatialItem;
+
+typedef struct {
+    int row, col;
+    int first;          // Vertices of the cell in the sorted array
+} SpatialCell;
+
+// Spatial index (spatial_index.c)
+// Vertices built for the whole chart are filed in a uniform grid of world cells
+// by the point each item (a block, a piece of a line, a label) is centred on.
+// Sorting then reorders the vertices so every cell is one contiguous run, cells in
+// row then column order, and a query for the visible rectangle finds the cells of
+// each visible row by binary search. Drawing a screenful of a huge chart costs a
+// handful of draw calls and touches only the vertices on screen.
+typedef struct {
+    SpatialItem *items;       // Since spatial_index_begin, in the order added
+    int itemCount;
+    int itemCapacity;
+    SpatialCell *cells;       // Non-empty cells as of the last sort
+    int cellCount;
+    int cellCapacity;
+    bool cellsValid;          // False if the last sort could not file every vertex
+    int vertexCount;          // Vertices given to the last sort
+    void *sorted;
+    size_t sortedBytes;
+    float reachX, reachY;     // Furthest any item reaches past its centre
+    VertexRange *ranges;      // Result of the last query
+    int rangeCapacity;
+} SpatialIndex;
+
+// Forget the items of the last build (memory is kept)
+void spatial_index_begin(SpatialIndex *index);
+
+// File count vertices starting at first, centred on x,y and reaching at most
+// halfW, halfH from it. Items must be added in vertex order, covering every vertex.
+void spatial_index_add(SpatialIndex *index, float x, float y, float halfW, float halfH, int first, int count);
+
+// Copy the vertexCount vertices of vertexSize bytes into cell order. Returns the
+// sorted vertices (owned by the index and valid until the next sort), or the
+// vertices as given if they could not be sorted, in which case queries return
+// all of them.
+const void* spatial_index_sort(SpatialIndex *index, const void *vertices, int vertexCount, size_t vertexSize);
+
+// Runs of sorted vertices that may touch view, adjacent runs merged. Returns the
+// number of runs in *ranges, valid until the next query.
+int spatial_index_query(SpatialIndex *index, const WorldRect *view, const VertexRange **ranges);
+
+void free_spatial_index(SpatialIndex *index);
+
+#endif // SPATIAL_INDEX_H
@@ -2,8 +2,10 @@
 #include "../imports/stb_truetype.h"
 #include "text_renderer.h"
 #include "embedded_font.h"
+#include "frame_stats.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <time.h>
 #include <GL/gl.h>
@@ -25,8 +27,20 @@ static float aspect_ratio = 1.333f;  // Default to 800/600
 static float y_scale = 1.0f;  // Y scaling factor to maintain original proportions
 static float flowchart_scale = 1.0f;  // Flowchart scale factor (for block labels only)
 
+// Glyph quads queued by draw_text until flush_text, in window pixels
+static TextBuffer frame_text = { NULL, 0, 0 };
+
+// Set while draw_text is captured into a buffer in world coordinates
+static TextBuffer *capture_text = NULL;
+
+// Bumped when the window size or aspect ratio changes the pixel size of text
+static unsigned int metrics_generation = 1;
+
 // Set window dimensions (call when window is created or resized)
 void text_renderer_set_window_size(int width, int height) {
+    if (width != window_width || height != window_height) {
+        metrics_generation++;
+    }
     window_width = width;
     window_height = height;
 }
@@ -39,6 +53,9 @@ void text_renderer_set_scroll_offsets(double offsetX, double offsetY) {
 
 // Set aspect ratio (call when window size changes)
 void text_renderer_set_aspect_ratio(float aspectRatio) {
+    if (aspectRatio != aspect_ratio) {
+        metrics_generation++;
+    }
     aspect_ratio = aspectRatio;
 }
 
@@ -112,6 +129,7 @@ int init_text_renderer(const char* fontPath) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     
     font_initialized = 1;
+    metrics_generation++;
     if (fontPath == NULL) {
         printf("Text renderer initialized successfully with embedded font\n");
     } else {
@@ -125,33 +143,114 @@ void cleanup_text_renderer(void) {
         glDeleteTextures(1, &font_texture);
         font_texture = 0;
     }
+    free_text_buffer(&frame_text);
     font_initialized = 0;
 }
 
-float get_text_width(const char* text, float fontSize) {
-    if (!font_initialized || !text) return 0.0f;
-    
-    // Convert fontSize from normalized coordinates to pixels (same as draw_text)
+// Font size in pixels for a size in normalized coordinates (shared by
+// get_text_width and draw_text so measured and drawn text always agree)
+static float font_size_pixels(float fontSize) {
     // fontSize is in normalized coordinates (typically 0.01-0.1), convert to pixels
     // Normalized coordinates go from -1 to 1, so total range is 2.0
     // For height, we use window_height to convert
+    // Apply flowchart scale to fontSize for block labels (but not menu/button labels)
     float fontSizeScaled = fontSize * flowchart_scale;
     float fontSizePixels = (fontSizeScaled * window_height) / 2.0f;  // Convert normalized height to pixels
-    if (fontSizePixels < 12.0f) fontSizePixels = 18.0f;  // Minimum readable size (same as draw_text)
-    
-    // Calculate scale based on pixel font size vs baked font size (32 pixels)
-    float scale = fontSizePixels / 32.0f;  // 32.0 is the baked font size
+    if (fontSizePixels < 12.0f) fontSizePixels = 18.0f;  // Minimum readable size
+    return fontSizePixels;
+}
+
+// Index of a character in the baked glyphs, or -1 if it was not baked
+static int glyph_index(char c) {
+    int code = (unsigned char)c;
+    return (code >= FIRST_CHAR && code < FIRST_CHAR + NUM_CHARS) ? code - FIRST_CHAR : -1;
+}
+
+// Advance of a string at the baked size (32 pixels), from the baked glyph metrics
+static float text_advance(const char* text) {
     float width = 0.0f;
-    
     for (const char* c = text; *c != '\0'; ++c) {
-        if (*c >= FIRST_CHAR && *c < FIRST_CHAR + NUM_CHARS) {
-            stbtt_bakedchar* b = &cdata[*c - FIRST_CHAR];
-            width += b->xadvance * scale;
-        } else if (*c == ' ') {
-            // Space character
-            width += 8.0f * scale;  // Approximate space width
+        int glyph = glyph_index(*c);
+        if (glyph >= 0) {
+            width += cdata[glyph].xadvance;
         }
     }
+    return width;
+}
+
+TextVertex* reserve_text_vertices(TextBuffer *buffer, int count) {
+    if (buffer->count + count > buffer->capacity) {
+        int newCapacity = buffer->capacity > 0 ? buffer->capacity : 1024;
+        while (newCapacity < buffer->count + count) {
+            newCapacity *= 2;
+        }
+        TextVertex *grown = realloc(buffer->vertices, (size_t)newCapacity * sizeof(TextVertex));
+        if (!grown) {
+            fprintf(stderr, "Out of memory growing text buffer to %d vertices\n", newCapacity);
+            return NULL;
+        }
+        buffer->vertices = grown;
+        buffer->capacity = newCapacity;
+    }
+    TextVertex *out = &buffer->vertices[buffer->count];
+    buffer->count += count;
+    return out;
+}
+
+void free_text_buffer(TextBuffer *buffer) {
+    free(buffer->vertices);
+    buffer->vertices = NULL;
+    buffer->count = 0;
+    buffer->capacity = 0;
+}
+
+void text_renderer_capture(TextBuffer *buffer) {
+    capture_text = buffer;
+}
+
+unsigned int text_metrics_generation(void) {
+    return metrics_generation;
+}
+
+// Append the glyph quads of a string to a captured buffer in world coordinates.
+// The glyphs are laid out from a whole-pixel origin, so the quads come out the
+// same wherever the text is placed and can be moved with the node they label.
+static void capture_text_quads(float x, float y, const char* text, float scale,
+                               unsigned char cr, unsigned char cg, unsigned char cb) {
+    // Window pixels to world units (inverse of the mapping in draw_text)
+    float unit_x = scale * 2.0f * aspect_ratio / (window_width * flowchart_scale);
+    float unit_y = -scale * 2.0f / (window_height * flowchart_scale);
+    float pen_x = 0.0f;
+    float pen_y = 0.0f;
+    
+    for (const char* c = text; *c != '\0'; ++c) {
+        int glyph = glyph_index(*c);
+        if (glyph < 0) continue;
+        
+        stbtt_aligned_quad q;
+        stbtt_GetBakedQuad(cdata, FONT_TEXTURE_SIZE, FONT_TEXTURE_SIZE,
+                          glyph, &pen_x, &pen_y, &q, 1);
+        if (q.x0 == q.x1) continue;  // Nothing to draw (space)
+        
+        TextVertex *v = reserve_text_vertices(capture_text, 4);
+        if (!v) break;
+        float x0 = x + q.x0 * unit_x;
+        float x1 = x + q.x1 * unit_x;
+        float y0 = y + q.y0 * unit_y;
+        float y1 = y + q.y1 * unit_y;
+        v[0] = (TextVertex){ x0, y0, q.s0, q.t0, cr, cg, cb, 255 };
+        v[1] = (TextVertex){ x1, y0, q.s1, q.t0, cr, cg, cb, 255 };
+        v[2] = (TextVertex){ x1, y1, q.s1, q.t1, cr, cg, cb, 255 };
+        v[3] = (TextVertex){ x0, y1, q.s0, q.t1, cr, cg, cb, 255 };
+    }
+}
+
+float get_text_width(const char* text, float fontSize) {
+    if (!font_initialized || !text) return 0.0f;
+    
+    // Calculate scale based on pixel font size vs baked font size (32 pixels)
+    float scale = font_size_pixels(fontSize) / 32.0f;  // 32.0 is the baked font size
+    float width = text_advance(text) * scale;
     
     // Convert from pixel coordinates to world coordinates
     // When draw_text converts x to pixels: pixel_x = ((screen_normalized_x / aspect_ratio + 1.0f) / 2.0f) * window_width
@@ -167,87 +266,106 @@ float draw_text(float x, float y, const char* text, float fontSize, float r, flo
     if (!font_initialized || !text || font_texture == 0) {
         return 0.0f;
     }
+    FRAME_COUNT(FRAME_COUNT_TEXT_CALLS, 1);
     
-    // Convert fontSize from normalized coordinates to pixels
-    // fontSize is in normalized coordinates (typically 0.01-0.1), convert to pixels
-    // Normalized coordinates go from -1 to 1, so total range is 2.0
-    // For height, we use window_height to convert
-    // Apply flowchart scale to fontSize for block labels (but not menu/button labels)
-    float fontSizeScaled = fontSize * flowchart_scale;
-    float fontSizePixels = (fontSizeScaled * window_height) / 2.0f;  // Convert normalized height to pixels
-    if (fontSizePixels < 12.0f) fontSizePixels = 18.0f;  // Minimum readable size
-    
-    // Save current matrices
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-    
-    // Set up pixel-perfect orthographic projection
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, window_width, window_height, 0, -1, 1);
-    
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    float fontSizePixels = font_size_pixels(fontSize);
     
     // Convert normalized coordinates to pixel coordinates
     // Apply the same transformation as OpenGL: screen = FLOWCHART_SCALE * world - scrollOffset
-    // x, y are in world coordinates (normalized)
-    // scroll_offset_x and scroll_offset_y are already negative (set as -scrollOffsetX in main.c)
-    // So: screen = FLOWCHART_SCALE * world - (-scrollOffset) = FLOWCHART_SCALE * world + scrollOffset
-    // But we want: screen = FLOWCHART_SCALE * world - scrollOffset
-    // So we need to negate the scroll offsets: screen = FLOWCHART_SCALE * world - (-scroll_offset)
+    // x, y are in world coordinates (normalized), scroll offsets are in screen coordinates
     float screen_normalized_x = flowchart_scale * (float)x - (float)scroll_offset_x;
     float screen_normalized_y = flowchart_scale * (float)y - (float)scroll_offset_y;
     // X coordinate is in range [-aspectRatio, aspectRatio]
     // Y coordinate is in range [-1, 1]
-    float pixel_x = ((screen_normalized_x / aspect_ratio + 1.0f) / 2.0f) * window_width;
-    float pixel_y = ((1.0f - screen_normalized_y) / 2.0f) * window_height;
+    float origin_x = ((screen_normalized_x / aspect_ratio + 1.0f) / 2.0f) * window_width;
+    float origin_y = ((1.0f - screen_normalized_y) / 2.0f) * window_height;
     
     float scale = fontSizePixels / 32.0f;  // 32.0 is the baked font size
-    float start_x = pixel_x;
+    unsigned char cr = (unsigned char)(r * 255.0f + 0.5f);
+    unsigned char cg = (unsigned char)(g * 255.0f + 0.5f);
+    unsigned char cb = (unsigned char)(b * 255.0f + 0.5f);
+    
+    if (capture_text) {
+        capture_text_quads(x, y, text, scale, cr, cg, cb);
+        return (text_advance(text) * scale / window_width) * 2.0f;
+    }
+    
+    // Lay the glyphs out at the baked size from the origin, then scale the quads
+    // about the origin
+    float pen_x = origin_x;
+    float pen_y = origin_y;
+    for (const char* c = text; *c != '\0'; ++c) {
+        int glyph = glyph_index(*c);
+        if (glyph < 0) continue;
+        
+        stbtt_aligned_quad q;
+        stbtt_GetBakedQuad(cdata, FONT_TEXTURE_SIZE, FONT_TEXTURE_SIZE,
+                          glyph, &pen_x, &pen_y, &q, 1);
+        if (q.x0 == q.x1) continue;  // Nothing to draw (space)
+        
+        TextVertex *v = reserve_text_vertices(&frame_text, 4);
+        if (!v) break;
+        float x0 = origin_x + (q.x0 - origin_x) * scale;
+        float x1 = origin_x + (q.x1 - origin_x) * scale;
+        float y0 = origin_y + (q.y0 - origin_y) * scale;
+        float y1 = origin_y + (q.y1 - origin_y) * scale;
+        v[0] = (TextVertex){ x0, y0, q.s0, q.t0, cr, cg, cb, 255 };
+        v[1] = (TextVertex){ x1, y0, q.s1, q.t0, cr, cg, cb, 255 };
+        v[2] = (TextVertex){ x1, y1, q.s1, q.t1, cr, cg, cb, 255 };
+        v[3] = (TextVertex){ x0, y1, q.s0, q.t1, cr, cg, cb, 255 };
+    }
     
-    // Enable blending for transparency
+    // Return width in normalized coordinates
+    float pixel_width = text_advance(text) * scale;
+    return (pixel_width / window_width) * 2.0f;
+}
+
+// Draw glyph quads with the font atlas bound and blending on, in the current
+// transform; base is where the TextVertex array starts (or offset 0 of a bound
+// buffer object)
+static void draw_glyph_quads(const char *base, const VertexRange *ranges, int rangeCount) {
+    // Enable blending for transparency; the texture's alpha is multiplied with
+    // the vertex color (GL_ALPHA texture, GL_MODULATE)
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glEnable(GL_TEXTURE_2D);
     glBindTexture(GL_TEXTURE_2D, font_texture);
-    
-    // Set texture environment to modulate (multiply texture alpha with vertex color)
     glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
     
-    // Set text color - ensure it's white
-    // For GL_ALPHA textures, we need to set the color which will be multiplied with the alpha
-    glColor4f(r, g, b, 1.0f);  // Use Color4f to ensure alpha is set
-    
-    // Apply scaling
-    glTranslatef(pixel_x, pixel_y, 0);
-    glScalef(scale, scale, 1.0f);
-    glTranslatef(-pixel_x, -pixel_y, 0);
-    
-    glBegin(GL_QUADS);
-    
-    for (const char* c = text; *c != '\0'; ++c) {
-        if (*c >= FIRST_CHAR && *c < FIRST_CHAR + NUM_CHARS) {
-            stbtt_aligned_quad q;
-            stbtt_GetBakedQuad(cdata, FONT_TEXTURE_SIZE, FONT_TEXTURE_SIZE, 
-                              *c - FIRST_CHAR, &pixel_x, &pixel_y, &q, 1);
-            
-            glTexCoord2f(q.s0, q.t0); glVertex2f(q.x0, q.y0);
-            glTexCoord2f(q.s1, q.t0); glVertex2f(q.x1, q.y0);
-            glTexCoord2f(q.s1, q.t1); glVertex2f(q.x1, q.y1);
-            glTexCoord2f(q.s0, q.t1); glVertex2f(q.x0, q.y1);
-        } else if (*c == ' ') {
-            // Space character - just advance
-            pixel_x += 8.0f;
-        }
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(2, GL_FLOAT, sizeof(TextVertex), base + offsetof(TextVertex, x));
+    glTexCoordPointer(2, GL_FLOAT, sizeof(TextVertex), base + offsetof(TextVertex, s));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(TextVertex), base + offsetof(TextVertex, r));
+    for (int i = 0; i < rangeCount; i++) {
+        glDrawArrays(GL_QUADS, ranges[i].first, ranges[i].count);
+        FRAME_COUNT(FRAME_COUNT_VERTICES, ranges[i].count);
     }
-    
-    glEnd();
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
     
     glDisable(GL_TEXTURE_2D);
     glDisable(GL_BLEND);
+    FRAME_COUNT(FRAME_COUNT_DRAW_CALLS, rangeCount);
+    FRAME_COUNT(FRAME_COUNT_STATE_CHANGES, 13);  // Blending, texture and client state on and off
+}
+
+void flush_text(void) {
+    if (frame_text.count == 0) return;
+    
+    // Save current matrices and set up pixel-perfect orthographic projection
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, window_width, window_height, 0, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    
+    VertexRange all = {0, frame_text.count};
+    draw_glyph_quads((const char*)frame_text.vertices, &all, 1);
     
     // Restore matrices - restore in reverse order
     glMatrixMode(GL_MODELVIEW);
@@ -256,8 +374,13 @@ float draw_text(float x, float y, const char* text, float fontSize, float r, flo
     glPopMatrix();
     glMatrixMode(GL_MODELVIEW);
     
-    // Return width in normalized coordinates
-    float pixel_width = (pixel_x - start_x) * scale;
-    return (pixel_width / window_width) * 2.0f;
+    frame_text.count = 0;
 }
 
+void draw_text_array(const VertexArray *array, const VertexRange *ranges, int rangeCount) {
+    if (!font_initialized || array->count == 0 || rangeCount == 0) return;
+    
+    const char *base = vertex_array_bind(array);
+    draw_glyph_quads(base, ranges, rangeCount);
+    vertex_array_unbind(array);
+}
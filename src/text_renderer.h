@@ -2,6 +2,21 @@
 #define TEXT_RENDERER_H
 
 #include <GLFW/glfw3.h>
+#include "scene_renderer.h"
+
+// One corner of a glyph quad: position, atlas coordinates and color
+typedef struct {
+    float x, y;
+    float s, t;
+    unsigned char r, g, b, a;
+} TextVertex;
+
+// Growable array of glyph quads (four vertices each)
+typedef struct {
+    TextVertex *vertices;
+    int count;
+    int capacity;
+} TextBuffer;
 
 // Initialize text renderer (call once at startup)
 // fontPath: path to .ttf font file, or NULL to use built-in simple renderer
@@ -11,9 +26,32 @@ int init_text_renderer(const char* fontPath);
 void cleanup_text_renderer(void);
 
 // Draw text at position (x, y) in normalized coordinates (-1 to 1)
-// Returns width of rendered text
+// Returns width of rendered text. The glyphs are queued in window pixels (using
+// the scroll offsets and scale set at the time of the call) and reach the screen
+// at the next flush_text.
 float draw_text(float x, float y, const char* text, float fontSize, float r, float g, float b);
 
+// Draw all queued text with one draw call. Call once a layer of the frame is
+// done, so its text ends up below whatever is drawn after it.
+void flush_text(void);
+
+// Retained text: while a buffer is set (NULL stops), draw_text appends its glyph
+// quads to it in world coordinates instead of queuing them, for text that is laid
+// out once and drawn on many frames. The quads are only valid for the window size
+// and aspect ratio (see text_metrics_generation) and flowchart scale in effect
+// while capturing.
+void text_renderer_capture(TextBuffer *buffer);
+
+// Changes whenever captured text would come out at a different size
+unsigned int text_metrics_generation(void);
+
+// Draw runs of captured glyph quads (uploaded as TextVertex) in the current transform
+void draw_text_array(const VertexArray *array, const VertexRange *ranges, int rangeCount);
+
+// Room for count more vertices at the end of a buffer, or NULL if out of memory
+TextVertex* reserve_text_vertices(TextBuffer *buffer, int count);
+void free_text_buffer(TextBuffer *buffer);
+
 // Get text width without rendering
 float get_text_width(const char* text, float fontSize);
 
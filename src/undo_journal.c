@@ -0,0 +1,761 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "flowchart_state.h"
+#include "undo_journal.h"
+#include "edit_journal.h"
+
+// One undoable edit: the array lengths on both sides and the changed records
+typedef struct {
+    int countBefore[UNDO_TABLE_COUNT];
+    int countAfter[UNDO_TABLE_COUNT];
+    size_t dataSize;
+    unsigned char data[];
+} UndoStep;
+
+// Records compared at once when looking for changes; pages with no change are
+// skipped with a single memcmp
+#define UNDO_PAGE_RECORDS 64
+
+// Chart as of the current history position, with the data derived from it at the
+// time it was recorded (branch widths and positions are part of the records)
+static FlowchartState saved = { 0 };
+static Variable savedVariables[MAX_VARIABLES];
+static int savedVariableCount = 0;
+static bool journalStarted = false;
+
+// The live arrays equal the saved copy while the revision is still liveSyncedRevision
+// (set whenever the journal itself made them equal)
+static bool liveSynced = false;
+static unsigned int liveSyncedRevision = 0;
+
+// A state in the undo tree. Every state but the root owns the step that leads to
+// it from its parent. Children are a singly linked list through nextSibling
+// (newest first); free slots are chained through nextSibling as well.
+typedef struct {
+    UndoStep *step;
+    int parent;             // -1 for the root
+    int firstChild;
+    int nextSibling;
+    int redoChild;          // Child redo moves to (the last one visited), -1 = none
+    unsigned int lastVisit; // visitClock when the state was last current
+    unsigned long long contentHash;  // Hash of the chart in this state (see record_hash)
+    bool used;
+    bool onPath;            // Scratch flag: ancestor of (or equal to) the current state
+} UndoState;
+
+static UndoState *states = NULL;
+static int stateCapacity = 0;
+static int stateSlots = 0;       // Slots handed out so far (in use or free)
+static int stateCount = 0;       // States in the tree
+static int freeState = -1;
+static int rootState = -1;
+static int currentState = -1;
+static int currentDepth = 0;     // Steps from the root to the current state
+static unsigned int visitClock = 0;
+static int historyCapacity = DEFAULT_UNDO_HISTORY_CAPACITY;
+static size_t stepBytes = 0;
+static size_t memoryBudget = DEFAULT_UNDO_MEMORY_BUDGET;
+
+// Content hash of the state the document was last saved or loaded in (valid while
+// savedHashKnown; otherwise no state matches the document on disk)
+static unsigned long long savedDocumentHash = 0;
+static bool savedHashKnown = false;
+
+// Content hash of the chart being recorded, updated as changed records are found
+static unsigned long long buildHash = 0;
+
+// Step being built by undo_journal_record (reused between records)
+static unsigned char *build = NULL;
+static size_t buildSize = 0;
+static size_t buildCapacity = 0;
+
+size_t undo_record_size(int table) {
+    switch (table) {
+        case UNDO_NODES:        return sizeof(FlowNode);
+        case UNDO_CONNECTIONS:  return sizeof(Connection);
+        case UNDO_IF_BLOCKS:    return sizeof(IFBlock);
+        case UNDO_CYCLE_BLOCKS: return sizeof(CycleBlock);
+        default:                return sizeof(Variable);
+    }
+}
+
+unsigned char* undo_live_records(int table, int *count) {
+    switch (table) {
+        case UNDO_NODES:        *count = nodeCount;       return (unsigned char*)nodes;
+        case UNDO_CONNECTIONS:  *count = connectionCount; return (unsigned char*)connections;
+        case UNDO_IF_BLOCKS:    *count = ifBlockCount;    return (unsigned char*)ifBlocks;
+        case UNDO_CYCLE_BLOCKS: *count = cycleBlockCount; return (unsigned char*)cycleBlocks;
+        default:                *count = variableCount;   return (unsigned char*)variables;
+    }
+}
+
+// Hash of one record at its position. The hash of a chart is the sum of the hashes
+// of all its records, so an edit updates it from just the records it changed.
+static unsigned long long record_hash(int table, int index, const unsigned char *record, size_t size) {
+    unsigned long long hash = 14695981039346656037ull;
+    hash = (hash ^ (unsigned long long)table) * 1099511628211ull;
+    hash = (hash ^ (unsigned long long)(unsigned int)index) * 1099511628211ull;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        unsigned long long word;
+        memcpy(&word, record + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ record[i]) * 1099511628211ull;
+    }
+    return hash ^ (hash >> 29);
+}
+
+static unsigned char* saved_records(int table, int **count) {
+    switch (table) {
+        case UNDO_NODES:        *count = &saved.nodeCount;       return (unsigned char*)saved.nodes;
+        case UNDO_CONNECTIONS:  *count = &saved.connectionCount; return (unsigned char*)saved.connections;
+        case UNDO_IF_BLOCKS:    *count = &saved.ifBlockCount;    return (unsigned char*)saved.ifBlocks;
+        case UNDO_CYCLE_BLOCKS: *count = &saved.cycleBlockCount; return (unsigned char*)saved.cycleBlocks;
+        default:                *count = &savedVariableCount;    return (unsigned char*)savedVariables;
+    }
+}
+
+static int allocate_state(void) {
+    int id = freeState;
+    if (id >= 0) {
+        freeState = states[id].nextSibling;
+    } else {
+        if (stateSlots >= stateCapacity) {
+            int newCapacity = stateCapacity > 0 ? stateCapacity * 2 : 64;
+            UndoState *grown = realloc(states, (size_t)newCapacity * sizeof(UndoState));
+            if (!grown) {
+                fprintf(stderr, "Out of memory growing undo tree to %d states\n", newCapacity);
+                return -1;
+            }
+            states = grown;
+            stateCapacity = newCapacity;
+        }
+        id = stateSlots++;
+    }
+
+    UndoState *state = &states[id];
+    state->step = NULL;
+    state->parent = -1;
+    state->firstChild = -1;
+    state->nextSibling = -1;
+    state->redoChild = -1;
+    state->lastVisit = ++visitClock;
+    state->contentHash = 0;
+    state->used = true;
+    state->onPath = false;
+    stateCount++;
+    return id;
+}
+
+static void free_step(UndoState *state) {
+    if (state->step) {
+        stepBytes -= sizeof(UndoStep) + state->step->dataSize;
+        free(state->step);
+        state->step = NULL;
+    }
+}
+
+static void release_state_slot(int id) {
+    states[id].used = false;
+    states[id].nextSibling = freeState;
+    freeState = id;
+    stateCount--;
+}
+
+// Free a state with no children, unlinking it from its parent
+static void free_state(int id) {
+    UndoState *state = &states[id];
+    if (state->parent >= 0) {
+        UndoState *parent = &states[state->parent];
+        int *link = &parent->firstChild;
+        while (*link != id) {
+            link = &states[*link].nextSibling;
+        }
+        *link = state->nextSibling;
+        if (parent->redoChild == id) {
+            parent->redoChild = -1;
+        }
+    }
+    free_step(state);
+    release_state_slot(id);
+}
+
+static void free_all_states(void) {
+    for (int i = 0; i < stateSlots; i++) {
+        if (states[i].used) {
+            free_step(&states[i]);
+        }
+    }
+    stateSlots = 0;
+    stateCount = 0;
+    freeState = -1;
+    rootState = -1;
+    currentState = -1;
+    currentDepth = 0;
+}
+
+static void update_history_counts(void) {
+    int redoSteps = 0;
+    for (int s = states[currentState].redoChild; s >= 0; s = states[s].redoChild) {
+        redoSteps++;
+    }
+    undoHistoryIndex = currentDepth;
+    undoHistoryCount = currentDepth + redoSteps + 1;
+}
+
+void undo_journal_reset(void) {
+    free_all_states();
+    rootState = allocate_state();
+    currentState = rootState;
+    journalStarted = rootState >= 0 && capture_flowchart_state(&saved);
+    memcpy(savedVariables, variables, (size_t)variableCount * sizeof(Variable));
+    savedVariableCount = variableCount;
+    liveSynced = journalStarted;
+    liveSyncedRevision = flowchart_revision();
+    if (journalStarted) {
+        // The only full pass over the records; edits update the hash from there
+        unsigned long long hash = 0;
+        for (int t = 0; t < UNDO_TABLE_COUNT; t++) {
+            size_t size = undo_record_size(t);
+            int *count;
+            const unsigned char *records = saved_records(t, &count);
+            for (int i = 0; i < *count; i++) {
+                hash += record_hash(t, i, records + (size_t)i * size, size);
+            }
+        }
+        states[rootState].contentHash = hash;
+        savedDocumentHash = hash;
+        savedHashKnown = true;
+        update_history_counts();
+    } else {
+        undoHistoryCount = 0;
+        undoHistoryIndex = -1;
+    }
+}
+
+static bool reserve_build(size_t extra) {
+    if (buildSize + extra <= buildCapacity) {
+        return true;
+    }
+    size_t newCapacity = buildCapacity > 0 ? buildCapacity : 4096;
+    while (newCapacity < buildSize + extra) {
+        newCapacity *= 2;
+    }
+    unsigned char *grown = realloc(build, newCapacity);
+    if (!grown) {
+        fprintf(stderr, "Out of memory recording an undo step of %zu bytes\n", newCapacity);
+        return false;
+    }
+    build = grown;
+    buildCapacity = newCapacity;
+    return true;
+}
+
+// Add a run of changed records to the build: their saved (old) contents, or zeros
+// for records the saved copy does not have yet
+static bool append_change(int table, int index, int count, const unsigned char *old, int savedCount) {
+    size_t size = undo_record_size(table);
+    UndoChange change = { table, index, count };
+    if (!reserve_build(sizeof(change) + (size_t)count * size)) {
+        return false;
+    }
+    memcpy(build + buildSize, &change, sizeof(change));
+    buildSize += sizeof(change);
+
+    int existing = savedCount - index;
+    if (existing > count) existing = count;
+    if (existing < 0) existing = 0;
+    if (existing > 0) {
+        memcpy(build + buildSize, old + (size_t)index * size, (size_t)existing * size);
+    }
+    if (existing < count) {
+        memset(build + buildSize + (size_t)existing * size, 0, (size_t)(count - existing) * size);
+    }
+    buildSize += (size_t)count * size;
+    return true;
+}
+
+// Add the runs of records that differ between the saved and live copies of one table
+static bool diff_table(int table) {
+    size_t size = undo_record_size(table);
+    int liveCount;
+    int *savedCount;
+    const unsigned char *live = undo_live_records(table, &liveCount);
+    const unsigned char *old = saved_records(table, &savedCount);
+    int common = liveCount < *savedCount ? liveCount : *savedCount;
+    int total = liveCount > *savedCount ? liveCount : *savedCount;
+
+    int i = 0;
+    while (i < total) {
+        // Skip whole unchanged pages, then single unchanged records
+        if (i % UNDO_PAGE_RECORDS == 0 && i + UNDO_PAGE_RECORDS <= common &&
+            memcmp(old + (size_t)i * size, live + (size_t)i * size, UNDO_PAGE_RECORDS * size) == 0) {
+            i += UNDO_PAGE_RECORDS;
+            continue;
+        }
+        if (i < common && memcmp(old + (size_t)i * size, live + (size_t)i * size, size) == 0) {
+            i++;
+            continue;
+        }
+        int runStart = i;
+        while (i < total && (i >= common || memcmp(old + (size_t)i * size, live + (size_t)i * size, size) != 0)) {
+            i++;
+        }
+        if (!append_change(table, runStart, i - runStart, old, *savedCount)) {
+            return false;
+        }
+        for (int r = runStart; r < i; r++) {
+            if (r < *savedCount) {
+                buildHash -= record_hash(table, r, old + (size_t)r * size, size);
+            }
+            if (r < liveCount) {
+                buildHash += record_hash(table, r, live + (size_t)r * size, size);
+            }
+        }
+    }
+    return true;
+}
+
+// Exchange the records a step holds with the saved copy, moving the saved copy to
+// the other side of the step (forward = redo, otherwise undo)
+static bool swap_step_with_saved(UndoStep *step, bool forward) {
+    const int *counts = forward ? step->countAfter : step->countBefore;
+    const int *otherCounts = forward ? step->countBefore : step->countAfter;
+    int needed[UNDO_TABLE_COUNT];
+    for (int t = 0; t < UNDO_TABLE_COUNT; t++) {
+        needed[t] = counts[t] > otherCounts[t] ? counts[t] : otherCounts[t];
+    }
+    if (!reserve_flowchart_state(&saved, needed[UNDO_NODES], needed[UNDO_CONNECTIONS],
+                                 needed[UNDO_IF_BLOCKS], needed[UNDO_CYCLE_BLOCKS])) {
+        return false;
+    }
+
+    size_t offset = 0;
+    while (offset < step->dataSize) {
+        UndoChange change;
+        memcpy(&change, step->data + offset, sizeof(change));
+        offset += sizeof(change);
+        size_t size = undo_record_size(change.table);
+        int *savedCount;
+        unsigned char *records = saved_records(change.table, &savedCount) + (size_t)change.index * size;
+        unsigned char *held = step->data + offset;
+
+        // Swap in fixed-size pieces through a small buffer
+        unsigned char buffer[1024];
+        size_t remaining = (size_t)change.count * size;
+        while (remaining > 0) {
+            size_t piece = remaining < sizeof(buffer) ? remaining : sizeof(buffer);
+            memcpy(buffer, records, piece);
+            memcpy(records, held, piece);
+            memcpy(held, buffer, piece);
+            records += piece;
+            held += piece;
+            remaining -= piece;
+        }
+        offset += (size_t)change.count * size;
+    }
+
+    for (int t = 0; t < UNDO_TABLE_COUNT; t++) {
+        int *savedCount;
+        saved_records(t, &savedCount);
+        *savedCount = counts[t];
+    }
+    return true;
+}
+
+// Bring the saved copy up to date with the live arrays after recording a step.
+// The step holds the old contents, so the saved copy can simply take the live ones.
+static bool copy_changes_to_saved(const UndoStep *step) {
+    if (!reserve_flowchart_state(&saved, nodeCount, connectionCount, ifBlockCount, cycleBlockCount)) {
+        return false;
+    }
+    size_t offset = 0;
+    while (offset < step->dataSize) {
+        UndoChange change;
+        memcpy(&change, step->data + offset, sizeof(change));
+        size_t size = undo_record_size(change.table);
+        offset += sizeof(change) + (size_t)change.count * size;
+
+        int liveCount;
+        int *savedCount;
+        const unsigned char *live = undo_live_records(change.table, &liveCount);
+        unsigned char *records = saved_records(change.table, &savedCount);
+        int copyCount = liveCount - change.index;
+        if (copyCount > change.count) copyCount = change.count;
+        if (copyCount > 0) {
+            memcpy(records + (size_t)change.index * size, live + (size_t)change.index * size, (size_t)copyCount * size);
+        }
+    }
+    for (int t = 0; t < UNDO_TABLE_COUNT; t++) {
+        int *savedCount;
+        saved_records(t, &savedCount);
+        *savedCount = step->countAfter[t];
+    }
+    return true;
+}
+
+static bool ensure_live_capacity(void) {
+    return ensure_node_capacity(saved.nodeCount) &&
+           ensure_connection_capacity(saved.connectionCount) &&
+           ensure_if_block_capacity(saved.ifBlockCount) &&
+           ensure_cycle_block_capacity(saved.cycleBlockCount);
+}
+
+static void take_saved_counts(void) {
+    nodeCount = saved.nodeCount;
+    connectionCount = saved.connectionCount;
+    ifBlockCount = saved.ifBlockCount;
+    cycleBlockCount = saved.cycleBlockCount;
+    variableCount = savedVariableCount;
+}
+
+static void mark_live_synced(void) {
+    liveSynced = true;
+    liveSyncedRevision = flowchart_revision();
+}
+
+// Take a step's runs out of the free slot list and indexes (before the live
+// records are overwritten) or put them back (after)
+static void update_step_indexes(const UndoStep *step, bool add) {
+    size_t offset = 0;
+    while (offset < step->dataSize) {
+        UndoChange change;
+        memcpy(&change, step->data + offset, sizeof(change));
+        offset += sizeof(change) + (size_t)change.count * undo_record_size(change.table);
+        switch (change.table) {
+            case UNDO_NODES:
+                (add ? index_nodes : unindex_nodes)(change.index, change.count);
+                break;
+            case UNDO_CONNECTIONS:
+                (add ? index_connections : unindex_connections)(change.index, change.count);
+                break;
+            case UNDO_IF_BLOCKS:
+                (add ? index_if_blocks : unindex_if_blocks)(change.index, change.count);
+                break;
+            case UNDO_CYCLE_BLOCKS:
+                (add ? index_cycle_blocks : unindex_cycle_blocks)(change.index, change.count);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Make the live arrays equal to the saved copy, writing only records that differ
+static bool sync_live_to_saved(void) {
+    if (!ensure_live_capacity()) {
+        return false;
+    }
+
+    for (int t = 0; t < UNDO_TABLE_COUNT; t++) {
+        size_t size = undo_record_size(t);
+        int liveCount;
+        int *savedCount;
+        unsigned char *live = undo_live_records(t, &liveCount);
+        const unsigned char *old = saved_records(t, &savedCount);
+        for (int i = 0; i < *savedCount; i++) {
+            if (i >= liveCount || memcmp(live + i * size, old + i * size, size) != 0) {
+                memcpy(live + i * size, old + i * size, size);
+            }
+        }
+    }
+
+    take_saved_counts();
+    rebuild_free_node_slots();
+    invalidate_adjacency();
+    invalidate_block_index();
+    mark_live_synced();
+    return true;
+}
+
+// After a step was swapped into the saved copy: copy just its records to the live
+// arrays if they matched the saved copy before, otherwise compare everything.
+// The free slot list and indexes are updated from the copied runs alone.
+static bool update_live_from_step(const UndoStep *step) {
+    if (!liveSynced || liveSyncedRevision != flowchart_revision()) {
+        return sync_live_to_saved();
+    }
+    if (!ensure_live_capacity()) {
+        return false;
+    }
+
+    update_step_indexes(step, false);
+    size_t offset = 0;
+    while (offset < step->dataSize) {
+        UndoChange change;
+        memcpy(&change, step->data + offset, sizeof(change));
+        size_t size = undo_record_size(change.table);
+        offset += sizeof(change) + (size_t)change.count * size;
+
+        int liveCount;
+        int *savedCount;
+        unsigned char *live = undo_live_records(change.table, &liveCount);
+        const unsigned char *records = saved_records(change.table, &savedCount);
+        int copyCount = *savedCount - change.index;
+        if (copyCount > change.count) copyCount = change.count;
+        if (copyCount > 0) {
+            memcpy(live + (size_t)change.index * size, records + (size_t)change.index * size, (size_t)copyCount * size);
+        }
+    }
+
+    take_saved_counts();
+    update_step_indexes(step, true);
+    mark_flowchart_changed();
+    mark_live_synced();
+    return true;
+}
+
+// Flag the current state and its ancestors, which pruning must keep
+static void mark_current_path(void) {
+    for (int i = 0; i < stateSlots; i++) {
+        states[i].onPath = false;
+    }
+    for (int s = currentState; s >= 0; s = states[s].parent) {
+        states[s].onPath = true;
+    }
+}
+
+// Remove one state to make room: the least recently visited leaf off the current
+// path, or when only that path is left, the root (its child becomes the root).
+// Returns false if nothing can go without losing the last undo step.
+static bool prune_one_state(void) {
+    int oldest = -1;
+    for (int i = 0; i < stateSlots; i++) {
+        const UndoState *state = &states[i];
+        if (state->used && !state->onPath && state->firstChild < 0 &&
+            (oldest < 0 || state->lastVisit < states[oldest].lastVisit)) {
+            oldest = i;
+        }
+    }
+    if (oldest >= 0) {
+        free_state(oldest);
+        return true;
+    }
+
+    if (currentDepth <= 1) {
+        return false;
+    }
+    int newRoot = states[rootState].firstChild;
+    states[rootState].firstChild = -1;
+    free_state(rootState);
+    free_step(&states[newRoot]);
+    states[newRoot].parent = -1;
+    rootState = newRoot;
+    currentDepth--;
+    return true;
+}
+
+// Prune until the tree fits both the memory budget and the step capacity
+static void enforce_history_limits(void) {
+    mark_current_path();
+    while ((stepBytes > memoryBudget || stateCount - 1 > historyCapacity) && prune_one_state()) {
+    }
+}
+
+bool undo_journal_record(void) {
+    // A history cleared from outside (undoHistoryCount = 0) starts over here
+    if (!journalStarted || undoHistoryCount == 0) {
+        undo_journal_reset();
+        return journalStarted;
+    }
+
+    buildSize = 0;
+    buildHash = states[currentState].contentHash;
+    for (int t = 0; t < UNDO_TABLE_COUNT; t++) {
+        if (!diff_table(t)) {
+            return false;
+        }
+    }
+
+    // Nothing changed (a no-op or cancelled edit): the current state already is
+    // this one, so recording it would only push real steps out of the history
+    if (buildSize == 0) {
+        liveSynced = true;
+        liveSyncedRevision = flowchart_revision();
+        return true;
+    }
+
+    int child = allocate_state();
+    if (child < 0) {
+        return false;
+    }
+
+    UndoStep *step = malloc(sizeof(UndoStep) + buildSize);
+    if (!step) {
+        fprintf(stderr, "Out of memory recording an undo step of %zu bytes\n", buildSize);
+        release_state_slot(child);
+        return false;
+    }
+    for (int t = 0; t < UNDO_TABLE_COUNT; t++) {
+        int liveCount;
+        int *savedCount;
+        undo_live_records(t, &liveCount);
+        saved_records(t, &savedCount);
+        step->countBefore[t] = *savedCount;
+        step->countAfter[t] = liveCount;
+    }
+    step->dataSize = buildSize;
+    if (buildSize > 0) {
+        memcpy(step->data, build, buildSize);
+    }
+
+    if (!copy_changes_to_saved(step)) {
+        free(step);
+        release_state_slot(child);
+        return false;
+    }
+
+    // The new state becomes a child of the current one; after an undo the old redo
+    // steps stay in the tree as another branch
+    UndoState *state = &states[child];
+    state->step = step;
+    state->contentHash = buildHash;
+    state->parent = currentState;
+    state->nextSibling = states[currentState].firstChild;
+    states[currentState].firstChild = child;
+    states[currentState].redoChild = child;
+    currentState = child;
+    currentDepth++;
+    stepBytes += sizeof(UndoStep) + step->dataSize;
+    edit_journal_log_step(step->data, step->dataSize);
+
+    enforce_history_limits();
+    update_history_counts();
+    liveSynced = true;
+    liveSyncedRevision = flowchart_revision();
+    return true;
+}
+
+bool undo_journal_undo(void) {
+    if (!journalStarted || currentState == rootState) {
+        return false;
+    }
+    UndoState *state = &states[currentState];
+    if (!swap_step_with_saved(state->step, false)) {
+        return false;
+    }
+    states[state->parent].redoChild = currentState;
+    currentState = state->parent;
+    currentDepth--;
+    states[currentState].lastVisit = ++visitClock;
+    update_history_counts();
+    if (!update_live_from_step(state->step)) {
+        return false;
+    }
+    edit_journal_log_step(state->step->data, state->step->dataSize);
+    return true;
+}
+
+bool undo_journal_redo(void) {
+    if (!journalStarted || states[currentState].redoChild < 0) {
+        return false;
+    }
+    UndoState *child = &states[states[currentState].redoChild];
+    if (!swap_step_with_saved(child->step, true)) {
+        return false;
+    }
+    currentState = states[currentState].redoChild;
+    currentDepth++;
+    child->lastVisit = ++visitClock;
+    update_history_counts();
+    if (!update_live_from_step(child->step)) {
+        return false;
+    }
+    edit_journal_log_step(child->step->data, child->step->dataSize);
+    return true;
+}
+
+bool undo_journal_jump(int target) {
+    if (!journalStarted || target < 0 || target >= stateSlots || !states[target].used) {
+        return false;
+    }
+
+    // Undo up to the closest common ancestor of the current and target states
+    mark_current_path();
+    int common = target;
+    while (!states[common].onPath) {
+        common = states[common].parent;
+    }
+    while (currentState != common) {
+        if (!undo_journal_undo()) {
+            return false;
+        }
+    }
+
+    // Then redo down towards the target, steering each redo along the way
+    while (currentState != target) {
+        int next = target;
+        while (states[next].parent != currentState) {
+            next = states[next].parent;
+        }
+        states[currentState].redoChild = next;
+        if (!undo_journal_redo()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int undo_current_state(void) {
+    return journalStarted ? currentState : -1;
+}
+
+int undo_state_parent(int state) {
+    return states[state].parent;
+}
+
+int undo_state_first_child(int state) {
+    return states[state].firstChild;
+}
+
+int undo_state_next_sibling(int state) {
+    return states[state].nextSibling;
+}
+
+bool undo_journal_revert(void) {
+    if (!journalStarted) {
+        return false;
+    }
+    return sync_live_to_saved();
+}
+
+void set_undo_memory_budget(size_t bytes) {
+    memoryBudget = bytes;
+    if (journalStarted) {
+        enforce_history_limits();
+        update_history_counts();
+    }
+}
+
+void set_undo_history_capacity(int capacity) {
+    historyCapacity = capacity < 1 ? 1 : capacity;
+    if (journalStarted) {
+        enforce_history_limits();
+        update_history_counts();
+    }
+}
+
+unsigned long long undo_journal_hash(void) {
+    return journalStarted ? states[currentState].contentHash : 0;
+}
+
+void undo_journal_set_saved(bool saved) {
+    savedDocumentHash = undo_journal_hash();
+    savedHashKnown = saved;
+}
+
+bool undo_journal_dirty(void) {
+    return journalStarted && (!savedHashKnown || states[currentState].contentHash != savedDocumentHash);
+}
+
+size_t undo_memory_used(void) {
+    return stepBytes + (size_t)stateCapacity * sizeof(UndoState) + sizeof(savedVariables) +
+           (size_t)saved.nodeCapacity * sizeof(FlowNode) +
+           (size_t)saved.connectionCapacity * sizeof(Connection) +
+           (size_t)saved.ifBlockCapacity * sizeof(IFBlock) +
+           (size_t)saved.cycleBlockCapacity * sizeof(CycleBlock);
+}
@@ -0,0 +1,103 @@
+#ifndef UNDO_JOURNAL_H
+#define UNDO_JOURNAL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Memory the undo steps may use before the least recently visited are pruned
+#define DEFAULT_UNDO_MEMORY_BUDGET (16 * 1024 * 1024)
+
+// Most undo steps kept, whatever their size (see set_undo_history_capacity)
+#define DEFAULT_UNDO_HISTORY_CAPACITY 1024
+
+// The record arrays a step can change
+typedef enum {
+    UNDO_NODES,
+    UNDO_CONNECTIONS,
+    UNDO_IF_BLOCKS,
+    UNDO_CYCLE_BLOCKS,
+    UNDO_VARIABLES,      // Variable table, derived from the declare blocks
+    UNDO_TABLE_COUNT
+} UndoTable;
+
+// A run of consecutive changed records of one table. In a step's data each
+// header is followed by the contents of those records on the other side of the
+// step: the old contents while the step is applied, the new ones once it has been
+// undone. Undo and redo swap them with the saved copy. The edit journal
+// (edit_journal.h) writes steps to disk as the same runs.
+typedef struct {
+    int table;
+    int index;
+    int count;
+} UndoChange;
+
+// Undo journal (undo_journal.c)
+// History is a tree of states joined by steps. Each step holds only the nodes,
+// connections, IF blocks, cycle blocks and variable table entries an edit changed,
+// so it costs memory in proportion to the edit rather than the chart. Steps are
+// recorded after layout, so branch widths and positions come back with the records
+// and undo/redo need no relayout or re-parse. The journal keeps one copy of the
+// chart as of the current state; recording diffs the live arrays against it, and
+// moving along a step swaps its records with that copy and brings the live arrays
+// back in line with it.
+// Editing after an undo starts a new branch instead of discarding the redo steps.
+// Redo follows the branch visited last. When the memory budget or step capacity
+// is exceeded, the least recently visited states off the current path are pruned
+// first, then the oldest states of the path itself.
+// undoHistoryCount / undoHistoryIndex describe the current path like a linear
+// history: states from the root through the redo steps, and the current depth.
+
+// Start a new history whose only state is the live chart
+void undo_journal_reset(void);
+
+// Record the changes made since the current state as a new child state and move to
+// it. Returns false if memory could not be allocated.
+bool undo_journal_record(void);
+
+// Move the live arrays to the parent state / the last visited child. They return
+// false if there is no step to undo or redo.
+bool undo_journal_undo(void);
+bool undo_journal_redo(void);
+
+// Move to any state in the tree (undoing to the common ancestor, then redoing).
+// Returns false if the state does not exist.
+bool undo_journal_jump(int state);
+
+// Walking the tree: state ids are valid until the state is pruned, -1 = none
+int undo_current_state(void);
+int undo_state_parent(int state);
+int undo_state_first_child(int state);
+int undo_state_next_sibling(int state);
+
+// Throw away unrecorded changes to the live arrays, returning to the current state
+bool undo_journal_revert(void);
+
+// Memory limit for undo steps (at least one undo step is always kept)
+void set_undo_memory_budget(size_t bytes);
+
+// Most steps the tree holds (at least 1)
+void set_undo_history_capacity(int capacity);
+
+// Size of one record of a table, and the live array behind it with its length
+size_t undo_record_size(int table);
+unsigned char* undo_live_records(int table, int *count);
+
+// Content hash of the chart at the current state. Each state is tagged with one;
+// recording updates it from the records the edit changed rather than rehashing
+// the chart, and an edit that changes nothing records no state at all.
+unsigned long long undo_journal_hash(void);
+
+// Remember the current state as the one on disk (saved: after saving), or note
+// that no state in the history matches the file (after replaying recovered edits).
+// A reset counts as saved.
+void undo_journal_set_saved(bool saved);
+
+// The chart differs from the last save or load: for the title bar, and for deciding
+// whether there is anything to autosave. Going back to the saved content by undo or
+// by editing it back clears it again.
+bool undo_journal_dirty(void);
+
+// Bytes spent on undo: the steps, the tree and the journal's copy of the chart
+size_t undo_memory_used(void);
+
+#endif // UNDO_JOURNAL_H